@@ -0,0 +1,193 @@
+#include "AppConfig.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    // Deep enough for any sane layout of config files; a file that includes itself hits it quickly.
+    const int MAX_CONFIG_DEPTH = 8;
+    // Each frame in flight holds its own command buffers, fences and query slots.
+    const long long MAX_FRAMES_IN_FLIGHT = 16;
+
+    std::string trim(const std::string& s) {
+        auto begin = s.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        auto end = s.find_last_not_of(" \t\r");
+        return s.substr(begin, end - begin + 1);
+    }
+
+    bool parseBool(const std::string& key, const std::string& value) {
+        if (value == "1" || value == "true" || value == "on" || value == "yes") return true;
+        if (value == "0" || value == "false" || value == "off" || value == "no") return false;
+        throw std::runtime_error("Expected on/off for " + key + ", got '" + value + "'");
+    }
+
+    // max never exceeds what the field's type holds, so the cast after never truncates.
+    long long parseInt(const std::string& key, const std::string& value, long long min, long long max) {
+        char* end = nullptr;
+        long long result = std::strtoll(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || result < min || result > max) {
+            throw std::runtime_error("Bad value for " + key + ": '" + value + "'");
+        }
+        return result;
+    }
+
+    // In (0, max]. NaN and infinity are refused.
+    double parseDouble(const std::string& key, const std::string& value, double max = std::numeric_limits<double>::max()) {
+        char* end = nullptr;
+        double result = std::strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || !std::isfinite(result) || !(result > 0 && result <= max)) {
+            throw std::runtime_error("Bad value for " + key + ": '" + value + "'");
+        }
+        return result;
+    }
+
+    const long long INT_MAXIMUM = std::numeric_limits<int>::max();
+    const long long UINT32_MAXIMUM = std::numeric_limits<std::uint32_t>::max();
+}
+
+void AppConfig::set(const std::string& key, const std::string& value) {
+    if (key == "width") {
+        width = static_cast<int>(parseInt(key, value, 1, INT_MAXIMUM));
+    } else if (key == "height") {
+        height = static_cast<int>(parseInt(key, value, 1, INT_MAXIMUM));
+    } else if (key == "resolution") {
+        auto x = value.find('x');
+        if (x == std::string::npos) {
+            throw std::runtime_error("Expected WxH for resolution, got '" + value + "'");
+        }
+        set("width", value.substr(0, x));
+        set("height", value.substr(x + 1));
+    } else if (key == "validation") {
+        validation = parseBool(key, value);
+    } else if (key == "device") {
+        device = value;
+    } else if (key == "frames-in-flight") {
+        framesInFlight = static_cast<std::uint32_t>(parseInt(key, value, 1, MAX_FRAMES_IN_FLIGHT));
+    } else if (key == "present-mode") {
+        if (value == "fifo") presentMode = PresentModePreference::Fifo;
+        else if (value == "mailbox") presentMode = PresentModePreference::Mailbox;
+        else if (value == "immediate") presentMode = PresentModePreference::Immediate;
+        else throw std::runtime_error("Unknown present mode '" + value + "'");
+    } else if (key == "mode") {
+        if (value == "windowed") mode = RunMode::Windowed;
+        else if (value == "headless") mode = RunMode::Headless;
+        else if (value == "benchmark") mode = RunMode::Benchmark;
+        else throw std::runtime_error("Unknown mode '" + value + "'");
+    } else if (key == "frames") {
+        frameCount = static_cast<std::uint32_t>(parseInt(key, value, 1, UINT32_MAXIMUM));
+    } else if (key == "target-fps") {
+        targetFrameMs = 1000.0 / parseDouble(key, value);
+    } else if (key == "min-render-scale") {
+        minRenderScale = parseDouble(key, value, 1.0);
+    } else if (key == "dynamic-resolution") {
+        dynamicResolution = parseBool(key, value);
+    } else if (key == "verbose") {
+        verbose = parseBool(key, value);
+    } else if (key == "capture") {
+        capturePath = value;
+    } else if (key == "capture-first-frame") {
+        captureFirstFrame = static_cast<std::uint32_t>(parseInt(key, value, 0, UINT32_MAXIMUM));
+    } else if (key == "capture-frames") {
+        captureFrameCount = static_cast<std::uint32_t>(parseInt(key, value, 1, UINT32_MAXIMUM));
+    } else if (key == "profile") {
+        profilePath = value;
+    } else if (key == "config") {
+        loadFile(value);
+    } else {
+        throw std::runtime_error("Unknown option '" + key + "'");
+    }
+}
+
+void AppConfig::loadFile(const std::string& path) {
+    if (configDepth >= MAX_CONFIG_DEPTH) {
+        throw std::runtime_error("Config files nested more than " + std::to_string(MAX_CONFIG_DEPTH) + " deep at " + path +
+                                 ", does one include itself?");
+    }
+    // Back out of the nesting however this file ends.
+    struct DepthGuard {
+        int& depth;
+        ~DepthGuard() { depth--; }
+    } guard = {++configDepth};
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open config file " + path);
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        auto equals = line.find('=');
+        if (equals == std::string::npos) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected key = value");
+        }
+        set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)));
+    }
+}
+
+bool AppConfig::parseCommandLine(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return false;
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            throw std::runtime_error("Unexpected argument '" + arg + "'");
+        }
+        arg = arg.substr(2);
+        // Flags without a value.
+        if (arg == "headless" || arg == "benchmark" || arg == "windowed") {
+            set("mode", arg);
+            continue;
+        }
+        if (arg == "validation" || arg == "verbose") {
+            set(arg, "on");
+            continue;
+        }
+        if (arg == "no-validation") {
+            set("validation", "off");
+            continue;
+        }
+        // --key=value or --key value.
+        auto equals = arg.find('=');
+        if (equals != std::string::npos) {
+            set(arg.substr(0, equals), arg.substr(equals + 1));
+        } else if (i + 1 < argc) {
+            set(arg, argv[++i]);
+        } else {
+            throw std::runtime_error("Missing value for --" + arg);
+        }
+    }
+    return true;
+}
+
+void AppConfig::printUsage(const char* program) {
+    std::cout << "usage: " << program << " [options]\n"
+        "  --config FILE             read key = value options from FILE (same names as below)\n"
+        "  --resolution WxH          window size (or --width N --height N)\n"
+        "  --device SEL              GPU by index, UUID or name substring\n"
+        "  --validation | --no-validation\n"
+        "  --frames-in-flight N      1 to 16\n"
+        "  --present-mode fifo|mailbox|immediate\n"
+        "  --mode windowed|headless|benchmark  (or --windowed, --headless, --benchmark)\n"
+        "  --frames N                frames to run in headless/benchmark mode\n"
+        "  --target-fps N            dynamic resolution frame-time target\n"
+        "  --min-render-scale S      lowest dynamic resolution scale, in (0, 1]\n"
+        "  --dynamic-resolution on|off\n"
+        "  --verbose                 print extensions and layers\n"
+        "  --capture FILE            record GPU work for vtreplay\n"
+        "  --capture-first-frame N   first captured frame (default 0)\n"
+        "  --capture-frames N        number of captured frames (default 1)\n"
+        "  --profile FILE            write CPU/GPU zones as Chrome trace JSON\n";
+}
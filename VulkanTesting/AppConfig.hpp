@@ -0,0 +1,60 @@
+#ifndef AppConfig_hpp
+#define AppConfig_hpp
+
+#include <cstdint>
+#include <string>
+
+enum class RunMode {
+    Windowed,  // Normal interactive run.
+    Headless,  // No window or surface, runs a fixed number of frames.
+    Benchmark, // Fixed number of frames, prints frame-time statistics on exit.
+};
+
+enum class PresentModePreference {
+    Fifo,
+    Mailbox,
+    Immediate,
+};
+
+// Everything that used to be a compile-time constant. Filled from defaults, then an optional
+// config file, then the command line, so scripts can sweep settings without rebuilding.
+struct AppConfig {
+    int width = 800;
+    int height = 600;
+#ifdef NDEBUG
+    bool validation = false;
+#else
+    bool validation = true;
+#endif
+    // Empty = best score. Otherwise an index ("1"), a UUID ("a1b2...") or a substring of the device name.
+    std::string device;
+    std::uint32_t framesInFlight = 2;
+    PresentModePreference presentMode = PresentModePreference::Fifo;
+    RunMode mode = RunMode::Windowed;
+    std::uint32_t frameCount = 1000; // For headless and benchmark runs.
+    double targetFrameMs = 1000.0 / 60.0;
+    double minRenderScale = 0.5; // In (0, 1].
+    bool dynamicResolution = true;
+    bool verbose = false; // Print extension and layer lists during startup.
+    // GPU capture for vtreplay. Empty = off. Frames [captureFirstFrame, captureFirstFrame + captureFrameCount).
+    std::string capturePath;
+    std::uint32_t captureFirstFrame = 0;
+    std::uint32_t captureFrameCount = 1;
+    // Zone profile (Chrome trace JSON) covering startup, every frame and shutdown. Empty = off.
+    std::string profilePath;
+
+    // Parses argv. Throws std::runtime_error on bad input; returns false if --help was printed.
+    bool parseCommandLine(int argc, char** argv);
+    // Reads "key = value" lines; '#' starts a comment. Keys are the long option names. A config key
+    // reads another file in place, nested at most a few levels.
+    void loadFile(const std::string& path);
+
+    static void printUsage(const char* program);
+
+private:
+    int configDepth = 0; // Config files being read, outermost included.
+
+    void set(const std::string& key, const std::string& value);
+};
+
+#endif /* AppConfig_hpp */
@@ -0,0 +1,256 @@
+#include "AssetIO.hpp"
+#include "Profiler.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef VT_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+AssetIOService::AssetIOService(unsigned workerCount, Dispatcher dispatch) : dispatch(std::move(dispatch)) {
+#ifdef VT_HAVE_IO_URING
+    // A single thread drives the ring; the kernel provides the parallelism.
+    // Probe once so that kernels without io_uring (or seccomp'd containers) fall back cleanly.
+    io_uring probe;
+    if (io_uring_queue_init(8, &probe, 0) == 0) {
+        io_uring_queue_exit(&probe);
+        useRing = true;
+        workers.emplace_back(&AssetIOService::ringWorker, this);
+        return;
+    }
+#endif
+    if (workerCount == 0) {
+        workerCount = 1;
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers.emplace_back(&AssetIOService::preadWorker, this);
+    }
+}
+
+AssetIOService::~AssetIOService() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& file : openFiles) {
+        close(file.second);
+    }
+}
+
+void AssetIOService::submit(IORequest request) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stopping) {
+            throw std::runtime_error("AssetIOService: submit after shutdown.");
+        }
+        queues[static_cast<int>(request.priority)].push_back(std::move(request));
+        pending++;
+    }
+    queueCondition.notify_one();
+}
+
+void AssetIOService::submit(std::vector<IORequest> batch) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stopping) {
+            throw std::runtime_error("AssetIOService: submit after shutdown.");
+        }
+        for (auto& request : batch) {
+            queues[static_cast<int>(request.priority)].push_back(std::move(request));
+        }
+        pending += batch.size();
+    }
+    queueCondition.notify_all();
+}
+
+void AssetIOService::waitIdle() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idleCondition.wait(lock, [this] { return pending == 0; });
+}
+
+void AssetIOService::closeFile(const std::string& path) {
+    std::lock_guard<std::mutex> lock(fdMutex);
+    auto found = openFiles.find(path);
+    if (found != openFiles.end()) {
+        close(found->second);
+        openFiles.erase(found);
+    }
+}
+
+std::uint64_t AssetIOService::fileSize(const std::string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("AssetIOService: cannot stat " + path);
+    }
+    return static_cast<std::uint64_t>(info.st_size);
+}
+
+const char* AssetIOService::backendName() const {
+    return useRing ? "io_uring" : "pread thread pool";
+}
+
+std::vector<IORequest> AssetIOService::popBatch(std::size_t maxCount, bool wait) {
+    std::vector<IORequest> batch;
+    std::unique_lock<std::mutex> lock(queueMutex);
+    auto hasWork = [this] {
+        for (const auto& queue : queues) {
+            if (!queue.empty()) return true;
+        }
+        return false;
+    };
+    if (wait) {
+        queueCondition.wait(lock, [&] { return stopping || hasWork(); });
+    }
+    for (auto& queue : queues) {
+        while (!queue.empty() && batch.size() < maxCount) {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+    }
+    return batch;
+}
+
+int AssetIOService::fileDescriptor(const std::string& path) {
+    std::lock_guard<std::mutex> lock(fdMutex);
+    auto found = openFiles.find(path);
+    if (found != openFiles.end()) {
+        return found->second;
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        openFiles.emplace(path, fd);
+    }
+    return fd;
+}
+
+void AssetIOService::complete(IORequest&& request, std::uint64_t bytesRead) {
+    auto finish = [this, request = std::move(request), bytesRead]() {
+        if (request.onComplete) {
+            request.onComplete(request, bytesRead);
+        }
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            idle = --pending == 0;
+        }
+        if (idle) {
+            idleCondition.notify_all();
+        }
+    };
+    if (dispatch) {
+        dispatch(std::move(finish));
+    } else {
+        finish();
+    }
+}
+
+void AssetIOService::preadWorker() {
+    Profiler::setThreadName("asset io");
+    for (;;) {
+        auto batch = popBatch(1, true);
+        if (batch.empty()) {
+            return; // Stopping and fully drained.
+        }
+        VT_ZONE("pread");
+        IORequest& request = batch.front();
+        std::uint64_t done = 0;
+        int fd = fileDescriptor(request.path);
+        if (fd >= 0) {
+            auto dst = static_cast<char*>(request.destination);
+            while (done < request.size) {
+                ssize_t n = pread(fd, dst + done, request.size - done, static_cast<off_t>(request.offset + done));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                done += static_cast<std::uint64_t>(n);
+            }
+        }
+        complete(std::move(request), done);
+    }
+}
+
+#ifdef VT_HAVE_IO_URING
+namespace {
+    // The SQE length is 32 bits. Larger reads go in pieces through the short-read path.
+    const std::uint64_t MAX_READ_SIZE = 1u << 30;
+
+    struct InFlightRead {
+        IORequest request;
+        int fd;
+        std::uint64_t done;
+    };
+
+    void queueRead(io_uring& ring, InFlightRead* read) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        auto dst = static_cast<char*>(read->request.destination) + read->done;
+        auto size = static_cast<unsigned>(std::min(read->request.size - read->done, MAX_READ_SIZE));
+        io_uring_prep_read(sqe, read->fd, dst, size, read->request.offset + read->done);
+        io_uring_sqe_set_data(sqe, read);
+    }
+}
+
+void AssetIOService::ringWorker() {
+    Profiler::setThreadName("asset io ring");
+    const unsigned queueDepth = 64;
+    io_uring ring;
+    if (io_uring_queue_init(queueDepth, &ring, 0) != 0) {
+        // Probe in the constructor succeeded, so this only happens under resource exhaustion.
+        preadWorker();
+        return;
+    }
+    unsigned inFlight = 0;
+    for (;;) {
+        // Top the ring up. Only block for new work when nothing is outstanding.
+        auto batch = popBatch(queueDepth - inFlight, inFlight == 0);
+        if (batch.empty() && inFlight == 0) {
+            break; // Stopping and fully drained.
+        }
+        for (auto& request : batch) {
+            int fd = fileDescriptor(request.path);
+            if (fd < 0 || request.size == 0) {
+                complete(std::move(request), 0);
+                continue;
+            }
+            queueRead(ring, new InFlightRead{std::move(request), fd, 0});
+            inFlight++;
+        }
+        if (inFlight == 0) {
+            continue;
+        }
+        io_uring_submit(&ring);
+
+        io_uring_cqe* cqe;
+        if (io_uring_wait_cqe(&ring, &cqe) != 0) {
+            continue;
+        }
+        // Reap everything that is ready in one go.
+        unsigned head;
+        unsigned reaped = 0;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            reaped++;
+            auto read = static_cast<InFlightRead*>(io_uring_cqe_get_data(cqe));
+            if (cqe->res > 0) {
+                read->done += static_cast<std::uint64_t>(cqe->res);
+            }
+            if (cqe->res > 0 && read->done < read->request.size) {
+                queueRead(ring, read); // Short read; continue where it stopped. Submitted next iteration.
+                continue;
+            }
+            inFlight--;
+            complete(std::move(read->request), read->done);
+            delete read;
+        }
+        io_uring_cq_advance(&ring, reaped);
+    }
+    io_uring_queue_exit(&ring);
+}
+#endif
@@ -0,0 +1,91 @@
+#ifndef AssetIO_hpp
+#define AssetIO_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Lower value = served first.
+enum class IOPriority : std::uint8_t {
+    Critical = 0, // Needed for the current frame.
+    Normal = 1,
+    Background = 2, // Prefetch / streaming ahead.
+    Count
+};
+
+// One read. The destination is owned by the caller and is usually a pointer into a mapped
+// staging buffer, so the bytes land exactly once where the GPU copy will pick them up.
+struct IORequest {
+    std::string path;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    void* destination = nullptr;
+    IOPriority priority = IOPriority::Normal;
+    // Called once the read finished. bytesRead < size means a short read or an error.
+    std::function<void(const IORequest& request, std::uint64_t bytesRead)> onComplete;
+};
+
+// Reads files in the background so the main thread never blocks on disk.
+// On Linux with liburing available (VT_HAVE_IO_URING) a single thread keeps a ring full with
+// batched submissions; everywhere else a small pool of threads does blocking pread() calls.
+// Completions are handed to `dispatch`, which lets a job system run them on its own workers.
+// Without a dispatcher they run on the I/O thread that finished the read.
+class AssetIOService {
+public:
+    using Dispatcher = std::function<void(std::function<void()>)>;
+
+    explicit AssetIOService(unsigned workerCount = 2, Dispatcher dispatch = nullptr);
+    ~AssetIOService();
+
+    AssetIOService(const AssetIOService&) = delete;
+    AssetIOService& operator=(const AssetIOService&) = delete;
+
+    void submit(IORequest request);
+    // Queues a whole batch under one lock, cheaper than many submit() calls.
+    void submit(std::vector<IORequest> batch);
+    // Blocks until every submitted request has completed (and its callback returned).
+    void waitIdle();
+    // Closes the descriptor kept open for path since its first request. Only once nothing for path is
+    // queued or in flight: a batch that reads every file once calls it from onComplete, so millions of
+    // inputs don't run out of descriptors.
+    void closeFile(const std::string& path);
+
+    static std::uint64_t fileSize(const std::string& path);
+
+    // Which backend is in use, for logging.
+    const char* backendName() const;
+
+private:
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::condition_variable idleCondition;
+    std::deque<IORequest> queues[static_cast<int>(IOPriority::Count)];
+    std::size_t pending = 0; // Queued + in flight. Guarded by queueMutex.
+    bool stopping = false;
+
+    std::mutex fdMutex;
+    std::unordered_map<std::string, int> openFiles; // Path -> fd, so each file is opened once.
+
+    Dispatcher dispatch;
+    std::vector<std::thread> workers;
+    bool useRing = false;
+
+    // Pops up to maxCount requests in priority order. Blocks while empty; returns empty when stopping.
+    std::vector<IORequest> popBatch(std::size_t maxCount, bool wait);
+    int fileDescriptor(const std::string& path);
+    void complete(IORequest&& request, std::uint64_t bytesRead);
+
+    void preadWorker();
+#ifdef VT_HAVE_IO_URING
+    void ringWorker();
+#endif
+};
+
+#endif /* AssetIO_hpp */
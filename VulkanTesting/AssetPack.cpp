@@ -0,0 +1,349 @@
+#include "AssetPack.hpp"
+#include "JobSystem.hpp"
+#include "Glz.hpp"
+#include "Profiler.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef VT_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef VT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+std::uint64_t packNameHash(const std::string& name) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool packCodecAvailable(PackCodec codec) {
+    switch (codec) {
+        case PackCodec::Store:
+        case PackCodec::GLZ:
+            return true;
+        case PackCodec::LZ4:
+#ifdef VT_HAVE_LZ4
+            return true;
+#else
+            return false;
+#endif
+        case PackCodec::Zstd:
+#ifdef VT_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+AssetPack::AssetPack(const std::string& path) {
+    VT_ZONE("open pack");
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open asset pack " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(PackHeader)) {
+        close(fd);
+        throw std::runtime_error("Asset pack is truncated: " + path);
+    }
+    mappedSize = static_cast<std::size_t>(info.st_size);
+    void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file alive.
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map asset pack " + path);
+    }
+    base = static_cast<const std::uint8_t*>(mapping);
+
+    header = reinterpret_cast<const PackHeader*>(base);
+    if (header->magic != PACK_MAGIC || header->version != PACK_VERSION) {
+        munmap(const_cast<std::uint8_t*>(base), mappedSize);
+        throw std::runtime_error("Not a VTPK v1 asset pack: " + path);
+    }
+    // Everything later reads or writes through these offsets without checking again, so a truncated
+    // or crafted pack is refused here, at the first field that points outside where it may.
+    std::string problem = validate();
+    if (!problem.empty()) {
+        munmap(const_cast<std::uint8_t*>(base), mappedSize);
+        throw std::runtime_error("Asset pack is corrupt (" + problem + "): " + path);
+    }
+    for (std::uint32_t i = 0; i < header->assetCount; i++) {
+        entryList.push_back(&toc[i]);
+    }
+}
+
+std::string AssetPack::validate() {
+    // Offsets and sizes are compared as "fits in what is left", so nothing here can overflow.
+    auto fits = [](std::uint64_t offset, std::uint64_t size, std::uint64_t limit) {
+        return offset <= limit && size <= limit - offset;
+    };
+    std::uint64_t tocSize = std::uint64_t(header->assetCount) * sizeof(PackEntry) + std::uint64_t(header->chunkCount) * sizeof(PackChunk);
+    if (header->tocOffset % alignof(PackEntry) != 0 || !fits(header->tocOffset, tocSize, mappedSize)) {
+        return "table of contents outside the file";
+    }
+    if (!fits(header->stringsOffset, header->stringsSize, mappedSize)) {
+        return "name table outside the file";
+    }
+    toc = reinterpret_cast<const PackEntry*>(base + header->tocOffset);
+    chunks = reinterpret_cast<const PackChunk*>(toc + header->assetCount);
+    strings = reinterpret_cast<const char*>(base + header->stringsOffset);
+
+    for (std::uint32_t c = 0; c < header->chunkCount; c++) {
+        if (!fits(chunks[c].offset, chunks[c].compressedSize, mappedSize) || chunks[c].uncompressedSize > PACK_CHUNK_SIZE) {
+            return "chunk " + std::to_string(c) + " out of range";
+        }
+    }
+    for (std::uint32_t i = 0; i < header->assetCount; i++) {
+        const PackEntry& entry = toc[i];
+        std::string where = "entry " + std::to_string(i);
+        if (i > 0 && toc[i - 1].nameHash > entry.nameHash) {
+            return where + " out of order";
+        }
+        if (!fits(entry.nameOffset, entry.nameLength, header->stringsSize)) {
+            return where + " name out of range";
+        }
+        if (entry.codec > PackCodec::GLZ) {
+            return where + " unknown codec";
+        }
+        if (!fits(entry.firstChunk, entry.chunkCount, header->chunkCount)) {
+            return where + " chunks out of range";
+        }
+        // decompress() writes chunk k at k * PACK_CHUNK_SIZE into a buffer of uncompressedSize bytes,
+        // so the chunks have to tile it exactly.
+        if (entry.chunkCount != entry.uncompressedSize / PACK_CHUNK_SIZE + (entry.uncompressedSize % PACK_CHUNK_SIZE != 0)) {
+            return where + " chunk count doesn't match its size";
+        }
+        for (std::uint32_t k = 0; k < entry.chunkCount; k++) {
+            const PackChunk& chunk = chunks[entry.firstChunk + k];
+            std::uint64_t expected = std::min<std::uint64_t>(PACK_CHUNK_SIZE, entry.uncompressedSize - std::uint64_t(k) * PACK_CHUNK_SIZE);
+            // Stored chunks are copied with their uncompressed size.
+            bool stored = entry.codec == PackCodec::Store;
+            if (chunk.uncompressedSize != expected || (stored && chunk.compressedSize != chunk.uncompressedSize)) {
+                return where + " chunk " + std::to_string(k) + " has the wrong size";
+            }
+            // The GPU path uploads an asset's chunks as one span and addresses GLZ input as uints.
+            const PackChunk* previous = k > 0 ? &chunks[entry.firstChunk + k - 1] : nullptr;
+            if (previous != nullptr && chunk.offset != previous->offset + previous->compressedSize) {
+                return where + " chunk " + std::to_string(k) + " doesn't follow the previous one";
+            }
+            if (entry.codec == PackCodec::GLZ && chunk.offset % 4 != 0) {
+                return where + " chunk " + std::to_string(k) + " is misaligned";
+            }
+        }
+    }
+    return std::string();
+}
+
+AssetPack::~AssetPack() {
+    munmap(const_cast<std::uint8_t*>(base), mappedSize);
+}
+
+const PackEntry* AssetPack::find(const std::string& name) const {
+    std::uint64_t hash = packNameHash(name);
+    const PackEntry* end = toc + header->assetCount;
+    auto it = std::lower_bound(toc, end, hash, [](const PackEntry& entry, std::uint64_t h) { return entry.nameHash < h; });
+    // Walk past hash collisions comparing the real names.
+    for (; it != end && it->nameHash == hash; ++it) {
+        if (it->nameLength == name.size() && std::memcmp(strings + it->nameOffset, name.data(), name.size()) == 0) {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+std::string AssetPack::name(const PackEntry& entry) const {
+    return std::string(strings + entry.nameOffset, entry.nameLength);
+}
+
+void AssetPack::decompress(const PackEntry& entry, void* dst, JobSystem* jobs) const {
+    VT_ZONE("decompress asset");
+    auto out = static_cast<std::uint8_t*>(dst);
+    // Chunk i always starts at i * PACK_CHUNK_SIZE in the output, so chunks are fully independent.
+    auto decodeOne = [&](std::size_t i) {
+        decompressChunk(entry.codec, chunks[entry.firstChunk + i], out + i * PACK_CHUNK_SIZE);
+    };
+    if (jobs != nullptr && entry.chunkCount > 1) {
+        jobs->parallelFor(entry.chunkCount, decodeOne);
+    } else {
+        for (std::uint32_t i = 0; i < entry.chunkCount; i++) {
+            decodeOne(i);
+        }
+    }
+}
+
+void AssetPack::decompressChunk(PackCodec codec, const PackChunk& chunk, std::uint8_t* dst) const {
+    VT_ZONE("decompress chunk");
+    const std::uint8_t* src = base + chunk.offset;
+    // The writer stores a chunk raw whenever compression didn't shrink it (except GLZ, which the GPU decodes as is).
+    if (codec == PackCodec::Store || (codec != PackCodec::GLZ && chunk.compressedSize == chunk.uncompressedSize)) {
+        std::memcpy(dst, src, chunk.uncompressedSize);
+        return;
+    }
+    switch (codec) {
+        case PackCodec::GLZ:
+            if (!glzDecompress(src, chunk.compressedSize, dst, chunk.uncompressedSize)) {
+                throw std::runtime_error("GLZ chunk failed to decompress.");
+            }
+            return;
+#ifdef VT_HAVE_LZ4
+        case PackCodec::LZ4: {
+            int n = LZ4_decompress_safe(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+                                        static_cast<int>(chunk.compressedSize), static_cast<int>(chunk.uncompressedSize));
+            if (n != static_cast<int>(chunk.uncompressedSize)) {
+                throw std::runtime_error("LZ4 chunk failed to decompress.");
+            }
+            return;
+        }
+#endif
+#ifdef VT_HAVE_ZSTD
+        case PackCodec::Zstd: {
+            std::size_t n = ZSTD_decompress(dst, chunk.uncompressedSize, src, chunk.compressedSize);
+            if (ZSTD_isError(n) || n != chunk.uncompressedSize) {
+                throw std::runtime_error("Zstd chunk failed to decompress.");
+            }
+            return;
+        }
+#endif
+        default:
+            throw std::runtime_error("Asset pack uses a codec this build doesn't support.");
+    }
+}
+
+void AssetPackWriter::add(const std::string& name, std::vector<std::uint8_t> bytes, PackCodec codec) {
+    if (!packCodecAvailable(codec)) {
+        throw std::runtime_error("Codec not available in this build for " + name);
+    }
+    // find() returns the first match, so a second asset of the same name could never be read.
+    if (!names.insert(name).second) {
+        throw std::runtime_error("Duplicate asset name " + name);
+    }
+    assets.push_back({name, std::move(bytes), codec});
+}
+
+namespace {
+    // Returns an empty vector when the codec didn't help, so the caller stores the chunk raw.
+    std::vector<std::uint8_t> compressChunk(PackCodec codec, const std::uint8_t* src, std::size_t size, int level) {
+        std::vector<std::uint8_t> out;
+        switch (codec) {
+            case PackCodec::Store:
+                break;
+            case PackCodec::GLZ:
+                return glzCompress(src, size);
+#ifdef VT_HAVE_LZ4
+            case PackCodec::LZ4: {
+                out.resize(static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(size))));
+                int n = LZ4_compress_HC(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(out.data()),
+                                        static_cast<int>(size), static_cast<int>(out.size()), level > 0 ? level : LZ4HC_CLEVEL_DEFAULT);
+                out.resize(n > 0 ? static_cast<std::size_t>(n) : 0);
+                break;
+            }
+#endif
+#ifdef VT_HAVE_ZSTD
+            case PackCodec::Zstd: {
+                out.resize(ZSTD_compressBound(size));
+                std::size_t n = ZSTD_compress(out.data(), out.size(), src, size, level > 0 ? level : 19);
+                out.resize(ZSTD_isError(n) ? 0 : n);
+                break;
+            }
+#endif
+            default:
+                break;
+        }
+        if (out.size() >= size) {
+            out.clear();
+        }
+        return out;
+    }
+
+    std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void AssetPackWriter::write(const std::string& path, int compressionLevel) const {
+    VT_ZONE("write pack");
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Failed to create " + path);
+    }
+
+    std::vector<PackEntry> entries;
+    std::vector<PackChunk> chunks;
+    std::string strings;
+    std::uint64_t offset = 0;
+    auto pad = [&](std::uint64_t target) {
+        static const char zeros[PACK_ALIGNMENT] = {};
+        file.write(zeros, static_cast<std::streamsize>(target - offset));
+        offset = target;
+    };
+    pad(PACK_ALIGNMENT); // Reserve the first page for the header, filled in at the end.
+
+    for (const auto& asset : assets) {
+        PackEntry entry = {};
+        entry.nameHash = packNameHash(asset.name);
+        entry.uncompressedSize = asset.bytes.size();
+        entry.nameOffset = static_cast<std::uint32_t>(strings.size());
+        entry.nameLength = static_cast<std::uint32_t>(asset.name.size());
+        entry.firstChunk = static_cast<std::uint32_t>(chunks.size());
+        entry.codec = asset.codec;
+        strings += asset.name;
+
+        pad(alignUp(offset, PACK_ALIGNMENT));
+        for (std::size_t at = 0; at < asset.bytes.size(); at += PACK_CHUNK_SIZE) {
+            if (asset.codec == PackCodec::GLZ) {
+                pad(alignUp(offset, 4)); // The decode shader addresses the input as uints.
+            }
+            std::size_t size = std::min<std::size_t>(PACK_CHUNK_SIZE, asset.bytes.size() - at);
+            auto packed = compressChunk(asset.codec, asset.bytes.data() + at, size, compressionLevel);
+            PackChunk chunk = {offset, 0, static_cast<std::uint32_t>(size)};
+            if (packed.empty()) {
+                file.write(reinterpret_cast<const char*>(asset.bytes.data() + at), static_cast<std::streamsize>(size));
+                chunk.compressedSize = chunk.uncompressedSize;
+            } else {
+                file.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(packed.size()));
+                chunk.compressedSize = static_cast<std::uint32_t>(packed.size());
+            }
+            offset += chunk.compressedSize;
+            chunks.push_back(chunk);
+        }
+        entry.chunkCount = static_cast<std::uint32_t>(chunks.size()) - entry.firstChunk;
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) { return a.nameHash < b.nameHash; });
+
+    PackHeader header = {};
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    header.assetCount = static_cast<std::uint32_t>(entries.size());
+    header.chunkCount = static_cast<std::uint32_t>(chunks.size());
+    pad(alignUp(offset, 8));
+    header.tocOffset = offset;
+    file.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(PackEntry)));
+    file.write(reinterpret_cast<const char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(PackChunk)));
+    offset += entries.size() * sizeof(PackEntry) + chunks.size() * sizeof(PackChunk);
+    header.stringsOffset = offset;
+    header.stringsSize = strings.size();
+    file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
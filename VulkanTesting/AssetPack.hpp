@@ -0,0 +1,126 @@
+#ifndef AssetPack_hpp
+#define AssetPack_hpp
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class JobSystem;
+
+// Single-file asset archive ("VTPK").
+//
+// Layout:
+//   PackHeader
+//   asset data, each asset starting on a PACK_ALIGNMENT boundary, split into chunks
+//   PackEntry[assetCount] sorted by nameHash
+//   PackChunk[totalChunks]
+//   name string table
+//
+// Assets are compressed in independent chunks of up to PACK_CHUNK_SIZE uncompressed bytes so that one
+// large asset can be decompressed by many threads at once. Page alignment means stored (uncompressed)
+// assets can be used straight out of the mapping.
+//
+// PACK_CHUNK_SIZE must match GLZ_CHUNK_SIZE so a GLZ chunk maps to exactly one compute workgroup.
+
+const std::uint32_t PACK_MAGIC = 0x4b505456; // "VTPK" little endian.
+const std::uint32_t PACK_VERSION = 1;
+const std::uint32_t PACK_ALIGNMENT = 4096;
+const std::uint32_t PACK_CHUNK_SIZE = 64 * 1024;
+
+enum class PackCodec : std::uint8_t {
+    Store = 0,
+    LZ4 = 1,
+    Zstd = 2,
+    GLZ = 3, // GPU-decodable, see Glz.hpp. Chunks are 4-byte aligned and never stored raw.
+};
+
+struct PackHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t assetCount;
+    std::uint32_t chunkCount;
+    std::uint64_t tocOffset; // Offset of the PackEntry array.
+    std::uint64_t stringsOffset;
+    std::uint64_t stringsSize;
+};
+
+struct PackEntry {
+    std::uint64_t nameHash;
+    std::uint64_t uncompressedSize;
+    std::uint32_t nameOffset; // Into the string table.
+    std::uint32_t nameLength;
+    std::uint32_t firstChunk;
+    std::uint32_t chunkCount;
+    PackCodec codec;
+    std::uint8_t reserved[7];
+};
+
+struct PackChunk {
+    std::uint64_t offset; // Absolute file offset.
+    std::uint32_t compressedSize;
+    std::uint32_t uncompressedSize;
+};
+
+static_assert(sizeof(PackHeader) == 40, "PackHeader layout is part of the file format.");
+static_assert(sizeof(PackEntry) == 40, "PackEntry layout is part of the file format.");
+static_assert(sizeof(PackChunk) == 16, "PackChunk layout is part of the file format.");
+
+// FNV-1a, used for the TOC lookup.
+std::uint64_t packNameHash(const std::string& name);
+bool packCodecAvailable(PackCodec codec);
+
+// Read side. Maps the whole file once; lookups are a binary search over the TOC.
+class AssetPack {
+public:
+    explicit AssetPack(const std::string& path);
+    ~AssetPack();
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    // nullptr if the asset isn't in the pack.
+    const PackEntry* find(const std::string& name) const;
+    std::string name(const PackEntry& entry) const;
+    const std::vector<const PackEntry*>& entries() const { return entryList; }
+    const PackChunk& chunk(std::uint32_t index) const { return chunks[index]; }
+    // Pointer into the mapping, for the GPU decompression path and for Store assets.
+    const std::uint8_t* data(std::uint64_t offset) const { return base + offset; }
+
+    // Decompresses an asset into dst, which must hold entry.uncompressedSize bytes (typically
+    // mapped staging memory). With a job system the chunks are spread across its workers.
+    void decompress(const PackEntry& entry, void* dst, JobSystem* jobs = nullptr) const;
+
+private:
+    const std::uint8_t* base = nullptr;
+    std::size_t mappedSize = 0;
+    const PackHeader* header = nullptr;
+    const PackEntry* toc = nullptr;
+    const PackChunk* chunks = nullptr;
+    const char* strings = nullptr;
+    std::vector<const PackEntry*> entryList;
+
+    // Bounds-checks the header, every entry and every chunk against the mapping, and checks that each
+    // entry's chunks lie back to back (4-byte aligned for GLZ); sets toc, chunks and strings. Returns
+    // what is wrong, or an empty string.
+    std::string validate();
+    void decompressChunk(PackCodec codec, const PackChunk& chunk, std::uint8_t* dst) const;
+};
+
+// Write side, used by the vtpack tool.
+class AssetPackWriter {
+public:
+    void add(const std::string& name, std::vector<std::uint8_t> bytes, PackCodec codec);
+    void write(const std::string& path, int compressionLevel = 0) const;
+
+private:
+    struct Pending {
+        std::string name;
+        std::vector<std::uint8_t> bytes;
+        PackCodec codec;
+    };
+    std::vector<Pending> assets;
+    std::unordered_set<std::string> names;
+};
+
+#endif /* AssetPack_hpp */
@@ -0,0 +1,199 @@
+// defrag_bench: how much memory a fragmented BufferPool gets back, and how fast, under frame budgets.
+//
+//   defrag_bench [--device SEL] [--frames N] [--frame-ms MS] [--budget-ms MS] [--live-mb N] [--churn N]
+//                [--block-mb N] [--verify]
+//
+// First a session's worth of churn: allocations from 4 KiB to 1 MiB, log-uniform, up to twice
+// --live-mb, then a random half of them freed, which leaves every block partly used. Then --frames
+// frames of --frame-ms each, every one freeing and allocating --churn allocations and calling
+// defragment() with --budget-ms. Reports the memory held against the memory used before and after,
+// the frames until waste settled, the bytes moved, the copy rate on the transfer queue and the CPU
+// cost per defragment() call. --verify puts the pool in host-visible memory, fills every allocation
+// with its own pattern and checks all of them at the end.
+
+#include "../BufferPool.hpp"
+#include "../VulkanContext.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::uint32_t frames = 600;
+        double frameMs = 16.0;
+        double budgetMs = 0.5;
+        std::uint32_t liveMb = 512;
+        std::uint32_t churn = 16;
+        std::uint32_t blockMb = 64;
+        bool verify = false;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--frame-ms" && hasValue) options.frameMs = std::max(0.0, std::atof(argv[++i]));
+            else if (arg == "--budget-ms" && hasValue) options.budgetMs = std::max(0.0, std::atof(argv[++i]));
+            else if (arg == "--live-mb" && hasValue) options.liveMb = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--churn" && hasValue) options.churn = static_cast<std::uint32_t>(std::max(0, std::atoi(argv[++i])));
+            else if (arg == "--block-mb" && hasValue) options.blockMb = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--verify") options.verify = true;
+            else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    struct Allocation {
+        BufferHandle handle;
+        std::uint32_t seed;
+    };
+
+    std::uint32_t pattern(std::uint32_t seed, VkDeviceSize word) {
+        return seed * 2654435761u + static_cast<std::uint32_t>(word);
+    }
+
+    void fill(const BufferPool& pool, const Allocation& allocation) {
+        BufferRange range = pool.resolve(allocation.handle);
+        auto* words = static_cast<std::uint32_t*>(range.mapped);
+        for (VkDeviceSize i = 0; i < range.size / 4; i++) {
+            words[i] = pattern(allocation.seed, i);
+        }
+    }
+
+    bool check(const BufferPool& pool, const Allocation& allocation) {
+        BufferRange range = pool.resolve(allocation.handle);
+        const auto* words = static_cast<const std::uint32_t*>(range.mapped);
+        for (VkDeviceSize i = 0; i < range.size / 4; i++) {
+            if (words[i] != pattern(allocation.seed, i)) return false;
+        }
+        return true;
+    }
+
+    double mb(VkDeviceSize bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "defrag_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+
+        BufferPoolCreateInfo poolInfo;
+        poolInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        if (options.verify) {
+            poolInfo.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+        poolInfo.blockSize = static_cast<VkDeviceSize>(options.blockMb) << 20;
+        poolInfo.queueFamilies = {context.queueFamilies().graphicsFamily, context.queueFamilies().computeFamily};
+        poolInfo.transferQueue = context.transferQueue();
+        poolInfo.transferFamily = context.queueFamilies().transferFamily;
+        poolInfo.name = "defrag_bench pool";
+        BufferPool pool(context.physicalDevice(), context.device(), poolInfo);
+
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<double> logSize(std::log(4096.0), std::log(1048576.0));
+        std::uint32_t seeds = 0;
+        std::vector<Allocation> allocations;
+        auto allocate = [&]() {
+            Allocation allocation;
+            allocation.handle = pool.allocate(static_cast<VkDeviceSize>(std::exp(logSize(rng))));
+            allocation.seed = ++seeds;
+            if (options.verify) fill(pool, allocation);
+            allocations.push_back(allocation);
+        };
+        auto freeRandom = [&]() {
+            std::size_t i = std::uniform_int_distribution<std::size_t>(0, allocations.size() - 1)(rng);
+            pool.free(allocations[i].handle);
+            allocations[i] = allocations.back();
+            allocations.pop_back();
+        };
+
+        VkDeviceSize target = static_cast<VkDeviceSize>(options.liveMb) << 20;
+        while (pool.stats().usedBytes < 2 * target) {
+            allocate();
+        }
+        for (std::size_t count = allocations.size() / 2; count > 0; count--) {
+            freeRandom();
+        }
+        BufferPoolStats before = pool.stats();
+
+        double defragMs = 0;
+        std::uint32_t settledFrame = 0;
+        VkDeviceSize lastWaste = before.blockBytes - before.usedBytes;
+        for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            for (std::uint32_t i = 0; i < options.churn && !allocations.empty(); i++) {
+                freeRandom();
+                allocate();
+            }
+            auto defragStart = std::chrono::steady_clock::now();
+            pool.defragment(options.budgetMs);
+            auto end = std::chrono::steady_clock::now();
+            defragMs += std::chrono::duration<double, std::milli>(end - defragStart).count();
+
+            BufferPoolStats stats = pool.stats();
+            VkDeviceSize waste = stats.blockBytes - stats.usedBytes;
+            if (waste < lastWaste) {
+                settledFrame = frame + 1;
+            }
+            lastWaste = waste;
+            double spent = std::chrono::duration<double, std::milli>(end - start).count();
+            if (spent < options.frameMs) {
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(options.frameMs - spent));
+            }
+        }
+
+        bool intact = true;
+        if (options.verify) {
+            // Let the last copy land, then switch handles and check every allocation.
+            vkQueueWaitIdle(context.transferQueue());
+            pool.defragment(0);
+            for (const Allocation& allocation : allocations) {
+                intact = intact && check(pool, allocation);
+            }
+        }
+        BufferPoolStats after = pool.stats();
+        std::cout << "live_mb=" << mb(after.usedBytes)
+                  << " held_mb_before=" << mb(before.blockBytes)
+                  << " waste_mb_before=" << mb(before.blockBytes - before.usedBytes)
+                  << " held_mb_after=" << mb(after.blockBytes)
+                  << " waste_mb_after=" << mb(after.blockBytes - after.usedBytes)
+                  << " blocks_before=" << before.blocks
+                  << " blocks_after=" << after.blocks
+                  << " released_blocks=" << after.releasedBlocks
+                  << " settled_frame=" << settledFrame
+                  << " moved_mb=" << mb(after.movedBytes)
+                  << " moves=" << after.moves
+                  << " copy_gbps=" << after.copyGBps
+                  << " defrag_cpu_us=" << defragMs * 1e3 / options.frames;
+        if (options.verify) {
+            std::cout << " verify=" << (intact ? "ok" : "FAILED");
+        }
+        std::cout << std::endl;
+        if (!intact) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,361 @@
+// gemm_bench: GFLOP/s of the TensorKernels GEMM and convolution kernels on the selected device.
+//
+//   gemm_bench [--device SEL] [--shaders DIR] [--sizes N,N,...] [--batch N] [--iterations N]
+//              [--fp32] [--tuning FILE] [--verbose]
+//
+// Square GEMMs of each size, then the convolution layers of a ResNet-50-style network at --batch.
+// Every shape is tuned first (all kernel variants that fit the device, fastest wins), then timed
+// with the winner over --iterations dispatches, with bias and ReLU on the convolutions as in
+// inference. Reports the variant, its time and GFLOP/s, the best fp32 tiled variant for comparison
+// when cooperative matrices won, and the largest error against a CPU reference on random data,
+// relative to the largest output (fp16 inputs land around 1e-3). Shapes beyond 2^28 multiply-adds
+// skip the CPU check. --fp32 keeps cooperative matrices out; --tuning saves the results for
+// TensorKernels::loadTuning(); --verbose lists every variant tried.
+
+#include "../TensorKernels.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::vector<std::uint32_t> sizes = {256, 512, 1000, 1024, 2048};
+        std::uint32_t batch = 1;
+        std::uint32_t iterations = 20;
+        bool fp32 = false;
+        std::string tuningPath;
+        bool verbose = false;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--batch" && hasValue) options.batch = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--iterations" && hasValue) options.iterations = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--tuning" && hasValue) options.tuningPath = argv[++i];
+            else if (arg == "--fp32") options.fp32 = true;
+            else if (arg == "--verbose") options.verbose = true;
+            else if (arg == "--sizes" && hasValue) {
+                options.sizes.clear();
+                std::stringstream stream(argv[++i]);
+                std::string size;
+                while (std::getline(stream, size, ',')) {
+                    options.sizes.push_back(static_cast<std::uint32_t>(std::max(1, std::atoi(size.c_str()))));
+                }
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    struct Workload {
+        std::string label;
+        bool convolution = false;
+        GemmShape gemm;
+        ConvShape conv;
+    };
+
+    Workload convLayer(std::uint32_t batch, std::uint32_t size, std::uint32_t channels, std::uint32_t outputChannels,
+                       std::uint32_t kernelSize, std::uint32_t stride) {
+        Workload workload;
+        workload.convolution = true;
+        workload.conv.batch = batch;
+        workload.conv.height = size;
+        workload.conv.width = size;
+        workload.conv.channels = channels;
+        workload.conv.outputChannels = outputChannels;
+        workload.conv.kernelSize = kernelSize;
+        workload.conv.stride = stride;
+        workload.conv.padding = kernelSize / 2;
+        workload.gemm = workload.conv.gemm();
+        workload.label = std::to_string(size) + "x" + std::to_string(size) + "x" + std::to_string(channels) + "->" +
+                         std::to_string(outputChannels) + "/k" + std::to_string(kernelSize) + "s" + std::to_string(stride);
+        return workload;
+    }
+
+    // Double accumulation, so the reference is the exact result for practical purposes.
+    std::vector<float> referenceGemm(const GemmShape& shape, const std::vector<float>& a, const std::vector<float>& b) {
+        std::vector<double> sums(static_cast<std::size_t>(shape.m) * shape.n, 0.0);
+        for (std::uint32_t m = 0; m < shape.m; m++) {
+            for (std::uint32_t k = 0; k < shape.k; k++) {
+                double value = a[static_cast<std::size_t>(m) * shape.k + k];
+                const float* row = &b[static_cast<std::size_t>(k) * shape.n];
+                double* out = &sums[static_cast<std::size_t>(m) * shape.n];
+                for (std::uint32_t n = 0; n < shape.n; n++) {
+                    out[n] += value * row[n];
+                }
+            }
+        }
+        return std::vector<float>(sums.begin(), sums.end());
+    }
+
+    // With bias and ReLU, like the GPU run.
+    std::vector<float> referenceConv(const ConvShape& shape, const std::vector<float>& input, const std::vector<float>& weights,
+                                     const std::vector<float>& bias) {
+        std::uint32_t outputHeight = shape.outputHeight(), outputWidth = shape.outputWidth();
+        std::uint32_t n = shape.outputChannels;
+        std::vector<float> output(static_cast<std::size_t>(shape.batch) * outputHeight * outputWidth * n);
+        std::vector<double> sums(n);
+        for (std::uint32_t image = 0; image < shape.batch; image++) {
+            for (std::uint32_t oy = 0; oy < outputHeight; oy++) {
+                for (std::uint32_t ox = 0; ox < outputWidth; ox++) {
+                    std::fill(sums.begin(), sums.end(), 0.0);
+                    for (std::uint32_t ky = 0; ky < shape.kernelSize; ky++) {
+                        int iy = static_cast<int>(oy * shape.stride + ky) - static_cast<int>(shape.padding);
+                        if (iy < 0 || iy >= static_cast<int>(shape.height)) continue;
+                        for (std::uint32_t kx = 0; kx < shape.kernelSize; kx++) {
+                            int ix = static_cast<int>(ox * shape.stride + kx) - static_cast<int>(shape.padding);
+                            if (ix < 0 || ix >= static_cast<int>(shape.width)) continue;
+                            const float* pixel = &input[((static_cast<std::size_t>(image) * shape.height + iy) * shape.width + ix) * shape.channels];
+                            const float* taps = &weights[(static_cast<std::size_t>(ky) * shape.kernelSize + kx) * shape.channels * n];
+                            for (std::uint32_t c = 0; c < shape.channels; c++) {
+                                for (std::uint32_t j = 0; j < n; j++) {
+                                    sums[j] += static_cast<double>(pixel[c]) * taps[static_cast<std::size_t>(c) * n + j];
+                                }
+                            }
+                        }
+                    }
+                    float* out = &output[((static_cast<std::size_t>(image) * outputHeight + oy) * outputWidth + ox) * n];
+                    for (std::uint32_t j = 0; j < n; j++) {
+                        out[j] = static_cast<float>(std::max(0.0, sums[j] + bias[j]));
+                    }
+                }
+            }
+        }
+        return output;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "gemm_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.computeQueue();
+        std::uint32_t family = context.queueFamilies().computeFamily;
+
+        TensorKernels kernels(physicalDevice, device, family, queue, options.shaderDir, context.cooperativeMatrix(), !options.fp32);
+        if (!options.tuningPath.empty()) {
+            kernels.loadTuning(options.tuningPath); // Keeps the other devices' entries when saving.
+        }
+        std::cout << "cooperative_matrix=" << (context.cooperativeMatrix().float16 && !options.fp32 ? "fp16" : "off") << std::endl;
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+        VkCommandBufferAllocateInfo commandBufferInfo = {};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (families[family].timestampValidBits == 0) {
+            throw std::runtime_error("gemm_bench needs timestamp queries on the compute queue.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+
+        auto submit = [&]() {
+            vkEndCommandBuffer(commandBuffer);
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit gemm_bench commands!");
+            }
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+        };
+        auto begin = [&]() {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        };
+
+        std::vector<Workload> workloads;
+        for (std::uint32_t size : options.sizes) {
+            Workload workload;
+            workload.gemm = {size, size, size};
+            workload.label = std::to_string(size) + "x" + std::to_string(size) + "x" + std::to_string(size);
+            workloads.push_back(workload);
+        }
+        workloads.push_back(convLayer(options.batch, 224, 3, 64, 7, 2));
+        workloads.push_back(convLayer(options.batch, 56, 64, 64, 3, 1));
+        workloads.push_back(convLayer(options.batch, 56, 64, 256, 1, 1));
+        workloads.push_back(convLayer(options.batch, 28, 128, 128, 3, 1));
+        workloads.push_back(convLayer(options.batch, 14, 256, 256, 3, 1));
+        workloads.push_back(convLayer(options.batch, 7, 512, 512, 3, 1));
+
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        for (const Workload& workload : workloads) {
+            std::vector<KernelTiming> timings = workload.convolution ? kernels.tune(workload.conv) : kernels.tune(workload.gemm);
+            if (options.verbose) {
+                for (const KernelTiming& timing : timings) {
+                    std::cout << "  " << workload.label << " " << timing.config.name() << " ms=" << timing.ms
+                              << " gflops=" << timing.gflops << std::endl;
+                }
+            }
+
+            // Random operands, uploaded once; the output is read back after one checked run.
+            const GemmShape& shape = workload.gemm;
+            std::size_t aCount = workload.convolution
+                                     ? static_cast<std::size_t>(workload.conv.batch) * workload.conv.height * workload.conv.width * workload.conv.channels
+                                     : static_cast<std::size_t>(shape.m) * shape.k;
+            std::size_t counts[4] = {aCount, static_cast<std::size_t>(shape.k) * shape.n,
+                                     static_cast<std::size_t>(shape.m) * shape.n, shape.n};
+            std::vector<float> host[4];
+            for (std::uint32_t i = 0; i < 4; i++) {
+                host[i].resize(counts[i]);
+                if (i != 2) {
+                    for (float& value : host[i]) value = uniform(random);
+                }
+            }
+            const char* names[4] = {"gemm_bench A", "gemm_bench B", "gemm_bench C", "gemm_bench bias"};
+            Buffer buffers[4];
+            VkDeviceSize stagingSize = 0;
+            for (std::uint32_t i = 0; i < 4; i++) {
+                buffers[i] = createBuffer(physicalDevice, device, counts[i] * sizeof(float),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, names[i]);
+                stagingSize += counts[i] * sizeof(float);
+            }
+            Buffer staging = createBuffer(physicalDevice, device, stagingSize,
+                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "gemm_bench staging");
+            KernelEpilogue epilogue;
+            if (workload.convolution) {
+                epilogue.bias = buffers[3].buffer;
+                epilogue.relu = true;
+            }
+            auto record = [&]() {
+                if (workload.convolution) {
+                    kernels.conv2d(commandBuffer, workload.conv, buffers[0].buffer, buffers[1].buffer, buffers[2].buffer, epilogue);
+                } else {
+                    kernels.gemm(commandBuffer, shape, buffers[0].buffer, buffers[1].buffer, buffers[2].buffer, epilogue);
+                }
+            };
+
+            begin();
+            VkDeviceSize offset = 0;
+            for (std::uint32_t i : {0u, 1u, 3u}) {
+                std::memcpy(static_cast<char*>(staging.mapped) + offset, host[i].data(), counts[i] * sizeof(float));
+                VkBufferCopy copy = {offset, 0, counts[i] * sizeof(float)};
+                vkd.vkCmdCopyBuffer(commandBuffer, staging.buffer, buffers[i].buffer, 1, &copy);
+                offset += counts[i] * sizeof(float);
+            }
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 1, &barrier, 0, nullptr, 0, nullptr);
+            record();
+            // TensorKernels leaves the output visible to transfers.
+            VkBufferCopy readback = {0, 0, counts[2] * sizeof(float)};
+            vkd.vkCmdCopyBuffer(commandBuffer, buffers[2].buffer, staging.buffer, 1, &readback);
+            submit();
+            std::memcpy(host[2].data(), staging.mapped, counts[2] * sizeof(float));
+            kernels.reset();
+
+            begin();
+            vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+            vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, queryPool, 0);
+            for (std::uint32_t i = 0; i < options.iterations; i++) {
+                record();
+            }
+            vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, queryPool, 1);
+            submit();
+            kernels.reset();
+            std::uint64_t stamps[2];
+            vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+            double ms = (stamps[1] - stamps[0]) * properties.limits.timestampPeriod * 1e-6 / options.iterations;
+
+            KernelConfig config = workload.convolution ? kernels.config(workload.conv) : kernels.config(shape);
+            std::cout << "kernel=" << (workload.convolution ? "conv2d" : "gemm")
+                      << " shape=" << workload.label
+                      << " config=" << config.name()
+                      << " ms=" << ms
+                      << " gflops=" << shape.flops() / (ms * 1e6);
+            if (config.cooperative) {
+                for (const KernelTiming& timing : timings) {
+                    if (!timing.config.cooperative) {
+                        std::cout << " tiled=" << timing.config.name() << " tiled_gflops=" << timing.gflops;
+                        break;
+                    }
+                }
+            }
+            if (static_cast<double>(shape.m) * shape.n * shape.k <= static_cast<double>(1u << 28)) {
+                std::vector<float> expected = workload.convolution ? referenceConv(workload.conv, host[0], host[1], host[3])
+                                                                   : referenceGemm(shape, host[0], host[1]);
+                double largest = 1e-6, error = 0;
+                for (std::size_t i = 0; i < expected.size(); i++) {
+                    largest = std::max(largest, std::abs(static_cast<double>(expected[i])));
+                    error = std::max(error, std::abs(static_cast<double>(expected[i]) - host[2][i]));
+                }
+                std::cout << " max_error=" << error / largest;
+            }
+            std::cout << std::endl;
+
+            destroyBuffer(device, staging);
+            for (Buffer& buffer : buffers) {
+                destroyBuffer(device, buffer);
+            }
+        }
+        if (!options.tuningPath.empty()) {
+            kernels.saveTuning(options.tuningPath);
+        }
+
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
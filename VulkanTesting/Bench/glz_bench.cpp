@@ -0,0 +1,242 @@
+// glz_bench: GLZ decode throughput, CPU (one thread and the job system) against the compute shader.
+//
+//   glz_bench [--device SEL] [--shader path/to/glz_decompress.comp.spv] [--size MiB] [--iterations N]
+//             [--capture out.vtcap] [--profile trace.json] [file]
+//
+// --capture writes the first GPU iteration to a file that vtreplay can re-run without this tool.
+// --profile writes CPU and GPU zones of the whole run as Chrome trace JSON.
+// Without a file, a synthetic buffer with a mix of text-like and random data is generated.
+// Runs headless, so it works on lavapipe.
+
+#include "../Glz.hpp"
+#include "../JobSystem.hpp"
+#include "../GpuCapture.hpp"
+#include "../GpuDecompressor.hpp"
+#include "../Profiler.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#ifdef VT_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+    struct Options {
+        std::string device; // Same selectors as the app: index, UUID or name substring.
+        std::string shaderPath = "shaders/glz_decompress.comp.spv";
+        std::size_t sizeMiB = 64;
+        int iterations = 5;
+        std::string capturePath;
+        std::string profilePath;
+        std::string input;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shader" && hasValue) options.shaderPath = argv[++i];
+            else if (arg == "--size" && hasValue) options.sizeMiB = static_cast<std::size_t>(std::atoi(argv[++i]));
+            else if (arg == "--iterations" && hasValue) options.iterations = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--capture" && hasValue) options.capturePath = argv[++i];
+            else if (arg == "--profile" && hasValue) options.profilePath = argv[++i];
+            else options.input = arg;
+        }
+        return options;
+    }
+
+    std::vector<std::uint8_t> makeInput(const Options& options) {
+        if (!options.input.empty()) {
+            std::ifstream file(options.input, std::ios::binary);
+            if (!file) throw std::runtime_error("failed to open " + options.input);
+            return std::vector<std::uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        }
+        // Roughly 2:1 compressible: runs of words from a small vocabulary interleaved with noise.
+        static const char* words[] = {"vertex ", "index ", "normal ", "texcoord ", "tangent ", "material ", "0.000 ", "1.000 "};
+        std::mt19937 rng(42);
+        std::vector<std::uint8_t> data;
+        data.reserve(options.sizeMiB << 20);
+        while (data.size() < (options.sizeMiB << 20)) {
+            if (rng() % 4 == 0) {
+                for (int i = 0; i < 16; i++) data.push_back(static_cast<std::uint8_t>(rng()));
+            } else {
+                const char* word = words[rng() % 8];
+                data.insert(data.end(), word, word + std::strlen(word));
+            }
+        }
+        data.resize(options.sizeMiB << 20);
+        return data;
+    }
+
+    template<typename F>
+    double bestOf(int iterations, F&& body) {
+        double best = 1e30;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    void report(const char* name, std::size_t bytes, double ms) {
+        std::cout << name << ": " << ms << " ms, " << (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) << " MiB/s" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        if (!options.profilePath.empty()) {
+            Profiler::setThreadName("main");
+            Profiler::start();
+        }
+        auto input = makeInput(options);
+
+        // Encode every 64 KiB chunk into one contiguous buffer, the same layout a GLZ pack asset has.
+        std::vector<std::uint8_t> compressed;
+        std::vector<GlzChunkRef> chunks;
+        for (std::size_t at = 0; at < input.size(); at += GLZ_CHUNK_SIZE) {
+            std::size_t size = std::min<std::size_t>(GLZ_CHUNK_SIZE, input.size() - at);
+            auto encoded = glzCompress(input.data() + at, size);
+            chunks.push_back({static_cast<std::uint32_t>(compressed.size()), static_cast<std::uint32_t>(at), static_cast<std::uint32_t>(size),
+                              static_cast<std::uint32_t>(encoded.size())});
+            compressed.insert(compressed.end(), encoded.begin(), encoded.end());
+        }
+        std::cout << "Input " << input.size() << " bytes, GLZ " << compressed.size() << " bytes ("
+                  << 100.0 * compressed.size() / input.size() << "%), " << chunks.size() << " chunks" << std::endl;
+
+        // CPU reference.
+        std::vector<std::uint8_t> output(input.size());
+        auto decodeChunk = [&](std::size_t i) {
+            const GlzChunkRef& c = chunks[i];
+            if (!glzDecompress(compressed.data() + c.srcOffset, c.compressedSize, output.data() + c.dstOffset, c.size)) {
+                throw std::runtime_error("CPU GLZ decode failed");
+            }
+        };
+        report("CPU GLZ, 1 thread", input.size(), bestOf(options.iterations, [&] {
+            for (std::size_t i = 0; i < chunks.size(); i++) decodeChunk(i);
+        }));
+        if (output != input) throw std::runtime_error("CPU GLZ output mismatch");
+        JobSystem jobs;
+        report("CPU GLZ, job system", input.size(), bestOf(options.iterations, [&] {
+            jobs.parallelFor(chunks.size(), decodeChunk);
+        }));
+#ifdef VT_HAVE_LZ4
+        {
+            std::vector<std::vector<char>> lz4Chunks;
+            for (const auto& c : chunks) {
+                std::vector<char> out(static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(c.size))));
+                int n = LZ4_compress_default(reinterpret_cast<const char*>(input.data() + c.dstOffset), out.data(), static_cast<int>(c.size), static_cast<int>(out.size()));
+                out.resize(static_cast<std::size_t>(n));
+                lz4Chunks.push_back(std::move(out));
+            }
+            report("CPU LZ4, job system", input.size(), bestOf(options.iterations, [&] {
+                jobs.parallelFor(chunks.size(), [&](std::size_t i) {
+                    LZ4_decompress_safe(lz4Chunks[i].data(), reinterpret_cast<char*>(output.data() + chunks[i].dstOffset),
+                                        static_cast<int>(lz4Chunks[i].size()), static_cast<int>(chunks[i].size));
+                });
+            }));
+        }
+#endif
+
+        // GPU. Headless: no surface extensions, no layers. Decodes on the async compute queue when there is one.
+        VulkanContextCreateInfo info;
+        info.applicationName = "glz_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.computeQueue();
+        std::uint32_t family = context.queueFamilies().computeFamily;
+        // Installed before the decompressor so its pipeline and buffers are part of the capture.
+        std::unique_ptr<GpuCapture> capture;
+        if (!options.capturePath.empty()) {
+            capture.reset(new GpuCapture(context, options.capturePath, 0, 1));
+        }
+
+        bool match;
+        {
+            // The output is read back on the graphics queue, which takes it over from compute.
+            std::uint32_t graphicsFamily = context.queueFamilies().graphicsFamily;
+            GpuDecompressor decompressor(physicalDevice, device, family, queue, graphicsFamily, options.shaderPath);
+            VkDeviceSize outputSize = (input.size() + 3) & ~std::size_t(3);
+            Buffer deviceOutput = createBuffer(physicalDevice, device, outputSize,
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "GLZ output");
+            double kernelMs = 1e30;
+            double totalMs = bestOf(options.iterations, [&] {
+                kernelMs = std::min(kernelMs, decompressor.decompress(compressed.data(), compressed.size(), chunks, deviceOutput.buffer));
+                if (capture) capture->frameBoundary();
+            });
+            if (kernelMs > 0) {
+                report("GPU GLZ, kernel", input.size(), kernelMs);
+            }
+            report("GPU GLZ, upload + decode + wait", input.size(), totalMs);
+
+            // Read back once to check the shader against the CPU decoder.
+            Buffer readback = createBuffer(physicalDevice, device, outputSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "readback");
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = graphicsFamily;
+            VkCommandPool pool;
+            vkCreateCommandPool(device, &poolInfo, nullptr, &pool);
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = pool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VkCommandBuffer cmd;
+            vkAllocateCommandBuffers(device, &allocInfo, &cmd);
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            vkBeginCommandBuffer(cmd, &beginInfo);
+            {
+                CommandLabel label(cmd, "readback");
+                decompressor.acquire(cmd, deviceOutput.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+                VkBufferCopy region = {0, 0, outputSize};
+                vkCmdCopyBuffer(cmd, deviceOutput.buffer, readback.buffer, 1, &region);
+            }
+            vkEndCommandBuffer(cmd);
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &cmd;
+            vkQueueSubmit(context.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+            vkQueueWaitIdle(context.graphicsQueue());
+            match = std::memcmp(readback.mapped, input.data(), input.size()) == 0;
+            std::cout << "GPU output " << (match ? "matches" : "DOES NOT match") << " input." << std::endl;
+
+            vkDestroyCommandPool(device, pool, nullptr);
+            destroyBuffer(device, readback);
+            destroyBuffer(device, deviceOutput);
+        }
+        if (!options.profilePath.empty()) {
+            Profiler::writeTrace(options.profilePath);
+        }
+        if (!match) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
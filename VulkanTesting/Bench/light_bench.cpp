@@ -0,0 +1,296 @@
+// light_bench: clustered lighting scaling, from 10 to 100k point lights.
+//
+//   light_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--iterations N] [--naive-max N]
+//
+// For every light count it times the binning pass, a full-screen shade through the clusters and, up
+// to --naive-max lights, the same shade looping over every light. The binned counts are checked
+// against the CPU reference in ClusteredLighting.cpp. Lights sit just above a ground plane spread
+// over the view frustum, which is what a scene full of small dynamic lights looks like.
+// One key=value line per light count so that sweep scripts can grep it.
+
+#include "../ClusteredLighting.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+#include "../VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 1920;
+        std::uint32_t height = 1080;
+        int iterations = 5;
+        std::uint32_t naiveMax = 10000;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--iterations" && hasValue) options.iterations = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--naive-max" && hasValue) options.naiveMax = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    // Mirrors the push constants of shaders/clustered_shade.comp.
+    struct ShadePush {
+        ClusterParams params;
+        std::uint32_t extent[2];
+        std::uint32_t lightCount;
+        std::uint32_t naive;
+    };
+
+    // The camera sits 10 units behind the world origin; lights are generated in view space and moved
+    // back into world space, so the binning pass has a real transform to apply.
+    const float VIEW[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, -10, 1};
+
+    void makeLights(PointLight* lights, std::uint32_t count, const ClusterParams& params) {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (std::uint32_t i = 0; i < count; i++) {
+            float depth = 1.0f + 149.0f * unit(rng);
+            PointLight& light = lights[i];
+            light.position[0] = (unit(rng) * 2.0f - 1.0f) * params.tanHalfFovX * depth;
+            light.position[1] = -2.0f + 0.2f + 1.3f * unit(rng);
+            light.position[2] = -depth + 10.0f;
+            light.radius = 0.5f + 3.5f * unit(rng);
+            for (float& c : light.color) c = unit(rng);
+            light.intensity = 1.0f + 4.0f * unit(rng);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "light_bench";
+        info.device = options.device;
+        info.measureUploads = true; // The light list is a DynamicBuffer.
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.computeQueue();
+        std::uint32_t family = context.queueFamilies().computeFamily;
+
+        ClusterParams params;
+        params.tanHalfFovY = params.tanHalfFovX * options.height / options.width;
+        const std::uint32_t maxLights = 100000;
+        ClusteredLighting lighting(physicalDevice, device, options.shaderDir + "/light_cluster.comp.spv", params, maxLights);
+
+        // Shading pipeline: set 0 is the cluster grid, set 1 the output pixels.
+        Buffer pixels = createBuffer(physicalDevice, device, VkDeviceSize(options.width) * options.height * 4,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "shaded pixels");
+        Buffer readback = createBuffer(physicalDevice, device, VkDeviceSize(params.clusterCount()) * sizeof(std::uint32_t),
+                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "cluster count readback");
+        VkShaderModule shadeModule = createShaderModule(device, options.shaderDir + "/clustered_shade.comp.spv");
+        VkDescriptorSetLayoutBinding outputBinding = {};
+        outputBinding.binding = 0;
+        outputBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        outputBinding.descriptorCount = 1;
+        outputBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &outputBinding;
+        VkDescriptorSetLayout outputLayout;
+        vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &outputLayout);
+        VkDescriptorSetLayout setLayouts[2] = {lighting.setLayout(), outputLayout};
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ShadePush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 2;
+        pipelineLayoutInfo.pSetLayouts = setLayouts;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VkPipelineLayout shadeLayout;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &shadeLayout);
+        VkPipeline shadePipeline = createComputePipeline(device, shadeModule, shadeLayout);
+        VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VkDescriptorPool descriptorPool;
+        vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &outputLayout;
+        VkDescriptorSet outputSet;
+        vkd.vkAllocateDescriptorSets(device, &setInfo, &outputSet);
+        VkDescriptorBufferInfo outputInfo = {pixels.buffer, 0, VK_WHOLE_SIZE};
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = outputSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &outputInfo;
+        vkd.vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        setObjectName(device, shadePipeline, "clustered shade");
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (families[family].timestampValidBits == 0) {
+            throw std::runtime_error("light_bench needs timestamp queries on the compute queue.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 4;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+
+        bool allMatch = true;
+        makeLights(lighting.lights(), maxLights, params);
+        for (std::uint32_t lightCount : {10u, 100u, 1000u, 10000u, 100000u}) {
+            bool naive = lightCount <= options.naiveMax;
+            double best[3] = {1e30, 1e30, 1e30};
+            for (int iteration = 0; iteration < options.iterations; iteration++) {
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 4);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+                lighting.record(commandBuffer, VIEW, lightCount);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+
+                ShadePush push = {params, {options.width, options.height}, lightCount, 0};
+                VkDescriptorSet sets[2] = {lighting.descriptorSet(), outputSet};
+                VkMemoryBarrier shaded = {};
+                shaded.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                shaded.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                shaded.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, shadePipeline);
+                vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, shadeLayout, 0, 2, sets, 0, nullptr);
+                {
+                    CommandLabel label(commandBuffer, "clustered shade");
+                    vkd.vkCmdPushConstants(commandBuffer, shadeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+                    vkd.vkCmdDispatch(commandBuffer, (options.width + 7) / 8, (options.height + 7) / 8, 1);
+                }
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 2);
+                if (naive) {
+                    CommandLabel label(commandBuffer, "naive shade");
+                    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                             0, 1, &shaded, 0, nullptr, 0, nullptr);
+                    push.naive = 1;
+                    vkd.vkCmdPushConstants(commandBuffer, shadeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+                    vkd.vkCmdDispatch(commandBuffer, (options.width + 7) / 8, (options.height + 7) / 8, 1);
+                }
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 3);
+                VkBufferCopy region = {0, 0, readback.size};
+                vkd.vkCmdCopyBuffer(commandBuffer, lighting.clusterCountBuffer(), readback.buffer, 1, &region);
+                vkEndCommandBuffer(commandBuffer);
+
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+                if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit light bench!");
+                }
+                vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                vkResetFences(device, 1, &fence);
+                std::uint64_t ticks[4];
+                vkGetQueryPoolResults(device, queryPool, 0, 4, sizeof(ticks), ticks, sizeof(std::uint64_t),
+                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                for (int phase = 0; phase < 3; phase++) {
+                    best[phase] = std::min(best[phase], (ticks[phase + 1] - ticks[phase]) * properties.limits.timestampPeriod / 1e6);
+                }
+            }
+
+            // Binning statistics and the check against the CPU reference.
+            auto gpuCounts = static_cast<const std::uint32_t*>(readback.mapped);
+            auto cpuCounts = clusterLightCounts(params, VIEW, lighting.lights(), lightCount);
+            std::uint32_t mismatched = 0, overflowing = 0, maxCount = 0, used = 0;
+            std::uint64_t total = 0;
+            for (std::uint32_t c = 0; c < params.clusterCount(); c++) {
+                mismatched += gpuCounts[c] != cpuCounts[c];
+                overflowing += gpuCounts[c] > params.maxLightsPerCluster;
+                maxCount = std::max(maxCount, gpuCounts[c]);
+                used += gpuCounts[c] > 0;
+                total += gpuCounts[c];
+            }
+            // Lights right on a cluster boundary may land differently with the GPU's log/pow.
+            bool match = mismatched <= params.clusterCount() / 100;
+            allMatch = allMatch && match;
+            std::cout << "lights=" << lightCount
+                      << " bin_ms=" << best[0]
+                      << " shade_ms=" << best[1];
+            if (naive) std::cout << " naive_ms=" << best[2];
+            std::cout << " avg_per_cluster=" << (used ? static_cast<double>(total) / used : 0.0)
+                      << " max_per_cluster=" << maxCount
+                      << " overflowing=" << overflowing
+                      << " cpu_mismatch=" << mismatched << std::endl;
+        }
+
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyPipeline(device, shadePipeline, nullptr);
+        vkDestroyPipelineLayout(device, shadeLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, outputLayout, nullptr);
+        vkDestroyShaderModule(device, shadeModule, nullptr);
+        destroyBuffer(device, readback);
+        destroyBuffer(device, pixels);
+        if (!allMatch) {
+            std::cerr << "GPU binning differs from the CPU reference." << std::endl;
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,340 @@
+// particle_bench: GPU particles from thousands to millions, simulated on the compute queue and drawn
+// on the graphics queue.
+//
+//   particle_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--frames N] [--particles N]
+//
+// For each count (65536, 262144, 1048576 and 4194304, or just --particles) a ParticleSystem starts
+// with a burst of that many particles and keeps the population steady by emitting count / mean
+// lifetime per second. Every frame, simulation, compaction and emission are submitted to the compute
+// queue and the indirect draw to the graphics queue, into an offscreen target. With a dedicated
+// compute family the two submits hand the buffers over with ownership transfers and semaphores
+// (queues=separate); otherwise both go to one queue (queues=shared). Reports the live and dropped
+// counts, the GPU time of each side, and particles simulated per second.
+
+#include "../GraphicsPipelines.hpp"
+#include "../ParticleSystem.hpp"
+#include "../VecMath.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 1280;
+        std::uint32_t height = 720;
+        std::uint32_t frames = 240;
+        std::vector<std::uint32_t> counts = {65536, 262144, 1048576, 4194304};
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(16, std::atoi(argv[++i])));
+            else if (arg == "--particles" && hasValue) options.counts = {static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])))};
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    VkCommandBuffer allocateCommandBuffer(VkDevice device, VkCommandPool pool) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        return commandBuffer;
+    }
+
+    VkCommandPool createCommandPool(VkDevice device, std::uint32_t family) {
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle_bench command pool!");
+        }
+        return commandPool;
+    }
+
+    VkQueryPool createTimestampPool(VkDevice device) {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+        return queryPool;
+    }
+
+    double elapsedMs(VkDevice device, VkQueryPool queryPool, double period) {
+        std::uint64_t stamps[2];
+        vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        return (stamps[1] - stamps[0]) * period;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "particle_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        std::uint32_t computeFamily = context.queueFamilies().computeFamily;
+        std::uint32_t graphicsFamily = context.queueFamilies().graphicsFamily;
+        VkQueue computeQueue = context.computeQueue();
+        VkQueue graphicsQueue = context.graphicsQueue();
+        bool separate = computeFamily != graphicsFamily;
+        VkExtent2D extent = {options.width, options.height};
+
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (families[computeFamily].timestampValidBits == 0 || families[graphicsFamily].timestampValidBits == 0) {
+            throw std::runtime_error("particle_bench needs timestamp queries on the compute and graphics queues.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        double period = properties.limits.timestampPeriod * 1e-6;
+
+        // One color attachment, cleared every frame. Pipelines go into this render pass.
+        const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        Image color = createImage(physicalDevice, device, extent, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                  "particle_bench color");
+        VkAttachmentDescription attachment = {};
+        attachment.format = colorFormat;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+        // The previous frame's writes to the same image.
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &attachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        VkRenderPass renderPass;
+        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle_bench render pass!");
+        }
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &color.view;
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+        VkFramebuffer framebuffer;
+        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle_bench framebuffer!");
+        }
+
+        DynamicStateSupport dynamicState = context.dynamicState();
+        dynamicState.dynamicRendering = false;
+        GraphicsPipelineCache pipelines(device, dynamicState);
+        RenderTarget target = {{colorFormat}, VK_FORMAT_UNDEFINED, renderPass, 0};
+
+        VkCommandPool computePool = createCommandPool(device, computeFamily);
+        VkCommandPool graphicsPool = createCommandPool(device, graphicsFamily);
+        VkCommandBuffer computeCommands = allocateCommandBuffer(device, computePool);
+        VkCommandBuffer graphicsCommands = allocateCommandBuffer(device, graphicsPool);
+        VkQueryPool computeQueries = createTimestampPool(device);
+        VkQueryPool graphicsQueries = createTimestampPool(device);
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkSemaphore simulated, drawn;
+        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &simulated);
+        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &drawn);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+        setObjectName(device, renderPass, "particle_bench pass");
+        setObjectName(device, simulated, "particles simulated");
+        setObjectName(device, drawn, "particles drawn");
+
+        // A fountain seen from the side, falling back onto the floor.
+        Mat4 view = lookAt(Vec3(0, 6, 22), Vec3(0, 5, 0), Vec3(0, 1, 0));
+        Mat4 viewProj = perspective(0.9f, static_cast<float>(extent.width) / extent.height, 0.1f, 100.0f) * view;
+        Vec3 right(view.at(0, 0), view.at(0, 1), view.at(0, 2));
+        Vec3 up(view.at(1, 0), view.at(1, 1), view.at(1, 2));
+        VkViewport viewport = {0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, extent};
+        const float dt = 1.0f / 60.0f;
+
+        for (std::uint32_t count : options.counts) {
+            ParticleEmitter emitter;
+            emitter.origin = Vec3(0, 0.5f, 0);
+            emitter.radius = 0.3f;
+            emitter.speed = 10.0f;
+            emitter.spread = 0.35f;
+            emitter.speedJitter = 0.25f;
+            emitter.lifeMin = 2.0f;
+            emitter.lifeMax = 4.0f;
+            emitter.rate = count / (0.5f * (emitter.lifeMin + emitter.lifeMax));
+            ParticleForces forces;
+            forces.bounce = 0.4f;
+            // Headroom for the burst and the rate briefly overlapping.
+            ParticleSystem particles(physicalDevice, device, computeFamily, graphicsFamily, options.shaderDir,
+                                     count + count / 4);
+            particles.burst(count);
+            float size = 0.02f * std::max(1.0f, 512.0f / std::sqrt(static_cast<float>(count)));
+
+            double simMs = 0, drawMs = 0, simulatedParticles = 0;
+            std::uint32_t timed = 0;
+            for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+                bool last = frame + 1 == options.frames;
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkd.vkBeginCommandBuffer(computeCommands, &beginInfo);
+                vkd.vkCmdResetQueryPool(computeCommands, computeQueries, 0, 2);
+                vkd.vkCmdWriteTimestamp(computeCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, computeQueries, 0);
+                particles.simulate(computeCommands, dt, emitter, forces);
+                vkd.vkCmdWriteTimestamp(computeCommands, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, computeQueries, 1);
+                vkEndCommandBuffer(computeCommands);
+
+                vkd.vkBeginCommandBuffer(graphicsCommands, &beginInfo);
+                vkd.vkCmdResetQueryPool(graphicsCommands, graphicsQueries, 0, 2);
+                vkd.vkCmdWriteTimestamp(graphicsCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graphicsQueries, 0);
+                particles.acquire(graphicsCommands);
+                VkClearValue clear = {};
+                clear.color = {{0.02f, 0.02f, 0.03f, 1.0f}};
+                VkRenderPassBeginInfo passInfo = {};
+                passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                passInfo.renderPass = renderPass;
+                passInfo.framebuffer = framebuffer;
+                passInfo.renderArea = scissor;
+                passInfo.clearValueCount = 1;
+                passInfo.pClearValues = &clear;
+                vkCmdBeginRenderPass(graphicsCommands, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdSetViewport(graphicsCommands, 0, 1, &viewport);
+                vkCmdSetScissor(graphicsCommands, 0, 1, &scissor);
+                particles.draw(graphicsCommands, pipelines, target, viewProj, right, up, size);
+                vkCmdEndRenderPass(graphicsCommands);
+                particles.release(graphicsCommands);
+                vkd.vkCmdWriteTimestamp(graphicsCommands, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, graphicsQueries, 1);
+                vkEndCommandBuffer(graphicsCommands);
+
+                // Separate queues: the draw waits for the simulation, the next simulation for the draw.
+                VkPipelineStageFlags simulateWait = ParticleSystem::simulateWaitStages();
+                VkPipelineStageFlags drawWait = ParticleSystem::drawWaitStages();
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &computeCommands;
+                if (separate) {
+                    submitInfo.waitSemaphoreCount = frame > 0 ? 1 : 0;
+                    submitInfo.pWaitSemaphores = &drawn;
+                    submitInfo.pWaitDstStageMask = &simulateWait;
+                    submitInfo.signalSemaphoreCount = 1;
+                    submitInfo.pSignalSemaphores = &simulated;
+                }
+                if (vkd.vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit particle simulation!");
+                }
+                submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &graphicsCommands;
+                if (separate) {
+                    submitInfo.waitSemaphoreCount = 1;
+                    submitInfo.pWaitSemaphores = &simulated;
+                    submitInfo.pWaitDstStageMask = &drawWait;
+                    // Nothing waits after the last frame, and the semaphore outlives this system.
+                    submitInfo.signalSemaphoreCount = last ? 0 : 1;
+                    submitInfo.pSignalSemaphores = &drawn;
+                }
+                if (vkd.vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit particle draw!");
+                }
+                // The draw waited for the simulation, so the fence covers both.
+                vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                vkResetFences(device, 1, &fence);
+
+                // The first frames fill the buffers and warm up clocks.
+                if (frame >= 8) {
+                    simMs += elapsedMs(device, computeQueries, period);
+                    drawMs += elapsedMs(device, graphicsQueries, period);
+                    simulatedParticles += particles.stats().live;
+                    timed++;
+                }
+            }
+
+            ParticleStats stats = particles.stats();
+            std::cout << "particles=" << count
+                      << " alive=" << stats.live
+                      << " dropped=" << stats.dropped
+                      << " sim_ms=" << simMs / timed
+                      << " draw_ms=" << drawMs / timed
+                      << " mparticles_per_s=" << simulatedParticles * 1e-6 / (simMs * 1e-3)
+                      << " queues=" << (separate ? "separate" : "shared") << std::endl;
+            // The next system's shaders and layout may reuse these handles.
+            pipelines.clear();
+        }
+
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroySemaphore(device, drawn, nullptr);
+        vkDestroySemaphore(device, simulated, nullptr);
+        vkDestroyQueryPool(device, graphicsQueries, nullptr);
+        vkDestroyQueryPool(device, computeQueries, nullptr);
+        vkDestroyCommandPool(device, graphicsPool, nullptr);
+        vkDestroyCommandPool(device, computePool, nullptr);
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        vkDestroyRenderPass(device, renderPass, nullptr);
+        destroyImage(device, color);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,395 @@
+// pipeline_bench: how many graphics pipelines a set of draw states needs, with and without dynamic
+// rendering and extended dynamic state.
+//
+//   pipeline_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--frames N] [--quads N]
+//
+// One program (the G-buffer shaders of render_pass_bench) drawn into three compatible render passes
+// that only differ in load op, under 480 raster states: cull mode and winding, depth test, write and
+// compare, topology and primitive restart, polygon mode, blending and color write mask. "baked" keys
+// pipelines on the render pass and every state bit, as a renderer without the extensions must;
+// "dynamic" lets GraphicsPipelineCache use whatever the device supports. Reports the pipeline count,
+// the CPU time spent creating them, and CPU and GPU time of a frame that draws every combination once,
+// where the dynamic path pays for its vkCmdSet* calls instead.
+
+#include "../GraphicsPipelines.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+#include "../VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 512;
+        std::uint32_t height = 512;
+        std::uint32_t frames = 16;
+        std::uint32_t quads = 16;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(2, std::atoi(argv[++i])));
+            else if (arg == "--quads" && hasValue) options.quads = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    // Mirrors the push constants of deferred_gbuffer.vert.
+    struct FramePush {
+        float aspect;
+        float time;
+    };
+
+    const VkFormat colorFormats[2] = {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT};
+    const VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+    const VkAttachmentLoadOp loadOps[3] = {VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_LOAD_OP_DONT_CARE};
+
+    // Two colors and depth, all left in their attachment layouts so any of the three can follow another.
+    VkRenderPass createRenderPass(VkDevice device, VkAttachmentLoadOp loadOp) {
+        VkAttachmentDescription attachments[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            attachments[i].format = i < 2 ? colorFormats[i] : depthFormat;
+            attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+            attachments[i].loadOp = loadOp;
+            attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            VkImageLayout layout = i < 2 ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            attachments[i].initialLayout = layout;
+            attachments[i].finalLayout = layout;
+        }
+        VkAttachmentReference colorRefs[2] = {{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}, {1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+        VkAttachmentReference depthRef = {2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 2;
+        subpass.pColorAttachments = colorRefs;
+        subpass.pDepthStencilAttachment = &depthRef;
+        // Each frame's passes follow the previous ones on the same attachments.
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 3;
+        renderPassInfo.pAttachments = attachments;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        VkRenderPass renderPass;
+        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render pass!");
+        }
+        return renderPass;
+    }
+
+    // The permutations a material system would ask for. Depth compare only varies with the test on.
+    std::vector<RasterState> rasterStates(bool wireframe) {
+        struct Cull { VkCullModeFlags mode; VkFrontFace front; };
+        const Cull culls[3] = {{VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE},
+                               {VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE},
+                               {VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE}};
+        struct Depth { bool test, write; VkCompareOp compare; };
+        const Depth depths[5] = {{false, false, VK_COMPARE_OP_LESS}, {true, false, VK_COMPARE_OP_LESS},
+                                 {true, true, VK_COMPARE_OP_LESS}, {true, false, VK_COMPARE_OP_LESS_OR_EQUAL},
+                                 {true, true, VK_COMPARE_OP_GREATER_OR_EQUAL}};
+        struct Topology { VkPrimitiveTopology topology; bool restart; };
+        const Topology topologies[4] = {{VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, false}, {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, false},
+                                        {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, true}, {VK_PRIMITIVE_TOPOLOGY_LINE_LIST, false}};
+        std::vector<RasterState> states;
+        for (const Cull& cull : culls) {
+            for (const Depth& depth : depths) {
+                for (const Topology& topology : topologies) {
+                    for (VkPolygonMode polygonMode : {VK_POLYGON_MODE_FILL, VK_POLYGON_MODE_LINE}) {
+                        for (bool blend : {false, true}) {
+                            for (bool alpha : {true, false}) {
+                                RasterState state;
+                                state.cullMode = cull.mode;
+                                state.frontFace = cull.front;
+                                state.depthTest = depth.test;
+                                state.depthWrite = depth.write;
+                                state.depthCompare = depth.compare;
+                                state.topology = topology.topology;
+                                state.primitiveRestart = topology.restart;
+                                // Without fillModeNonSolid the wireframe variants are just filled again.
+                                state.polygonMode = wireframe ? polygonMode : VK_POLYGON_MODE_FILL;
+                                state.blend = blend;
+                                state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+                                                       (alpha ? VK_COLOR_COMPONENT_A_BIT : 0);
+                                states.push_back(state);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return states;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "pipeline_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+        const DynamicStateSupport& support = context.dynamicState();
+        VkExtent2D extent = {options.width, options.height};
+
+        std::vector<RasterState> states = rasterStates(support.fillModeNonSolid);
+        std::cout << "dynamic_rendering=" << support.dynamicRendering
+                  << " extended_dynamic_state=" << support.extendedDynamicState
+                  << " extended_dynamic_state2=" << support.extendedDynamicState2
+                  << " dynamic_polygon_mode=" << support.polygonMode
+                  << " dynamic_blend_enable=" << support.colorBlendEnable
+                  << " dynamic_write_mask=" << support.colorWriteMask
+                  << " unrestricted_topology=" << support.unrestrictedTopology
+                  << " states=" << states.size() << std::endl;
+
+        GraphicsProgram program;
+        program.vertex = createShaderModule(device, options.shaderDir + "/deferred_gbuffer.vert.spv");
+        program.fragment = createShaderModule(device, options.shaderDir + "/deferred_gbuffer.frag.spv");
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FramePush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &program.layout);
+
+        Image attachments[3];
+        for (std::uint32_t i = 0; i < 3; i++) {
+            bool depth = i == 2;
+            attachments[i] = createImage(physicalDevice, device, extent, depth ? depthFormat : colorFormats[i],
+                                         depth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                         depth ? "pipeline_bench depth" : "pipeline_bench color");
+        }
+        RenderTarget targets[3];
+        VkFramebuffer framebuffers[3];
+        for (std::uint32_t t = 0; t < 3; t++) {
+            targets[t].colorFormats = {colorFormats[0], colorFormats[1]};
+            targets[t].depthFormat = depthFormat;
+            targets[t].renderPass = createRenderPass(device, loadOps[t]);
+            VkImageView views[3] = {attachments[0].view, attachments[1].view, attachments[2].view};
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = targets[t].renderPass;
+            framebufferInfo.attachmentCount = 3;
+            framebufferInfo.pAttachments = views;
+            framebufferInfo.width = extent.width;
+            framebufferInfo.height = extent.height;
+            framebufferInfo.layers = 1;
+            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffers[t]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
+        }
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+
+        auto submit = [&]() {
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit pipeline_bench commands!");
+            }
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+        };
+
+        // The render passes expect attachment layouts on entry.
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        VkImageMemoryBarrier barriers[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            bool depth = i == 2;
+            barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barriers[i].dstAccessMask = depth ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[i].newLayout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].image = attachments[i].image;
+            barriers[i].subresourceRange = {static_cast<VkImageAspectFlags>(depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT), 0, 1, 0, 1};
+        }
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                                 0, 0, nullptr, 0, nullptr, 3, barriers);
+        vkEndCommandBuffer(commandBuffer);
+        submit();
+
+        FramePush push = {static_cast<float>(extent.width) / extent.height, 0.0f};
+        VkViewport viewport = {0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, extent};
+        VkClearValue clearValues[3] = {};
+        clearValues[2].depthStencil = {1.0f, 0};
+
+        for (bool dynamic : {false, true}) {
+            GraphicsPipelineCache cache(device, support, dynamic);
+            // Everything a level would ask for up front, which is where a loading screen or a hitch goes.
+            for (const RenderTarget& target : targets) {
+                for (const RasterState& state : states) {
+                    cache.get(program, target, state);
+                }
+            }
+            GraphicsPipelineStats created = cache.stats();
+
+            double recordMs = 0;
+            double gpuMs = 0;
+            for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+                push.time = static_cast<float>(frame) / 60.0f;
+                auto start = std::chrono::steady_clock::now();
+                vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+                for (std::uint32_t t = 0; t < 3; t++) {
+                    if (cache.dynamicRendering()) {
+                        VkRenderingAttachmentInfoKHR colorInfos[2] = {};
+                        for (std::uint32_t i = 0; i < 2; i++) {
+                            colorInfos[i].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+                            colorInfos[i].imageView = attachments[i].view;
+                            colorInfos[i].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                            colorInfos[i].loadOp = loadOps[t];
+                            colorInfos[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                            colorInfos[i].clearValue = clearValues[i];
+                        }
+                        VkRenderingAttachmentInfoKHR depthInfo = colorInfos[0];
+                        depthInfo.imageView = attachments[2].view;
+                        depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                        depthInfo.clearValue = clearValues[2];
+                        VkRenderingInfoKHR renderingInfo = {};
+                        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+                        renderingInfo.renderArea = scissor;
+                        renderingInfo.layerCount = 1;
+                        renderingInfo.colorAttachmentCount = 2;
+                        renderingInfo.pColorAttachments = colorInfos;
+                        renderingInfo.pDepthAttachment = &depthInfo;
+                        vkd.vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+                    } else {
+                        VkRenderPassBeginInfo renderPassInfo = {};
+                        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                        renderPassInfo.renderPass = targets[t].renderPass;
+                        renderPassInfo.framebuffer = framebuffers[t];
+                        renderPassInfo.renderArea = scissor;
+                        renderPassInfo.clearValueCount = 3;
+                        renderPassInfo.pClearValues = clearValues;
+                        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                    }
+                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+                    for (const RasterState& state : states) {
+                        cache.bind(commandBuffer, program, targets[t], state);
+                        vkd.vkCmdPushConstants(commandBuffer, program.layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                               0, sizeof(push), &push);
+                        vkCmdDraw(commandBuffer, 6, options.quads, 0, 0);
+                    }
+                    if (cache.dynamicRendering()) {
+                        vkd.vkCmdEndRenderingKHR(commandBuffer);
+                    } else {
+                        vkCmdEndRenderPass(commandBuffer);
+                    }
+                }
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+                vkEndCommandBuffer(commandBuffer);
+                double record = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                submit();
+                std::uint64_t stamps[2];
+                vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                // The first frame warms driver-side caches.
+                if (frame > 0) {
+                    recordMs += record;
+                    gpuMs += (stamps[1] - stamps[0]) * properties.limits.timestampPeriod * 1e-6;
+                }
+            }
+
+            std::uint32_t timed = options.frames - 1;
+            std::cout << "mode=" << (dynamic ? "dynamic" : "baked")
+                      << " draws=" << 3 * states.size()
+                      << " pipelines=" << created.pipelines
+                      << " create_ms=" << created.createMs
+                      << " create_ms_per_pipeline=" << created.createMs / std::max(1u, created.pipelines)
+                      << " record_ms=" << recordMs / timed
+                      << " gpu_ms=" << gpuMs / timed << std::endl;
+        }
+
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        for (std::uint32_t t = 0; t < 3; t++) {
+            vkDestroyFramebuffer(device, framebuffers[t], nullptr);
+            vkDestroyRenderPass(device, targets[t].renderPass, nullptr);
+        }
+        for (Image& attachment : attachments) {
+            destroyImage(device, attachment);
+        }
+        vkDestroyPipelineLayout(device, program.layout, nullptr);
+        vkDestroyShaderModule(device, program.fragment, nullptr);
+        vkDestroyShaderModule(device, program.vertex, nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,318 @@
+// post_bench: the post-processing chain fused into one compute pass per frame versus one pass per
+// effect.
+//
+//   post_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--frames N] [--quads N]
+//
+// Renders the deferred frame of render_pass_bench (G-buffer and lighting through RenderGraph) and
+// hands the lit HDR attachment straight from the graph to PostProcess: bloom, tonemapping, grading
+// and sharpening. "fused" runs the per-pixel stages in a single dispatch, "separate" gives each
+// its own full-screen pass through an intermediate image. Reports dispatches, the image traffic of
+// the chain, its GPU time, and the largest difference between the two outputs (in 8-bit steps;
+// separate rounds to 8 bits between stages, so expect a step or two).
+
+#include "../GraphicsPipelines.hpp"
+#include "../PostProcess.hpp"
+#include "../RenderGraph.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+#include "../VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 1920;
+        std::uint32_t height = 1080;
+        std::uint32_t frames = 100;
+        std::uint32_t quads = 20000;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(8, std::atoi(argv[++i])));
+            else if (arg == "--quads" && hasValue) options.quads = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    // Mirrors the push constants of the deferred_* shaders.
+    struct FramePush {
+        float aspect;
+        float time;
+    };
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "post_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+        VkExtent2D extent = {options.width, options.height};
+
+        // The lit frame. Pipelines go into RenderGraph's render passes, so no dynamic rendering.
+        DynamicStateSupport dynamicState = context.dynamicState();
+        dynamicState.dynamicRendering = false;
+        GraphicsPipelineCache pipelines(device, dynamicState);
+        GraphicsProgram gbufferProgram, lightingProgram;
+        gbufferProgram.vertex = createShaderModule(device, options.shaderDir + "/deferred_gbuffer.vert.spv");
+        gbufferProgram.fragment = createShaderModule(device, options.shaderDir + "/deferred_gbuffer.frag.spv");
+        lightingProgram.vertex = createShaderModule(device, options.shaderDir + "/fullscreen.vert.spv");
+        lightingProgram.fragment = createShaderModule(device, options.shaderDir + "/deferred_lighting.frag.spv");
+
+        VkDescriptorSetLayoutBinding inputBindings[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            inputBindings[i].binding = i;
+            inputBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            inputBindings[i].descriptorCount = 1;
+            inputBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = inputBindings;
+        VkDescriptorSetLayout lightingSetLayout;
+        vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &lightingSetLayout);
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FramePush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &gbufferProgram.layout);
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &lightingSetLayout;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &lightingProgram.layout);
+
+        VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VkDescriptorPool descriptorPool;
+        vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &lightingSetLayout;
+        VkDescriptorSet lightingSet;
+        vkd.vkAllocateDescriptorSets(device, &setInfo, &lightingSet);
+
+        FramePush push = {static_cast<float>(extent.width) / extent.height, 0.0f};
+        VkViewport viewport = {0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, extent};
+        RenderGraph graph(physicalDevice, device);
+        VkClearValue black = {};
+        VkClearValue farDepth = {};
+        farDepth.depthStencil = {1.0f, 0};
+        std::uint32_t albedo = graph.addAttachment({"albedo", VK_FORMAT_R8G8B8A8_UNORM, false, black});
+        std::uint32_t normal = graph.addAttachment({"normal", VK_FORMAT_R16G16B16A16_SFLOAT, false, black});
+        std::uint32_t depth = graph.addAttachment({"depth", VK_FORMAT_D32_SFLOAT, false, farDepth});
+        std::uint32_t hdr = graph.addAttachment({"hdr", VK_FORMAT_R16G16B16A16_SFLOAT, true, black});
+        RenderTarget gbufferTarget, lightingTarget;
+        RasterState gbufferState, lightingState;
+        gbufferState.depthTest = true;
+        gbufferState.depthWrite = true;
+        std::uint32_t gbufferPass = graph.addPass({"gbuffer",
+            {{albedo, AttachmentUse::Color}, {normal, AttachmentUse::Color}, {depth, AttachmentUse::Depth}},
+            [&](VkCommandBuffer cmd) {
+                vkCmdSetViewport(cmd, 0, 1, &viewport);
+                vkCmdSetScissor(cmd, 0, 1, &scissor);
+                pipelines.bind(cmd, gbufferProgram, gbufferTarget, gbufferState);
+                vkd.vkCmdPushConstants(cmd, gbufferProgram.layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+                vkCmdDraw(cmd, 6, options.quads, 0, 0);
+            }});
+        std::uint32_t lightingPass = graph.addPass({"lighting",
+            {{albedo, AttachmentUse::Input}, {normal, AttachmentUse::Input}, {depth, AttachmentUse::Input}, {hdr, AttachmentUse::Color}},
+            [&](VkCommandBuffer cmd) {
+                vkCmdSetViewport(cmd, 0, 1, &viewport);
+                vkCmdSetScissor(cmd, 0, 1, &scissor);
+                pipelines.bind(cmd, lightingProgram, lightingTarget, lightingState);
+                vkd.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingProgram.layout, 0, 1, &lightingSet, 0, nullptr);
+                vkd.vkCmdPushConstants(cmd, lightingProgram.layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+                vkCmdDraw(cmd, 3, 1, 0, 0);
+            }});
+        graph.compile(extent);
+        std::cout << graph.describe();
+        gbufferTarget = {{VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT}, VK_FORMAT_D32_SFLOAT,
+                         graph.renderPass(gbufferPass), graph.subpass(gbufferPass)};
+        lightingTarget = {{VK_FORMAT_R16G16B16A16_SFLOAT}, VK_FORMAT_UNDEFINED,
+                          graph.renderPass(lightingPass), graph.subpass(lightingPass)};
+
+        VkDescriptorImageInfo inputInfos[3] = {
+            {VK_NULL_HANDLE, graph.view(albedo), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            {VK_NULL_HANDLE, graph.view(normal), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            {VK_NULL_HANDLE, graph.view(depth), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        };
+        VkWriteDescriptorSet writes[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = lightingSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            writes[i].pImageInfo = &inputInfos[i];
+        }
+        vkd.vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (families[family].timestampValidBits == 0) {
+            throw std::runtime_error("post_bench needs timestamp queries on the graphics queue.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 3;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+
+        VkDeviceSize pixelCount = static_cast<VkDeviceSize>(extent.width) * extent.height;
+        Buffer readback = createBuffer(physicalDevice, device, pixelCount * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "post_bench readback");
+        std::vector<std::uint8_t> firstOutput;
+
+        PostProcessSettings settings;
+        settings.gain[0] = 1.05f; // A mild warm grade, so that every stage does something.
+        settings.gain[2] = 0.95f;
+        settings.contrast = 1.1f;
+        settings.saturation = 1.1f;
+        for (bool fused : {true, false}) {
+            PostProcess post(physicalDevice, device, options.shaderDir, extent, fused);
+            post.setInput(graph.view(hdr));
+            double sceneMs = 0, postMs = 0;
+            std::uint32_t timed = 0;
+            std::uint32_t lastFrame = options.frames - 1;
+            for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+                push.time = static_cast<float>(frame) / 60.0f;
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 3);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+                graph.record(commandBuffer);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, queryPool, 1);
+                post.record(commandBuffer, settings);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, queryPool, 2);
+                if (frame == lastFrame) {
+                    VkBufferImageCopy region = {};
+                    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+                    region.imageExtent = {extent.width, extent.height, 1};
+                    vkCmdCopyImageToBuffer(commandBuffer, post.output().image, VK_IMAGE_LAYOUT_GENERAL, readback.buffer, 1, &region);
+                }
+                vkEndCommandBuffer(commandBuffer);
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+                if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit post_bench commands!");
+                }
+                vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                vkResetFences(device, 1, &fence);
+                std::uint64_t stamps[3];
+                vkGetQueryPoolResults(device, queryPool, 0, 3, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                if (frame >= 4) {
+                    double period = properties.limits.timestampPeriod * 1e-6;
+                    sceneMs += (stamps[1] - stamps[0]) * period;
+                    postMs += (stamps[2] - stamps[1]) * period;
+                    timed++;
+                }
+            }
+
+            // The readback barrier in PostProcess::record() covers the copy; the fence covers the host.
+            const auto* pixels = static_cast<const std::uint8_t*>(readback.mapped);
+            int maxDifference = 0;
+            if (firstOutput.empty()) {
+                firstOutput.assign(pixels, pixels + pixelCount * 4);
+            } else {
+                for (VkDeviceSize i = 0; i < pixelCount * 4; i++) {
+                    maxDifference = std::max(maxDifference, std::abs(static_cast<int>(pixels[i]) - firstOutput[i]));
+                }
+            }
+            const PostProcessStats& stats = post.stats();
+            std::cout << "mode=" << (fused ? "fused" : "separate")
+                      << " resolution=" << extent.width << "x" << extent.height
+                      << " dispatches=" << stats.dispatches
+                      << " read_mb=" << stats.bytesRead / 1048576.0
+                      << " written_mb=" << stats.bytesWritten / 1048576.0
+                      << " scene_ms=" << sceneMs / timed
+                      << " post_ms=" << postMs / timed;
+            if (!fused) {
+                std::cout << " max_difference=" << maxDifference;
+            }
+            std::cout << std::endl;
+        }
+
+        destroyBuffer(device, readback);
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        pipelines.clear();
+        vkDestroyPipelineLayout(device, lightingProgram.layout, nullptr);
+        vkDestroyPipelineLayout(device, gbufferProgram.layout, nullptr);
+        vkDestroyDescriptorSetLayout(device, lightingSetLayout, nullptr);
+        for (VkShaderModule module : {lightingProgram.fragment, lightingProgram.vertex, gbufferProgram.fragment, gbufferProgram.vertex}) {
+            vkDestroyShaderModule(device, module, nullptr);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
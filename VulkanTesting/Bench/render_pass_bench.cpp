@@ -0,0 +1,387 @@
+// render_pass_bench: a deferred frame with and without render pass merging.
+//
+//   render_pass_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--frames N] [--quads N]
+//
+// Three passes through RenderGraph: a G-buffer (albedo, normal, depth) of overlapping instanced
+// quads, lighting that reads the G-buffer through input attachments, and a post pass that samples
+// the lit image. "merged" lets the graph put G-buffer and lighting into subpasses of one render pass
+// with a transient G-buffer; "separate" gives every pass its own render pass, so the G-buffer is
+// stored and loaded again. Reports GPU time and the attachment traffic implied by the load and
+// store ops, which is what a tile-based GPU actually pays in DRAM bandwidth. Desktop GPUs run the
+// subpasses like separate passes, so expect the time to move much less than the traffic there.
+
+#include "../RenderGraph.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 1920;
+        std::uint32_t height = 1080;
+        std::uint32_t frames = 200;
+        std::uint32_t quads = 20000;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(8, std::atoi(argv[++i])));
+            else if (arg == "--quads" && hasValue) options.quads = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    // Mirrors the push constants of the deferred_* shaders.
+    struct FramePush {
+        float aspect;
+        float time;
+    };
+
+    // Triangle lists, no vertex input, dynamic viewport and scissor.
+    VkPipeline createPipeline(VkDevice device, VkShaderModule vertex, VkShaderModule fragment, VkPipelineLayout layout,
+                              VkRenderPass renderPass, std::uint32_t subpass, std::uint32_t colorCount, bool depth) {
+        VkPipelineShaderStageCreateInfo stages[2] = {};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vertex;
+        stages[0].pName = "main";
+        stages[1] = stages[0];
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = fragment;
+
+        VkPipelineVertexInputStateCreateInfo vertexInput = {};
+        vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkPipelineViewportStateCreateInfo viewport = {};
+        viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+        VkPipelineRasterizationStateCreateInfo rasterization = {};
+        rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization.cullMode = VK_CULL_MODE_NONE;
+        rasterization.lineWidth = 1.0f;
+        VkPipelineMultisampleStateCreateInfo multisample = {};
+        multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = depth ? VK_TRUE : VK_FALSE;
+        depthStencil.depthWriteEnable = depth ? VK_TRUE : VK_FALSE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(colorCount);
+        for (VkPipelineColorBlendAttachmentState& blend : blendAttachments) {
+            blend = {};
+            blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        }
+        VkPipelineColorBlendStateCreateInfo colorBlend = {};
+        colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlend.attachmentCount = colorCount;
+        colorBlend.pAttachments = blendAttachments.data();
+        VkDynamicState dynamicStates[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamic = {};
+        dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic.dynamicStateCount = 2;
+        dynamic.pDynamicStates = dynamicStates;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = stages;
+        pipelineInfo.pVertexInputState = &vertexInput;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewport;
+        pipelineInfo.pRasterizationState = &rasterization;
+        pipelineInfo.pMultisampleState = &multisample;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlend;
+        pipelineInfo.pDynamicState = &dynamic;
+        pipelineInfo.layout = layout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = subpass;
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+        return pipeline;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "render_pass_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+        VkExtent2D extent = {options.width, options.height};
+
+        VkShaderModule gbufferVertex = createShaderModule(device, options.shaderDir + "/deferred_gbuffer.vert.spv");
+        VkShaderModule gbufferFragment = createShaderModule(device, options.shaderDir + "/deferred_gbuffer.frag.spv");
+        VkShaderModule fullscreenVertex = createShaderModule(device, options.shaderDir + "/fullscreen.vert.spv");
+        VkShaderModule lightingFragment = createShaderModule(device, options.shaderDir + "/deferred_lighting.frag.spv");
+        VkShaderModule postFragment = createShaderModule(device, options.shaderDir + "/deferred_post.frag.spv");
+
+        // Set layouts: lighting reads three input attachments, post samples one image.
+        VkDescriptorSetLayoutBinding lightingBindings[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            lightingBindings[i].binding = i;
+            lightingBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            lightingBindings[i].descriptorCount = 1;
+            lightingBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+        VkDescriptorSetLayoutBinding postBinding = {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = lightingBindings;
+        VkDescriptorSetLayout lightingSetLayout, postSetLayout;
+        vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &lightingSetLayout);
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &postBinding;
+        vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &postSetLayout);
+
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FramePush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VkPipelineLayout gbufferLayout, lightingLayout, postLayout;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &gbufferLayout);
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &lightingSetLayout;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &lightingLayout);
+        pipelineLayoutInfo.pSetLayouts = &postSetLayout;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &postLayout);
+
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        VkSampler sampler;
+        vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
+
+        VkDescriptorPoolSize poolSizes[2] = {
+            {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+        };
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 2;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        VkDescriptorPool descriptorPool;
+        vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+        VkDescriptorSetLayout setLayouts[2] = {lightingSetLayout, postSetLayout};
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 2;
+        setInfo.pSetLayouts = setLayouts;
+        VkDescriptorSet sets[2];
+        vkd.vkAllocateDescriptorSets(device, &setInfo, sets);
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (families[family].timestampValidBits == 0) {
+            throw std::runtime_error("render_pass_bench needs timestamp queries on the graphics queue.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+
+        FramePush push = {static_cast<float>(extent.width) / extent.height, 0.0f};
+        VkViewport viewport = {0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+        VkRect2D scissor = {{0, 0}, extent};
+        VkPipeline gbufferPipeline = VK_NULL_HANDLE, lightingPipeline = VK_NULL_HANDLE, postPipeline = VK_NULL_HANDLE;
+
+        RenderGraph graph(physicalDevice, device);
+        VkClearValue black = {};
+        VkClearValue farDepth = {};
+        farDepth.depthStencil = {1.0f, 0};
+        std::uint32_t albedo = graph.addAttachment({"albedo", VK_FORMAT_R8G8B8A8_UNORM, false, black});
+        std::uint32_t normal = graph.addAttachment({"normal", VK_FORMAT_R16G16B16A16_SFLOAT, false, black});
+        std::uint32_t depth = graph.addAttachment({"depth", VK_FORMAT_D32_SFLOAT, false, farDepth});
+        std::uint32_t hdr = graph.addAttachment({"hdr", VK_FORMAT_R16G16B16A16_SFLOAT, false, black});
+        std::uint32_t ldr = graph.addAttachment({"ldr", VK_FORMAT_R8G8B8A8_UNORM, true, black});
+        std::uint32_t gbufferPass = graph.addPass({"gbuffer",
+            {{albedo, AttachmentUse::Color}, {normal, AttachmentUse::Color}, {depth, AttachmentUse::Depth}},
+            [&](VkCommandBuffer cmd) {
+                vkCmdSetViewport(cmd, 0, 1, &viewport);
+                vkCmdSetScissor(cmd, 0, 1, &scissor);
+                vkd.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, gbufferPipeline);
+                vkd.vkCmdPushConstants(cmd, gbufferLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+                vkCmdDraw(cmd, 6, options.quads, 0, 0);
+            }});
+        std::uint32_t lightingPass = graph.addPass({"lighting",
+            {{albedo, AttachmentUse::Input}, {normal, AttachmentUse::Input}, {depth, AttachmentUse::Input}, {hdr, AttachmentUse::Color}},
+            [&](VkCommandBuffer cmd) {
+                vkCmdSetViewport(cmd, 0, 1, &viewport);
+                vkCmdSetScissor(cmd, 0, 1, &scissor);
+                vkd.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline);
+                vkd.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingLayout, 0, 1, &sets[0], 0, nullptr);
+                vkd.vkCmdPushConstants(cmd, lightingLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+                vkCmdDraw(cmd, 3, 1, 0, 0);
+            }});
+        std::uint32_t postPass = graph.addPass({"post",
+            {{hdr, AttachmentUse::Sampled}, {ldr, AttachmentUse::Color}},
+            [&](VkCommandBuffer cmd) {
+                vkCmdSetViewport(cmd, 0, 1, &viewport);
+                vkCmdSetScissor(cmd, 0, 1, &scissor);
+                vkd.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, postPipeline);
+                vkd.vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, postLayout, 0, 1, &sets[1], 0, nullptr);
+                vkCmdDraw(cmd, 3, 1, 0, 0);
+            }});
+
+        for (bool merge : {true, false}) {
+            graph.compile(extent, merge);
+            std::cout << graph.describe();
+            gbufferPipeline = createPipeline(device, gbufferVertex, gbufferFragment, gbufferLayout,
+                                             graph.renderPass(gbufferPass), graph.subpass(gbufferPass), 2, true);
+            lightingPipeline = createPipeline(device, fullscreenVertex, lightingFragment, lightingLayout,
+                                              graph.renderPass(lightingPass), graph.subpass(lightingPass), 1, false);
+            postPipeline = createPipeline(device, fullscreenVertex, postFragment, postLayout,
+                                          graph.renderPass(postPass), graph.subpass(postPass), 1, false);
+
+            VkDescriptorImageInfo imageInfos[4] = {
+                {VK_NULL_HANDLE, graph.view(albedo), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                {VK_NULL_HANDLE, graph.view(normal), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                {VK_NULL_HANDLE, graph.view(depth), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                {sampler, graph.view(hdr), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            };
+            VkWriteDescriptorSet writes[4] = {};
+            for (std::uint32_t i = 0; i < 4; i++) {
+                writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet = i < 3 ? sets[0] : sets[1];
+                writes[i].dstBinding = i < 3 ? i : 0;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                writes[i].pImageInfo = &imageInfos[i];
+            }
+            vkd.vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+
+            double totalMs = 0;
+            std::uint32_t timed = 0;
+            for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+                push.time = static_cast<float>(frame) / 60.0f;
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+                graph.record(commandBuffer);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+                vkEndCommandBuffer(commandBuffer);
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+                if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit render_pass_bench commands!");
+                }
+                vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                vkResetFences(device, 1, &fence);
+                std::uint64_t stamps[2];
+                vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                // Skip the first frames: pipeline warm-up and clock ramp.
+                if (frame >= 4) {
+                    totalMs += (stamps[1] - stamps[0]) * properties.limits.timestampPeriod * 1e-6;
+                    timed++;
+                }
+            }
+
+            const RenderGraphStats& stats = graph.stats();
+            std::cout << "mode=" << (merge ? "merged" : "separate")
+                      << " resolution=" << extent.width << "x" << extent.height
+                      << " render_passes=" << stats.renderPasses
+                      << " subpasses=" << stats.subpasses
+                      << " transient=" << stats.transientAttachments
+                      << " lazily_allocated=" << stats.lazilyAllocated
+                      << " loaded_mb=" << stats.bytesLoaded / 1048576.0
+                      << " stored_mb=" << stats.bytesStored / 1048576.0
+                      << " gpu_ms=" << totalMs / timed << std::endl;
+
+            vkDestroyPipeline(device, postPipeline, nullptr);
+            vkDestroyPipeline(device, lightingPipeline, nullptr);
+            vkDestroyPipeline(device, gbufferPipeline, nullptr);
+        }
+
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroySampler(device, sampler, nullptr);
+        vkDestroyPipelineLayout(device, postLayout, nullptr);
+        vkDestroyPipelineLayout(device, lightingLayout, nullptr);
+        vkDestroyPipelineLayout(device, gbufferLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, postSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, lightingSetLayout, nullptr);
+        for (VkShaderModule module : {postFragment, lightingFragment, fullscreenVertex, gbufferFragment, gbufferVertex}) {
+            vkDestroyShaderModule(device, module, nullptr);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+// shadow_bench: how much shadow rendering the atlas cache saves over re-rendering every shadow map.
+//
+//   shadow_bench [--lights N] [--casters N] [--frames N] [--atlas SIZE] [--static-every N]
+//
+// CPU only: simulates a scene of spot and point lights plus a sun with cascades, a camera flying
+// through it and moving casters, and sums the texels that ShadowAtlas asks to render and copy per
+// frame. The re-render-all baseline draws every tile in full every frame. --static-every N also
+// changes a piece of static geometry every N frames (a door opening, say).
+// Prints one key=value line so that sweep scripts can grep it.
+
+#include "../ShadowAtlas.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::uint32_t lights = 64;
+        std::uint32_t casters = 16;
+        std::uint32_t frames = 600;
+        std::uint32_t atlas = 8192;
+        std::uint32_t staticEvery = 0;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--lights" && hasValue) options.lights = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+            else if (arg == "--casters" && hasValue) options.casters = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--atlas" && hasValue) options.atlas = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+            else if (arg == "--static-every" && hasValue) options.staticEvery = static_cast<std::uint32_t>(std::atoi(argv[++i]));
+            else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    Bounds box(const Vec3& center, float halfSize) {
+        Bounds bounds;
+        bounds.add(center - Vec3(halfSize, halfSize, halfSize));
+        bounds.add(center + Vec3(halfSize, halfSize, halfSize));
+        return bounds;
+    }
+
+    double area(const VkRect2D& rect) {
+        return static_cast<double>(rect.extent.width) * rect.extent.height;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        ShadowAtlasCreateInfo info;
+        info.size = options.atlas;
+        ShadowAtlas atlas(info);
+
+        // Lights scattered over a 200 x 200 m level, a quarter of them point lights.
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> spread(-100.0f, 100.0f);
+        for (std::uint32_t i = 0; i < options.lights; i++) {
+            ShadowLightDesc desc;
+            desc.type = i % 4 == 3 ? ShadowLightType::Point : ShadowLightType::Spot;
+            desc.position = Vec3(spread(random), 6.0f, spread(random));
+            desc.direction = normalize(Vec3(spread(random) * 0.01f, -1.0f, spread(random) * 0.01f));
+            desc.range = 15.0f;
+            desc.resolution = desc.type == ShadowLightType::Point ? 256 : 512;
+            atlas.setLight(i, desc);
+        }
+        ShadowLightDesc sun;
+        sun.type = ShadowLightType::Directional;
+        sun.direction = normalize(Vec3(0.3f, -1.0f, 0.2f));
+        sun.resolution = 2048;
+        atlas.setLight(options.lights, sun);
+
+        // Casters walk circles around random points on the ground.
+        std::vector<Vec3> centers(options.casters);
+        for (Vec3& center : centers) {
+            center = Vec3(spread(random), 1.0f, spread(random));
+        }
+        auto casterAt = [&](std::uint32_t caster, std::uint32_t frame) {
+            float angle = static_cast<float>(frame) * 0.02f + static_cast<float>(caster);
+            return box(centers[caster] + Vec3(std::cos(angle) * 4.0f, 0.0f, std::sin(angle) * 4.0f), 0.5f);
+        };
+
+        double renderTexels = 0, copyTexels = 0, naiveTexels = 0, buildMs = 0;
+        std::size_t staticPasses = 0, dynamicPasses = 0;
+        for (std::uint32_t frame = 0; frame <= options.frames; frame++) {
+            // Walks forward slowly, looking around.
+            ShadowCamera camera;
+            float t = static_cast<float>(frame) / 60.0f;
+            camera.position = Vec3(-80.0f + t * 1.5f, 1.8f, std::sin(t * 0.3f) * 20.0f);
+            camera.forward = normalize(Vec3(std::cos(t * 0.2f), -0.1f, std::sin(t * 0.2f)));
+            if (frame > 0) {
+                for (std::uint32_t caster = 0; caster < options.casters; caster++) {
+                    atlas.dynamicCasterMoved(casterAt(caster, frame - 1), casterAt(caster, frame));
+                }
+                if (options.staticEvery != 0 && frame % options.staticEvery == 0) {
+                    atlas.staticGeometryChanged(box(Vec3(spread(random), 1.0f, spread(random)), 1.0f));
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<ShadowPass> passes = atlas.build(camera);
+            auto end = std::chrono::steady_clock::now();
+            // The first frame fills the cache; the steady state is what matters.
+            if (frame == 0) {
+                continue;
+            }
+            buildMs += std::chrono::duration<double, std::milli>(end - start).count();
+            for (const ShadowPass& pass : passes) {
+                if (pass.type == ShadowPassType::CopyStatic) {
+                    copyTexels += area(pass.region);
+                } else {
+                    renderTexels += area(pass.region);
+                    (pass.type == ShadowPassType::RenderStatic ? staticPasses : dynamicPasses)++;
+                }
+            }
+            for (const ShadowViewGpu& view : atlas.views()) {
+                double size = view.atlasRect[2] * options.atlas;
+                naiveTexels += size * size;
+            }
+        }
+
+        double frames = options.frames;
+        std::cout << "lights=" << options.lights << " casters=" << options.casters
+                  << " views=" << atlas.views().size()
+                  << " static_passes=" << staticPasses / frames
+                  << " dynamic_passes=" << dynamicPasses / frames
+                  << " render_mtexels=" << renderTexels / frames / 1e6
+                  << " copy_mtexels=" << copyTexels / frames / 1e6
+                  << " naive_mtexels=" << naiveTexels / frames / 1e6
+                  << " saved_pct=" << (naiveTexels > 0 ? 100.0 * (1.0 - renderTexels / naiveTexels) : 0.0)
+                  << " build_ms=" << buildMs / frames << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
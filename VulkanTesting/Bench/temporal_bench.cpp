@@ -0,0 +1,368 @@
+// temporal_bench: image quality and cost of the temporal resolve at native and reduced resolution.
+//
+//   temporal_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--frames N]
+//
+// Renders the analytic test scene of shaders/temporal_scene.comp (a spinning wheel over a panning
+// background, both full of sub-pixel edges) for N frames per mode and compares the last frame with
+// an 8x8 supersampled reference: one sample per pixel without any resolve, TAA at native resolution,
+// and TAA upscaling from 75% and 50% of the output size. PSNR is measured on tonemapped colors.
+// One key=value line per mode so that sweep scripts can grep it.
+
+#include "../Temporal.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+#include "../VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 1920;
+        std::uint32_t height = 1080;
+        std::uint32_t frames = 64;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(2, std::atoi(argv[++i])));
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    // Mirrors the push constants of shaders/temporal_scene.comp.
+    struct ScenePush {
+        std::uint32_t renderExtent[2];
+        std::uint32_t outputExtent[2];
+        float jitter[2];
+        float time;
+        float previousTime;
+        std::uint32_t gridSize;
+    };
+
+    struct Mode {
+        const char* name;
+        double scale;
+        bool temporal;
+    };
+
+    float halfToFloat(std::uint16_t h) {
+        std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+        std::uint32_t exponent = (h >> 10) & 0x1F;
+        std::uint32_t mantissa = h & 0x3FF;
+        float value;
+        if (exponent == 0) {
+            value = std::ldexp(static_cast<float>(mantissa), -24);
+        } else if (exponent == 31) {
+            value = mantissa ? NAN : INFINITY;
+        } else {
+            value = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+        }
+        return sign ? -value : value;
+    }
+
+    // Tonemapped RGB of an RGBA16F readback, so that PSNR weighs errors the way they are seen.
+    std::vector<float> tonemapped(const Buffer& readback, std::size_t pixels) {
+        const std::uint16_t* halves = static_cast<const std::uint16_t*>(readback.mapped);
+        std::vector<float> result(pixels * 3);
+        for (std::size_t i = 0; i < pixels; i++) {
+            for (int c = 0; c < 3; c++) {
+                float v = std::max(0.0f, halfToFloat(halves[i * 4 + c]));
+                result[i * 3 + c] = v / (1.0f + v);
+            }
+        }
+        return result;
+    }
+
+    double psnr(const std::vector<float>& image, const std::vector<float>& reference) {
+        double error = 0;
+        for (std::size_t i = 0; i < image.size(); i++) {
+            double d = image[i] - reference[i];
+            error += d * d;
+        }
+        error /= image.size();
+        return error > 0 ? 10.0 * std::log10(1.0 / error) : 99.0;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "temporal_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+        VkExtent2D outputExtent = {options.width, options.height};
+        std::size_t pixelCount = static_cast<std::size_t>(options.width) * options.height;
+
+        // Render targets at output size; reduced resolutions render into their top left corner,
+        // the way DynamicResolutionScaler uses its render target.
+        Image color = createImage(physicalDevice, device, outputExtent, VK_FORMAT_R16G16B16A16_SFLOAT,
+                                  VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "scene color");
+        Image motion = createImage(physicalDevice, device, outputExtent, VK_FORMAT_R16G16B16A16_SFLOAT,
+                                   VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, "scene motion");
+        Image depth = createImage(physicalDevice, device, outputExtent, VK_FORMAT_R32_SFLOAT,
+                                  VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, "scene depth");
+        Buffer readback = createBuffer(physicalDevice, device, VkDeviceSize(pixelCount) * 8, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "readback");
+        TemporalResolve resolve(physicalDevice, device, options.shaderDir + "/taa_resolve.comp.spv", outputExtent);
+        resolve.setInputs(color.view, motion.view, depth.view);
+
+        VkShaderModule sceneModule = createShaderModule(device, options.shaderDir + "/temporal_scene.comp.spv");
+        VkDescriptorSetLayoutBinding bindings[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        VkDescriptorSetLayout sceneSetLayout;
+        vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &sceneSetLayout);
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ScenePush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &sceneSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VkPipelineLayout sceneLayout;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &sceneLayout);
+        VkPipeline scenePipeline = createComputePipeline(device, sceneModule, sceneLayout);
+        VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VkDescriptorPool descriptorPool;
+        vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &sceneSetLayout;
+        VkDescriptorSet sceneSet;
+        vkd.vkAllocateDescriptorSets(device, &setInfo, &sceneSet);
+        VkDescriptorImageInfo imageInfos[3] = {
+            {VK_NULL_HANDLE, color.view, VK_IMAGE_LAYOUT_GENERAL},
+            {VK_NULL_HANDLE, motion.view, VK_IMAGE_LAYOUT_GENERAL},
+            {VK_NULL_HANDLE, depth.view, VK_IMAGE_LAYOUT_GENERAL},
+        };
+        VkWriteDescriptorSet writes[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = sceneSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo = &imageInfos[i];
+        }
+        vkd.vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+        setObjectName(device, scenePipeline, "temporal test scene");
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (families[family].timestampValidBits == 0) {
+            throw std::runtime_error("temporal_bench needs timestamp queries on the graphics queue.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 3;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+
+        auto begin = [&]() {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        };
+        auto submit = [&]() {
+            vkEndCommandBuffer(commandBuffer);
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit temporal_bench commands!");
+            }
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+        };
+        // Scene pass into the render targets; leaves them ready for sampling by the resolve.
+        auto recordScene = [&](VkExtent2D renderExtent, const float jitter[2], float time, float previousTime, std::uint32_t gridSize) {
+            CommandLabel label(commandBuffer, "temporal test scene");
+            VkImageMemoryBarrier barriers[3] = {};
+            Image* targets[3] = {&color, &motion, &depth};
+            for (int i = 0; i < 3; i++) {
+                barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barriers[i].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+                barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].image = targets[i]->image;
+                barriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            }
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 3, barriers);
+            ScenePush push = {{renderExtent.width, renderExtent.height}, {outputExtent.width, outputExtent.height},
+                              {jitter[0], jitter[1]}, time, previousTime, gridSize};
+            vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scenePipeline);
+            vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sceneLayout, 0, 1, &sceneSet, 0, nullptr);
+            vkd.vkCmdPushConstants(commandBuffer, sceneLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            vkd.vkCmdDispatch(commandBuffer, (renderExtent.width + 7) / 8, (renderExtent.height + 7) / 8, 1);
+            for (VkImageMemoryBarrier& barrier : barriers) {
+                barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 3, barriers);
+        };
+        auto recordReadback = [&](VkImage image, VkImageLayout layout) {
+            VkBufferImageCopy region = {};
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.imageExtent = {outputExtent.width, outputExtent.height, 1};
+            vkCmdCopyImageToBuffer(commandBuffer, image, layout, readback.buffer, 1, &region);
+        };
+        auto frameTime = [](std::uint32_t frame) { return static_cast<float>(frame) / 60.0f; };
+
+        // The reference: the last frame of every mode, supersampled.
+        float noJitter[2] = {0, 0};
+        std::uint32_t lastFrame = options.frames - 1;
+        begin();
+        recordScene(outputExtent, noJitter, frameTime(lastFrame), frameTime(lastFrame), 8);
+        recordReadback(color.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        submit();
+        std::vector<float> reference = tonemapped(readback, pixelCount);
+
+        const Mode modes[] = {
+            {"no_aa", 1.0, false},
+            {"taa", 1.0, true},
+            {"taa", 0.75, true},
+            {"taa", 0.5, true},
+        };
+        for (const Mode& mode : modes) {
+            VkExtent2D renderExtent = {std::max<std::uint32_t>(8, static_cast<std::uint32_t>(options.width * mode.scale) & ~7u),
+                                       std::max<std::uint32_t>(8, static_cast<std::uint32_t>(options.height * mode.scale) & ~7u)};
+            TemporalCamera camera;
+            double sceneMs = 0, resolveMs = 0;
+            std::uint32_t timed = 0;
+            for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+                TemporalView view = camera.advance(Mat4(), Mat4(), renderExtent, outputExtent);
+                const float* jitter = mode.temporal ? view.jitter : noJitter;
+                begin();
+                vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 3);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+                recordScene(renderExtent, jitter, frameTime(frame), frameTime(frame > 0 ? frame - 1 : 0), 1);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+                if (mode.temporal) {
+                    resolve.record(commandBuffer, view, renderExtent);
+                }
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 2);
+                if (frame == lastFrame) {
+                    if (mode.temporal) {
+                        recordReadback(resolve.output().image, VK_IMAGE_LAYOUT_GENERAL);
+                    } else {
+                        recordReadback(color.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                    }
+                }
+                submit();
+                std::uint64_t stamps[3];
+                vkGetQueryPoolResults(device, queryPool, 0, 3, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                // Skip the first frames: pipeline warm-up and clock ramp.
+                if (frame >= 4) {
+                    double period = properties.limits.timestampPeriod * 1e-6;
+                    sceneMs += (stamps[1] - stamps[0]) * period;
+                    resolveMs += (stamps[2] - stamps[1]) * period;
+                    timed++;
+                }
+            }
+            double quality = psnr(tonemapped(readback, pixelCount), reference);
+            timed = std::max<std::uint32_t>(timed, 1);
+            std::cout << "mode=" << mode.name << " scale=" << mode.scale
+                      << " render=" << renderExtent.width << "x" << renderExtent.height
+                      << " output=" << outputExtent.width << "x" << outputExtent.height
+                      << " psnr_db=" << quality
+                      << " scene_ms=" << sceneMs / timed
+                      << " resolve_ms=" << resolveMs / timed
+                      << " total_ms=" << (sceneMs + resolveMs) / timed << std::endl;
+        }
+
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyPipeline(device, scenePipeline, nullptr);
+        vkDestroyPipelineLayout(device, sceneLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, sceneSetLayout, nullptr);
+        vkDestroyShaderModule(device, sceneModule, nullptr);
+        destroyBuffer(device, readback);
+        destroyImage(device, depth);
+        destroyImage(device, motion);
+        destroyImage(device, color);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+// upload_bench: per-frame uploads of dynamic data, written in place in host-visible device-local
+// memory (resizable BAR) against staged through host memory and a GPU copy.
+//
+//   upload_bench [--device SEL] [--frames N] [--sizes-kb A,B,...]
+//
+// For every size and route it runs --frames frames of: write the whole buffer from the CPU, record
+// recordDynamicUpload() between two timestamps, submit and wait. Reports the CPU write time, the
+// GPU upload time and the frame latency from the first write to the fence, best and mean, as one
+// key=value line per size and route. Without the heap only the staged route runs.
+
+#include "../Profiler.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::uint32_t frames = 200;
+        std::vector<std::uint32_t> sizesKb = {16, 256, 4096, 32768};
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--sizes-kb" && hasValue) {
+                options.sizesKb.clear();
+                std::stringstream list(argv[++i]);
+                std::string item;
+                while (std::getline(list, item, ',')) {
+                    options.sizesKb.push_back(static_cast<std::uint32_t>(std::max(1, std::atoi(item.c_str()))));
+                }
+            }
+            else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    struct Timing {
+        double best = 0;
+        double total = 0;
+        std::uint32_t count = 0;
+
+        void add(double us) {
+            best = count++ == 0 ? us : std::min(best, us);
+            total += us;
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "upload_bench";
+        info.device = options.device;
+        info.measureUploads = true; // The path it picks is one of the results.
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        double period = properties.limits.timestampPeriod;
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = context.queueFamilies().graphicsFamily;
+        VkCommandPool commandPool;
+        if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+        VkCommandBufferAllocateInfo commandBufferInfo = {};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        UploadPath chosen = context.uploadPath();
+        std::vector<bool> routes = {false};
+        if (chosen.hostVisibleDeviceLocal) {
+            routes.insert(routes.begin(), true);
+        }
+        for (std::uint32_t sizeKb : options.sizesKb) {
+            VkDeviceSize size = VkDeviceSize(sizeKb) << 10;
+            std::vector<std::uint8_t> data(static_cast<std::size_t>(size));
+            for (std::size_t i = 0; i < data.size(); i++) {
+                data[i] = static_cast<std::uint8_t>(i * 7);
+            }
+            for (bool direct : routes) {
+                UploadPath path = chosen;
+                path.direct = direct;
+                setUploadPath(path);
+                DynamicBuffer buffer = createDynamicBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                           "upload_bench data");
+                Timing write, upload, frame;
+                for (std::uint32_t f = 0; f < options.frames; f++) {
+                    std::uint64_t start = Profiler::now();
+                    std::memcpy(buffer.mapped, data.data(), data.size());
+                    std::uint64_t written = Profiler::now();
+
+                    VkCommandBufferBeginInfo beginInfo = {};
+                    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                    vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                    vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+                    vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+                    recordDynamicUpload(commandBuffer, buffer, size, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+                    vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+                    vkEndCommandBuffer(commandBuffer);
+                    VkSubmitInfo submitInfo = {};
+                    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                    submitInfo.commandBufferCount = 1;
+                    submitInfo.pCommandBuffers = &commandBuffer;
+                    vkd.vkQueueSubmit(queue, 1, &submitInfo, fence);
+                    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                    std::uint64_t done = Profiler::now();
+                    vkResetFences(device, 1, &fence);
+
+                    std::uint64_t stamps[2];
+                    vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                    write.add((written - start) * 1e-3);
+                    upload.add(stamps[1] > stamps[0] ? (stamps[1] - stamps[0]) * period * 1e-3 : 0);
+                    frame.add((done - start) * 1e-3);
+                }
+                destroyDynamicBuffer(device, buffer);
+
+                std::cout << "size_kb=" << sizeKb
+                          << " route=" << (direct ? "direct" : "staged")
+                          << " chosen=" << (direct == chosen.direct ? "yes" : "no")
+                          << " write_us_best=" << write.best
+                          << " write_us_mean=" << write.total / options.frames
+                          << " upload_us_best=" << upload.best
+                          << " upload_us_mean=" << upload.total / options.frames
+                          << " frame_us_best=" << frame.best
+                          << " frame_us_mean=" << frame.total / options.frames
+                          << " write_gbps=" << (write.best > 0 ? size / (write.best * 1e3) : 0) << std::endl;
+            }
+        }
+        setUploadPath(chosen);
+
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,377 @@
+// vrs_bench: how much fragment work the shading rate map saves, and what it costs in quality.
+//
+//   vrs_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--frames N]
+//
+// Renders one frame of the analytic test scene of shaders/temporal_scene.comp, builds the shading
+// rate map from it with content adaptation, fixed foveation at the screen center, and both, and reads
+// the map back. shaded_fraction is fragment shader invocations relative to full rate. psnr_db compares
+// the frame with a CPU simulation of coarse shading (every fragment takes the color at its center)
+// against the full-rate frame, on tonemapped colors. map_ms is the GPU time of building the map.
+//
+// The simulation does not need the device to support variable rate shading; vrs_supported says
+// whether it would actually apply the map.
+
+#include "../ShadingRate.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+#include "../VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 1920;
+        std::uint32_t height = 1080;
+        std::uint32_t frames = 32;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    // Mirrors the push constants of shaders/temporal_scene.comp.
+    struct ScenePush {
+        std::uint32_t renderExtent[2];
+        std::uint32_t outputExtent[2];
+        float jitter[2];
+        float time;
+        float previousTime;
+        std::uint32_t gridSize;
+    };
+
+    struct Mode {
+        const char* name;
+        bool content;
+        bool foveated;
+    };
+
+    float halfToFloat(std::uint16_t h) {
+        std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+        std::uint32_t exponent = (h >> 10) & 0x1F;
+        std::uint32_t mantissa = h & 0x3FF;
+        float value;
+        if (exponent == 0) {
+            value = std::ldexp(static_cast<float>(mantissa), -24);
+        } else if (exponent == 31) {
+            value = mantissa ? NAN : INFINITY;
+        } else {
+            value = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+        }
+        return sign ? -value : value;
+    }
+
+    double psnr(const std::vector<float>& image, const std::vector<float>& reference) {
+        double error = 0;
+        for (std::size_t i = 0; i < image.size(); i++) {
+            double d = image[i] - reference[i];
+            error += d * d;
+        }
+        error /= image.size();
+        return error > 0 ? 10.0 * std::log10(1.0 / error) : 99.0;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "vrs_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+        VkExtent2D extent = {options.width, options.height};
+        std::size_t pixelCount = static_cast<std::size_t>(options.width) * options.height;
+
+        Image color = createImage(physicalDevice, device, extent, VK_FORMAT_R16G16B16A16_SFLOAT,
+                                  VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "scene color");
+        Image motion = createImage(physicalDevice, device, extent, VK_FORMAT_R16G16B16A16_SFLOAT,
+                                   VK_IMAGE_USAGE_STORAGE_BIT, "scene motion");
+        Image depth = createImage(physicalDevice, device, extent, VK_FORMAT_R32_SFLOAT,
+                                  VK_IMAGE_USAGE_STORAGE_BIT, "scene depth");
+        Buffer colorReadback = createBuffer(physicalDevice, device, VkDeviceSize(pixelCount) * 8, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "color readback");
+        ShadingRateMap rateMap(physicalDevice, device, options.shaderDir + "/shading_rate.comp.spv", extent,
+                               context.fragmentShadingRate());
+        rateMap.setInput(color.view);
+        const Image& rates = rateMap.image();
+        VkExtent2D tile = rateMap.texelSize();
+        Buffer rateReadback = createBuffer(physicalDevice, device, VkDeviceSize(rates.extent.width) * rates.extent.height,
+                                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "rate readback");
+
+        VkShaderModule sceneModule = createShaderModule(device, options.shaderDir + "/temporal_scene.comp.spv");
+        VkDescriptorSetLayoutBinding bindings[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        VkDescriptorSetLayout sceneSetLayout;
+        vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &sceneSetLayout);
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ScenePush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &sceneSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VkPipelineLayout sceneLayout;
+        vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &sceneLayout);
+        VkPipeline scenePipeline = createComputePipeline(device, sceneModule, sceneLayout);
+        VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VkDescriptorPool descriptorPool;
+        vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &sceneSetLayout;
+        VkDescriptorSet sceneSet;
+        vkd.vkAllocateDescriptorSets(device, &setInfo, &sceneSet);
+        VkDescriptorImageInfo imageInfos[3] = {
+            {VK_NULL_HANDLE, color.view, VK_IMAGE_LAYOUT_GENERAL},
+            {VK_NULL_HANDLE, motion.view, VK_IMAGE_LAYOUT_GENERAL},
+            {VK_NULL_HANDLE, depth.view, VK_IMAGE_LAYOUT_GENERAL},
+        };
+        VkWriteDescriptorSet writes[3] = {};
+        for (std::uint32_t i = 0; i < 3; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = sceneSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo = &imageInfos[i];
+        }
+        vkd.vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+        setObjectName(device, scenePipeline, "vrs test scene");
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        if (families[family].timestampValidBits == 0) {
+            throw std::runtime_error("vrs_bench needs timestamp queries on the graphics queue.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        VkQueryPool queryPool;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+
+        auto begin = [&]() {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        };
+        auto submit = [&]() {
+            vkEndCommandBuffer(commandBuffer);
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit vrs_bench commands!");
+            }
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+        };
+
+        // The scene at full rate, left readable by the map and read back as the reference.
+        begin();
+        {
+            CommandLabel label(commandBuffer, "vrs test scene");
+            VkImageMemoryBarrier barriers[3] = {};
+            Image* targets[3] = {&color, &motion, &depth};
+            for (int i = 0; i < 3; i++) {
+                barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barriers[i].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+                barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].image = targets[i]->image;
+                barriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            }
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 3, barriers);
+            ScenePush push = {{extent.width, extent.height}, {extent.width, extent.height}, {0, 0}, 1.0f, 1.0f, 1};
+            vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scenePipeline);
+            vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sceneLayout, 0, 1, &sceneSet, 0, nullptr);
+            vkd.vkCmdPushConstants(commandBuffer, sceneLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            vkd.vkCmdDispatch(commandBuffer, (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+            barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 1, barriers);
+            VkBufferImageCopy region = {};
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.imageExtent = {extent.width, extent.height, 1};
+            vkCmdCopyImageToBuffer(commandBuffer, color.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, colorReadback.buffer, 1, &region);
+        }
+        submit();
+        std::vector<float> reference(pixelCount * 3);
+        const std::uint16_t* halves = static_cast<const std::uint16_t*>(colorReadback.mapped);
+        for (std::size_t i = 0; i < pixelCount; i++) {
+            for (int c = 0; c < 3; c++) {
+                float v = std::max(0.0f, halfToFloat(halves[i * 4 + c]));
+                reference[i * 3 + c] = v / (1.0f + v);
+            }
+        }
+
+        const Mode modes[] = {
+            {"content", true, false},
+            {"foveated", false, true},
+            {"content+foveated", true, true},
+        };
+        for (const Mode& mode : modes) {
+            ShadingRateSettings settings;
+            settings.contentAdaptive = mode.content;
+            if (mode.foveated) {
+                settings.gaze[0] = 0.5f;
+                settings.gaze[1] = 0.5f;
+            }
+            double mapMs = 0;
+            for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+                begin();
+                vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+                rateMap.record(commandBuffer, settings);
+                vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+                if (frame + 1 == options.frames) {
+                    // Back to a layout transfers can read from, whatever record() left it in.
+                    VkImageLayout layout = rateMap.active() ? VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR : VK_IMAGE_LAYOUT_GENERAL;
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                    barrier.oldLayout = layout;
+                    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.image = rates.image;
+                    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+                    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+                    VkBufferImageCopy region = {};
+                    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+                    region.imageExtent = {rates.extent.width, rates.extent.height, 1};
+                    vkCmdCopyImageToBuffer(commandBuffer, rates.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, rateReadback.buffer, 1, &region);
+                }
+                submit();
+                std::uint64_t stamps[2];
+                vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                mapMs += (stamps[1] - stamps[0]) * properties.limits.timestampPeriod * 1e-6;
+            }
+
+            // Coarse shading on the CPU: each fragment of each tile shades once, at its center pixel.
+            const std::uint8_t* rateTexels = static_cast<const std::uint8_t*>(rateReadback.mapped);
+            std::vector<float> coarse(pixelCount * 3);
+            double fragments = 0;
+            for (std::uint32_t y = 0; y < extent.height; y++) {
+                for (std::uint32_t x = 0; x < extent.width; x++) {
+                    std::uint8_t rate = rateTexels[(y / tile.height) * rates.extent.width + x / tile.width];
+                    std::uint32_t fragmentWidth = 1u << (rate >> 2);
+                    std::uint32_t fragmentHeight = 1u << (rate & 3);
+                    fragments += 1.0 / (fragmentWidth * fragmentHeight);
+                    std::uint32_t sx = std::min(extent.width - 1, x / fragmentWidth * fragmentWidth + fragmentWidth / 2);
+                    std::uint32_t sy = std::min(extent.height - 1, y / fragmentHeight * fragmentHeight + fragmentHeight / 2);
+                    for (int c = 0; c < 3; c++) {
+                        coarse[(static_cast<std::size_t>(y) * extent.width + x) * 3 + c] =
+                            reference[(static_cast<std::size_t>(sy) * extent.width + sx) * 3 + c];
+                    }
+                }
+            }
+            std::cout << "mode=" << mode.name
+                      << " resolution=" << extent.width << "x" << extent.height
+                      << " tile=" << tile.width << "x" << tile.height
+                      << " vrs_supported=" << (rateMap.active() ? 1 : 0)
+                      << " shaded_fraction=" << fragments / pixelCount
+                      << " psnr_db=" << psnr(coarse, reference)
+                      << " map_ms=" << mapMs / options.frames << std::endl;
+        }
+
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyPipeline(device, scenePipeline, nullptr);
+        vkDestroyPipelineLayout(device, sceneLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, sceneSetLayout, nullptr);
+        vkDestroyShaderModule(device, sceneModule, nullptr);
+        destroyBuffer(device, rateReadback);
+        destroyBuffer(device, colorReadback);
+        destroyImage(device, depth);
+        destroyImage(device, motion);
+        destroyImage(device, color);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,290 @@
+// vt_bench: a virtual texture far larger than its page budget, streamed by what a moving view samples.
+//
+//   vt_bench [--device SEL] [--shaders DIR] [--resolution WxH] [--frames N] [--size N] [--budget TILES]
+//            [--uploads N]
+//
+// A --size square RGBA8 texture (16384 by default, capped at the device's largest 2D image) lives in
+// a sparse image with memory behind at most --budget tiles. Every frame a compute pass renders the
+// view into a buffer, panning across the texture while zooming between the whole texture and one
+// texel per pixel, then VirtualTexture::update() streams in what the frame asked for, at most
+// --uploads tiles. Tiles come from a procedural loader, so the numbers are binding and upload cost,
+// not disk. Reports committed against virtual memory, tile traffic, the share of samples that had
+// to fall back to a coarser level, and the time per frame and per update.
+
+#include "../VirtualTexture.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDebug.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+#include "../VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::uint32_t width = 1280;
+        std::uint32_t height = 720;
+        std::uint32_t frames = 600;
+        std::uint32_t size = 16384;
+        std::uint32_t budget = 2048;
+        std::uint32_t uploads = 64;
+    };
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) options.device = argv[++i];
+            else if (arg == "--shaders" && hasValue) options.shaderDir = argv[++i];
+            else if (arg == "--frames" && hasValue) options.frames = static_cast<std::uint32_t>(std::max(16, std::atoi(argv[++i])));
+            else if (arg == "--size" && hasValue) options.size = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--budget" && hasValue) options.budget = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--uploads" && hasValue) options.uploads = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--resolution" && hasValue) {
+                std::string value = argv[++i];
+                auto x = value.find('x');
+                if (x == std::string::npos) throw std::runtime_error("Expected WxH for --resolution, got '" + value + "'");
+                options.width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+                options.height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+            } else throw std::runtime_error("Unknown argument '" + arg + "'");
+        }
+        return options;
+    }
+
+    // Mirrors the push constants of shaders/vt_view.comp.
+    struct ViewPush {
+        float origin[2];
+        float step[2];
+        std::uint32_t extent[2];
+        float lod;
+    };
+
+    // A checkerboard of 256 texel squares with a grid every 1024, tinted by level so that coarse
+    // fallbacks show. Coordinates are in mip 0 texels, so every level shows the same picture.
+    void loadTile(std::uint32_t level, std::uint32_t x, std::uint32_t y, std::uint32_t width, std::uint32_t height,
+                  std::uint8_t* rgba) {
+        static const std::uint8_t tints[4][3] = {{255, 255, 255}, {255, 200, 160}, {160, 255, 200}, {180, 200, 255}};
+        const std::uint8_t* tint = tints[level % 4];
+        for (std::uint32_t row = 0; row < height; row++) {
+            for (std::uint32_t column = 0; column < width; column++) {
+                std::uint32_t u = (x + column) << level;
+                std::uint32_t v = (y + row) << level;
+                bool checker = ((u >> 8) ^ (v >> 8)) & 1;
+                bool line = (u & 1023) < (4u << level) || (v & 1023) < (4u << level);
+                std::uint8_t shade = line ? 20 : (checker ? 200 : 120);
+                std::uint8_t* texel = rgba + (static_cast<std::size_t>(row) * width + column) * 4;
+                for (int c = 0; c < 3; c++) {
+                    texel[c] = static_cast<std::uint8_t>(shade * tint[c] / 255);
+                }
+                texel[3] = 255;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parse(argc, argv);
+        VulkanContextCreateInfo info;
+        info.applicationName = "vt_bench";
+        info.device = options.device;
+        VulkanContext context(info);
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.computeQueue();
+        std::uint32_t family = context.queueFamilies().computeFamily;
+        if (!context.sparseResidency().residencyImage2D) {
+            throw std::runtime_error("vt_bench needs sparse residency for 2D images.");
+        }
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        std::uint32_t size = 1;
+        while (size * 2 <= std::min(options.size, properties.limits.maxImageDimension2D)) {
+            size *= 2;
+        }
+
+        VirtualTexture texture(physicalDevice, device, context.sparseResidency(), context.sparseQueue(), family, queue,
+                               {size, size}, options.budget, loadTile, options.uploads);
+
+        Buffer pixels = createBuffer(physicalDevice, device, VkDeviceSize(options.width) * options.height * 4,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "vt_bench pixels");
+        Buffer coarse = createBuffer(physicalDevice, device, sizeof(std::uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     "vt_bench coarse samples");
+        std::memset(coarse.mapped, 0, sizeof(std::uint32_t));
+
+        VkShaderModule module = createShaderModule(device, options.shaderDir + "/vt_view.comp.spv");
+        // The virtual texture at 0 to 2, then pixels and the coarse sample count.
+        VkDescriptorSetLayoutBinding bindings[5] = {};
+        for (std::uint32_t i = 0; i < 5; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 5;
+        layoutInfo.pBindings = bindings;
+        VkDescriptorSetLayout setLayout;
+        if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create vt_bench descriptor set layout!");
+        }
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ViewPush)};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VkPipelineLayout pipelineLayout;
+        if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create vt_bench pipeline layout!");
+        }
+        VkPipeline pipeline = createComputePipeline(device, module, pipelineLayout);
+
+        VkDescriptorPoolSize poolSizes[2] = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+                                             {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4}};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        VkDescriptorPool descriptorPool;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create vt_bench descriptor pool!");
+        }
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &setLayout;
+        VkDescriptorSet set;
+        vkd.vkAllocateDescriptorSets(device, &setInfo, &set);
+        texture.writeDescriptors(set, 0);
+        VkDescriptorBufferInfo bufferInfos[2] = {{pixels.buffer, 0, VK_WHOLE_SIZE}, {coarse.buffer, 0, VK_WHOLE_SIZE}};
+        VkWriteDescriptorSet writes[2] = {};
+        for (std::uint32_t i = 0; i < 2; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = set;
+            writes[i].dstBinding = 3 + i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkd.vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create vt_bench command pool!");
+        }
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+        setObjectName(device, pipeline, "vt_bench view");
+
+        // The view spans from the whole texture (a scale of 1) down to one texel per pixel, over and
+        // over, while its centre drifts along a Lissajous curve.
+        float closest = static_cast<float>(options.width) / size;
+        double frameMs = 0, updateMs = 0;
+        std::uint64_t sampled = 0, coarseSamples = 0;
+        for (std::uint32_t frame = 0; frame < options.frames; frame++) {
+            float t = static_cast<float>(frame) / options.frames;
+            float zoom = 0.5f - 0.5f * std::cos(t * 6.2831853f * 3.0f);
+            float span = std::pow(closest, zoom);
+            float aspect = static_cast<float>(options.height) / options.width;
+            float centerX = 0.5f + (0.5f - 0.5f * span) * std::sin(t * 6.2831853f * 2.0f);
+            float centerY = 0.5f + (0.5f - 0.5f * span * aspect) * std::sin(t * 6.2831853f * 3.0f + 1.0f);
+            ViewPush push = {};
+            push.step[0] = span / options.width;
+            push.step[1] = span / options.width;
+            push.origin[0] = centerX - 0.5f * span;
+            push.origin[1] = centerY - 0.5f * span * aspect;
+            push.extent[0] = options.width;
+            push.extent[1] = options.height;
+            push.lod = std::max(0.0f, std::log2(push.step[0] * size));
+
+            auto start = std::chrono::steady_clock::now();
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+            vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            vkd.vkCmdDispatch(commandBuffer, (options.width + 15) / 16, (options.height + 15) / 16, 1);
+            // Also makes the coarse count visible to the host.
+            texture.recordFeedbackBarrier(commandBuffer);
+            vkEndCommandBuffer(commandBuffer);
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit vt_bench frame!");
+            }
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+            texture.update();
+            frameMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            updateMs += texture.stats().updateMs;
+
+            auto* count = static_cast<std::uint32_t*>(coarse.mapped);
+            coarseSamples += *count;
+            *count = 0;
+            sampled += static_cast<std::uint64_t>(options.width) * options.height;
+        }
+
+        const VirtualTextureStats& stats = texture.stats();
+        std::cout << "virtual=" << size << "x" << size
+                  << " tile=" << stats.tileSize.width << "x" << stats.tileSize.height
+                  << " virtual_mb=" << stats.virtualBytes / (1024.0 * 1024.0)
+                  << " committed_mb=" << stats.committedBytes / (1024.0 * 1024.0)
+                  << " budget_tiles=" << stats.budgetTiles
+                  << " resident=" << stats.residentTiles
+                  << " loaded=" << stats.loadedTiles
+                  << " evicted=" << stats.evictedTiles
+                  << " coarse_pct=" << 100.0 * coarseSamples / sampled
+                  << " update_ms=" << updateMs / options.frames
+                  << " frame_ms=" << frameMs / options.frames << std::endl;
+
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        vkDestroyShaderModule(device, module, nullptr);
+        destroyBuffer(device, coarse);
+        destroyBuffer(device, pixels);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,450 @@
+#include "BufferPool.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanMemory.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+BufferPool::BufferPool(VkPhysicalDevice physicalDevice, VkDevice device, const BufferPoolCreateInfo& info)
+    : physicalDevice(physicalDevice), device(device), info(info) {
+    if (info.transferQueue == VK_NULL_HANDLE) {
+        throw std::runtime_error("buffer pool needs a transfer queue!");
+    }
+    families = info.queueFamilies;
+    families.push_back(info.transferFamily);
+    std::sort(families.begin(), families.end());
+    families.erase(std::unique(families.begin(), families.end()), families.end());
+
+    // Any range may be bound as any kind of buffer, and host-visible ranges flushed on their own.
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    const VkPhysicalDeviceLimits& limits = properties.limits;
+    alignment = std::max<VkDeviceSize>({alignment, limits.minStorageBufferOffsetAlignment, limits.minUniformBufferOffsetAlignment,
+                                        limits.minTexelBufferOffsetAlignment, limits.nonCoherentAtomSize,
+                                        limits.optimalBufferCopyOffsetAlignment});
+    timestampPeriod = limits.timestampPeriod * 1e-6;
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = info.transferFamily;
+    if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer pool command pool!");
+    }
+    VkCommandBufferAllocateInfo commandBufferInfo = {};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    vkd.vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+    std::uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> familyProperties(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, familyProperties.data());
+    std::uint32_t validBits = familyProperties[info.transferFamily].timestampValidBits;
+    if (validBits != 0) {
+        timestampMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+    }
+    std::string name = info.name;
+    setObjectName(device, commandPool, name + " command pool");
+    setObjectName(device, commandBuffer, name + " moves");
+    setObjectName(device, fence, name + " moves fence");
+
+}
+
+BufferPool::~BufferPool() {
+    if (!moves.empty()) {
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+    for (std::uint32_t i = 0; i < blocks.size(); i++) {
+        if (blocks[i].memory != VK_NULL_HANDLE) {
+            releaseBlock(i);
+        }
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+    }
+    vkDestroyFence(device, fence, nullptr);
+    vkd.vkDestroyCommandPool(device, commandPool, nullptr);
+}
+
+BufferHandle BufferPool::allocate(VkDeviceSize size, bool movable) {
+    if (size == 0) {
+        throw std::runtime_error("empty buffer pool allocation!");
+    }
+    size = alignUp(size, alignment);
+    std::uint32_t block;
+    VkDeviceSize offset;
+    allocateRange(size, ~0u, true, block, offset);
+    std::uint32_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(slots.size());
+        slots.push_back(Slot());
+    }
+    Slot& slot = slots[index];
+    slot.block = block;
+    slot.offset = offset;
+    slot.size = size;
+    slot.live = true;
+    slot.movable = movable;
+    slot.moving = false;
+    blocks[block].pinned += movable ? 0 : 1;
+    liveBytes += size;
+    liveCount++;
+    changes++;
+    BufferHandle handle;
+    handle.index = index;
+    handle.generation = slot.generation;
+    return handle;
+}
+
+void BufferPool::free(BufferHandle handle) {
+    Slot& slot = slots[slotIndex(handle)];
+    blocks[slot.block].pinned -= slot.movable ? 0 : 1;
+    // A moving allocation is still being read by the copy; finishMoves() releases both of its ranges.
+    if (!slot.moving) {
+        releaseRange(slot.block, slot.offset, slot.size);
+    }
+    liveBytes -= slot.size;
+    liveCount--;
+    changes++;
+    slot.live = false;
+    slot.moving = false;
+    slot.generation = slot.generation == ~0u ? 1 : slot.generation + 1;
+    freeSlots.push_back(handle.index);
+}
+
+BufferRange BufferPool::resolve(BufferHandle handle) const {
+    const Slot& slot = slots[slotIndex(handle)];
+    const Block& block = blocks[slot.block];
+    BufferRange range;
+    range.buffer = block.buffer;
+    range.offset = slot.offset;
+    range.size = slot.size;
+    range.mapped = block.mapped != nullptr ? block.mapped + slot.offset : nullptr;
+    return range;
+}
+
+void BufferPool::defragment(double budgetMs) {
+    VT_FUNCTION_ZONE();
+    frame++;
+    bool idle = moves.empty() || finishMoves();
+
+    while (!retired.empty() && retired.front().releaseAt <= frame) {
+        releaseRange(retired.front().block, retired.front().offset, retired.front().size);
+        retired.pop_front();
+    }
+    // Empty blocks go back to the driver, except one to absorb allocation churn.
+    bool spare = false;
+    for (std::uint32_t i = 0; i < blocks.size(); i++) {
+        Block& block = blocks[i];
+        if (block.memory == VK_NULL_HANDLE || block.used != 0) {
+            continue;
+        }
+        if (!spare && !block.evacuating) {
+            spare = true;
+            continue;
+        }
+        releaseBlock(i);
+        releasedBlocks++;
+    }
+
+    if (idle) {
+        startMoves(budgetMs);
+    }
+}
+
+BufferPoolStats BufferPool::stats() const {
+    BufferPoolStats result;
+    for (const Block& block : blocks) {
+        if (block.memory != VK_NULL_HANDLE) {
+            result.blocks++;
+            result.blockBytes += block.size;
+        }
+    }
+    result.allocations = liveCount;
+    result.usedBytes = liveBytes;
+    result.moving = static_cast<std::uint32_t>(moves.size());
+    result.moves = totalMoves;
+    result.movedBytes = totalMovedBytes;
+    result.releasedBlocks = releasedBlocks;
+    result.copyGBps = bytesPerMs * 1e-6;
+    return result;
+}
+
+std::uint32_t BufferPool::createBlock(VkDeviceSize size) {
+    Block block;
+    block.size = size;
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = info.usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = families.size() > 1 ? static_cast<std::uint32_t>(families.size()) : 0;
+    bufferInfo.pQueueFamilyIndices = families.data();
+    if (vkd.vkCreateBuffer(device, &bufferInfo, nullptr, &block.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer pool block!");
+    }
+    try {
+        block.memory = allocateBufferMemory(physicalDevice, device, block.buffer, info.properties);
+    } catch (...) {
+        vkd.vkDestroyBuffer(device, block.buffer, nullptr);
+        throw;
+    }
+    if (info.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* mapped;
+        vkd.vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        block.mapped = static_cast<std::uint8_t*>(mapped);
+    }
+    block.freeRanges[0] = size;
+
+    std::uint32_t index = 0;
+    while (index < blocks.size() && blocks[index].memory != VK_NULL_HANDLE) {
+        index++;
+    }
+    std::string name = std::string(info.name) + " block " + std::to_string(index);
+    setObjectName(device, block.buffer, name);
+    setObjectName(device, block.memory, name);
+    if (index == blocks.size()) {
+        blocks.push_back(block);
+    } else {
+        blocks[index] = block;
+    }
+    return index;
+}
+
+void BufferPool::releaseBlock(std::uint32_t index) {
+    Block& block = blocks[index];
+    if (block.mapped != nullptr) {
+        vkd.vkUnmapMemory(device, block.memory);
+    }
+    vkd.vkDestroyBuffer(device, block.buffer, nullptr);
+    vkd.vkFreeMemory(device, block.memory, nullptr);
+    block = Block();
+}
+
+bool BufferPool::allocateRange(VkDeviceSize size, std::uint32_t exclude, bool grow, std::uint32_t& block,
+                               VkDeviceSize& offset) {
+    // Filling the fullest blocks first leaves the emptiest ones to drain on their own.
+    std::vector<std::uint32_t> order;
+    for (std::uint32_t i = 0; i < blocks.size(); i++) {
+        if (blocks[i].memory != VK_NULL_HANDLE && !blocks[i].evacuating && i != exclude &&
+            blocks[i].size - blocks[i].used >= size) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b) { return blocks[a].used > blocks[b].used; });
+    for (std::uint32_t i : order) {
+        auto& ranges = blocks[i].freeRanges;
+        auto best = ranges.end();
+        for (auto range = ranges.begin(); range != ranges.end(); ++range) {
+            if (range->second >= size && (best == ranges.end() || range->second < best->second)) {
+                best = range;
+            }
+        }
+        if (best == ranges.end()) {
+            continue;
+        }
+        block = i;
+        offset = best->first;
+        if (best->second > size) {
+            ranges[offset + size] = best->second - size;
+        }
+        ranges.erase(best);
+        blocks[i].used += size;
+        return true;
+    }
+    if (!grow) {
+        return false;
+    }
+    // Whole 2 MiB pages, so drivers can back blocks with large pages.
+    const VkDeviceSize page = 2ull << 20;
+    block = createBlock((std::max(info.blockSize, size) + page - 1) / page * page);
+    offset = 0;
+    auto& ranges = blocks[block].freeRanges;
+    ranges.clear();
+    if (blocks[block].size > size) {
+        ranges[size] = blocks[block].size - size;
+    }
+    blocks[block].used = size;
+    return true;
+}
+
+void BufferPool::releaseRange(std::uint32_t index, VkDeviceSize offset, VkDeviceSize size) {
+    Block& block = blocks[index];
+    block.used -= size;
+    auto& ranges = block.freeRanges;
+    auto next = ranges.lower_bound(offset);
+    if (next != ranges.end() && offset + size == next->first) {
+        size += next->second;
+        next = ranges.erase(next);
+    }
+    if (next != ranges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    ranges[offset] = size;
+}
+
+bool BufferPool::finishMoves() {
+    if (vkGetFenceStatus(device, fence) != VK_SUCCESS) {
+        return false;
+    }
+    vkResetFences(device, 1, &fence);
+    VkDeviceSize bytes = 0;
+    for (const Move& move : moves) {
+        bytes += move.size;
+        Slot& slot = slots[move.slot];
+        std::uint64_t releaseAt = frame + info.framesInFlight;
+        if (slot.live && slot.generation == move.generation) {
+            // Frames submitted until now may still read the old location.
+            retired.push_back({move.srcBlock, move.srcOffset, move.size, releaseAt});
+            slot.block = move.dstBlock;
+            slot.offset = move.dstOffset;
+            slot.moving = false;
+            totalMoves++;
+            totalMovedBytes += move.size;
+        } else {
+            // Freed while moving: neither copy is referenced.
+            retired.push_back({move.srcBlock, move.srcOffset, move.size, releaseAt});
+            releaseRange(move.dstBlock, move.dstOffset, move.size);
+        }
+    }
+    if (queryPool != VK_NULL_HANDLE && bytes > 0) {
+        std::uint64_t stamps[2];
+        if (vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS && ((stamps[1] - stamps[0]) & timestampMask) != 0) {
+            // Smoothed, so one small copy dominated by fixed costs doesn't skew the budget.
+            double measured = bytes / (((stamps[1] - stamps[0]) & timestampMask) * timestampPeriod);
+            bytesPerMs = 0.75 * bytesPerMs + 0.25 * measured;
+        }
+    }
+    moves.clear();
+    epoch++;
+    return true;
+}
+
+void BufferPool::startMoves(double budgetMs) {
+    // Keep emptying the block already started on, or pick the one with the least left to move.
+    std::uint32_t source = ~0u;
+    VkDeviceSize freeBytes = 0;
+    for (const Block& block : blocks) {
+        if (block.memory != VK_NULL_HANDLE && !block.evacuating) {
+            freeBytes += block.size - block.used;
+        }
+    }
+    for (std::uint32_t i = 0; i < blocks.size(); i++) {
+        const Block& block = blocks[i];
+        if (block.memory == VK_NULL_HANDLE || block.pinned > 0 || block.stuckAt == changes || block.used == 0) {
+            continue;
+        }
+        if (block.evacuating) {
+            source = i;
+            break;
+        }
+        bool sparse = block.used < info.maxDefragOccupancy * block.size;
+        bool fits = freeBytes - (block.size - block.used) >= block.used;
+        if (sparse && fits && (source == ~0u || block.used < blocks[source].used)) {
+            source = i;
+        }
+    }
+    if (source == ~0u) {
+        return;
+    }
+
+    std::vector<std::uint32_t> candidates;
+    for (std::uint32_t i = 0; i < slots.size(); i++) {
+        if (slots[i].live && !slots[i].moving && slots[i].block == source) {
+            candidates.push_back(i);
+        }
+    }
+    if (candidates.empty()) {
+        return; // Only old locations left; they go within framesInFlight frames.
+    }
+    blocks[source].evacuating = true;
+    // Large allocations first, while the gaps elsewhere are still there.
+    std::sort(candidates.begin(), candidates.end(), [this](std::uint32_t a, std::uint32_t b) { return slots[a].size > slots[b].size; });
+    double budgetBytes = budgetMs * bytesPerMs;
+    VkDeviceSize bytes = 0;
+    for (std::uint32_t index : candidates) {
+        Slot& slot = slots[index];
+        if (!moves.empty() && bytes + slot.size > budgetBytes) {
+            break;
+        }
+        Move move;
+        if (!allocateRange(slot.size, source, false, move.dstBlock, move.dstOffset)) {
+            continue;
+        }
+        move.slot = index;
+        move.generation = slot.generation;
+        move.srcBlock = source;
+        move.srcOffset = slot.offset;
+        move.size = slot.size;
+        moves.push_back(move);
+        slot.moving = true;
+        bytes += slot.size;
+    }
+    if (moves.empty()) {
+        // Nothing left fits elsewhere. Try again once allocations change.
+        blocks[source].evacuating = false;
+        blocks[source].stuckAt = changes;
+        return;
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+        vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+    for (const Move& move : moves) {
+        VkBufferCopy region = {move.srcOffset, move.dstOffset, move.size};
+        vkd.vkCmdCopyBuffer(commandBuffer, blocks[move.srcBlock].buffer, blocks[move.dstBlock].buffer, 1, &region);
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, queryPool, 1);
+    }
+    vkEndCommandBuffer(commandBuffer);
+    // The fence makes the copies available; frames submitted after finishMoves() saw it see them.
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkd.vkQueueSubmit(info.transferQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit buffer pool moves!");
+    }
+}
+
+std::uint32_t BufferPool::slotIndex(BufferHandle handle) const {
+    if (handle.index >= slots.size() || !slots[handle.index].live || slots[handle.index].generation != handle.generation) {
+        throw std::runtime_error("invalid buffer pool handle!");
+    }
+    return handle.index;
+}
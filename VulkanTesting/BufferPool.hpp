@@ -0,0 +1,167 @@
+#ifndef BufferPool_hpp
+#define BufferPool_hpp
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+// An allocation in a BufferPool. Stays valid while the pool moves the allocation around; resolve()
+// gives where it is now. A default-constructed handle is null.
+struct BufferHandle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0; // 0 = null; bumped when the slot is freed, so stale handles fail.
+    bool valid() const { return generation != 0; }
+};
+
+// Where an allocation lives right now: a range of one of the pool's block buffers.
+struct BufferRange {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr; // Host-visible pools only.
+};
+
+struct BufferPoolCreateInfo {
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    VkDeviceSize blockSize = 64ull << 20; // Larger allocations get a block of their own. Rounded up to 2 MiB.
+    // Every queue family that uses the allocations, besides transferFamily. Blocks are shared
+    // concurrently between them, so moves need no ownership transfers.
+    std::vector<std::uint32_t> queueFamilies;
+    // Where defragment() copies; VulkanContext::transferQueue() and its family.
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    std::uint32_t transferFamily = 0;
+    // Blocks fuller than this are left alone by defragment(): moving them frees too little.
+    float maxDefragOccupancy = 0.7f;
+    // Frames the GPU may still be reading an old location after a move; the frames in flight.
+    std::uint32_t framesInFlight = 2;
+    const char* name = "buffer pool";
+};
+
+struct BufferPoolStats {
+    std::uint32_t blocks = 0;
+    std::uint32_t allocations = 0;
+    VkDeviceSize blockBytes = 0;     // VkDeviceMemory held.
+    VkDeviceSize usedBytes = 0;      // Live allocations, alignment included.
+    std::uint32_t moving = 0;        // Allocations with a copy in flight.
+    std::uint64_t moves = 0;         // In total, and so on below.
+    VkDeviceSize movedBytes = 0;
+    std::uint64_t releasedBlocks = 0;
+    double copyGBps = 0;             // Measured on the transfer queue, or the initial estimate.
+};
+
+// A sub-allocator for buffers: each block is one VkDeviceMemory with one VkBuffer over all of it, and
+// allocations are aligned ranges of those buffers, handed out as BufferHandles.
+//
+// Long sessions with lots of allocation churn leave blocks mostly empty but impossible to release.
+// defragment(), called once per frame, evacuates such blocks a little at a time: it copies live
+// movable allocations into the gaps of fuller blocks on the transfer queue, as many bytes as fit in
+// its time budget, and switches their handles over once the copy has finished. Old locations stay
+// allocated for framesInFlight more frames, since frames already submitted may still read them, and
+// a block is released as soon as nothing is left in it.
+//
+// A copy in flight would lose writes, so movable allocations are written when created and only read
+// after that. Anything the CPU or GPU keeps writing should be allocated with movable = false. Whatever caches a resolved range
+// (descriptor sets, vertex buffer bindings) has to resolve again when moveEpoch() changes.
+class BufferPool {
+public:
+    BufferPool(VkPhysicalDevice physicalDevice, VkDevice device, const BufferPoolCreateInfo& info);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    BufferHandle allocate(VkDeviceSize size, bool movable = true);
+    // Once the GPU is done with the allocation, as with destroyBuffer().
+    void free(BufferHandle handle);
+    BufferRange resolve(BufferHandle handle) const;
+    // Bumped every time defragment() switches allocations to their new locations.
+    std::uint64_t moveEpoch() const { return epoch; }
+
+    // Once per frame. Finishes the moves of the previous call if their copies are done, releases old
+    // locations and empty blocks, and starts copying up to budgetMs worth of allocations out of the
+    // emptiest block. Waits for nothing.
+    void defragment(double budgetMs);
+
+    BufferPoolStats stats() const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE; // Null once released; the entry is reused.
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize used = 0; // Live, retiring and reserved ranges.
+        std::uint8_t* mapped = nullptr;
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges; // Offset to size, coalesced.
+        std::uint32_t pinned = 0;      // Live allocations that are not movable.
+        bool evacuating = false;       // defragment() is emptying it; allocate() stays away.
+        std::uint64_t stuckAt = ~0ull; // Value of changes when its allocations last didn't fit elsewhere.
+    };
+    struct Slot {
+        std::uint32_t generation = 1;
+        std::uint32_t block = 0;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        bool live = false;
+        bool movable = false;
+        bool moving = false;
+    };
+    struct Move {
+        std::uint32_t slot;
+        std::uint32_t generation;
+        std::uint32_t srcBlock;
+        VkDeviceSize srcOffset;
+        std::uint32_t dstBlock;
+        VkDeviceSize dstOffset;
+        VkDeviceSize size;
+    };
+    struct Retired {
+        std::uint32_t block;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        std::uint64_t releaseAt; // Value of frame.
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    BufferPoolCreateInfo info;
+    std::vector<std::uint32_t> families; // Distinct, transferFamily included.
+    VkDeviceSize alignment = 16;
+    std::vector<Block> blocks;
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<Move> moves; // Of the copy in flight.
+    std::deque<Retired> retired;
+    std::uint64_t frame = 0;
+    std::uint64_t epoch = 0;
+    std::uint64_t changes = 0; // Allocations and frees.
+    std::uint64_t totalMoves = 0;
+    VkDeviceSize totalMovedBytes = 0;
+    std::uint64_t releasedBlocks = 0;
+    VkDeviceSize liveBytes = 0;
+    std::uint32_t liveCount = 0;
+    double bytesPerMs = 4e6; // Until the first copy is timed.
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE; // Null when the transfer family has no timestamps.
+    double timestampPeriod = 0;
+    std::uint64_t timestampMask = 0; // The transfer family's timestampValidBits.
+
+    std::uint32_t createBlock(VkDeviceSize size);
+    void releaseBlock(std::uint32_t index);
+    // Best fit in the fullest block that has room, skipping exclude and evacuating blocks. Returns
+    // false when nothing fits and grow is false.
+    bool allocateRange(VkDeviceSize size, std::uint32_t exclude, bool grow, std::uint32_t& block, VkDeviceSize& offset);
+    void releaseRange(std::uint32_t block, VkDeviceSize offset, VkDeviceSize size);
+    bool finishMoves();
+    void startMoves(double budgetMs);
+    // Throws for null, freed and foreign handles.
+    std::uint32_t slotIndex(BufferHandle handle) const;
+};
+
+#endif /* BufferPool_hpp */
@@ -0,0 +1,211 @@
+#include "ClusteredLighting.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+    // Mirrors the push constants of shaders/light_cluster.comp.
+    struct ClusterPush {
+        float view[16];
+        ClusterParams params;
+        std::uint32_t lightCount;
+    };
+}
+
+ClusteredLighting::ClusteredLighting(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderPath,
+                                     const ClusterParams& params, std::uint32_t maxLights)
+    : device(device), clusterParams(params), lightCapacity(maxLights) {
+    lightBuffer = createDynamicBuffer(physicalDevice, device, VkDeviceSize(maxLights) * sizeof(PointLight),
+                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "lights");
+    viewLights = createBuffer(physicalDevice, device, VkDeviceSize(maxLights) * 4 * sizeof(float),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "view-space lights");
+    clusterCounts = createBuffer(physicalDevice, device, VkDeviceSize(params.clusterCount()) * sizeof(std::uint32_t),
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "cluster light counts");
+    lightIndices = createBuffer(physicalDevice, device,
+                                VkDeviceSize(params.clusterCount()) * params.maxLightsPerCluster * sizeof(std::uint32_t),
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "cluster light indices");
+
+    shaderModule = createShaderModule(device, shaderPath);
+
+    // Lights, view-space lights, cluster counts, light indices. Fragment shaders read the grid too.
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for (std::uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings = bindings;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light cluster descriptor set layout!");
+    }
+
+    VkPushConstantRange pushRange = {};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.size = sizeof(ClusterPush);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light clustering pipeline layout!");
+    }
+
+    pipeline = createComputePipeline(device, shaderModule, pipelineLayout);
+
+    VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4};
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light cluster descriptor pool!");
+    }
+    VkDescriptorSetAllocateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkd.vkAllocateDescriptorSets(device, &setInfo, &set) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate light cluster descriptor set!");
+    }
+    // The buffers never change, so the set is written once.
+    VkDescriptorBufferInfo bufferInfos[4] = {
+        {lightBuffer.buffer.buffer, 0, VK_WHOLE_SIZE},
+        {viewLights.buffer, 0, VK_WHOLE_SIZE},
+        {clusterCounts.buffer, 0, VK_WHOLE_SIZE},
+        {lightIndices.buffer, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet writes[4] = {};
+    for (std::uint32_t i = 0; i < 4; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkd.vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+
+    setObjectName(device, shaderModule, "light_cluster.comp");
+    setObjectName(device, descriptorSetLayout, "light cluster set layout");
+    setObjectName(device, pipelineLayout, "light clustering layout");
+    setObjectName(device, pipeline, "light clustering");
+    setObjectName(device, descriptorPool, "light cluster descriptor pool");
+    setObjectName(device, set, "light cluster set");
+}
+
+ClusteredLighting::~ClusteredLighting() {
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    destroyBuffer(device, lightIndices);
+    destroyBuffer(device, clusterCounts);
+    destroyBuffer(device, viewLights);
+    destroyDynamicBuffer(device, lightBuffer);
+}
+
+void ClusteredLighting::record(VkCommandBuffer commandBuffer, const float view[16], std::uint32_t lightCount) {
+    CommandLabel label(commandBuffer, "light clustering");
+    lightCount = std::min(lightCount, lightCapacity);
+    // Binning reads the lights, and so does shading through the descriptor set.
+    recordDynamicUpload(commandBuffer, lightBuffer, VkDeviceSize(lightCount) * sizeof(PointLight),
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    vkd.vkCmdFillBuffer(commandBuffer, clusterCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+    VkMemoryBarrier cleared = {};
+    cleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &cleared, 0, nullptr, 0, nullptr);
+
+    ClusterPush push;
+    std::copy(view, view + 16, push.view);
+    push.params = clusterParams;
+    push.lightCount = lightCount;
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+    vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkd.vkCmdDispatch(commandBuffer, (lightCount + 63) / 64, 1, 1);
+
+    VkMemoryBarrier built = {};
+    built.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    built.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    built.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &built, 0, nullptr, 0, nullptr);
+}
+
+std::vector<std::uint32_t> clusterLightCounts(const ClusterParams& p, const float view[16],
+                                              const PointLight* lights, std::uint32_t lightCount) {
+    std::vector<std::uint32_t> counts(p.clusterCount(), 0);
+    const float depthRatio = std::log(p.farPlane / p.nearPlane);
+    auto sliceOf = [&](float depth) {
+        return static_cast<int>(std::floor(std::log(depth / p.nearPlane) / depthRatio * p.slices));
+    };
+    auto sliceDepth = [&](int slice) {
+        return p.nearPlane * std::pow(p.farPlane / p.nearPlane, static_cast<float>(slice) / p.slices);
+    };
+    for (std::uint32_t i = 0; i < lightCount; i++) {
+        const float* w = lights[i].position;
+        float center[3];
+        for (int r = 0; r < 3; r++) {
+            center[r] = view[r] * w[0] + view[4 + r] * w[1] + view[8 + r] * w[2] + view[12 + r];
+        }
+        float radius = lights[i].radius;
+        float depth = -center[2];
+        if (depth + radius < p.nearPlane || depth - radius > p.farPlane) {
+            continue;
+        }
+        int firstSlice = std::max(sliceOf(std::max(depth - radius, p.nearPlane)), 0);
+        int lastSlice = std::min(sliceOf(std::min(depth + radius, p.farPlane)), static_cast<int>(p.slices) - 1);
+        for (int slice = firstSlice; slice <= lastSlice; slice++) {
+            float d0 = std::max(sliceDepth(slice), depth - radius);
+            float d1 = std::min(sliceDepth(slice + 1), depth + radius);
+            float tanMin[2], tanMax[2];
+            for (int a = 0; a < 2; a++) {
+                float lo = center[a] - radius;
+                float hi = center[a] + radius;
+                tanMin[a] = std::min(lo / d0, lo / d1);
+                tanMax[a] = std::max(hi / d0, hi / d1);
+            }
+            int x0 = std::max(static_cast<int>(std::floor((0.5f + 0.5f * tanMin[0] / p.tanHalfFovX) * p.tilesX)), 0);
+            int x1 = std::min(static_cast<int>(std::floor((0.5f + 0.5f * tanMax[0] / p.tanHalfFovX) * p.tilesX)), static_cast<int>(p.tilesX) - 1);
+            int y0 = std::max(static_cast<int>(std::floor((0.5f - 0.5f * tanMax[1] / p.tanHalfFovY) * p.tilesY)), 0);
+            int y1 = std::min(static_cast<int>(std::floor((0.5f - 0.5f * tanMin[1] / p.tanHalfFovY) * p.tilesY)), static_cast<int>(p.tilesY) - 1);
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    float tx0 = (static_cast<float>(x) / p.tilesX * 2.0f - 1.0f) * p.tanHalfFovX;
+                    float tx1 = (static_cast<float>(x + 1) / p.tilesX * 2.0f - 1.0f) * p.tanHalfFovX;
+                    float ty0 = (1.0f - static_cast<float>(y + 1) / p.tilesY * 2.0f) * p.tanHalfFovY;
+                    float ty1 = (1.0f - static_cast<float>(y) / p.tilesY * 2.0f) * p.tanHalfFovY;
+                    float boxMin[3] = {std::min(tx0 * d0, tx0 * d1), std::min(ty0 * d0, ty0 * d1), -d1};
+                    float boxMax[3] = {std::max(tx1 * d0, tx1 * d1), std::max(ty1 * d0, ty1 * d1), -d0};
+                    float distance2 = 0;
+                    for (int a = 0; a < 3; a++) {
+                        float d = std::max(boxMin[a], std::min(center[a], boxMax[a])) - center[a];
+                        distance2 += d * d;
+                    }
+                    if (distance2 <= radius * radius) {
+                        counts[(static_cast<std::uint32_t>(slice) * p.tilesY + y) * p.tilesX + x]++;
+                    }
+                }
+            }
+        }
+    }
+    return counts;
+}
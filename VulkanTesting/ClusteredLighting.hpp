@@ -0,0 +1,88 @@
+#ifndef ClusteredLighting_hpp
+#define ClusteredLighting_hpp
+
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Mirrors PointLight in shaders/clustered_lighting.glsl (std430, 32 bytes).
+struct PointLight {
+    float position[3]; // World space.
+    float radius;      // Influence reaches zero here.
+    float color[3];
+    float intensity;
+};
+
+// Mirrors ClusterParams in shaders/clustered_lighting.glsl. The projection is assumed symmetric,
+// so the field of view is enough to place the tiles.
+struct ClusterParams {
+    float tanHalfFovX = 1.0f;
+    float tanHalfFovY = 0.5625f;
+    float nearPlane = 0.1f;
+    float farPlane = 1000.0f;
+    std::uint32_t tilesX = 16;
+    std::uint32_t tilesY = 9;
+    std::uint32_t slices = 24;
+    std::uint32_t maxLightsPerCluster = 128;
+
+    std::uint32_t clusterCount() const { return tilesX * tilesY * slices; }
+};
+
+// Clustered forward lighting. Each frame a compute pass bins the dynamic lights into a froxel grid
+// (screen tiles times exponential depth slices); shading then loops over the lights of one
+// cluster instead of all of them, which keeps per-pixel cost bounded as the light count grows.
+//
+// The grid lives in one descriptor set with the four bindings of clustered_lighting.glsl. Shading
+// pipelines include that file and bind descriptorSet() at set 0 (or CLUSTER_SET). The buffers are
+// single buffered: write lights() only once the previous frame's shading finished.
+class ClusteredLighting {
+public:
+    ClusteredLighting(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderPath,
+                      const ClusterParams& params, std::uint32_t maxLights);
+    ~ClusteredLighting();
+
+    ClusteredLighting(const ClusteredLighting&) = delete;
+    ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+    // Persistently mapped, maxLights() entries. Device-local memory with resizable BAR, otherwise a
+    // staging buffer that record() copies from.
+    PointLight* lights() { return static_cast<PointLight*>(lightBuffer.mapped); }
+    std::uint32_t maxLights() const { return lightCapacity; }
+    const ClusterParams& params() const { return clusterParams; }
+
+    // Records the upload (when staged), clear and binning of the first lightCount lights, then a
+    // barrier that makes the grid visible to compute and fragment shaders. view is column major,
+    // world to view space, with the camera looking down -Z.
+    void record(VkCommandBuffer commandBuffer, const float view[16], std::uint32_t lightCount);
+
+    VkDescriptorSetLayout setLayout() const { return descriptorSetLayout; }
+    VkDescriptorSet descriptorSet() const { return set; }
+    VkBuffer clusterCountBuffer() const { return clusterCounts.buffer; }
+
+private:
+    VkDevice device;
+    ClusterParams clusterParams;
+    std::uint32_t lightCapacity;
+
+    DynamicBuffer lightBuffer;
+    Buffer viewLights;
+    Buffer clusterCounts;
+    Buffer lightIndices;
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+// CPU version of light_cluster.comp, for validation: the unclamped light count of every cluster.
+std::vector<std::uint32_t> clusterLightCounts(const ClusterParams& params, const float view[16],
+                                              const PointLight* lights, std::uint32_t lightCount);
+
+#endif /* ClusteredLighting_hpp */
@@ -0,0 +1,335 @@
+#include "ExternalMemory.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    const VkExternalMemoryHandleTypeFlagBits memoryHandleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+    const VkExternalSemaphoreHandleTypeFlagBits semaphoreHandleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+    // More than any message here carries.
+    const std::size_t maxFds = 64;
+
+    // Both sides: the image with the external memory handle type, a dedicated allocation that is either
+    // exported (importFd < 0) or imported from importFd, and a view.
+    Image createSharedImage(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format,
+                            VkImageUsageFlags usage, int importFd, VkDeviceSize& allocationSize, const char* name) {
+        VkPhysicalDeviceExternalImageFormatInfo externalFormatInfo = {};
+        externalFormatInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO;
+        externalFormatInfo.handleType = memoryHandleType;
+        VkPhysicalDeviceImageFormatInfo2 formatInfo = {};
+        formatInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+        formatInfo.pNext = &externalFormatInfo;
+        formatInfo.format = format;
+        formatInfo.type = VK_IMAGE_TYPE_2D;
+        formatInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        formatInfo.usage = usage;
+        VkExternalImageFormatProperties externalProperties = {};
+        externalProperties.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES;
+        VkImageFormatProperties2 formatProperties = {};
+        formatProperties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+        formatProperties.pNext = &externalProperties;
+        VkExternalMemoryFeatureFlags needed =
+            importFd < 0 ? VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT : VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT;
+        if (vkGetPhysicalDeviceImageFormatProperties2(physicalDevice, &formatInfo, &formatProperties) != VK_SUCCESS ||
+            (externalProperties.externalMemoryProperties.externalMemoryFeatures & needed) != needed) {
+            throw std::runtime_error("image format can't be shared as an opaque fd!");
+        }
+
+        Image result;
+        result.format = format;
+        result.extent = extent;
+        result.dedicated = true;
+        VkExternalMemoryImageCreateInfo externalInfo = {};
+        externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
+        externalInfo.handleTypes = memoryHandleType;
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.pNext = &externalInfo;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(device, &imageInfo, nullptr, &result.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shared image!");
+        }
+
+        // Dedicated on both sides, whatever the driver prefers: the importer can't know otherwise.
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device, result.image, &requirements);
+        VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.image = result.image;
+        VkExportMemoryAllocateInfo exportInfo = {};
+        exportInfo.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO;
+        exportInfo.pNext = &dedicatedInfo;
+        exportInfo.handleTypes = memoryHandleType;
+        VkImportMemoryFdInfoKHR importInfo = {};
+        importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
+        importInfo.pNext = &dedicatedInfo;
+        importInfo.handleType = memoryHandleType;
+        importInfo.fd = importFd;
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        if (importFd < 0) {
+            allocInfo.pNext = &exportInfo;
+            allocationSize = requirements.size;
+        } else {
+            allocInfo.pNext = &importInfo;
+        }
+        allocInfo.allocationSize = allocationSize;
+        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkd.vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) != VK_SUCCESS) {
+            vkDestroyImage(device, result.image, nullptr);
+            throw std::runtime_error(importFd < 0 ? "failed to allocate exportable image memory!"
+                                                  : "failed to import image memory!");
+        }
+        vkBindImageMemory(device, result.image, result.memory, 0);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = result.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        if (vkCreateImageView(device, &viewInfo, nullptr, &result.view) != VK_SUCCESS) {
+            vkd.vkFreeMemory(device, result.memory, nullptr);
+            vkDestroyImage(device, result.image, nullptr);
+            throw std::runtime_error("failed to create shared image view!");
+        }
+        setObjectName(device, result.image, name);
+        setObjectName(device, result.memory, name);
+        setObjectName(device, result.view, name);
+        return result;
+    }
+
+    void requireInterop(bool loaded) {
+        if (!loaded) {
+            throw std::runtime_error("external memory and semaphore fds are not enabled!");
+        }
+    }
+
+    sockaddr_un socketAddress(const std::string& path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("socket path too long: " + path);
+        }
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        return address;
+    }
+}
+
+Image createExportableImage(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format,
+                            VkImageUsageFlags usage, VkDeviceSize& allocationSize, const char* name) {
+    requireInterop(vkd.vkGetMemoryFdKHR != nullptr);
+    return createSharedImage(physicalDevice, device, extent, format, usage, -1, allocationSize, name);
+}
+
+Image importImage(VkPhysicalDevice physicalDevice, VkDevice device, int fd, VkDeviceSize allocationSize,
+                  VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, const char* name) {
+    requireInterop(vkd.vkGetMemoryFdKHR != nullptr);
+    return createSharedImage(physicalDevice, device, extent, format, usage, fd, allocationSize, name);
+}
+
+int exportMemoryFd(VkDevice device, VkDeviceMemory memory) {
+    requireInterop(vkd.vkGetMemoryFdKHR != nullptr);
+    VkMemoryGetFdInfoKHR getInfo = {};
+    getInfo.sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR;
+    getInfo.memory = memory;
+    getInfo.handleType = memoryHandleType;
+    int fd = -1;
+    if (vkd.vkGetMemoryFdKHR(device, &getInfo, &fd) != VK_SUCCESS) {
+        throw std::runtime_error("failed to export memory fd!");
+    }
+    return fd;
+}
+
+VkSemaphore createExportableSemaphore(VkDevice device, const char* name) {
+    VkExportSemaphoreCreateInfo exportInfo = {};
+    exportInfo.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO;
+    exportInfo.handleTypes = semaphoreHandleType;
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &exportInfo;
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create exportable semaphore!");
+    }
+    setObjectName(device, semaphore, name);
+    return semaphore;
+}
+
+int exportSemaphoreFd(VkDevice device, VkSemaphore semaphore) {
+    requireInterop(vkd.vkGetSemaphoreFdKHR != nullptr);
+    VkSemaphoreGetFdInfoKHR getInfo = {};
+    getInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR;
+    getInfo.semaphore = semaphore;
+    getInfo.handleType = semaphoreHandleType;
+    int fd = -1;
+    if (vkd.vkGetSemaphoreFdKHR(device, &getInfo, &fd) != VK_SUCCESS) {
+        throw std::runtime_error("failed to export semaphore fd!");
+    }
+    return fd;
+}
+
+VkSemaphore importSemaphore(VkDevice device, int fd, const char* name) {
+    requireInterop(vkd.vkImportSemaphoreFdKHR != nullptr);
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create semaphore!");
+    }
+    VkImportSemaphoreFdInfoKHR importInfo = {};
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR;
+    importInfo.semaphore = semaphore;
+    importInfo.handleType = semaphoreHandleType;
+    importInfo.fd = fd;
+    if (vkd.vkImportSemaphoreFdKHR(device, &importInfo) != VK_SUCCESS) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+        throw std::runtime_error("failed to import semaphore fd!");
+    }
+    setObjectName(device, semaphore, name);
+    return semaphore;
+}
+
+FdChannel::FdChannel(const std::string& path, bool server, int timeoutMs) : socketPath(path), server(server) {
+    sockaddr_un address = socketAddress(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("failed to create socket!");
+    }
+    if (server) {
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 1) != 0) {
+            close(fd);
+            throw std::runtime_error("failed to listen on " + path);
+        }
+        socketFd = accept(fd, nullptr, nullptr);
+        close(fd);
+        if (socketFd < 0) {
+            unlink(path.c_str());
+            throw std::runtime_error("failed to accept a connection on " + path);
+        }
+        return;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        if ((errno != ENOENT && errno != ECONNREFUSED) || std::chrono::steady_clock::now() > deadline) {
+            close(fd);
+            throw std::runtime_error("failed to connect to " + path);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    socketFd = fd;
+}
+
+FdChannel::~FdChannel() {
+    close(socketFd);
+    if (server) {
+        unlink(socketPath.c_str());
+    }
+}
+
+void FdChannel::send(const void* data, std::size_t size, const std::vector<int>& fds) {
+    if (fds.size() > maxFds) {
+        throw std::runtime_error("too many fds for one message!");
+    }
+    const auto* bytes = static_cast<const char*>(data);
+    // The fds ride along with the first chunk.
+    alignas(cmsghdr) char control[CMSG_SPACE(maxFds * sizeof(int))];
+    msghdr message = {};
+    iovec chunk = {const_cast<char*>(bytes), size};
+    message.msg_iov = &chunk;
+    message.msg_iovlen = 1;
+    if (!fds.empty()) {
+        std::memset(control, 0, sizeof(control));
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+        std::memcpy(CMSG_DATA(header), fds.data(), fds.size() * sizeof(int));
+    }
+    std::size_t sent = 0;
+    while (sent < size) {
+        // A peer that went away is an error here, not a SIGPIPE that kills the process.
+        ssize_t count = sendmsg(socketFd, &message, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            throw std::runtime_error("failed to send on " + socketPath);
+        }
+        sent += static_cast<std::size_t>(count);
+        chunk.iov_base = const_cast<char*>(bytes + sent);
+        chunk.iov_len = size - sent;
+        message.msg_control = nullptr;
+        message.msg_controllen = 0;
+    }
+}
+
+bool FdChannel::receive(void* data, std::size_t size, std::vector<int>* fds) {
+    auto* bytes = static_cast<char*>(data);
+    alignas(cmsghdr) char control[CMSG_SPACE(maxFds * sizeof(int))];
+    std::size_t received = 0;
+    while (received < size) {
+        msghdr message = {};
+        iovec chunk = {bytes + received, size - received};
+        message.msg_iov = &chunk;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        // Close-on-exec from the start, so a child this process spawns never inherits them.
+        ssize_t count = recvmsg(socketFd, &message, MSG_CMSG_CLOEXEC);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count == 0 && received == 0) {
+            return false;
+        }
+        if (count <= 0) {
+            throw std::runtime_error("failed to receive on " + socketPath);
+        }
+        std::vector<int> arrived;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            std::size_t fdCount = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            std::size_t first = arrived.size();
+            arrived.resize(first + fdCount);
+            std::memcpy(arrived.data() + first, CMSG_DATA(header), fdCount * sizeof(int));
+        }
+        // More fds than fit in control: the kernel closed the rest, so the message is incomplete.
+        bool truncated = (message.msg_flags & MSG_CTRUNC) != 0;
+        for (int fd : arrived) {
+            if (fds != nullptr && !truncated) {
+                fds->push_back(fd);
+            } else {
+                close(fd);
+            }
+        }
+        if (truncated) {
+            throw std::runtime_error("too many fds received on " + socketPath);
+        }
+        received += static_cast<std::size_t>(count);
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef ExternalMemory_hpp
+#define ExternalMemory_hpp
+
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Images and semaphores shared with another process as opaque POSIX file descriptors
+// (VK_KHR_external_memory_fd, VK_KHR_external_semaphore_fd; see VulkanContext::externalInterop()).
+// An encoder or an analysis tool then reads rendered frames where they are instead of through a CPU
+// readback. Both processes have to run on the same device and driver, i.e. the same deviceUUID and
+// driverUUID.
+//
+// Every fd handed out here is a new reference that belongs to the caller: send it on and close it.
+// The import functions take over theirs when they succeed.
+//
+// A shared image changes hands with queue family ownership transfers to and from
+// VK_QUEUE_FAMILY_EXTERNAL, and shared semaphores order the release before the acquire.
+
+// A device-local 2D image in its own exportable allocation, like createImage() but color formats only.
+// allocationSize is what importImage() needs on the other side. Throws when the device can't export
+// the format and usage.
+Image createExportableImage(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format,
+                            VkImageUsageFlags usage, VkDeviceSize& allocationSize, const char* name = nullptr);
+// The exporter's image in this process. extent, format and usage must be the exporter's.
+Image importImage(VkPhysicalDevice physicalDevice, VkDevice device, int fd, VkDeviceSize allocationSize,
+                  VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, const char* name = nullptr);
+int exportMemoryFd(VkDevice device, VkDeviceMemory memory);
+
+// A binary semaphore whose payload other processes can import and then wait on or signal.
+VkSemaphore createExportableSemaphore(VkDevice device, const char* name = nullptr);
+int exportSemaphoreFd(VkDevice device, VkSemaphore semaphore);
+// Permanently shares the payload behind fd.
+VkSemaphore importSemaphore(VkDevice device, int fd, const char* name = nullptr);
+
+// What an importer needs besides the fds to take over a ring of shared images. Plain data, so that it
+// can go over an FdChannel as is.
+struct SharedImageInfo {
+    char deviceUUID[33] = {}; // ExternalInteropSupport's, null terminated.
+    char driverUUID[33] = {};
+    VkExtent2D extent = {0, 0};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags usage = 0;
+    VkDeviceSize allocationSize = 0;
+    std::uint32_t imageCount = 0;
+};
+
+// One connected Unix domain socket carrying fixed-size messages with file descriptors attached
+// (SCM_RIGHTS): how the fds above get to the other process. Messages are raw structs, so both
+// ends must come from the same build.
+class FdChannel {
+public:
+    // server = true creates the socket at path, replacing a stale one, and waits for one peer; the
+    // client retries for up to timeoutMs while the server isn't listening yet.
+    FdChannel(const std::string& path, bool server, int timeoutMs = 10000);
+    ~FdChannel();
+
+    FdChannel(const FdChannel&) = delete;
+    FdChannel& operator=(const FdChannel&) = delete;
+
+    // The fds stay open here; the peer gets its own.
+    void send(const void* data, std::size_t size, const std::vector<int>& fds = {});
+    // Exactly size bytes plus the fds that came with them. False when the peer has closed the
+    // connection before the message started.
+    bool receive(void* data, std::size_t size, std::vector<int>* fds = nullptr);
+
+private:
+    int socketFd = -1;
+    std::string socketPath; // Unlinked again by the server.
+    bool server;
+};
+
+#endif /* ExternalMemory_hpp */
@@ -0,0 +1,171 @@
+#include "Glz.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const std::uint32_t MIN_MATCH = 4;
+    const std::uint32_t HASH_BITS = 11;
+
+    std::uint32_t hash4(const std::uint8_t* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, 4);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void putLength(std::vector<std::uint8_t>& out, std::uint32_t extra) {
+        while (extra >= 255) {
+            out.push_back(255);
+            extra -= 255;
+        }
+        out.push_back(static_cast<std::uint8_t>(extra));
+    }
+
+    void putSequence(std::vector<std::uint8_t>& out, const std::uint8_t* literals, std::uint32_t literalLength,
+                     std::uint32_t offset, std::uint32_t matchLength) {
+        std::uint32_t litNibble = std::min<std::uint32_t>(literalLength, 15);
+        std::uint32_t matchNibble = matchLength == 0 ? 0 : std::min<std::uint32_t>(matchLength - MIN_MATCH, 15);
+        out.push_back(static_cast<std::uint8_t>(litNibble << 4 | matchNibble));
+        if (litNibble == 15) {
+            putLength(out, literalLength - 15);
+        }
+        out.insert(out.end(), literals, literals + literalLength);
+        if (matchLength == 0) {
+            return;
+        }
+        out.push_back(static_cast<std::uint8_t>(offset & 0xFF));
+        out.push_back(static_cast<std::uint8_t>(offset >> 8));
+        if (matchNibble == 15) {
+            putLength(out, matchLength - MIN_MATCH - 15);
+        }
+    }
+
+    // Greedy single-probe matcher, same idea as LZ4's fast mode. Decode speed is what matters here.
+    void compressStream(const std::uint8_t* src, std::uint32_t size, std::vector<std::uint8_t>& out) {
+        std::int32_t table[1 << HASH_BITS];
+        std::fill(std::begin(table), std::end(table), -1);
+        std::uint32_t pos = 0;
+        std::uint32_t literalStart = 0;
+        while (pos + MIN_MATCH <= size) {
+            std::uint32_t h = hash4(src + pos);
+            std::int32_t candidate = table[h];
+            table[h] = static_cast<std::int32_t>(pos);
+            if (candidate < 0 || std::memcmp(src + candidate, src + pos, MIN_MATCH) != 0) {
+                pos++;
+                continue;
+            }
+            std::uint32_t length = MIN_MATCH;
+            while (pos + length < size && src[candidate + length] == src[pos + length]) {
+                length++;
+            }
+            putSequence(out, src + literalStart, pos - literalStart, pos - static_cast<std::uint32_t>(candidate), length);
+            pos += length;
+            literalStart = pos;
+        }
+        if (literalStart < size) {
+            putSequence(out, src + literalStart, size - literalStart, 0, 0);
+        }
+    }
+
+    void writeU32(std::uint8_t* p, std::uint32_t v) {
+        std::memcpy(p, &v, 4);
+    }
+
+    std::uint32_t readU32(const std::uint8_t* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+}
+
+std::vector<std::uint8_t> glzCompress(const std::uint8_t* src, std::size_t size) {
+    if (size > GLZ_CHUNK_SIZE) {
+        throw std::runtime_error("glzCompress: chunk larger than GLZ_CHUNK_SIZE.");
+    }
+    std::uint32_t streamCount = static_cast<std::uint32_t>((size + GLZ_STREAM_SIZE - 1) / GLZ_STREAM_SIZE);
+    std::size_t headerSize = 4 + 4 * streamCount;
+    std::vector<std::uint8_t> out(headerSize);
+    writeU32(out.data(), streamCount);
+    for (std::uint32_t i = 0; i < streamCount; i++) {
+        std::uint32_t begin = i * GLZ_STREAM_SIZE;
+        std::uint32_t length = std::min<std::uint32_t>(GLZ_STREAM_SIZE, static_cast<std::uint32_t>(size) - begin);
+        compressStream(src + begin, length, out);
+        writeU32(out.data() + 4 + 4 * i, static_cast<std::uint32_t>(out.size() - headerSize));
+    }
+    // The shader reads whole words.
+    out.resize((out.size() + 3) & ~std::size_t(3));
+    return out;
+}
+
+bool glzCheckHeader(const std::uint8_t* src, std::size_t srcSize, std::size_t dstSize) {
+    if (srcSize < 4 || dstSize > GLZ_CHUNK_SIZE) {
+        return false;
+    }
+    std::uint32_t streamCount = readU32(src);
+    std::size_t headerSize = 4 + 4 * std::size_t(streamCount);
+    if (headerSize > srcSize || streamCount != (dstSize + GLZ_STREAM_SIZE - 1) / GLZ_STREAM_SIZE) {
+        return false;
+    }
+    std::uint32_t streamBegin = 0;
+    for (std::uint32_t i = 0; i < streamCount; i++) {
+        std::uint32_t streamEnd = readU32(src + 4 + 4 * i);
+        if (streamEnd < streamBegin || streamEnd > srcSize - headerSize) {
+            return false;
+        }
+        streamBegin = streamEnd;
+    }
+    return true;
+}
+
+bool glzDecompress(const std::uint8_t* src, std::size_t srcSize, std::uint8_t* dst, std::size_t dstSize) {
+    if (!glzCheckHeader(src, srcSize, dstSize)) {
+        return false;
+    }
+    std::uint32_t streamCount = readU32(src);
+    std::size_t headerSize = 4 + 4 * std::size_t(streamCount);
+    const std::uint8_t* data = src + headerSize;
+    std::uint32_t streamBegin = 0;
+    for (std::uint32_t i = 0; i < streamCount; i++) {
+        std::uint32_t streamEnd = readU32(src + 4 + 4 * i);
+        const std::uint8_t* in = data + streamBegin;
+        const std::uint8_t* inEnd = data + streamEnd;
+        std::uint8_t* outBegin = dst + std::size_t(i) * GLZ_STREAM_SIZE;
+        std::uint8_t* out = outBegin;
+        std::uint8_t* outEnd = outBegin + std::min<std::size_t>(GLZ_STREAM_SIZE, dstSize - std::size_t(i) * GLZ_STREAM_SIZE);
+        auto readLength = [&](std::uint32_t base) -> std::uint32_t {
+            std::uint32_t b;
+            do {
+                if (in >= inEnd) return ~0u;
+                b = *in++;
+                base += b;
+            } while (b == 255);
+            return base;
+        };
+        while (out < outEnd) {
+            if (in >= inEnd) return false;
+            std::uint32_t token = *in++;
+            std::uint32_t literalLength = token >> 4;
+            if (literalLength == 15 && (literalLength = readLength(15)) == ~0u) return false;
+            if (literalLength > std::size_t(inEnd - in) || literalLength > std::size_t(outEnd - out)) return false;
+            std::memcpy(out, in, literalLength);
+            in += literalLength;
+            out += literalLength;
+            if (out >= outEnd) {
+                break;
+            }
+            if (inEnd - in < 2) return false;
+            std::uint32_t offset = in[0] | std::uint32_t(in[1]) << 8;
+            in += 2;
+            std::uint32_t matchLength = (token & 15) + MIN_MATCH;
+            if ((token & 15) == 15 && (matchLength = readLength(matchLength)) == ~0u) return false;
+            if (offset == 0 || offset > std::size_t(out - outBegin) || matchLength > std::size_t(outEnd - out)) return false;
+            // Byte copy: matches may overlap their own output.
+            for (std::uint32_t k = 0; k < matchLength; k++, out++) {
+                *out = *(out - offset);
+            }
+        }
+        streamBegin = streamEnd;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef Glz_hpp
+#define Glz_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GLZ: an LZ4-style byte codec laid out for GPU decoding.
+//
+// A chunk of up to GLZ_CHUNK_SIZE bytes is cut into GLZ_STREAM_SIZE slices, and each slice is compressed
+// as an independent stream that only references its own output. One compute invocation decodes one
+// stream, one workgroup decodes one chunk, so a 64 KiB chunk keeps 32 lanes busy with no cross-lane
+// dependencies. The ratio is a little worse than plain LZ4 because matches can't cross slices.
+//
+// Encoded chunk:
+//   uint32 streamCount
+//   uint32 streamEnd[streamCount]   end of each stream, relative to the first stream byte
+//   stream bytes
+// Stream: sequences of
+//   token (literal length << 4 | match length - 4), [literal length ext], literals,
+//   uint16 match offset, [match length ext]
+// where a nibble of 15 is extended by bytes until one is < 255. A stream ends as soon as its slice
+// is full, so the last sequence carries literals only.
+//
+// Keep in sync with shaders/glz_decompress.comp.
+
+const std::uint32_t GLZ_STREAM_SIZE = 2048;
+const std::uint32_t GLZ_CHUNK_SIZE = 64 * 1024;
+const std::uint32_t GLZ_MAX_STREAMS = GLZ_CHUNK_SIZE / GLZ_STREAM_SIZE;
+
+// size must be <= GLZ_CHUNK_SIZE. The result is always 4-byte aligned in length.
+std::vector<std::uint8_t> glzCompress(const std::uint8_t* src, std::size_t size);
+// Reference CPU decoder. Returns false on malformed input.
+bool glzDecompress(const std::uint8_t* src, std::size_t srcSize, std::uint8_t* dst, std::size_t dstSize);
+// The part of a chunk the GPU decoder takes on trust: a stream count that fits dstSize and a stream
+// table that ascends and stays within srcSize. Stream bytes are bounds checked while decoding.
+bool glzCheckHeader(const std::uint8_t* src, std::size_t srcSize, std::size_t dstSize);
+
+#endif /* Glz_hpp */
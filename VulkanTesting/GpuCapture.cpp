@@ -0,0 +1,739 @@
+#include "GpuCapture.hpp"
+#include "VulkanContext.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+GpuCapture* GpuCapture::active = nullptr;
+
+namespace {
+    // Little-endian appends. The capture is only ever read back on the same kind of machine.
+    struct Writer {
+        std::vector<std::uint8_t> bytes;
+
+        void u32(std::uint32_t v) { raw(&v, sizeof(v)); }
+        void u64(std::uint64_t v) { raw(&v, sizeof(v)); }
+        void raw(const void* data, std::size_t size) {
+            auto p = static_cast<const std::uint8_t*>(data);
+            bytes.insert(bytes.end(), p, p + size);
+        }
+    };
+
+    template<typename T>
+    std::uint64_t handleKey(T handle) {
+        std::uint64_t key = 0;
+        std::memcpy(&key, &handle, sizeof(handle));
+        return key;
+    }
+
+    std::uint64_t fnv1a64(const std::uint8_t* data, std::size_t size) {
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        for (std::size_t i = 0; i < size; i++) {
+            hash = (hash ^ data[i]) * 0x100000001b3ull;
+        }
+        return hash | 1; // Never 0, which means "not uploaded yet".
+    }
+}
+
+GpuCapture::GpuCapture(const VulkanContext& context, const std::string& path, std::uint32_t firstFrame, std::uint32_t frameCount)
+    : physicalDevice(context.physicalDevice()), queues{context.graphicsQueue(), context.computeQueue(), context.transferQueue()},
+      families{context.queueFamilies().graphicsFamily, context.queueFamilies().computeFamily, context.queueFamilies().transferFamily},
+      path(path), firstFrame(firstFrame), frameCount(frameCount), original(vkd) {
+    if (active != nullptr) {
+        throw std::runtime_error("Only one GpuCapture can be active at a time.");
+    }
+    active = this;
+    vkd.vkCreateBuffer = createBuffer;
+    vkd.vkDestroyBuffer = destroyBuffer;
+    vkd.vkAllocateMemory = allocateMemory;
+    vkd.vkFreeMemory = freeMemory;
+    vkd.vkBindBufferMemory = bindBufferMemory;
+    vkd.vkMapMemory = mapMemory;
+    vkd.vkUnmapMemory = unmapMemory;
+    vkd.vkCreateShaderModule = createShaderModule;
+    vkd.vkCreateDescriptorSetLayout = createDescriptorSetLayout;
+    vkd.vkCreatePipelineLayout = createPipelineLayout;
+    vkd.vkCreateComputePipelines = createComputePipelines;
+    vkd.vkAllocateDescriptorSets = allocateDescriptorSets;
+    vkd.vkUpdateDescriptorSets = updateDescriptorSets;
+    vkd.vkAllocateCommandBuffers = allocateCommandBuffers;
+    vkd.vkFreeCommandBuffers = freeCommandBuffers;
+    vkd.vkDestroyCommandPool = destroyCommandPool;
+    vkd.vkBeginCommandBuffer = beginCommandBuffer;
+    vkd.vkCmdBindPipeline = cmdBindPipeline;
+    vkd.vkCmdBindDescriptorSets = cmdBindDescriptorSets;
+    vkd.vkCmdPushConstants = cmdPushConstants;
+    vkd.vkCmdDispatch = cmdDispatch;
+    vkd.vkCmdDispatchIndirect = cmdDispatchIndirect;
+    vkd.vkCmdDrawIndirect = cmdDrawIndirect;
+    vkd.vkCmdCopyBuffer = cmdCopyBuffer;
+    vkd.vkCmdCopyBufferToImage = cmdCopyBufferToImage;
+    vkd.vkCmdCopyImageToBuffer = cmdCopyImageToBuffer;
+    vkd.vkCmdFillBuffer = cmdFillBuffer;
+    vkd.vkCmdPipelineBarrier = cmdPipelineBarrier;
+    vkd.vkCmdBeginRenderPass = cmdBeginRenderPass;
+    if (original.vkCmdBeginRenderingKHR != nullptr) {
+        vkd.vkCmdBeginRenderingKHR = cmdBeginRenderingKHR;
+    }
+    vkd.vkQueueSubmit = queueSubmit;
+    if (firstFrame == 0 && frameCount > 0) {
+        start();
+    }
+}
+
+GpuCapture::~GpuCapture() {
+    if (file.is_open()) {
+        finish();
+    }
+    vkd = original;
+    active = nullptr;
+}
+
+void GpuCapture::frameBoundary() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file.is_open()) {
+        writeRecord(CaptureRecord::FrameEnd, {});
+    }
+    frame++;
+    if (file.is_open() && frame >= firstFrame + frameCount) {
+        finish();
+    } else if (!file.is_open() && !done && frame == firstFrame) {
+        start();
+    }
+}
+
+void GpuCapture::start() {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to open capture file " + path);
+    }
+    std::uint32_t header[2] = {CAPTURE_MAGIC, CAPTURE_VERSION};
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    // Everything that exists now, then the current descriptor contents. Uploads follow lazily,
+    // at the first submit that references each buffer.
+    for (const auto& object : objectRecords) {
+        file.write(reinterpret_cast<const char*>(object.second.data()), static_cast<std::streamsize>(object.second.size()));
+    }
+    for (const auto& binding : descriptors) {
+        writeRecord(CaptureRecord::DescriptorWrite, binding.second.record);
+    }
+    for (auto& buffer : buffers) {
+        buffer.second.uploadedHash = 0;
+    }
+    std::cout << "Capturing frames " << firstFrame << ".." << firstFrame + frameCount - 1 << " to " << path << std::endl;
+}
+
+void GpuCapture::finish() {
+    file.close();
+    done = true;
+    std::cout << "Capture written to " << path << std::endl;
+}
+
+void GpuCapture::writeRecord(CaptureRecord type, const std::vector<std::uint8_t>& payload) {
+    std::uint32_t header[2] = {static_cast<std::uint32_t>(type), static_cast<std::uint32_t>(payload.size())};
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+}
+
+std::uint32_t GpuCapture::addObject(std::uint64_t handle, CaptureRecord type, std::vector<std::uint8_t> payload) {
+    std::uint32_t id = nextId++;
+    std::memcpy(payload.data(), &id, sizeof(id)); // Every creation record starts with its id.
+    ids[handle] = id;
+    Writer record;
+    record.u32(static_cast<std::uint32_t>(type));
+    record.u32(static_cast<std::uint32_t>(payload.size()));
+    record.raw(payload.data(), payload.size());
+    if (file.is_open()) {
+        file.write(reinterpret_cast<const char*>(record.bytes.data()), static_cast<std::streamsize>(record.bytes.size()));
+    }
+    objectRecords[id] = std::move(record.bytes);
+    return id;
+}
+
+std::uint32_t GpuCapture::idOf(std::uint64_t handle) const {
+    auto it = ids.find(handle);
+    return it == ids.end() ? 0 : it->second;
+}
+
+std::uint32_t GpuCapture::bufferId(VkBuffer buffer) const {
+    auto it = buffers.find(handleKey(buffer));
+    return it == buffers.end() ? 0 : it->second.id;
+}
+
+void GpuCapture::uploadChanged(const std::vector<VkBuffer>& referenced) {
+    for (VkBuffer handle : referenced) {
+        auto it = buffers.find(handleKey(handle));
+        if (it == buffers.end()) {
+            continue;
+        }
+        BufferInfo& buffer = it->second;
+        auto memory = memories.find(handleKey(buffer.memory));
+        if (memory == memories.end() || memory->second.mapped == nullptr ||
+            buffer.memoryOffset < memory->second.mapOffset) {
+            continue;
+        }
+        const std::uint8_t* contents = memory->second.mapped + (buffer.memoryOffset - memory->second.mapOffset);
+        std::uint64_t hash = fnv1a64(contents, static_cast<std::size_t>(buffer.size));
+        if (hash == buffer.uploadedHash) {
+            continue;
+        }
+        buffer.uploadedHash = hash;
+        Writer upload;
+        upload.u32(buffer.id);
+        upload.u64(0);
+        upload.u64(buffer.size);
+        upload.raw(contents, static_cast<std::size_t>(buffer.size));
+        writeRecord(CaptureRecord::Upload, upload.bytes);
+    }
+}
+
+// Why a submitted stream can't be captured faithfully, or empty when it can.
+std::string GpuCapture::unsupportedWork(const CommandStream& stream) const {
+    if (stream.unsupported != nullptr) {
+        return stream.unsupported;
+    }
+    for (VkDescriptorSet set : stream.sets) {
+        if (imageSets.count(idOf(handleKey(set))) > 0) {
+            return "a descriptor set with image descriptors";
+        }
+    }
+    return std::string();
+}
+
+// Deletes the partial file and throws out of the submit that hit `reason`.
+void GpuCapture::abortCapture(const std::string& reason) {
+    file.close();
+    std::remove(path.c_str());
+    done = true;
+    throw std::runtime_error("Capture aborted in frame " + std::to_string(frame) + ": a submit uses " + reason +
+                             ", and only compute and transfer work on buffers can be captured. Nothing was written to " + path + ".");
+}
+
+// Recording goes on so the app's own command buffer stays valid; the stream just can't be submitted
+// while capturing.
+void GpuCapture::markUnsupported(VkCommandBuffer commandBuffer, const char* command) {
+    std::lock_guard<std::mutex> lock(active->mutex);
+    CommandStream& stream = active->streams[handleKey(commandBuffer)];
+    if (stream.unsupported == nullptr) {
+        stream.unsupported = command;
+    }
+}
+
+// Ownership transfers are recorded by queue number, since the replay device may number its
+// families differently. Several numbers can share a family; any of them names it.
+std::uint32_t GpuCapture::queueNumber(std::uint32_t family) const {
+    if (family == VK_QUEUE_FAMILY_IGNORED) {
+        return CAPTURE_NO_QUEUE;
+    }
+    for (std::uint32_t i = 0; i < 3; i++) {
+        if (families[i] == family) {
+            return i;
+        }
+    }
+    return CAPTURE_NO_QUEUE;
+}
+
+// Hooks. Creation hooks always track; stream hooks always record, because command buffers may be
+// recorded before the first captured frame and submitted inside it.
+
+VkResult VKAPI_CALL GpuCapture::createBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
+                                             const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer) {
+    VkResult result = active->original.vkCreateBuffer(device, pCreateInfo, pAllocator, pBuffer);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        BufferInfo& info = active->buffers[handleKey(*pBuffer)];
+        info.size = pCreateInfo->size;
+        info.usage = pCreateInfo->usage;
+    }
+    return result;
+}
+
+void VKAPI_CALL GpuCapture::destroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator) {
+    {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        auto it = active->buffers.find(handleKey(buffer));
+        if (it != active->buffers.end()) {
+            // The replayer keeps every buffer alive to the end, so only the live set needs trimming.
+            active->objectRecords.erase(it->second.id);
+            active->buffers.erase(it);
+        }
+    }
+    active->original.vkDestroyBuffer(device, buffer, pAllocator);
+}
+
+VkResult VKAPI_CALL GpuCapture::allocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+                                               const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory) {
+    VkResult result = active->original.vkAllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+    if (result == VK_SUCCESS) {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(active->physicalDevice, &memoryProperties);
+        std::lock_guard<std::mutex> lock(active->mutex);
+        active->memories[handleKey(*pMemory)].properties = memoryProperties.memoryTypes[pAllocateInfo->memoryTypeIndex].propertyFlags;
+    }
+    return result;
+}
+
+void VKAPI_CALL GpuCapture::freeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator) {
+    {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        active->memories.erase(handleKey(memory));
+    }
+    active->original.vkFreeMemory(device, memory, pAllocator);
+}
+
+VkResult VKAPI_CALL GpuCapture::bindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset) {
+    VkResult result = active->original.vkBindBufferMemory(device, buffer, memory, memoryOffset);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    auto it = active->buffers.find(handleKey(buffer));
+    auto mem = active->memories.find(handleKey(memory));
+    if (result == VK_SUCCESS && it != active->buffers.end() && mem != active->memories.end()) {
+        BufferInfo& info = it->second;
+        info.memory = memory;
+        info.memoryOffset = memoryOffset;
+        // The buffer only becomes an object of the capture once its memory type is known.
+        Writer payload;
+        payload.u32(0);
+        payload.u64(info.size);
+        payload.u32(info.usage);
+        payload.u32(mem->second.properties);
+        info.id = active->addObject(handleKey(buffer), CaptureRecord::Buffer, std::move(payload.bytes));
+        active->ids.erase(handleKey(buffer)); // Buffers are looked up through `buffers`.
+    }
+    return result;
+}
+
+VkResult VKAPI_CALL GpuCapture::mapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+                                          VkMemoryMapFlags flags, void** ppData) {
+    VkResult result = active->original.vkMapMemory(device, memory, offset, size, flags, ppData);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        MemoryInfo& info = active->memories[handleKey(memory)];
+        info.mapOffset = offset;
+        info.mapped = static_cast<std::uint8_t*>(*ppData);
+    }
+    return result;
+}
+
+void VKAPI_CALL GpuCapture::unmapMemory(VkDevice device, VkDeviceMemory memory) {
+    {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        auto it = active->memories.find(handleKey(memory));
+        if (it != active->memories.end()) {
+            it->second.mapped = nullptr;
+        }
+    }
+    active->original.vkUnmapMemory(device, memory);
+}
+
+VkResult VKAPI_CALL GpuCapture::createShaderModule(VkDevice device, const VkShaderModuleCreateInfo* pCreateInfo,
+                                                   const VkAllocationCallbacks* pAllocator, VkShaderModule* pShaderModule) {
+    VkResult result = active->original.vkCreateShaderModule(device, pCreateInfo, pAllocator, pShaderModule);
+    if (result == VK_SUCCESS) {
+        Writer payload;
+        payload.u32(0);
+        payload.u32(static_cast<std::uint32_t>(pCreateInfo->codeSize));
+        payload.raw(pCreateInfo->pCode, pCreateInfo->codeSize);
+        std::lock_guard<std::mutex> lock(active->mutex);
+        active->addObject(handleKey(*pShaderModule), CaptureRecord::ShaderModule, std::move(payload.bytes));
+    }
+    return result;
+}
+
+VkResult VKAPI_CALL GpuCapture::createDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
+                                                          const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout) {
+    VkResult result = active->original.vkCreateDescriptorSetLayout(device, pCreateInfo, pAllocator, pSetLayout);
+    if (result == VK_SUCCESS) {
+        Writer payload;
+        payload.u32(0);
+        payload.u32(pCreateInfo->bindingCount);
+        for (std::uint32_t i = 0; i < pCreateInfo->bindingCount; i++) {
+            const VkDescriptorSetLayoutBinding& binding = pCreateInfo->pBindings[i];
+            payload.u32(binding.binding);
+            payload.u32(static_cast<std::uint32_t>(binding.descriptorType));
+            payload.u32(binding.descriptorCount);
+            payload.u32(binding.stageFlags);
+        }
+        std::lock_guard<std::mutex> lock(active->mutex);
+        active->addObject(handleKey(*pSetLayout), CaptureRecord::SetLayout, std::move(payload.bytes));
+    }
+    return result;
+}
+
+VkResult VKAPI_CALL GpuCapture::createPipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo,
+                                                     const VkAllocationCallbacks* pAllocator, VkPipelineLayout* pPipelineLayout) {
+    VkResult result = active->original.vkCreatePipelineLayout(device, pCreateInfo, pAllocator, pPipelineLayout);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        Writer payload;
+        payload.u32(0);
+        payload.u32(pCreateInfo->setLayoutCount);
+        for (std::uint32_t i = 0; i < pCreateInfo->setLayoutCount; i++) {
+            payload.u32(active->idOf(handleKey(pCreateInfo->pSetLayouts[i])));
+        }
+        payload.u32(pCreateInfo->pushConstantRangeCount);
+        for (std::uint32_t i = 0; i < pCreateInfo->pushConstantRangeCount; i++) {
+            payload.u32(pCreateInfo->pPushConstantRanges[i].stageFlags);
+            payload.u32(pCreateInfo->pPushConstantRanges[i].offset);
+            payload.u32(pCreateInfo->pPushConstantRanges[i].size);
+        }
+        active->addObject(handleKey(*pPipelineLayout), CaptureRecord::PipelineLayout, std::move(payload.bytes));
+    }
+    return result;
+}
+
+VkResult VKAPI_CALL GpuCapture::createComputePipelines(VkDevice device, VkPipelineCache pipelineCache, std::uint32_t createInfoCount,
+                                                       const VkComputePipelineCreateInfo* pCreateInfos,
+                                                       const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines) {
+    VkResult result = active->original.vkCreateComputePipelines(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        for (std::uint32_t i = 0; i < createInfoCount; i++) {
+            Writer payload;
+            payload.u32(0);
+            payload.u32(active->idOf(handleKey(pCreateInfos[i].layout)));
+            payload.u32(active->idOf(handleKey(pCreateInfos[i].stage.module)));
+            std::uint32_t nameLength = static_cast<std::uint32_t>(std::strlen(pCreateInfos[i].stage.pName));
+            payload.u32(nameLength);
+            payload.raw(pCreateInfos[i].stage.pName, nameLength);
+            active->addObject(handleKey(pPipelines[i]), CaptureRecord::ComputePipeline, std::move(payload.bytes));
+        }
+    }
+    return result;
+}
+
+VkResult VKAPI_CALL GpuCapture::allocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo* pAllocateInfo,
+                                                       VkDescriptorSet* pDescriptorSets) {
+    VkResult result = active->original.vkAllocateDescriptorSets(device, pAllocateInfo, pDescriptorSets);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        for (std::uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++) {
+            Writer payload;
+            payload.u32(0);
+            payload.u32(active->idOf(handleKey(pAllocateInfo->pSetLayouts[i])));
+            active->addObject(handleKey(pDescriptorSets[i]), CaptureRecord::DescriptorSet, std::move(payload.bytes));
+        }
+    }
+    return result;
+}
+
+void VKAPI_CALL GpuCapture::updateDescriptorSets(VkDevice device, std::uint32_t descriptorWriteCount, const VkWriteDescriptorSet* pDescriptorWrites,
+                                                 std::uint32_t descriptorCopyCount, const VkCopyDescriptorSet* pDescriptorCopies) {
+    active->original.vkUpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites, descriptorCopyCount, pDescriptorCopies);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    for (std::uint32_t i = 0; i < descriptorCopyCount; i++) {
+        active->imageSets.insert(active->idOf(handleKey(pDescriptorCopies[i].dstSet)));
+    }
+    for (std::uint32_t i = 0; i < descriptorWriteCount; i++) {
+        const VkWriteDescriptorSet& write = pDescriptorWrites[i];
+        std::uint32_t setId = active->idOf(handleKey(write.dstSet));
+        if (write.pBufferInfo == nullptr) {
+            active->imageSets.insert(setId); // Only buffer descriptors are captured.
+            continue;
+        }
+        for (std::uint32_t j = 0; j < write.descriptorCount; j++) {
+            const VkDescriptorBufferInfo& info = write.pBufferInfo[j];
+            Writer payload;
+            payload.u32(setId);
+            payload.u32(write.dstBinding);
+            payload.u32(write.dstArrayElement + j);
+            payload.u32(static_cast<std::uint32_t>(write.descriptorType));
+            payload.u32(active->bufferId(info.buffer));
+            payload.u64(info.offset);
+            payload.u64(info.range);
+            if (active->file.is_open()) {
+                active->writeRecord(CaptureRecord::DescriptorWrite, payload.bytes);
+            }
+            DescriptorBinding& binding = active->descriptors[std::make_pair(setId, write.dstBinding << 16 | (write.dstArrayElement + j))];
+            binding.buffer = info.buffer;
+            binding.record = std::move(payload.bytes);
+        }
+    }
+}
+
+VkResult VKAPI_CALL GpuCapture::allocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+                                                       VkCommandBuffer* pCommandBuffers) {
+    VkResult result = active->original.vkAllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+    if (result == VK_SUCCESS) {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        for (std::uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+            active->streams[handleKey(pCommandBuffers[i])].pool = pAllocateInfo->commandPool;
+        }
+    }
+    return result;
+}
+
+void VKAPI_CALL GpuCapture::freeCommandBuffers(VkDevice device, VkCommandPool commandPool, std::uint32_t commandBufferCount,
+                                               const VkCommandBuffer* pCommandBuffers) {
+    {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        for (std::uint32_t i = 0; i < commandBufferCount; i++) {
+            active->streams.erase(handleKey(pCommandBuffers[i]));
+        }
+    }
+    active->original.vkFreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+}
+
+void VKAPI_CALL GpuCapture::destroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks* pAllocator) {
+    {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        for (auto it = active->streams.begin(); it != active->streams.end();) {
+            it = it->second.pool == commandPool ? active->streams.erase(it) : std::next(it);
+        }
+    }
+    active->original.vkDestroyCommandPool(device, commandPool, pAllocator);
+}
+
+VkResult VKAPI_CALL GpuCapture::beginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* pBeginInfo) {
+    {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        CommandStream& stream = active->streams[handleKey(commandBuffer)];
+        VkCommandPool pool = stream.pool;
+        stream = CommandStream();
+        stream.pool = pool;
+        stream.oneTime = (pBeginInfo->flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != 0;
+    }
+    return active->original.vkBeginCommandBuffer(commandBuffer, pBeginInfo);
+}
+
+void VKAPI_CALL GpuCapture::cmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline) {
+    active->original.vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::BindPipeline));
+    command.u32(static_cast<std::uint32_t>(pipelineBindPoint));
+    command.u32(active->idOf(handleKey(pipeline)));
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+}
+
+void VKAPI_CALL GpuCapture::cmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout,
+                                                  std::uint32_t firstSet, std::uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets,
+                                                  std::uint32_t dynamicOffsetCount, const std::uint32_t* pDynamicOffsets) {
+    active->original.vkCmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount,
+                                             pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::BindDescriptorSets));
+    command.u32(static_cast<std::uint32_t>(pipelineBindPoint));
+    command.u32(active->idOf(handleKey(layout)));
+    command.u32(firstSet);
+    command.u32(descriptorSetCount);
+    for (std::uint32_t i = 0; i < descriptorSetCount; i++) {
+        command.u32(active->idOf(handleKey(pDescriptorSets[i])));
+        stream.sets.push_back(pDescriptorSets[i]);
+    }
+    command.u32(dynamicOffsetCount);
+    for (std::uint32_t i = 0; i < dynamicOffsetCount; i++) {
+        command.u32(pDynamicOffsets[i]);
+    }
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+}
+
+void VKAPI_CALL GpuCapture::cmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                                             std::uint32_t offset, std::uint32_t size, const void* pValues) {
+    active->original.vkCmdPushConstants(commandBuffer, layout, stageFlags, offset, size, pValues);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::PushConstants));
+    command.u32(active->idOf(handleKey(layout)));
+    command.u32(stageFlags);
+    command.u32(offset);
+    command.u32(size);
+    command.raw(pValues, size);
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+}
+
+void VKAPI_CALL GpuCapture::cmdDispatch(VkCommandBuffer commandBuffer, std::uint32_t groupCountX, std::uint32_t groupCountY, std::uint32_t groupCountZ) {
+    active->original.vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::Dispatch));
+    command.u32(groupCountX);
+    command.u32(groupCountY);
+    command.u32(groupCountZ);
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+}
+
+void VKAPI_CALL GpuCapture::cmdDispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) {
+    active->original.vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::DispatchIndirect));
+    command.u32(active->bufferId(buffer));
+    command.u64(offset);
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+    stream.buffers.push_back(buffer);
+}
+
+void VKAPI_CALL GpuCapture::cmdDrawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+                                            std::uint32_t drawCount, std::uint32_t stride) {
+    active->original.vkCmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+    markUnsupported(commandBuffer, "vkCmdDrawIndirect");
+}
+
+void VKAPI_CALL GpuCapture::cmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer,
+                                          std::uint32_t regionCount, const VkBufferCopy* pRegions) {
+    active->original.vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::CopyBuffer));
+    command.u32(active->bufferId(srcBuffer));
+    command.u32(active->bufferId(dstBuffer));
+    command.u32(regionCount);
+    for (std::uint32_t i = 0; i < regionCount; i++) {
+        command.u64(pRegions[i].srcOffset);
+        command.u64(pRegions[i].dstOffset);
+        command.u64(pRegions[i].size);
+    }
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+    stream.buffers.push_back(srcBuffer);
+}
+
+void VKAPI_CALL GpuCapture::cmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage,
+                                                 VkImageLayout dstImageLayout, std::uint32_t regionCount, const VkBufferImageCopy* pRegions) {
+    active->original.vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
+    markUnsupported(commandBuffer, "vkCmdCopyBufferToImage");
+}
+
+void VKAPI_CALL GpuCapture::cmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout,
+                                                 VkBuffer dstBuffer, std::uint32_t regionCount, const VkBufferImageCopy* pRegions) {
+    active->original.vkCmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount, pRegions);
+    markUnsupported(commandBuffer, "vkCmdCopyImageToBuffer");
+}
+
+void VKAPI_CALL GpuCapture::cmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset,
+                                          VkDeviceSize size, std::uint32_t data) {
+    active->original.vkCmdFillBuffer(commandBuffer, dstBuffer, dstOffset, size, data);
+    std::lock_guard<std::mutex> lock(active->mutex);
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::FillBuffer));
+    command.u32(active->bufferId(dstBuffer));
+    command.u64(dstOffset);
+    command.u64(size);
+    command.u32(data);
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+}
+
+void VKAPI_CALL GpuCapture::cmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+                                               VkDependencyFlags dependencyFlags, std::uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers,
+                                               std::uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+                                               std::uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers) {
+    active->original.vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, pMemoryBarriers,
+                                          bufferMemoryBarrierCount, pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
+    if (imageMemoryBarrierCount > 0) {
+        markUnsupported(commandBuffer, "image memory barriers");
+    }
+    for (std::uint32_t i = 0; i < bufferMemoryBarrierCount; i++) {
+        const VkBufferMemoryBarrier& barrier = pBufferMemoryBarriers[i];
+        if ((barrier.srcQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED && active->queueNumber(barrier.srcQueueFamilyIndex) == CAPTURE_NO_QUEUE) ||
+            (barrier.dstQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED && active->queueNumber(barrier.dstQueueFamilyIndex) == CAPTURE_NO_QUEUE)) {
+            markUnsupported(commandBuffer, "ownership transfers to other queue families");
+        }
+    }
+    std::lock_guard<std::mutex> lock(active->mutex);
+    Writer command;
+    command.u32(static_cast<std::uint32_t>(CaptureCommand::PipelineBarrier));
+    command.u32(srcStageMask);
+    command.u32(dstStageMask);
+    command.u32(dependencyFlags);
+    command.u32(memoryBarrierCount);
+    for (std::uint32_t i = 0; i < memoryBarrierCount; i++) {
+        command.u32(pMemoryBarriers[i].srcAccessMask);
+        command.u32(pMemoryBarriers[i].dstAccessMask);
+    }
+    command.u32(bufferMemoryBarrierCount);
+    for (std::uint32_t i = 0; i < bufferMemoryBarrierCount; i++) {
+        command.u32(pBufferMemoryBarriers[i].srcAccessMask);
+        command.u32(pBufferMemoryBarriers[i].dstAccessMask);
+        command.u32(active->queueNumber(pBufferMemoryBarriers[i].srcQueueFamilyIndex));
+        command.u32(active->queueNumber(pBufferMemoryBarriers[i].dstQueueFamilyIndex));
+        command.u32(active->bufferId(pBufferMemoryBarriers[i].buffer));
+        command.u64(pBufferMemoryBarriers[i].offset);
+        command.u64(pBufferMemoryBarriers[i].size);
+    }
+    auto& stream = active->streams[handleKey(commandBuffer)];
+    stream.bytes.insert(stream.bytes.end(), command.bytes.begin(), command.bytes.end());
+}
+
+void VKAPI_CALL GpuCapture::cmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* pRenderPassBegin,
+                                               VkSubpassContents contents) {
+    active->original.vkCmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+    markUnsupported(commandBuffer, "vkCmdBeginRenderPass");
+}
+
+void VKAPI_CALL GpuCapture::cmdBeginRenderingKHR(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR* pRenderingInfo) {
+    active->original.vkCmdBeginRenderingKHR(commandBuffer, pRenderingInfo);
+    markUnsupported(commandBuffer, "vkCmdBeginRenderingKHR");
+}
+
+VkResult VKAPI_CALL GpuCapture::queueSubmit(VkQueue queue, std::uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+    {
+        std::lock_guard<std::mutex> lock(active->mutex);
+        if (active->file.is_open()) {
+            // Checked before anything of this submit is written, so a capture never holds half of it.
+            std::uint32_t queueIndex = 0;
+            while (queueIndex < 3 && active->queues[queueIndex] != queue) {
+                queueIndex++;
+            }
+            if (queueIndex == 3) {
+                active->abortCapture("a queue the capture doesn't know");
+            }
+            for (std::uint32_t i = 0; i < submitCount; i++) {
+                for (std::uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) {
+                    std::string reason = active->unsupportedWork(active->streams[handleKey(pSubmits[i].pCommandBuffers[j])]);
+                    if (!reason.empty()) {
+                        active->abortCapture(reason);
+                    }
+                }
+            }
+            for (std::uint32_t i = 0; i < submitCount; i++) {
+                // Uploads first: the host writes happened before the submit.
+                std::vector<VkBuffer> referenced;
+                for (std::uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) {
+                    const CommandStream& stream = active->streams[handleKey(pSubmits[i].pCommandBuffers[j])];
+                    referenced.insert(referenced.end(), stream.buffers.begin(), stream.buffers.end());
+                    for (VkDescriptorSet set : stream.sets) {
+                        std::uint32_t setId = active->idOf(handleKey(set));
+                        for (auto it = active->descriptors.lower_bound(std::make_pair(setId, 0u));
+                             it != active->descriptors.end() && it->first.first == setId; ++it) {
+                            referenced.push_back(it->second.buffer);
+                        }
+                    }
+                }
+                active->uploadChanged(referenced);
+
+                Writer payload;
+                payload.u32(queueIndex);
+                payload.u32(pSubmits[i].commandBufferCount);
+                for (std::uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) {
+                    const CommandStream& stream = active->streams[handleKey(pSubmits[i].pCommandBuffers[j])];
+                    payload.u32(static_cast<std::uint32_t>(stream.bytes.size()));
+                    payload.raw(stream.bytes.data(), stream.bytes.size());
+                }
+                active->writeRecord(CaptureRecord::Submit, payload.bytes);
+            }
+        }
+        // A one-time stream can't be submitted again, so its commands can go now. The entry itself
+        // goes with the command buffer.
+        for (std::uint32_t i = 0; i < submitCount; i++) {
+            for (std::uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) {
+                auto it = active->streams.find(handleKey(pSubmits[i].pCommandBuffers[j]));
+                if (it != active->streams.end() && it->second.oneTime) {
+                    it->second.bytes = std::vector<std::uint8_t>();
+                    it->second.buffers = std::vector<VkBuffer>();
+                    it->second.sets = std::vector<VkDescriptorSet>();
+                }
+            }
+        }
+    }
+    return active->original.vkQueueSubmit(queue, submitCount, pSubmits, fence);
+}
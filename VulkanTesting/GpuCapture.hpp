@@ -0,0 +1,179 @@
+#ifndef GpuCapture_hpp
+#define GpuCapture_hpp
+
+#include "VulkanDispatch.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class VulkanContext;
+
+// Capture file (.vtcap) layout. Everything is little endian. After the 8-byte header the file is a
+// sequence of records: uint32 type, uint32 payload size, payload. Objects are referred to by ids
+// assigned in creation order, so creation records always precede their users.
+const std::uint32_t CAPTURE_MAGIC = 0x50435456; // "VTCP"
+const std::uint32_t CAPTURE_VERSION = 3;
+// Queue family fields hold a Submit queue number, or this for VK_QUEUE_FAMILY_IGNORED.
+const std::uint32_t CAPTURE_NO_QUEUE = 0xFFFFFFFF;
+
+enum class CaptureRecord : std::uint32_t {
+    Buffer = 1,      // id, size:u64, usage, memory properties
+    ShaderModule,    // id, byte count, SPIR-V
+    SetLayout,       // id, binding count, {binding, type, count, stages}
+    PipelineLayout,  // id, set layout count, ids, push range count, {stages, offset, size}
+    ComputePipeline, // id, layout, module, entry point length, entry point
+    DescriptorSet,   // id, layout
+    DescriptorWrite, // set, binding, array element, type, buffer, offset:u64, range:u64
+    Upload,          // buffer, offset:u64, size:u64, bytes
+    Submit,          // queue (0 graphics, 1 compute, 2 transfer), command buffer count, {byte count, commands}
+    FrameEnd,
+};
+
+// Commands inside a Submit record: uint32 opcode followed by its arguments.
+enum class CaptureCommand : std::uint32_t {
+    BindPipeline = 1,   // bind point, pipeline
+    BindDescriptorSets, // bind point, layout, first set, count, set ids, dynamic offset count, offsets
+    PushConstants,      // layout, stages, offset, size, bytes
+    Dispatch,           // x, y, z
+    CopyBuffer,         // src, dst, region count, {srcOffset:u64, dstOffset:u64, size:u64}
+    FillBuffer,         // dst, offset:u64, size:u64, data
+    PipelineBarrier,    // src stages, dst stages, dependency flags, memory barrier count,
+                        // {src access, dst access}, buffer barrier count,
+                        // {src access, dst access, src queue, dst queue, buffer, offset:u64, size:u64}
+    DispatchIndirect,   // buffer, offset:u64
+};
+
+// Records the compute/transfer work the app submits for a range of frames into a .vtcap file that
+// GpuReplay re-executes headless, so a real frame can be benchmarked and bisected without the app.
+//
+// Works by swapping entries of the vkd dispatch table, so only code that calls through vkd is seen.
+// Object creation is tracked from construction on (metadata only) and written out when the frame
+// range starts, so create the capture before the resources it should cover. Host-visible buffers
+// referenced by a submit are hashed and written as uploads when their contents changed; device-local
+// buffers are not read back and start out zeroed on replay.
+//
+// Only compute and transfer work on buffers is recorded. A captured submit that touches an image
+// (copies, image barriers, image descriptors), begins a render pass, or goes to or transfers
+// ownership to a queue family other than the context's graphics, compute and transfer ones aborts
+// the capture: the file is deleted and the submit throws, instead of leaving a capture that replays
+// different work.
+class GpuCapture {
+public:
+    // Captures frames [firstFrame, firstFrame + frameCount). Frames are delimited by frameBoundary().
+    GpuCapture(const VulkanContext& context, const std::string& path, std::uint32_t firstFrame, std::uint32_t frameCount);
+    ~GpuCapture();
+
+    GpuCapture(const GpuCapture&) = delete;
+    GpuCapture& operator=(const GpuCapture&) = delete;
+
+    // Call once at the end of every frame.
+    void frameBoundary();
+    bool capturing() const { return file.is_open(); }
+    bool finished() const { return done; }
+
+private:
+    struct MemoryInfo {
+        VkMemoryPropertyFlags properties = 0;
+        VkDeviceSize mapOffset = 0;
+        std::uint8_t* mapped = nullptr;
+    };
+    struct BufferInfo {
+        std::uint32_t id = 0;
+        VkDeviceSize size = 0;
+        VkBufferUsageFlags usage = 0;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize memoryOffset = 0;
+        std::uint64_t uploadedHash = 0; // Contents as of the last Upload record, 0 = never uploaded.
+    };
+    struct CommandStream {
+        std::vector<std::uint8_t> bytes;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDescriptorSet> sets;
+        VkCommandPool pool = VK_NULL_HANDLE;
+        bool oneTime = false;              // ONE_TIME_SUBMIT: commands dropped once submitted.
+        const char* unsupported = nullptr; // First command the capture can't record.
+    };
+    struct DescriptorBinding {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        std::vector<std::uint8_t> record; // Serialized DescriptorWrite, replayed at capture start.
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkQueue queues[3]; // Indexed by the Submit record's queue number.
+    std::uint32_t families[3]; // Their families.
+    std::string path;
+    std::uint32_t firstFrame;
+    std::uint32_t frameCount;
+    std::uint32_t frame = 0;
+    bool done = false;
+    std::ofstream file;
+
+    VulkanDispatch original; // vkd as it was before the hooks went in.
+    std::mutex mutex;
+    std::uint32_t nextId = 1;
+    std::map<std::uint32_t, std::vector<std::uint8_t>> objectRecords; // By id, so in creation order.
+    std::unordered_map<std::uint64_t, std::uint32_t> ids; // Non-buffer handle -> id.
+    std::unordered_map<std::uint64_t, BufferInfo> buffers;
+    std::unordered_map<std::uint64_t, MemoryInfo> memories;
+    std::unordered_map<std::uint64_t, CommandStream> streams;
+    std::map<std::pair<std::uint32_t, std::uint32_t>, DescriptorBinding> descriptors; // (set id, binding << 16 | element)
+    std::unordered_set<std::uint32_t> imageSets; // Set ids with image, texel or copied descriptors.
+
+    void start();
+    void finish();
+    void writeRecord(CaptureRecord type, const std::vector<std::uint8_t>& payload);
+    std::uint32_t addObject(std::uint64_t handle, CaptureRecord type, std::vector<std::uint8_t> payload);
+    std::uint32_t idOf(std::uint64_t handle) const;
+    std::uint32_t bufferId(VkBuffer buffer) const;
+    void uploadChanged(const std::vector<VkBuffer>& referenced);
+    std::string unsupportedWork(const CommandStream& stream) const;
+    void abortCapture(const std::string& reason);
+    static void markUnsupported(VkCommandBuffer commandBuffer, const char* command);
+    std::uint32_t queueNumber(std::uint32_t family) const;
+
+    // Hooks installed into vkd. They forward to `original` and record through the active capture.
+    static GpuCapture* active;
+    static VkResult VKAPI_CALL createBuffer(VkDevice, const VkBufferCreateInfo*, const VkAllocationCallbacks*, VkBuffer*);
+    static void VKAPI_CALL destroyBuffer(VkDevice, VkBuffer, const VkAllocationCallbacks*);
+    static VkResult VKAPI_CALL allocateMemory(VkDevice, const VkMemoryAllocateInfo*, const VkAllocationCallbacks*, VkDeviceMemory*);
+    static void VKAPI_CALL freeMemory(VkDevice, VkDeviceMemory, const VkAllocationCallbacks*);
+    static VkResult VKAPI_CALL bindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize);
+    static VkResult VKAPI_CALL mapMemory(VkDevice, VkDeviceMemory, VkDeviceSize, VkDeviceSize, VkMemoryMapFlags, void**);
+    static void VKAPI_CALL unmapMemory(VkDevice, VkDeviceMemory);
+    static VkResult VKAPI_CALL createShaderModule(VkDevice, const VkShaderModuleCreateInfo*, const VkAllocationCallbacks*, VkShaderModule*);
+    static VkResult VKAPI_CALL createDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo*, const VkAllocationCallbacks*, VkDescriptorSetLayout*);
+    static VkResult VKAPI_CALL createPipelineLayout(VkDevice, const VkPipelineLayoutCreateInfo*, const VkAllocationCallbacks*, VkPipelineLayout*);
+    static VkResult VKAPI_CALL createComputePipelines(VkDevice, VkPipelineCache, std::uint32_t, const VkComputePipelineCreateInfo*, const VkAllocationCallbacks*, VkPipeline*);
+    static VkResult VKAPI_CALL allocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo*, VkDescriptorSet*);
+    static void VKAPI_CALL updateDescriptorSets(VkDevice, std::uint32_t, const VkWriteDescriptorSet*, std::uint32_t, const VkCopyDescriptorSet*);
+    static VkResult VKAPI_CALL allocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo*, VkCommandBuffer*);
+    static void VKAPI_CALL freeCommandBuffers(VkDevice, VkCommandPool, std::uint32_t, const VkCommandBuffer*);
+    static void VKAPI_CALL destroyCommandPool(VkDevice, VkCommandPool, const VkAllocationCallbacks*);
+    static VkResult VKAPI_CALL beginCommandBuffer(VkCommandBuffer, const VkCommandBufferBeginInfo*);
+    static void VKAPI_CALL cmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline);
+    static void VKAPI_CALL cmdBindDescriptorSets(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, std::uint32_t, std::uint32_t, const VkDescriptorSet*, std::uint32_t, const std::uint32_t*);
+    static void VKAPI_CALL cmdPushConstants(VkCommandBuffer, VkPipelineLayout, VkShaderStageFlags, std::uint32_t, std::uint32_t, const void*);
+    static void VKAPI_CALL cmdDispatch(VkCommandBuffer, std::uint32_t, std::uint32_t, std::uint32_t);
+    static void VKAPI_CALL cmdDispatchIndirect(VkCommandBuffer, VkBuffer, VkDeviceSize);
+    static void VKAPI_CALL cmdDrawIndirect(VkCommandBuffer, VkBuffer, VkDeviceSize, std::uint32_t, std::uint32_t);
+    static void VKAPI_CALL cmdCopyBuffer(VkCommandBuffer, VkBuffer, VkBuffer, std::uint32_t, const VkBufferCopy*);
+    static void VKAPI_CALL cmdCopyBufferToImage(VkCommandBuffer, VkBuffer, VkImage, VkImageLayout, std::uint32_t, const VkBufferImageCopy*);
+    static void VKAPI_CALL cmdCopyImageToBuffer(VkCommandBuffer, VkImage, VkImageLayout, VkBuffer, std::uint32_t, const VkBufferImageCopy*);
+    static void VKAPI_CALL cmdFillBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkDeviceSize, std::uint32_t);
+    static void VKAPI_CALL cmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags,
+                                              std::uint32_t, const VkMemoryBarrier*, std::uint32_t, const VkBufferMemoryBarrier*,
+                                              std::uint32_t, const VkImageMemoryBarrier*);
+    static void VKAPI_CALL cmdBeginRenderPass(VkCommandBuffer, const VkRenderPassBeginInfo*, VkSubpassContents);
+    static void VKAPI_CALL cmdBeginRenderingKHR(VkCommandBuffer, const VkRenderingInfoKHR*);
+    static VkResult VKAPI_CALL queueSubmit(VkQueue, std::uint32_t, const VkSubmitInfo*, VkFence);
+};
+
+#endif /* GpuCapture_hpp */
@@ -0,0 +1,318 @@
+#include "GpuDecompressor.hpp"
+#include "AssetPack.hpp"
+#include "Glz.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+GpuDecompressor::GpuDecompressor(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t queueFamily, VkQueue queue,
+                                 std::uint32_t dstFamily, const std::string& shaderPath)
+    : physicalDevice(physicalDevice), device(device), queueFamily(queueFamily), dstFamily(dstFamily), queue(queue) {
+    VT_ZONE("create GLZ pipeline");
+    shaderModule = createShaderModule(device, shaderPath);
+
+    // src, chunk table, dst.
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    for (std::uint32_t i = 0; i < 3; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create GLZ descriptor set layout!");
+    }
+
+    VkPushConstantRange pushRange = {};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.size = sizeof(std::uint32_t);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create GLZ pipeline layout!");
+    }
+
+    pipeline = createComputePipeline(device, shaderModule, pipelineLayout);
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create GLZ command pool!");
+    }
+    VkCommandBufferAllocateInfo commandBufferInfo = {};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    vkd.vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+    // Timestamps are optional per queue family.
+    auto families = std::vector<VkQueueFamilyProperties>();
+    std::uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    families.resize(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    std::uint32_t validBits = families[queueFamily].timestampValidBits;
+    if (validBits > 0) {
+        timestampMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+    }
+
+    setObjectName(device, shaderModule, "glz_decompress.comp");
+    setObjectName(device, setLayout, "GLZ set layout");
+    setObjectName(device, pipelineLayout, "GLZ pipeline layout");
+    setObjectName(device, pipeline, "GLZ decompress");
+    setObjectName(device, commandPool, "GLZ command pool");
+    setObjectName(device, commandBuffer, "GLZ commands");
+    setObjectName(device, fence, "GLZ fence");
+    setObjectName(device, queryPool, "GLZ timestamps");
+}
+
+GpuDecompressor::~GpuDecompressor() {
+    if (staging.buffer != VK_NULL_HANDLE) destroyBuffer(device, staging);
+    if (chunkTable.buffer != VK_NULL_HANDLE) destroyBuffer(device, chunkTable);
+    if (queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, queryPool, nullptr);
+    vkDestroyFence(device, fence, nullptr);
+    vkd.vkDestroyCommandPool(device, commandPool, nullptr);
+    for (VkDescriptorPool pool : descriptorPools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+void GpuDecompressor::record(VkCommandBuffer commandBuffer, VkBuffer src, VkBuffer chunkTable, VkBuffer dst, std::uint32_t chunkCount) {
+    CommandLabel label(commandBuffer, "GLZ decode");
+    VkDescriptorSet set = allocateSet(src, chunkTable, dst);
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+    vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(chunkCount), &chunkCount);
+    vkd.vkCmdDispatch(commandBuffer, chunkCount, 1, 1);
+
+    if (dstFamily != queueFamily) {
+        // Release dst to dstFamily; acquire() there makes the writes visible.
+        VkBufferMemoryBarrier release = {};
+        release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        release.dstAccessMask = 0;
+        release.srcQueueFamilyIndex = queueFamily;
+        release.dstQueueFamilyIndex = dstFamily;
+        release.buffer = dst;
+        release.offset = 0;
+        release.size = VK_WHOLE_SIZE;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 1, &release, 0, nullptr);
+        return;
+    }
+    // Make the decoded data visible to whatever reads it next.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuDecompressor::acquire(VkCommandBuffer commandBuffer, VkBuffer dst, VkPipelineStageFlags dstStages,
+                              VkAccessFlags dstAccess) {
+    if (dstFamily == queueFamily) {
+        return;
+    }
+    VkBufferMemoryBarrier acquire = {};
+    acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    acquire.srcAccessMask = 0;
+    acquire.dstAccessMask = dstAccess;
+    acquire.srcQueueFamilyIndex = queueFamily;
+    acquire.dstQueueFamilyIndex = dstFamily;
+    acquire.buffer = dst;
+    acquire.offset = 0;
+    acquire.size = VK_WHOLE_SIZE;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0, 0, nullptr, 1, &acquire, 0, nullptr);
+}
+
+void GpuDecompressor::reset() {
+    for (VkDescriptorPool pool : descriptorPools) {
+        vkResetDescriptorPool(device, pool, 0);
+    }
+    currentPool = 0;
+}
+
+VkDescriptorSet GpuDecompressor::allocateSet(VkBuffer src, VkBuffer chunkTable, VkBuffer dst) {
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    for (;;) {
+        bool fresh = currentPool == descriptorPools.size();
+        if (fresh) {
+            VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * 64};
+            VkDescriptorPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.maxSets = 64;
+            poolInfo.poolSizeCount = 1;
+            poolInfo.pPoolSizes = &poolSize;
+            VkDescriptorPool pool;
+            if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create GLZ descriptor pool!");
+            }
+            setObjectName(device, pool, "GLZ descriptor pool");
+            descriptorPools.push_back(pool);
+        }
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPools[currentPool];
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &setLayout;
+        if (vkd.vkAllocateDescriptorSets(device, &setInfo, &set) == VK_SUCCESS) {
+            break;
+        }
+        // A full pool moves on to the next one; a fresh pool can't be full.
+        if (fresh) {
+            throw std::runtime_error("failed to allocate GLZ descriptor set!");
+        }
+        currentPool++;
+    }
+
+    VkDescriptorBufferInfo bufferInfos[3] = {
+        {src, 0, VK_WHOLE_SIZE},
+        {chunkTable, 0, VK_WHOLE_SIZE},
+        {dst, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet writes[3] = {};
+    for (std::uint32_t i = 0; i < 3; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkd.vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+    return set;
+}
+
+void GpuDecompressor::ensureCapacity(Buffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, const char* name) {
+    if (buffer.buffer != VK_NULL_HANDLE && buffer.size >= size) {
+        return;
+    }
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        destroyBuffer(device, buffer);
+    }
+    buffer = createBuffer(physicalDevice, device, size, usage,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, name);
+}
+
+double GpuDecompressor::decompress(const std::uint8_t* compressed, std::size_t compressedSize,
+                                   const std::vector<GlzChunkRef>& chunks, VkBuffer dst) {
+    VT_ZONE("GPU decompress");
+    // The shader bounds its reads by each chunk's stream table; check those tables here so that
+    // malformed input fails loudly instead of decoding to garbage.
+    for (std::size_t i = 0; i < chunks.size(); i++) {
+        const GlzChunkRef& chunk = chunks[i];
+        if (chunk.srcOffset % 4 != 0 || chunk.dstOffset % 4 != 0 ||
+            std::uint64_t(chunk.srcOffset) + chunk.compressedSize > compressedSize ||
+            !glzCheckHeader(compressed + chunk.srcOffset, chunk.compressedSize, chunk.size)) {
+            throw std::runtime_error("GpuDecompressor: chunk " + std::to_string(i) + " is malformed.");
+        }
+    }
+    ensureCapacity(staging, (compressedSize + 3) & ~std::size_t(3), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "GLZ staging");
+    ensureCapacity(chunkTable, chunks.size() * sizeof(GlzChunkRef), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "GLZ chunk table");
+    std::memcpy(staging.mapped, compressed, compressedSize);
+    std::memcpy(chunkTable.mapped, chunks.data(), chunks.size() * sizeof(GlzChunkRef));
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+        vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+    record(commandBuffer, staging.buffer, chunkTable.buffer, dst, static_cast<std::uint32_t>(chunks.size()));
+    if (queryPool != VK_NULL_HANDLE) {
+        vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+    }
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit GLZ decode!");
+    }
+    std::uint64_t submitted = Profiler::now();
+    {
+        VT_ZONE("wait for decode");
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+    std::uint64_t signaled = Profiler::now();
+    vkResetFences(device, 1, &fence);
+    reset();
+
+    if (queryPool == VK_NULL_HANDLE) {
+        return 0;
+    }
+    std::uint64_t ticks[2];
+    vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(ticks), ticks, sizeof(std::uint64_t),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    // Only the low timestampValidBits count; the difference wraps within them.
+    double gpuNs = ((ticks[1] - ticks[0]) & timestampMask) * timestampPeriod;
+    if (Profiler::enabled()) {
+        // GPU ticks are on their own clock. Without calibrated timestamps, anchor the decode so that
+        // it ends when the fence was seen signaled, and never starts before the submit.
+        static const ZoneSource source = {"GLZ decode", __func__, __FILE__, __LINE__};
+        std::uint64_t duration = static_cast<std::uint64_t>(gpuNs);
+        std::uint64_t begin = signaled - submitted > duration ? signaled - duration : submitted;
+        Profiler::gpuZone(&source, "compute", begin, begin + duration);
+    }
+    return gpuNs / 1e6;
+}
+
+double GpuDecompressor::decompress(const AssetPack& pack, const PackEntry& entry, VkBuffer dst) {
+    if (entry.codec != PackCodec::GLZ) {
+        throw std::runtime_error("GpuDecompressor: asset is not GLZ encoded.");
+    }
+    if (entry.chunkCount == 0) {
+        return 0;
+    }
+    // An asset's chunks are contiguous in the pack, so the whole span uploads in one copy.
+    std::uint64_t spanBegin = pack.chunk(entry.firstChunk).offset;
+    std::uint64_t spanEnd = spanBegin;
+    std::vector<GlzChunkRef> refs(entry.chunkCount);
+    for (std::uint32_t i = 0; i < entry.chunkCount; i++) {
+        const PackChunk& chunk = pack.chunk(entry.firstChunk + i);
+        if (chunk.offset != spanEnd || spanEnd - spanBegin + chunk.compressedSize > UINT32_MAX) {
+            throw std::runtime_error("GpuDecompressor: asset chunks are not one contiguous span.");
+        }
+        refs[i] = {static_cast<std::uint32_t>(chunk.offset - spanBegin), i * PACK_CHUNK_SIZE, chunk.uncompressedSize,
+                   chunk.compressedSize};
+        spanEnd = chunk.offset + chunk.compressedSize;
+    }
+    return decompress(pack.data(spanBegin), static_cast<std::size_t>(spanEnd - spanBegin), refs, dst);
+}
@@ -0,0 +1,86 @@
+#ifndef GpuDecompressor_hpp
+#define GpuDecompressor_hpp
+
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class AssetPack;
+struct PackEntry;
+
+// Mirrors ChunkRef in shaders/glz_decompress.comp.
+struct GlzChunkRef {
+    std::uint32_t srcOffset;
+    std::uint32_t dstOffset;
+    std::uint32_t size;
+    std::uint32_t compressedSize;
+};
+
+// Decodes GLZ chunks with a compute shader, so compressed bytes are what crosses the bus and the
+// CPU never touches the decoded data. Meant to run on the dedicated compute queue when there is one.
+//
+// The decoded data is used on dstFamily, usually graphics. When that is another family than the
+// decode's, dst buffers (created EXCLUSIVE) change owner: record() ends by releasing dst to
+// dstFamily, and acquire() takes it there. The acquire has to be submitted after the decode: behind
+// a semaphore the decode signals, or after decompress() returned. On one family record() leaves a
+// plain barrier and acquire() records nothing. A decode overwrites all of dst, so it never takes dst
+// back from dstFamily first.
+class GpuDecompressor {
+public:
+    GpuDecompressor(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t queueFamily, VkQueue queue,
+                    std::uint32_t dstFamily, const std::string& shaderPath);
+    ~GpuDecompressor();
+
+    GpuDecompressor(const GpuDecompressor&) = delete;
+    GpuDecompressor& operator=(const GpuDecompressor&) = delete;
+
+    // Records the decode of chunkCount chunks into an existing command buffer on queueFamily. Buffers
+    // must stay alive until it executes. Each call allocates a descriptor set; reset() frees them all
+    // once the recorded work has finished.
+    void record(VkCommandBuffer commandBuffer, VkBuffer src, VkBuffer chunkTable, VkBuffer dst, std::uint32_t chunkCount);
+    // Command buffer on dstFamily, before the first use of dst at dstStages with dstAccess.
+    void acquire(VkCommandBuffer commandBuffer, VkBuffer dst, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+    // Frees the descriptor sets of everything recorded so far.
+    void reset();
+
+    // Uploads compressed bytes, decodes into dst (usually device local) and waits; resets like reset().
+    // dst still needs acquire() on dstFamily.
+    // Returns the GPU time of the decode in milliseconds, or 0 when the queue has no timestamps.
+    double decompress(const std::uint8_t* compressed, std::size_t compressedSize,
+                      const std::vector<GlzChunkRef>& chunks, VkBuffer dst);
+    // Same, for a GLZ asset from a pack. dst must hold entry.uncompressedSize rounded up to 4 bytes.
+    double decompress(const AssetPack& pack, const PackEntry& entry, VkBuffer dst);
+
+private:
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    std::uint32_t queueFamily;
+    std::uint32_t dstFamily;
+    VkQueue queue;
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> descriptorPools;
+    std::size_t currentPool = 0;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE; // Null when the queue family has no timestamps.
+    double timestampPeriod = 0; // Nanoseconds per tick.
+    std::uint64_t timestampMask = 0; // The queue family's timestampValidBits.
+
+    // Reused across calls, grown on demand.
+    Buffer staging;
+    Buffer chunkTable;
+
+    VkDescriptorSet allocateSet(VkBuffer src, VkBuffer chunkTable, VkBuffer dst);
+    void ensureCapacity(Buffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, const char* name);
+};
+
+#endif /* GpuDecompressor_hpp */
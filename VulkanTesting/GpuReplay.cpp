@@ -0,0 +1,519 @@
+#include "GpuReplay.hpp"
+#include "VulkanContext.hpp"
+#include "VulkanDebug.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+
+namespace {
+    struct Reader {
+        const std::uint8_t* p;
+        const std::uint8_t* end;
+
+        std::uint32_t u32() { std::uint32_t v; raw(&v, sizeof(v)); return v; }
+        std::uint64_t u64() { std::uint64_t v; raw(&v, sizeof(v)); return v; }
+        void raw(void* dst, std::size_t size) {
+            if (static_cast<std::size_t>(end - p) < size) {
+                throw std::runtime_error("capture file is truncated");
+            }
+            std::memcpy(dst, p, size);
+            p += size;
+        }
+        const std::uint8_t* skip(std::size_t size) {
+            if (static_cast<std::size_t>(end - p) < size) {
+                throw std::runtime_error("capture file is truncated");
+            }
+            const std::uint8_t* at = p;
+            p += size;
+            return at;
+        }
+    };
+
+    bool isObjectRecord(CaptureRecord type) {
+        return type == CaptureRecord::Buffer || type == CaptureRecord::ShaderModule || type == CaptureRecord::SetLayout ||
+               type == CaptureRecord::PipelineLayout || type == CaptureRecord::ComputePipeline || type == CaptureRecord::DescriptorSet;
+    }
+}
+
+GpuReplay::GpuReplay(const VulkanContext& context, const std::string& path)
+    : physicalDevice(context.physicalDevice()), device(context.device()),
+      queues{context.graphicsQueue(), context.computeQueue(), context.transferQueue()},
+      families{context.queueFamilies().graphicsFamily, context.queueFamilies().computeFamily,
+               context.queueFamilies().transferFamily} {
+    load(path);
+
+    for (int i = 0; i < 3; i++) {
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = families[i];
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPools[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay command pool!");
+        }
+    }
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create replay fence!");
+    }
+    setObjectName(device, commandPools[0], "replay graphics commands");
+    setObjectName(device, commandPools[1], "replay compute commands");
+    setObjectName(device, commandPools[2], "replay transfer commands");
+    setObjectName(device, fence, "replay fence");
+    setObjectName(device, descriptorPool, "replay descriptor pool");
+}
+
+GpuReplay::~GpuReplay() {
+    vkDeviceWaitIdle(device);
+    vkDestroyFence(device, fence, nullptr);
+    for (VkCommandPool pool : commandPools) {
+        vkDestroyCommandPool(device, pool, nullptr);
+    }
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    for (Object& o : objects) {
+        if (o.buffer.buffer != VK_NULL_HANDLE) destroyBuffer(device, o.buffer);
+        if (o.pipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, o.pipeline, nullptr);
+        if (o.pipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(device, o.pipelineLayout, nullptr);
+        if (o.setLayout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device, o.setLayout, nullptr);
+        if (o.shaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, o.shaderModule, nullptr);
+    }
+}
+
+void GpuReplay::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    std::vector<std::uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader reader{bytes.data(), bytes.data() + bytes.size()};
+    if (reader.u32() != CAPTURE_MAGIC) {
+        throw std::runtime_error(path + " is not a capture file");
+    }
+    if (reader.u32() != CAPTURE_VERSION) {
+        throw std::runtime_error(path + ": unsupported capture version");
+    }
+    while (reader.p != reader.end) {
+        Event event;
+        event.type = static_cast<CaptureRecord>(reader.u32());
+        std::uint32_t size = reader.u32();
+        const std::uint8_t* payload = reader.skip(size);
+        event.payload.assign(payload, payload + size);
+        events.push_back(std::move(event));
+    }
+
+    // Pool sizes: every descriptor of every set's layout.
+    std::map<std::uint32_t, std::map<VkDescriptorType, std::uint32_t>> layoutCounts;
+    std::map<VkDescriptorType, std::uint32_t> poolCounts;
+    std::uint32_t setCount = 0;
+    for (const Event& event : events) {
+        Reader r{event.payload.data(), event.payload.data() + event.payload.size()};
+        if (event.type == CaptureRecord::SetLayout) {
+            std::uint32_t id = r.u32();
+            std::uint32_t bindingCount = r.u32();
+            for (std::uint32_t i = 0; i < bindingCount; i++) {
+                r.u32();
+                auto type = static_cast<VkDescriptorType>(r.u32());
+                layoutCounts[id][type] += r.u32();
+                r.u32();
+            }
+        } else if (event.type == CaptureRecord::DescriptorSet) {
+            r.u32();
+            for (const auto& count : layoutCounts[r.u32()]) {
+                poolCounts[count.first] += count.second;
+            }
+            setCount++;
+        } else if (event.type == CaptureRecord::Submit) {
+            submits++;
+        } else if (event.type == CaptureRecord::FrameEnd) {
+            frames++;
+        }
+    }
+    if (setCount > 0) {
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (const auto& count : poolCounts) {
+            poolSizes.push_back({count.first, count.second});
+        }
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = setCount;
+        poolInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay descriptor pool!");
+        }
+    }
+
+    // Objects live for the whole replay, wherever their record appears in the stream.
+    for (const Event& event : events) {
+        if (isObjectRecord(event.type)) {
+            createObject(event.type, event.payload);
+        }
+    }
+}
+
+GpuReplay::Object& GpuReplay::object(std::uint32_t id) {
+    if (id == 0 || id >= objects.size()) {
+        throw std::runtime_error("capture references an object created before the capture was installed");
+    }
+    return objects[id];
+}
+
+std::uint32_t GpuReplay::family(std::uint32_t queueNumber) const {
+    if (queueNumber == CAPTURE_NO_QUEUE) {
+        return VK_QUEUE_FAMILY_IGNORED;
+    }
+    if (queueNumber >= 3) {
+        throw std::runtime_error("capture transfers ownership to an unknown queue");
+    }
+    return families[queueNumber];
+}
+
+void GpuReplay::createObject(CaptureRecord type, const std::vector<std::uint8_t>& payload) {
+    Reader r{payload.data(), payload.data() + payload.size()};
+    std::uint32_t id = r.u32();
+    if (id >= objects.size()) {
+        objects.resize(id + 1);
+    }
+    Object& o = objects[id];
+    switch (type) {
+        case CaptureRecord::Buffer: {
+            VkDeviceSize size = r.u64();
+            VkBufferUsageFlags usage = r.u32();
+            VkMemoryPropertyFlags properties = r.u32();
+            // Device-local buffers get cleared before the first run, which needs TRANSFER_DST.
+            o.buffer = createBuffer(physicalDevice, device, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    properties & (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+            break;
+        }
+        case CaptureRecord::ShaderModule: {
+            std::uint32_t codeSize = r.u32();
+            std::vector<std::uint32_t> code(codeSize / sizeof(std::uint32_t));
+            r.raw(code.data(), codeSize);
+            VkShaderModuleCreateInfo moduleInfo = {};
+            moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            moduleInfo.codeSize = codeSize;
+            moduleInfo.pCode = code.data();
+            if (vkCreateShaderModule(device, &moduleInfo, nullptr, &o.shaderModule) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create replay shader module!");
+            }
+            break;
+        }
+        case CaptureRecord::SetLayout: {
+            std::vector<VkDescriptorSetLayoutBinding> bindings(r.u32());
+            for (auto& binding : bindings) {
+                binding.binding = r.u32();
+                binding.descriptorType = static_cast<VkDescriptorType>(r.u32());
+                binding.descriptorCount = r.u32();
+                binding.stageFlags = r.u32();
+                binding.pImmutableSamplers = nullptr;
+            }
+            VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
+            layoutInfo.pBindings = bindings.data();
+            if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &o.setLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create replay descriptor set layout!");
+            }
+            break;
+        }
+        case CaptureRecord::PipelineLayout: {
+            std::vector<VkDescriptorSetLayout> setLayouts(r.u32());
+            for (auto& layout : setLayouts) {
+                layout = object(r.u32()).setLayout;
+            }
+            std::vector<VkPushConstantRange> ranges(r.u32());
+            for (auto& range : ranges) {
+                range.stageFlags = r.u32();
+                range.offset = r.u32();
+                range.size = r.u32();
+            }
+            VkPipelineLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            layoutInfo.setLayoutCount = static_cast<std::uint32_t>(setLayouts.size());
+            layoutInfo.pSetLayouts = setLayouts.data();
+            layoutInfo.pushConstantRangeCount = static_cast<std::uint32_t>(ranges.size());
+            layoutInfo.pPushConstantRanges = ranges.data();
+            if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &o.pipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create replay pipeline layout!");
+            }
+            break;
+        }
+        case CaptureRecord::ComputePipeline: {
+            VkPipelineLayout layout = object(r.u32()).pipelineLayout;
+            VkShaderModule module = object(r.u32()).shaderModule;
+            std::string entryPoint(r.u32(), '\0');
+            r.raw(&entryPoint[0], entryPoint.size());
+            VkComputePipelineCreateInfo pipelineInfo = {};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfo.stage.module = module;
+            pipelineInfo.stage.pName = entryPoint.c_str();
+            pipelineInfo.layout = layout;
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &o.pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create replay pipeline!");
+            }
+            break;
+        }
+        case CaptureRecord::DescriptorSet: {
+            VkDescriptorSetLayout layout = object(r.u32()).setLayout;
+            VkDescriptorSetAllocateInfo setInfo = {};
+            setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            setInfo.descriptorPool = descriptorPool;
+            setInfo.descriptorSetCount = 1;
+            setInfo.pSetLayouts = &layout;
+            if (vkAllocateDescriptorSets(device, &setInfo, &o.descriptorSet) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate replay descriptor set!");
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    if (debugUtilsEnabled()) {
+        // Named by capture id, the number the .vtcap records refer to.
+        std::string name = "capture #" + std::to_string(id);
+        setObjectName(device, o.buffer.buffer, name);
+        setObjectName(device, o.buffer.memory, name);
+        setObjectName(device, o.shaderModule, name);
+        setObjectName(device, o.setLayout, name);
+        setObjectName(device, o.pipelineLayout, name);
+        setObjectName(device, o.pipeline, name);
+        setObjectName(device, o.descriptorSet, name);
+    }
+}
+
+// The app's device-local buffers had whatever earlier frames left in them; zero is the closest
+// deterministic stand-in. Done before every run, so that each one starts from the same state.
+// Host-visible buffers need nothing: each is uploaded before the first submit that uses it.
+void GpuReplay::clearDeviceLocalBuffers() {
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPools[0];
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate replay command buffer!");
+    }
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    for (const Object& o : objects) {
+        if (o.buffer.buffer != VK_NULL_HANDLE && o.buffer.mapped == nullptr) {
+            vkCmdFillBuffer(commandBuffer, o.buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+    }
+    vkEndCommandBuffer(commandBuffer);
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    VkResult result = vkQueueSubmit(queues[0], 1, &submitInfo, VK_NULL_HANDLE);
+    if (result == VK_SUCCESS) {
+        result = vkQueueWaitIdle(queues[0]);
+    }
+    vkFreeCommandBuffers(device, commandPools[0], 1, &commandBuffer);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to clear replay buffers!");
+    }
+}
+
+std::vector<double> GpuReplay::run() {
+    clearDeviceLocalBuffers();
+    std::vector<double> frameTimes;
+    std::size_t submitIndex[3] = {0, 0, 0};
+    auto frameStart = std::chrono::steady_clock::now();
+    for (const Event& event : events) {
+        Reader r{event.payload.data(), event.payload.data() + event.payload.size()};
+        switch (event.type) {
+            case CaptureRecord::Upload: {
+                Buffer& buffer = object(r.u32()).buffer;
+                VkDeviceSize offset = r.u64();
+                VkDeviceSize size = r.u64();
+                if (buffer.mapped == nullptr || offset + size > buffer.size) {
+                    throw std::runtime_error("capture uploads into a buffer that is not host visible");
+                }
+                r.raw(static_cast<std::uint8_t*>(buffer.mapped) + offset, static_cast<std::size_t>(size));
+                break;
+            }
+            case CaptureRecord::DescriptorWrite: {
+                VkWriteDescriptorSet write = {};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet = object(r.u32()).descriptorSet;
+                write.dstBinding = r.u32();
+                write.dstArrayElement = r.u32();
+                write.descriptorType = static_cast<VkDescriptorType>(r.u32());
+                write.descriptorCount = 1;
+                VkDescriptorBufferInfo bufferInfo;
+                bufferInfo.buffer = object(r.u32()).buffer.buffer;
+                bufferInfo.offset = r.u64();
+                bufferInfo.range = r.u64();
+                write.pBufferInfo = &bufferInfo;
+                vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+                break;
+            }
+            case CaptureRecord::Submit: {
+                std::uint32_t queue = r.u32();
+                if (queue >= 3) {
+                    throw std::runtime_error("capture submits to an unknown queue");
+                }
+                std::uint32_t count = r.u32();
+                // Command buffers are recorded at replay time because descriptor writes between
+                // submits would invalidate pre-recorded ones.
+                std::vector<VkCommandBuffer> submitted;
+                for (std::uint32_t i = 0; i < count; i++) {
+                    if (submitIndex[queue] == commandBuffers[queue].size()) {
+                        VkCommandBufferAllocateInfo allocInfo = {};
+                        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                        allocInfo.commandPool = commandPools[queue];
+                        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                        allocInfo.commandBufferCount = 1;
+                        VkCommandBuffer commandBuffer;
+                        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                            throw std::runtime_error("failed to allocate replay command buffer!");
+                        }
+                        commandBuffers[queue].push_back(commandBuffer);
+                    }
+                    VkCommandBuffer commandBuffer = commandBuffers[queue][submitIndex[queue]++];
+                    std::uint32_t size = r.u32();
+                    record(commandBuffer, r.skip(size), size);
+                    submitted.push_back(commandBuffer);
+                }
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = count;
+                submitInfo.pCommandBuffers = submitted.data();
+                if (vkQueueSubmit(queues[queue], 1, &submitInfo, fence) != VK_SUCCESS) {
+                    throw std::runtime_error("replay submit failed!");
+                }
+                vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                vkResetFences(device, 1, &fence);
+                break;
+            }
+            case CaptureRecord::FrameEnd: {
+                auto now = std::chrono::steady_clock::now();
+                frameTimes.push_back(std::chrono::duration<double, std::milli>(now - frameStart).count());
+                frameStart = now;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return frameTimes;
+}
+
+void GpuReplay::record(VkCommandBuffer commandBuffer, const std::uint8_t* commands, std::size_t size) {
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    Reader r{commands, commands + size};
+    while (r.p != r.end) {
+        switch (static_cast<CaptureCommand>(r.u32())) {
+            case CaptureCommand::BindPipeline: {
+                auto bindPoint = static_cast<VkPipelineBindPoint>(r.u32());
+                vkCmdBindPipeline(commandBuffer, bindPoint, object(r.u32()).pipeline);
+                break;
+            }
+            case CaptureCommand::BindDescriptorSets: {
+                auto bindPoint = static_cast<VkPipelineBindPoint>(r.u32());
+                VkPipelineLayout layout = object(r.u32()).pipelineLayout;
+                std::uint32_t firstSet = r.u32();
+                std::vector<VkDescriptorSet> sets(r.u32());
+                for (auto& set : sets) {
+                    set = object(r.u32()).descriptorSet;
+                }
+                std::vector<std::uint32_t> dynamicOffsets(r.u32());
+                for (auto& offset : dynamicOffsets) {
+                    offset = r.u32();
+                }
+                vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, static_cast<std::uint32_t>(sets.size()),
+                                        sets.data(), static_cast<std::uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+                break;
+            }
+            case CaptureCommand::PushConstants: {
+                VkPipelineLayout layout = object(r.u32()).pipelineLayout;
+                VkShaderStageFlags stages = r.u32();
+                std::uint32_t offset = r.u32();
+                std::uint32_t valueSize = r.u32();
+                vkCmdPushConstants(commandBuffer, layout, stages, offset, valueSize, r.skip(valueSize));
+                break;
+            }
+            case CaptureCommand::Dispatch: {
+                std::uint32_t x = r.u32();
+                std::uint32_t y = r.u32();
+                std::uint32_t z = r.u32();
+                vkCmdDispatch(commandBuffer, x, y, z);
+                break;
+            }
+            case CaptureCommand::CopyBuffer: {
+                VkBuffer src = object(r.u32()).buffer.buffer;
+                VkBuffer dst = object(r.u32()).buffer.buffer;
+                std::vector<VkBufferCopy> regions(r.u32());
+                for (auto& region : regions) {
+                    region.srcOffset = r.u64();
+                    region.dstOffset = r.u64();
+                    region.size = r.u64();
+                }
+                vkCmdCopyBuffer(commandBuffer, src, dst, static_cast<std::uint32_t>(regions.size()), regions.data());
+                break;
+            }
+            case CaptureCommand::FillBuffer: {
+                VkBuffer dst = object(r.u32()).buffer.buffer;
+                VkDeviceSize offset = r.u64();
+                VkDeviceSize fillSize = r.u64();
+                vkCmdFillBuffer(commandBuffer, dst, offset, fillSize, r.u32());
+                break;
+            }
+            case CaptureCommand::PipelineBarrier: {
+                VkPipelineStageFlags srcStages = r.u32();
+                VkPipelineStageFlags dstStages = r.u32();
+                VkDependencyFlags dependencyFlags = r.u32();
+                std::vector<VkMemoryBarrier> memoryBarriers(r.u32());
+                for (auto& barrier : memoryBarriers) {
+                    barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = r.u32();
+                    barrier.dstAccessMask = r.u32();
+                }
+                std::vector<VkBufferMemoryBarrier> bufferBarriers(r.u32());
+                for (auto& barrier : bufferBarriers) {
+                    barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                    barrier.srcAccessMask = r.u32();
+                    barrier.dstAccessMask = r.u32();
+                    barrier.srcQueueFamilyIndex = family(r.u32());
+                    barrier.dstQueueFamilyIndex = family(r.u32());
+                    if (barrier.srcQueueFamilyIndex == barrier.dstQueueFamilyIndex) {
+                        // Both sides share a family on this device, so there is nothing to transfer.
+                        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    }
+                    barrier.buffer = object(r.u32()).buffer.buffer;
+                    barrier.offset = r.u64();
+                    barrier.size = r.u64();
+                }
+                vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, dependencyFlags,
+                                     static_cast<std::uint32_t>(memoryBarriers.size()), memoryBarriers.data(),
+                                     static_cast<std::uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+                break;
+            }
+            case CaptureCommand::DispatchIndirect: {
+                VkBuffer buffer = object(r.u32()).buffer.buffer;
+                vkCmdDispatchIndirect(commandBuffer, buffer, r.u64());
+                break;
+            }
+            default:
+                throw std::runtime_error("unknown command in capture file");
+        }
+    }
+    vkEndCommandBuffer(commandBuffer);
+}
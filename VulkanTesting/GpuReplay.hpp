@@ -0,0 +1,68 @@
+#ifndef GpuReplay_hpp
+#define GpuReplay_hpp
+
+#include "GpuCapture.hpp"
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class VulkanContext;
+
+// Re-executes a .vtcap file written by GpuCapture. All objects are created up front; run() then
+// replays uploads, descriptor writes and submits in capture order, waiting for each submit, and
+// returns the wall time of every captured frame. Safe to run() repeatedly for stable numbers.
+class GpuReplay {
+public:
+    GpuReplay(const VulkanContext& context, const std::string& path);
+    ~GpuReplay();
+
+    GpuReplay(const GpuReplay&) = delete;
+    GpuReplay& operator=(const GpuReplay&) = delete;
+
+    std::vector<double> run();
+
+    std::size_t frameCount() const { return frames; }
+    std::size_t submitCount() const { return submits; }
+
+private:
+    struct Event {
+        CaptureRecord type;
+        std::vector<std::uint8_t> payload;
+    };
+    // One slot per capture id; only the member for the object's kind is set.
+    struct Object {
+        Buffer buffer;
+        VkShaderModule shaderModule = VK_NULL_HANDLE;
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue queues[3]; // Graphics, compute, transfer: the Submit record's queue numbers.
+    std::uint32_t families[3];
+    std::vector<Event> events;
+    std::vector<Object> objects;
+    std::size_t frames = 0;
+    std::size_t submits = 0;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkCommandPool commandPools[3] = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+    std::vector<VkCommandBuffer> commandBuffers[3];
+    VkFence fence = VK_NULL_HANDLE;
+
+    void load(const std::string& path);
+    void createObject(CaptureRecord type, const std::vector<std::uint8_t>& payload);
+    void clearDeviceLocalBuffers();
+    Object& object(std::uint32_t id);
+    std::uint32_t family(std::uint32_t queueNumber) const;
+    void record(VkCommandBuffer commandBuffer, const std::uint8_t* commands, std::size_t size);
+};
+
+#endif /* GpuReplay_hpp */
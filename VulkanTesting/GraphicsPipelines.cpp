@@ -0,0 +1,221 @@
+#include "GraphicsPipelines.hpp"
+#include "VulkanDispatch.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    template<typename T>
+    std::uint64_t handleKey(T handle) {
+        std::uint64_t key = 0;
+        std::memcpy(&key, &handle, sizeof(handle));
+        return key;
+    }
+
+    // Without dynamicPrimitiveTopologyUnrestricted, a dynamic topology must stay in the class the
+    // pipeline was created with.
+    std::uint64_t topologyClass(VkPrimitiveTopology topology) {
+        switch (topology) {
+            case VK_PRIMITIVE_TOPOLOGY_POINT_LIST: return 0;
+            case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+            case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP: return 1;
+            default: return 2;
+        }
+    }
+}
+
+GraphicsPipelineCache::GraphicsPipelineCache(VkDevice device, const DynamicStateSupport& support, bool dynamic)
+    : device(device), support(dynamic ? support : DynamicStateSupport()) {
+    // A device feature rather than a way of building pipelines: baked pipelines need it just the same.
+    this->support.fillModeNonSolid = support.fillModeNonSolid;
+}
+
+GraphicsPipelineCache::~GraphicsPipelineCache() {
+    clear();
+}
+
+void GraphicsPipelineCache::clear() {
+    for (auto& entry : pipelines) {
+        vkDestroyPipeline(device, entry.second, nullptr);
+    }
+    pipelines.clear();
+}
+
+std::vector<std::uint64_t> GraphicsPipelineCache::key(const GraphicsProgram& program, const RenderTarget& target,
+                                                      const RasterState& state) const {
+    std::vector<std::uint64_t> words = {handleKey(program.vertex), handleKey(program.fragment), handleKey(program.layout)};
+    if (support.dynamicRendering) {
+        words.push_back(target.depthFormat);
+        words.insert(words.end(), target.colorFormats.begin(), target.colorFormats.end());
+    } else {
+        words.push_back(handleKey(target.renderPass));
+        words.push_back(target.subpass);
+    }
+    // Marks the end of the variable-length target part.
+    words.push_back(~0ull);
+
+    if (!support.extendedDynamicState) {
+        words.push_back(state.topology);
+        words.push_back(state.cullMode);
+        words.push_back(state.frontFace);
+        words.push_back(state.depthTest);
+        words.push_back(state.depthWrite);
+        words.push_back(state.depthCompare);
+    } else if (!support.unrestrictedTopology) {
+        words.push_back(topologyClass(state.topology));
+    }
+    if (!support.extendedDynamicState2) words.push_back(state.primitiveRestart);
+    if (!support.polygonMode) words.push_back(state.polygonMode);
+    if (!support.colorBlendEnable) words.push_back(state.blend);
+    if (!support.colorWriteMask) words.push_back(state.colorWriteMask);
+    return words;
+}
+
+VkPipeline GraphicsPipelineCache::get(const GraphicsProgram& program, const RenderTarget& target, const RasterState& state) {
+    if (state.polygonMode != VK_POLYGON_MODE_FILL && !support.fillModeNonSolid) {
+        throw std::runtime_error("line and point polygon modes need fillModeNonSolid!");
+    }
+    statistics.lookups++;
+    std::vector<std::uint64_t> words = key(program, target, state);
+    auto it = pipelines.find(words);
+    if (it != pipelines.end()) {
+        return it->second;
+    }
+    auto start = std::chrono::steady_clock::now();
+    VkPipeline pipeline = create(program, target, state);
+    statistics.createMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    statistics.pipelines++;
+    pipelines.emplace(std::move(words), pipeline);
+    return pipeline;
+}
+
+void GraphicsPipelineCache::bind(VkCommandBuffer commandBuffer, const GraphicsProgram& program, const RenderTarget& target,
+                                 const RasterState& state) {
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, get(program, target, state));
+    if (support.extendedDynamicState) {
+        vkd.vkCmdSetPrimitiveTopologyEXT(commandBuffer, state.topology);
+        vkd.vkCmdSetCullModeEXT(commandBuffer, state.cullMode);
+        vkd.vkCmdSetFrontFaceEXT(commandBuffer, state.frontFace);
+        vkd.vkCmdSetDepthTestEnableEXT(commandBuffer, state.depthTest ? VK_TRUE : VK_FALSE);
+        vkd.vkCmdSetDepthWriteEnableEXT(commandBuffer, state.depthWrite ? VK_TRUE : VK_FALSE);
+        vkd.vkCmdSetDepthCompareOpEXT(commandBuffer, state.depthCompare);
+    }
+    if (support.extendedDynamicState2) {
+        vkd.vkCmdSetPrimitiveRestartEnableEXT(commandBuffer, state.primitiveRestart ? VK_TRUE : VK_FALSE);
+    }
+    if (support.polygonMode) {
+        vkd.vkCmdSetPolygonModeEXT(commandBuffer, state.polygonMode);
+    }
+    auto colorCount = static_cast<std::uint32_t>(target.colorFormats.size());
+    if (support.colorBlendEnable && colorCount > 0) {
+        std::vector<VkBool32> enables(colorCount, state.blend ? VK_TRUE : VK_FALSE);
+        vkd.vkCmdSetColorBlendEnableEXT(commandBuffer, 0, colorCount, enables.data());
+    }
+    if (support.colorWriteMask && colorCount > 0) {
+        std::vector<VkColorComponentFlags> masks(colorCount, state.colorWriteMask);
+        vkd.vkCmdSetColorWriteMaskEXT(commandBuffer, 0, colorCount, masks.data());
+    }
+}
+
+VkPipeline GraphicsPipelineCache::create(const GraphicsProgram& program, const RenderTarget& target, const RasterState& state) {
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = program.vertex;
+    stages[0].pName = "main";
+    stages[1] = stages[0];
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = program.fragment;
+
+    // State that is dynamic is ignored here but still has to be valid: the first state that asked for
+    // the pipeline fills it in, except restart and polygon mode, which fall back to their defaults
+    // (restart with a list topology needs a feature we don't enable).
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = state.topology;
+    inputAssembly.primitiveRestartEnable = state.primitiveRestart && !support.extendedDynamicState2 ? VK_TRUE : VK_FALSE;
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = support.polygonMode ? VK_POLYGON_MODE_FILL : state.polygonMode;
+    rasterization.cullMode = state.cullMode;
+    rasterization.frontFace = state.frontFace;
+    rasterization.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = state.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = state.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = state.depthCompare;
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(target.colorFormats.size());
+    for (VkPipelineColorBlendAttachmentState& blend : blendAttachments) {
+        blend = {};
+        blend.blendEnable = state.blend ? VK_TRUE : VK_FALSE;
+        blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend.colorBlendOp = VK_BLEND_OP_ADD;
+        blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend.alphaBlendOp = VK_BLEND_OP_ADD;
+        blend.colorWriteMask = state.colorWriteMask;
+    }
+    VkPipelineColorBlendStateCreateInfo colorBlend = {};
+    colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlend.attachmentCount = static_cast<std::uint32_t>(blendAttachments.size());
+    colorBlend.pAttachments = blendAttachments.data();
+
+    std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    if (support.extendedDynamicState) {
+        dynamicStates.insert(dynamicStates.end(), {VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT, VK_DYNAMIC_STATE_CULL_MODE_EXT,
+                                                   VK_DYNAMIC_STATE_FRONT_FACE_EXT, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+                                                   VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT});
+    }
+    if (support.extendedDynamicState2) dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT);
+    if (support.polygonMode) dynamicStates.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+    if (support.colorBlendEnable && !blendAttachments.empty()) dynamicStates.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+    if (support.colorWriteMask && !blendAttachments.empty()) dynamicStates.push_back(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT);
+    VkPipelineDynamicStateCreateInfo dynamic = {};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = static_cast<std::uint32_t>(dynamicStates.size());
+    dynamic.pDynamicStates = dynamicStates.data();
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewport;
+    pipelineInfo.pRasterizationState = &rasterization;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamic;
+    pipelineInfo.layout = program.layout;
+
+    VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    if (support.dynamicRendering) {
+        renderingInfo.colorAttachmentCount = static_cast<std::uint32_t>(target.colorFormats.size());
+        renderingInfo.pColorAttachmentFormats = target.colorFormats.data();
+        renderingInfo.depthAttachmentFormat = target.depthFormat;
+        pipelineInfo.pNext = &renderingInfo;
+    } else {
+        pipelineInfo.renderPass = target.renderPass;
+        pipelineInfo.subpass = target.subpass;
+    }
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline;
+}
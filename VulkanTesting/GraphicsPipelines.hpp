@@ -0,0 +1,90 @@
+#ifndef GraphicsPipelines_hpp
+#define GraphicsPipelines_hpp
+
+#include "VulkanContext.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Shaders and layout of a draw. No vertex input: the shaders in this repo build geometry from
+// gl_VertexIndex and gl_InstanceIndex or read storage buffers.
+struct GraphicsProgram {
+    VkShaderModule vertex = VK_NULL_HANDLE;
+    VkShaderModule fragment = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+
+// Where a draw goes. Formats are always needed (they size the blend state); renderPass and subpass
+// only without dynamic rendering, where any compatible render pass would do but the pipeline still
+// belongs to one.
+struct RenderTarget {
+    std::vector<VkFormat> colorFormats;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    std::uint32_t subpass = 0;
+};
+
+// The per-draw state materials and passes vary. Everything the device can set dynamically is left out
+// of the pipeline and set by GraphicsPipelineCache::bind() instead.
+struct RasterState {
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    bool primitiveRestart = false; // Strips only.
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL; // Line and point need DynamicStateSupport::fillModeNonSolid.
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    bool depthTest = false;
+    bool depthWrite = false;
+    VkCompareOp depthCompare = VK_COMPARE_OP_LESS;
+    bool blend = false; // Straight alpha on every color attachment.
+    VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+};
+
+struct GraphicsPipelineStats {
+    std::uint32_t pipelines = 0; // Distinct pipelines created.
+    std::uint64_t lookups = 0;   // get() and bind() calls.
+    double createMs = 0;         // CPU time in vkCreateGraphicsPipelines.
+};
+
+// Graphics pipelines by (program, target, state), created on first use. With dynamic rendering a
+// pipeline is keyed by attachment formats instead of a render pass, and with the extended dynamic
+// state extensions most of RasterState drops out of the key, so permutations that used to be separate
+// pipelines collapse into one. Whatever the device lacks stays in the key, so the cache works the same
+// on plain Vulkan 1.0, just with more pipelines.
+class GraphicsPipelineCache {
+public:
+    // dynamic = false bakes everything and keys on render passes even when the device could do better,
+    // for comparison.
+    GraphicsPipelineCache(VkDevice device, const DynamicStateSupport& support, bool dynamic = true);
+    ~GraphicsPipelineCache();
+
+    GraphicsPipelineCache(const GraphicsPipelineCache&) = delete;
+    GraphicsPipelineCache& operator=(const GraphicsPipelineCache&) = delete;
+
+    // Throws for a polygon mode other than fill when the device lacks fillModeNonSolid.
+    VkPipeline get(const GraphicsProgram& program, const RenderTarget& target, const RasterState& state);
+    // Binds get()'s pipeline and sets the state it left dynamic. Viewport and scissor are always
+    // dynamic and up to the caller.
+    void bind(VkCommandBuffer commandBuffer, const GraphicsProgram& program, const RenderTarget& target,
+              const RasterState& state);
+
+    // Targets must be recorded with vkCmdBeginRenderingKHR instead of a render pass when true.
+    bool dynamicRendering() const { return support.dynamicRendering; }
+    const GraphicsPipelineStats& stats() const { return statistics; }
+    // Destroys every pipeline, e.g. after the render passes were recreated.
+    void clear();
+
+private:
+    VkDevice device;
+    DynamicStateSupport support; // What this cache uses: the device's, or nothing.
+    std::map<std::vector<std::uint64_t>, VkPipeline> pipelines;
+    GraphicsPipelineStats statistics;
+
+    std::vector<std::uint64_t> key(const GraphicsProgram& program, const RenderTarget& target, const RasterState& state) const;
+    VkPipeline create(const GraphicsProgram& program, const RenderTarget& target, const RasterState& state);
+};
+
+#endif /* GraphicsPipelines_hpp */
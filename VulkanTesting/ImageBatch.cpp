@@ -0,0 +1,555 @@
+#include "ImageBatch.hpp"
+#include "ImageCodec.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool hasMemoryType(VkPhysicalDevice physicalDevice, VkMemoryPropertyFlags properties) {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        for (std::uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Mirrors the push constants of shaders/batch_resize.comp.
+    struct ResizePush {
+        std::uint32_t inputExtent[2];
+        std::uint32_t outputExtent[2];
+    };
+
+    // Mirrors the push constants of shaders/batch_convolve.comp.
+    struct ConvolvePush {
+        std::uint32_t extent[2];
+        std::uint32_t size;
+        float bias;
+        float weights[25];
+    };
+
+    // Mirrors the push constants of shaders/batch_color.comp.
+    struct ColorPush {
+        float rows[3][4];
+        std::uint32_t extent[2];
+        std::uint32_t linear;
+    };
+
+    const std::uint32_t PUSH_SIZE = std::max(sizeof(ResizePush), std::max(sizeof(ConvolvePush), sizeof(ColorPush)));
+    // Workgroup size of all three shaders.
+    const std::uint32_t FILTER_TILE = 16;
+    const char* const SHADER_NAMES[3] = {"batch_resize.comp", "batch_convolve.comp", "batch_color.comp"};
+}
+
+ImageBatch::ImageBatch(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t queueFamily, VkQueue queue,
+                       const std::string& shaderDir, JobSystem& jobs, const std::vector<ImageFilter>& filters,
+                       unsigned slotCount)
+    : physicalDevice(physicalDevice), device(device), queue(queue), jobs(jobs), filters(filters),
+      io(2, [&jobs](std::function<void()> job) { jobs.enqueue(std::move(job)); }) {
+    VT_ZONE("create image batch");
+    for (ImageFilter& filter : this->filters) {
+        if (filter.type == ImageFilterType::Resize && filter.width == 0 && filter.height == 0) {
+            throw std::runtime_error("ImageBatch: a resize needs a width, a height or both.");
+        }
+        if (filter.type == ImageFilterType::Convolve) {
+            if (filter.kernelSize != 3 && filter.kernelSize != 5) {
+                throw std::runtime_error("ImageBatch: convolution kernels must be 3x3 or 5x5.");
+            }
+            float sum = 0.0f;
+            for (std::uint32_t i = 0; i < filter.kernelSize * filter.kernelSize; i++) {
+                sum += filter.kernel[i];
+            }
+            if (std::fabs(sum) > 1e-6f) {
+                for (std::uint32_t i = 0; i < filter.kernelSize * filter.kernelSize; i++) {
+                    filter.kernel[i] /= sum;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        modules[i] = createShaderModule(device, shaderDir + "/" + SHADER_NAMES[i] + ".spv");
+        setObjectName(device, modules[i], SHADER_NAMES[i]);
+    }
+
+    // Every filter reads one storage image and writes another.
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    for (std::uint32_t i = 0; i < 2; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image batch descriptor set layout!");
+    }
+    VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, PUSH_SIZE};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image batch pipeline layout!");
+    }
+    for (int i = 0; i < 3; i++) {
+        pipelines[i] = createComputePipeline(device, modules[i], pipelineLayout);
+        setObjectName(device, pipelines[i], SHADER_NAMES[i]);
+    }
+
+    if (slotCount == 0) {
+        slotCount = jobs.threadCount() + 2;
+    }
+    VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4 * slotCount};
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 2 * slotCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image batch descriptor pool!");
+    }
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image batch command pool!");
+    }
+
+    // Timestamps are optional per queue family.
+    std::uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    maxDimension = properties.limits.maxImageDimension2D;
+    std::uint32_t validBits = families[queueFamily].timestampValidBits;
+    if (validBits > 0) {
+        timestampPeriod = properties.limits.timestampPeriod;
+        timestampMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2 * slotCount;
+        if (vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image batch query pool!");
+        }
+        setObjectName(device, queryPool, "image batch timestamps");
+    }
+
+    for (unsigned i = 0; i < slotCount; i++) {
+        std::unique_ptr<Slot> slot(new Slot());
+        VkDescriptorSetLayout setLayouts[2] = {setLayout, setLayout};
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPool;
+        setInfo.descriptorSetCount = 2;
+        setInfo.pSetLayouts = setLayouts;
+        if (vkd.vkAllocateDescriptorSets(device, &setInfo, slot->sets) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate image batch descriptor sets!");
+        }
+        VkCommandBufferAllocateInfo commandBufferInfo = {};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        if (vkd.vkAllocateCommandBuffers(device, &commandBufferInfo, &slot->commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate image batch command buffers!");
+        }
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &slot->fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image batch fence!");
+        }
+        std::string name = "image batch slot " + std::to_string(i);
+        setObjectName(device, slot->commandBuffer, name);
+        setObjectName(device, slot->fence, name);
+        slots.push_back(std::move(slot));
+    }
+    setObjectName(device, setLayout, "image batch set layout");
+    setObjectName(device, pipelineLayout, "image batch pipeline layout");
+    setObjectName(device, descriptorPool, "image batch descriptor pool");
+    setObjectName(device, commandPool, "image batch command pool");
+}
+
+ImageBatch::~ImageBatch() {
+    // Only after a run() that threw is anything still in flight.
+    io.waitIdle();
+    jobs.waitIdle();
+    for (auto& slot : slots) {
+        if (slot->state.load() == Running) {
+            vkWaitForFences(device, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+        }
+        if (slot->upload.buffer != VK_NULL_HANDLE) destroyBuffer(device, slot->upload);
+        if (slot->readback.buffer != VK_NULL_HANDLE) destroyBuffer(device, slot->readback);
+        for (Image& image : slot->images) {
+            if (image.image != VK_NULL_HANDLE) destroyImage(device, image);
+        }
+        vkDestroyFence(device, slot->fence, nullptr);
+    }
+    if (queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, queryPool, nullptr);
+    vkd.vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    for (int i = 0; i < 3; i++) {
+        vkDestroyPipeline(device, pipelines[i], nullptr);
+        vkDestroyShaderModule(device, modules[i], nullptr);
+    }
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+}
+
+void ImageBatch::run(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) {
+    VT_ZONE("image batch");
+    if (outputs.size() != inputs.size()) {
+        throw std::runtime_error("ImageBatch: need one output path per input.");
+    }
+    statistics = ImageBatchStats();
+    failureList.clear();
+    auto start = std::chrono::steady_clock::now();
+    std::size_t next = 0;
+    std::size_t finished = 0;
+    while (finished < inputs.size()) {
+        std::uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            seen = events;
+        }
+        // Moves every slot on as far as it can go. Only this thread submits, so the queue needs no lock.
+        bool progressed = false;
+        bool running = false;
+        for (std::uint32_t i = 0; i < slots.size(); i++) {
+            Slot& slot = *slots[i];
+            switch (slot.state.load()) {
+                case Idle:
+                    if (next < inputs.size()) {
+                        slot.index = next++;
+                        load(slot, inputs[slot.index]);
+                        progressed = true;
+                    }
+                    break;
+                case Loaded:
+                    statistics.bytesRead += slot.file.size();
+                    statistics.pixelsIn += static_cast<std::uint64_t>(slot.inputExtent.width) * slot.inputExtent.height;
+                    statistics.decodeMs += slot.decodeMs;
+                    submit(slot, i);
+                    progressed = true;
+                    break;
+                case Running:
+                    if (vkGetFenceStatus(device, slot.fence) != VK_SUCCESS) {
+                        running = true;
+                        break;
+                    }
+                    vkResetFences(device, 1, &slot.fence);
+                    if (queryPool != VK_NULL_HANDLE) {
+                        std::uint64_t stamps[2];
+                        vkGetQueryPoolResults(device, queryPool, 2 * i, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                        statistics.gpuMs += ((stamps[1] - stamps[0]) & timestampMask) * timestampPeriod * 1e-6;
+                    }
+                    save(slot, outputs[slot.index]);
+                    progressed = true;
+                    break;
+                case Saved:
+                    statistics.images++;
+                    statistics.bytesWritten += slot.bytesWritten;
+                    statistics.pixelsOut += static_cast<std::uint64_t>(slot.outputExtent.width) * slot.outputExtent.height;
+                    statistics.encodeMs += slot.encodeMs;
+                    slot.state.store(Idle);
+                    finished++;
+                    progressed = true;
+                    break;
+                case Failed:
+                    statistics.failed++;
+                    failureList.push_back(inputs[slot.index] + ": " + slot.error);
+                    slot.state.store(Idle);
+                    finished++;
+                    progressed = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (!progressed) {
+            // Workers wake us when a slot finishes loading or saving; fences are polled, which costs
+            // at most the timeout in latency and keeps this thread off the driver's wait paths.
+            std::unique_lock<std::mutex> lock(eventMutex);
+            auto changed = [&] { return events != seen; };
+            if (running) {
+                eventCondition.wait_for(lock, std::chrono::microseconds(200), changed);
+            } else {
+                eventCondition.wait(lock, changed);
+            }
+        }
+    }
+    statistics.wallMs = millisecondsSince(start);
+}
+
+void ImageBatch::finishStage(Slot& slot, SlotState state) {
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        slot.state.store(state);
+        events++;
+    }
+    eventCondition.notify_one();
+}
+
+void ImageBatch::load(Slot& slot, const std::string& path) {
+    slot.state.store(Loading);
+    std::uint64_t size;
+    try {
+        size = AssetIOService::fileSize(path);
+    } catch (const std::exception& e) {
+        slot.error = e.what();
+        slot.state.store(Failed);
+        return;
+    }
+    slot.file.resize(size);
+    IORequest request;
+    request.path = path;
+    request.size = size;
+    request.destination = slot.file.data();
+    request.onComplete = [this, &slot](const IORequest& request, std::uint64_t bytesRead) {
+        io.closeFile(request.path);
+        VT_ZONE("decode image");
+        auto start = std::chrono::steady_clock::now();
+        try {
+            if (bytesRead < request.size) {
+                throw std::runtime_error("short read.");
+            }
+            PnmHeader header = parsePnmHeader(slot.file.data(), slot.file.size());
+            VkDeviceSize bytes = static_cast<VkDeviceSize>(header.width) * header.height * 4;
+            if (slot.upload.size < bytes) {
+                if (slot.upload.buffer != VK_NULL_HANDLE) destroyBuffer(device, slot.upload);
+                slot.upload = createBuffer(physicalDevice, device, bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                           "image batch upload");
+            }
+            // Straight into the mapped staging buffer: the decoded pixels are written once.
+            decodePnm(slot.file.data(), header, static_cast<std::uint8_t*>(slot.upload.mapped));
+            slot.inputExtent = {header.width, header.height};
+            slot.decodeMs = millisecondsSince(start);
+            finishStage(slot, Loaded);
+        } catch (const std::exception& e) {
+            slot.error = e.what();
+            finishStage(slot, Failed);
+        }
+    };
+    io.submit(std::move(request));
+}
+
+std::vector<VkExtent2D> ImageBatch::chainExtents(VkExtent2D input) const {
+    std::vector<VkExtent2D> extents;
+    VkExtent2D current = input;
+    for (const ImageFilter& filter : filters) {
+        if (filter.type == ImageFilterType::Resize) {
+            double aspect = static_cast<double>(current.width) / current.height;
+            std::uint32_t width = filter.width;
+            std::uint32_t height = filter.height;
+            if (width == 0) width = static_cast<std::uint32_t>(std::max(1.0, std::round(height * aspect)));
+            if (height == 0) height = static_cast<std::uint32_t>(std::max(1.0, std::round(width / aspect)));
+            current = {width, height};
+        }
+        extents.push_back(current);
+    }
+    return extents;
+}
+
+void ImageBatch::ensureImages(Slot& slot, VkExtent2D extent) {
+    VkExtent2D capacity = slot.images[0].extent;
+    if (extent.width <= capacity.width && extent.height <= capacity.height) {
+        return;
+    }
+    // Grow to cover everything seen so far, so mixed portrait and landscape inputs settle quickly.
+    capacity = {std::max(extent.width, capacity.width), std::max(extent.height, capacity.height)};
+    for (Image& image : slot.images) {
+        if (image.image != VK_NULL_HANDLE) destroyImage(device, image);
+        image = createImage(physicalDevice, device, capacity, VK_FORMAT_R8G8B8A8_UNORM,
+                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                            "image batch image");
+    }
+    slot.fresh = true;
+
+    VkDescriptorImageInfo imageInfos[2] = {
+        {VK_NULL_HANDLE, slot.images[0].view, VK_IMAGE_LAYOUT_GENERAL},
+        {VK_NULL_HANDLE, slot.images[1].view, VK_IMAGE_LAYOUT_GENERAL},
+    };
+    VkWriteDescriptorSet writes[4] = {};
+    for (std::uint32_t i = 0; i < 4; i++) {
+        std::uint32_t set = i / 2;
+        std::uint32_t binding = i % 2;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = slot.sets[set];
+        writes[i].dstBinding = binding;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[i].pImageInfo = &imageInfos[(set + binding) % 2];
+    }
+    vkd.vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+}
+
+void ImageBatch::submit(Slot& slot, std::uint32_t slotIndex) {
+    VT_ZONE("submit image");
+    std::vector<VkExtent2D> extents = chainExtents(slot.inputExtent);
+    VkExtent2D capacity = slot.inputExtent;
+    for (const VkExtent2D& extent : extents) {
+        capacity = {std::max(capacity.width, extent.width), std::max(capacity.height, extent.height)};
+    }
+    if (capacity.width > maxDimension || capacity.height > maxDimension) {
+        slot.error = "larger than the device's " + std::to_string(maxDimension) + " pixel image limit.";
+        slot.state.store(Failed);
+        return;
+    }
+    ensureImages(slot, capacity);
+    slot.outputExtent = extents.empty() ? slot.inputExtent : extents.back();
+    VkDeviceSize outputBytes = static_cast<VkDeviceSize>(slot.outputExtent.width) * slot.outputExtent.height * 4;
+    if (slot.readback.size < outputBytes) {
+        if (slot.readback.buffer != VK_NULL_HANDLE) destroyBuffer(device, slot.readback);
+        // The encoder reads every byte on the CPU, which is slow from uncached memory.
+        VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (hasMemoryType(physicalDevice, properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+            properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        }
+        slot.readback = createBuffer(physicalDevice, device, outputBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties,
+                                     "image batch readback");
+    }
+
+    VkCommandBuffer commandBuffer = slot.commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 2 * slotIndex, 2);
+        vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * slotIndex);
+    }
+    {
+        CommandLabel label(commandBuffer, "image batch");
+        // Both images live in GENERAL, so from here on only memory barriers separate the steps.
+        if (slot.fresh) {
+            VkImageMemoryBarrier barriers[2] = {};
+            for (int i = 0; i < 2; i++) {
+                barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barriers[i].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+                barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barriers[i].image = slot.images[i].image;
+                barriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            }
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 2, barriers);
+            slot.fresh = false;
+        }
+        VkBufferImageCopy upload = {};
+        upload.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        upload.imageExtent = {slot.inputExtent.width, slot.inputExtent.height, 1};
+        vkd.vkCmdCopyBufferToImage(commandBuffer, slot.upload.buffer, slot.images[0].image, VK_IMAGE_LAYOUT_GENERAL, 1, &upload);
+
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkExtent2D current = slot.inputExtent;
+        for (std::size_t i = 0; i < filters.size(); i++) {
+            vkd.vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            const ImageFilter& filter = filters[i];
+            VkExtent2D output = extents[i];
+            vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[static_cast<int>(filter.type)]);
+            vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &slot.sets[i % 2], 0, nullptr);
+            if (filter.type == ImageFilterType::Resize) {
+                ResizePush push = {{current.width, current.height}, {output.width, output.height}};
+                vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            } else if (filter.type == ImageFilterType::Convolve) {
+                ConvolvePush push = {{output.width, output.height}, filter.kernelSize, filter.bias, {}};
+                std::copy(filter.kernel, filter.kernel + 25, push.weights);
+                vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            } else {
+                ColorPush push = {};
+                std::copy(filter.matrix, filter.matrix + 12, &push.rows[0][0]);
+                push.extent[0] = output.width;
+                push.extent[1] = output.height;
+                push.linear = filter.linear ? 1 : 0;
+                vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            }
+            vkd.vkCmdDispatch(commandBuffer, (output.width + FILTER_TILE - 1) / FILTER_TILE,
+                              (output.height + FILTER_TILE - 1) / FILTER_TILE, 1);
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            current = output;
+        }
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkd.vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferImageCopy readback = {};
+        readback.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        readback.imageExtent = {slot.outputExtent.width, slot.outputExtent.height, 1};
+        vkd.vkCmdCopyImageToBuffer(commandBuffer, slot.images[filters.size() % 2].image, VK_IMAGE_LAYOUT_GENERAL,
+                                   slot.readback.buffer, 1, &readback);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * slotIndex + 1);
+    }
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkd.vkQueueSubmit(queue, 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit image batch commands!");
+    }
+    slot.state.store(Running);
+}
+
+void ImageBatch::save(Slot& slot, const std::string& path) {
+    slot.state.store(Saving);
+    jobs.enqueue([this, &slot, path] {
+        VT_ZONE("encode image");
+        auto start = std::chrono::steady_clock::now();
+        try {
+            auto encoded = encodePnm(static_cast<const std::uint8_t*>(slot.readback.mapped), slot.outputExtent.width,
+                                     slot.outputExtent.height);
+            std::ofstream file(path, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("cannot create " + path);
+            }
+            file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+            if (!file) {
+                throw std::runtime_error("failed to write " + path);
+            }
+            slot.bytesWritten = encoded.size();
+            slot.encodeMs = millisecondsSince(start);
+            finishStage(slot, Saved);
+        } catch (const std::exception& e) {
+            slot.error = e.what();
+            finishStage(slot, Failed);
+        }
+    });
+}
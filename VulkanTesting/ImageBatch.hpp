@@ -0,0 +1,152 @@
+#ifndef ImageBatch_hpp
+#define ImageBatch_hpp
+
+#include "AssetIO.hpp"
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+enum class ImageFilterType {
+    Resize,
+    Convolve,
+    Color,
+};
+
+// One step of an ImageBatch chain, on 8-bit RGBA with sRGB-encoded color. Only the fields of its
+// type are used.
+struct ImageFilter {
+    ImageFilterType type = ImageFilterType::Color;
+    // Resize: output size in pixels. 0 in one dimension keeps the aspect ratio.
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    // Convolve: kernelSize * kernelSize weights, row major, kernelSize 3 or 5. Scaled to sum to one
+    // unless they sum to zero (edge detection); bias is added after.
+    std::uint32_t kernelSize = 3;
+    float kernel[25] = {};
+    float bias = 0.0f;
+    // Color: rgb' = matrix * (r, g, b, 1), three rows of four. In linear light when linear is set.
+    float matrix[12] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+    bool linear = false;
+};
+
+// What the last run() did. The per-stage times are summed over all images, so together they exceed
+// wallMs by however much the stages overlapped.
+struct ImageBatchStats {
+    std::uint64_t images = 0; // Written.
+    std::uint64_t failed = 0; // Skipped, see ImageBatch::failures().
+    std::uint64_t bytesRead = 0;
+    std::uint64_t bytesWritten = 0;
+    std::uint64_t pixelsIn = 0;
+    std::uint64_t pixelsOut = 0;
+    double wallMs = 0;
+    double decodeMs = 0; // CPU, from file bytes to RGBA in the upload buffer.
+    double gpuMs = 0;    // Upload, filters and readback. 0 when the queue has no timestamps.
+    double encodeMs = 0; // CPU, encode and write.
+};
+
+// Headless batch filtering on the compute path: reads images from disk, runs a chain of GPU filters
+// (resize, convolution, color conversion) and writes the results. Each image in flight owns a slot
+// with its own staging buffers, images and command buffer, and slots move independently through
+// read and decode (I/O service and job workers), upload, filters and readback (one submit on the
+// queue), then encode and write (job workers again). With a few more slots than workers, disk, CPU
+// and GPU stay busy at once and throughput is that of the slowest stage, not the sum of all.
+//
+// Reads binary netpbm (P5, P6) and writes P6; see ImageCodec.hpp. Only core Vulkan 1.0 compute and
+// transfer, so it runs on lavapipe.
+class ImageBatch {
+public:
+    // queue must belong to queueFamily and support compute. shaderDir holds batch_resize.comp.spv,
+    // batch_convolve.comp.spv and batch_color.comp.spv. slotCount 0 = two more than the job workers.
+    ImageBatch(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t queueFamily, VkQueue queue,
+               const std::string& shaderDir, JobSystem& jobs, const std::vector<ImageFilter>& filters,
+               unsigned slotCount = 0);
+    ~ImageBatch();
+
+    ImageBatch(const ImageBatch&) = delete;
+    ImageBatch& operator=(const ImageBatch&) = delete;
+
+    // Filters inputs[i] into outputs[i] and returns once everything is written. Images that can't be
+    // read, decoded or written are skipped and listed in failures(); device errors throw.
+    void run(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs);
+
+    const ImageBatchStats& stats() const { return statistics; }
+    // "path: reason" for every image the last run() skipped.
+    const std::vector<std::string>& failures() const { return failureList; }
+
+private:
+    enum SlotState {
+        Idle,
+        Loading, // Reading and decoding on the workers.
+        Loaded,  // Decoded into upload, ready to submit.
+        Running, // Submitted.
+        Saving,  // Encoding and writing on the workers.
+        Saved,
+        Failed,
+    };
+
+    struct Slot {
+        std::atomic<int> state{Idle};
+        std::size_t index = 0; // Into run()'s inputs.
+        std::vector<std::uint8_t> file;
+        Buffer upload;   // Decoded RGBA8, grown on the workers.
+        Buffer readback; // Filtered RGBA8.
+        Image images[2]; // Filters ping-pong between them.
+        bool fresh = true; // images still in VK_IMAGE_LAYOUT_UNDEFINED.
+        VkExtent2D inputExtent = {0, 0};
+        VkExtent2D outputExtent = {0, 0};
+        VkDescriptorSet sets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE}; // sets[i] reads images[i], writes the other.
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // Written on the workers, read by the main thread once state says they are done.
+        double decodeMs = 0;
+        double encodeMs = 0;
+        std::uint64_t bytesWritten = 0;
+        std::string error;
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue queue;
+    JobSystem& jobs;
+    std::vector<ImageFilter> filters;
+    AssetIOService io;
+    ImageBatchStats statistics;
+    std::vector<std::string> failureList;
+
+    VkShaderModule modules[3] = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE}; // By ImageFilterType.
+    VkPipeline pipelines[3] = {VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE; // Two per slot. Null when the queue family has no timestamps.
+    double timestampPeriod = 0;              // Nanoseconds per tick.
+    std::uint64_t timestampMask = 0;         // The queue family's timestampValidBits.
+    std::uint32_t maxDimension = 0;          // maxImageDimension2D.
+    std::vector<std::unique_ptr<Slot>> slots;
+
+    // Workers bump events whenever a slot leaves Loading or Saving, so run() can sleep until then.
+    std::mutex eventMutex;
+    std::condition_variable eventCondition;
+    std::uint64_t events = 0;
+
+    void load(Slot& slot, const std::string& path);
+    void submit(Slot& slot, std::uint32_t slotIndex);
+    void save(Slot& slot, const std::string& path);
+    void finishStage(Slot& slot, SlotState state);
+    // Output extent of every filter in turn, for an input extent.
+    std::vector<VkExtent2D> chainExtents(VkExtent2D input) const;
+    void ensureImages(Slot& slot, VkExtent2D extent);
+};
+
+#endif /* ImageBatch_hpp */
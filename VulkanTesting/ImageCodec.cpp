@@ -0,0 +1,99 @@
+#include "ImageCodec.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    bool isSpace(std::uint8_t c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // Next decimal header field, skipping whitespace and # comments before it.
+    std::uint32_t readField(const std::uint8_t* data, std::size_t size, std::size_t& at) {
+        for (;;) {
+            while (at < size && isSpace(data[at])) at++;
+            if (at < size && data[at] == '#') {
+                while (at < size && data[at] != '\n') at++;
+                continue;
+            }
+            break;
+        }
+        if (at >= size || data[at] < '0' || data[at] > '9') {
+            throw std::runtime_error("PNM: malformed header.");
+        }
+        std::uint64_t value = 0;
+        while (at < size && data[at] >= '0' && data[at] <= '9') {
+            value = value * 10 + (data[at++] - '0');
+            if (value > 0xFFFFFFu) {
+                throw std::runtime_error("PNM: header value out of range.");
+            }
+        }
+        return static_cast<std::uint32_t>(value);
+    }
+}
+
+PnmHeader parsePnmHeader(const std::uint8_t* data, std::size_t size) {
+    if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+        throw std::runtime_error("PNM: not a binary P5 or P6 image.");
+    }
+    PnmHeader header;
+    header.channels = data[1] == '5' ? 1 : 3;
+    std::size_t at = 2;
+    header.width = readField(data, size, at);
+    header.height = readField(data, size, at);
+    std::uint32_t maxValue = readField(data, size, at);
+    if (header.width == 0 || header.height == 0) {
+        throw std::runtime_error("PNM: empty image.");
+    }
+    if (maxValue != 255) {
+        throw std::runtime_error("PNM: only 8-bit samples (maxval 255) are supported, got " + std::to_string(maxValue) + ".");
+    }
+    // Exactly one whitespace byte separates the header from the samples.
+    if (at >= size || !isSpace(data[at])) {
+        throw std::runtime_error("PNM: malformed header.");
+    }
+    header.dataOffset = at + 1;
+    std::uint64_t sampleBytes = static_cast<std::uint64_t>(header.width) * header.height * header.channels;
+    if (size - header.dataOffset < sampleBytes) {
+        throw std::runtime_error("PNM: truncated image data.");
+    }
+    return header;
+}
+
+void decodePnm(const std::uint8_t* data, const PnmHeader& header, std::uint8_t* rgba) {
+    const std::uint8_t* src = data + header.dataOffset;
+    std::size_t pixels = static_cast<std::size_t>(header.width) * header.height;
+    if (header.channels == 1) {
+        for (std::size_t i = 0; i < pixels; i++) {
+            rgba[0] = rgba[1] = rgba[2] = src[i];
+            rgba[3] = 255;
+            rgba += 4;
+        }
+    } else {
+        for (std::size_t i = 0; i < pixels; i++) {
+            rgba[0] = src[0];
+            rgba[1] = src[1];
+            rgba[2] = src[2];
+            rgba[3] = 255;
+            src += 3;
+            rgba += 4;
+        }
+    }
+}
+
+std::vector<std::uint8_t> encodePnm(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height) {
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::size_t pixels = static_cast<std::size_t>(width) * height;
+    std::vector<std::uint8_t> out(header.size() + pixels * 3);
+    std::copy(header.begin(), header.end(), out.begin());
+    std::uint8_t* dst = out.data() + header.size();
+    for (std::size_t i = 0; i < pixels; i++) {
+        dst[0] = rgba[0];
+        dst[1] = rgba[1];
+        dst[2] = rgba[2];
+        dst += 3;
+        rgba += 4;
+    }
+    return out;
+}
@@ -0,0 +1,25 @@
+#ifndef ImageCodec_hpp
+#define ImageCodec_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Binary netpbm: P5 (grey) and P6 (RGB) with 8-bit samples, what the batch tools read and write. No
+// library needed, decoding runs at memory speed, and every image tool converts to and from it.
+
+struct PnmHeader {
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t channels = 0; // 1 for P5, 3 for P6.
+    std::size_t dataOffset = 0; // First sample byte.
+};
+
+// Throws std::runtime_error for anything but an 8-bit P5 or P6 image, truncated ones included.
+PnmHeader parsePnmHeader(const std::uint8_t* data, std::size_t size);
+// Expands the samples to RGBA8 (grey into all three channels, alpha 255): width * height * 4 bytes.
+void decodePnm(const std::uint8_t* data, const PnmHeader& header, std::uint8_t* rgba);
+// P6 from tightly packed RGBA8. Alpha is dropped.
+std::vector<std::uint8_t> encodePnm(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height);
+
+#endif /* ImageCodec_hpp */
@@ -0,0 +1,128 @@
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+JobSystem::JobSystem(unsigned threadCount) {
+    if (threadCount == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        threadCount = hw > 1 ? hw - 1 : 1;
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    workAvailable.notify_one();
+}
+
+void JobSystem::parallelFor(std::size_t count, const std::function<void(std::size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    // Indices are handed out from a shared counter so uneven items balance themselves.
+    // The shared state outlives this call in case a helper job is dequeued after we return.
+    // The first exception a body throws is kept and rethrown here once every index is accounted
+    // for; until then other threads may still be using body. Indices after a failure are skipped.
+    struct State {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+    auto drain = [state, count, &body]() {
+        for (;;) {
+            std::size_t i = state->next.fetch_add(1);
+            if (i >= count) {
+                return;
+            }
+            if (!state->failed.load(std::memory_order_relaxed)) {
+                try {
+                    body(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (!state->error) {
+                        state->error = std::current_exception();
+                    }
+                    state->failed.store(true, std::memory_order_relaxed);
+                }
+            }
+            if (state->done.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+    std::size_t helpers = std::min<std::size_t>(workers.size(), count - 1);
+    for (std::size_t i = 0; i < helpers; i++) {
+        // A helper that starts after all indices are taken returns immediately without touching body.
+        enqueue([state, count, drain]() {
+            if (state->next.load() < count) {
+                drain();
+            }
+        });
+    }
+    drain();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->done.load() == count; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void JobSystem::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && running == 0; });
+}
+
+void JobSystem::workerLoop(unsigned index) {
+    Profiler::setThreadName("job worker " + std::to_string(index));
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return; // Stopping and drained.
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running++;
+        }
+        {
+            VT_ZONE("job");
+            job();
+        }
+        bool nowIdle;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            nowIdle = jobs.empty() && running == 0;
+        }
+        if (nowIdle) {
+            idle.notify_all();
+        }
+    }
+}
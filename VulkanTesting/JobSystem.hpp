@@ -0,0 +1,44 @@
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads with a single FIFO queue.
+// Deliberately simple: jobs here are coarse (a file read, a 64 KiB decompress), so one lock is fine.
+class JobSystem {
+public:
+    // 0 = one worker per hardware thread, minus the calling thread.
+    explicit JobSystem(unsigned threadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void enqueue(std::function<void()> job);
+    // Runs body(0..count-1) across the workers and the calling thread, returns when all are done.
+    // If a body throws, the rest are skipped and the first exception is rethrown here.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+    // Blocks until the queue is empty and no job is running.
+    void waitIdle();
+
+    unsigned threadCount() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> jobs;
+    std::size_t running = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void workerLoop(unsigned index);
+};
+
+#endif /* JobSystem_hpp */
@@ -0,0 +1,371 @@
+#include "ParticleSystem.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    // Mirrors the push constants of the compute shaders in shaders/particles.glsl.
+    struct SimulatePush {
+        float gravity[4];
+        float origin[4];
+        float direction[4];
+        float spread[4];
+        float dt;
+        float floorHeight;
+        float bounce;
+        std::uint32_t emitCount;
+        std::uint32_t seed;
+        std::uint32_t capacity;
+        std::uint32_t current;
+    };
+
+    // Mirrors the push constants of shaders/particle.vert.
+    struct DrawPush {
+        float viewProj[16];
+        float right[4];
+        float up[4];
+    };
+
+    // The state block of shaders/particles.glsl: count[2], dropped, frame, then the two indirect
+    // commands, each padded to a uvec4.
+    const VkDeviceSize STATE_SIZE = 48;
+    const VkDeviceSize DISPATCH_OFFSET = 16;
+    const VkDeviceSize DRAW_OFFSET = 32;
+    const std::uint32_t PARTICLE_SIZE = 32;
+    const std::uint32_t PARTICLE_GROUP = 256;
+    const std::uint32_t MAX_GROUPS = 65535; // The minimum maxComputeWorkGroupCount.
+
+    // Between the passes of one frame: counts and particles written by one pass are read and appended
+    // to by the next, and finalize overwrites the dispatch arguments simulate was launched with.
+    void passBarrier(VkCommandBuffer commandBuffer) {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
+
+ParticleSystem::ParticleSystem(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t computeFamily,
+                               std::uint32_t graphicsFamily, const std::string& shaderDir, std::uint32_t capacity)
+    : device(device), computeFamily(computeFamily), graphicsFamily(graphicsFamily), maxParticles(capacity) {
+    if (capacity == 0 || capacity > MAX_GROUPS * PARTICLE_GROUP) {
+        throw std::runtime_error("particle capacity out of range!");
+    }
+    for (std::uint32_t i = 0; i < 2; i++) {
+        particles[i] = createBuffer(physicalDevice, device, static_cast<VkDeviceSize>(capacity) * PARTICLE_SIZE,
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    i == 0 ? "particles 0" : "particles 1");
+    }
+    state = createBuffer(physicalDevice, device, STATE_SIZE,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "particle state");
+    statsBuffer = createBuffer(physicalDevice, device, 2 * sizeof(std::uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               "particle stats");
+    std::memset(statsBuffer.mapped, 0, static_cast<std::size_t>(statsBuffer.size));
+
+    emitModule = createShaderModule(device, shaderDir + "/particle_emit.comp.spv");
+    simulateModule = createShaderModule(device, shaderDir + "/particle_simulate.comp.spv");
+    finalizeModule = createShaderModule(device, shaderDir + "/particle_finalize.comp.spv");
+    program.vertex = createShaderModule(device, shaderDir + "/particle.vert.spv");
+    program.fragment = createShaderModule(device, shaderDir + "/particle.frag.spv");
+
+    // Source, destination, state and stats.
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for (std::uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings = bindings;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &computeSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle descriptor set layout!");
+    }
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    layoutInfo.bindingCount = 1;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &drawSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle descriptor set layout!");
+    }
+
+    VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SimulatePush)};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &computeSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &computeLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle pipeline layout!");
+    }
+    pushRange = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPush)};
+    pipelineLayoutInfo.pSetLayouts = &drawSetLayout;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &program.layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle pipeline layout!");
+    }
+
+    emitPipeline = createComputePipeline(device, emitModule, computeLayout);
+    simulatePipeline = createComputePipeline(device, simulateModule, computeLayout);
+    finalizePipeline = createComputePipeline(device, finalizeModule, computeLayout);
+
+    VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * 4 + 2};
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 4;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle descriptor pool!");
+    }
+    VkDescriptorSetLayout setLayouts[4] = {computeSetLayout, computeSetLayout, drawSetLayout, drawSetLayout};
+    VkDescriptorSet sets[4];
+    VkDescriptorSetAllocateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = 4;
+    setInfo.pSetLayouts = setLayouts;
+    if (vkd.vkAllocateDescriptorSets(device, &setInfo, sets) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate particle descriptor sets!");
+    }
+    VkDescriptorBufferInfo bufferInfos[10];
+    VkWriteDescriptorSet writes[10] = {};
+    std::uint32_t writeCount = 0;
+    for (std::uint32_t i = 0; i < 2; i++) {
+        computeSets[i] = sets[i];
+        drawSets[i] = sets[2 + i];
+        VkBuffer computeBuffers[4] = {particles[i].buffer, particles[1 - i].buffer, state.buffer, statsBuffer.buffer};
+        for (std::uint32_t binding = 0; binding < 5; binding++) {
+            VkWriteDescriptorSet& write = writes[writeCount];
+            bufferInfos[writeCount] = {binding < 4 ? computeBuffers[binding] : particles[i].buffer, 0, VK_WHOLE_SIZE};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = binding < 4 ? computeSets[i] : drawSets[i];
+            write.dstBinding = binding < 4 ? binding : 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfos[writeCount];
+            writeCount++;
+        }
+    }
+    vkd.vkUpdateDescriptorSets(device, writeCount, writes, 0, nullptr);
+
+    setObjectName(device, emitModule, "particle_emit.comp");
+    setObjectName(device, simulateModule, "particle_simulate.comp");
+    setObjectName(device, finalizeModule, "particle_finalize.comp");
+    setObjectName(device, program.vertex, "particle.vert");
+    setObjectName(device, program.fragment, "particle.frag");
+    setObjectName(device, computeSetLayout, "particle compute set layout");
+    setObjectName(device, drawSetLayout, "particle draw set layout");
+    setObjectName(device, computeLayout, "particle compute pipeline layout");
+    setObjectName(device, program.layout, "particle draw pipeline layout");
+    setObjectName(device, emitPipeline, "particle emit");
+    setObjectName(device, simulatePipeline, "particle simulate");
+    setObjectName(device, finalizePipeline, "particle finalize");
+    setObjectName(device, descriptorPool, "particle descriptor pool");
+}
+
+ParticleSystem::~ParticleSystem() {
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipeline(device, finalizePipeline, nullptr);
+    vkDestroyPipeline(device, simulatePipeline, nullptr);
+    vkDestroyPipeline(device, emitPipeline, nullptr);
+    vkDestroyPipelineLayout(device, program.layout, nullptr);
+    vkDestroyPipelineLayout(device, computeLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, drawSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, computeSetLayout, nullptr);
+    vkDestroyShaderModule(device, program.fragment, nullptr);
+    vkDestroyShaderModule(device, program.vertex, nullptr);
+    vkDestroyShaderModule(device, finalizeModule, nullptr);
+    vkDestroyShaderModule(device, simulateModule, nullptr);
+    vkDestroyShaderModule(device, emitModule, nullptr);
+    destroyBuffer(device, statsBuffer);
+    destroyBuffer(device, state);
+    destroyBuffer(device, particles[1]);
+    destroyBuffer(device, particles[0]);
+}
+
+void ParticleSystem::simulate(VkCommandBuffer commandBuffer, float dt, const ParticleEmitter& emitter,
+                              const ParticleForces& forces) {
+    VT_FUNCTION_ZONE();
+    if (phase == Simulated || phase == Drawing) {
+        throw std::runtime_error("particle simulate() without acquire() and release() since the last one!");
+    }
+    CommandLabel label(commandBuffer, "particles");
+    if (phase == Fresh) {
+        vkd.vkCmdFillBuffer(commandBuffer, state.buffer, 0, STATE_SIZE, 0);
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                                 0, nullptr, 0, nullptr);
+    } else if (crossQueue()) {
+        // Take back what release() handed over; the semaphore wait made the draw's reads finish.
+        transferBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, simulateWaitStages(), 0,
+                        VK_ACCESS_SHADER_READ_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                        graphicsFamily, computeFamily);
+    }
+
+    // Whole particles only; the rest carries over to the next frame.
+    pendingEmission += static_cast<double>(std::max(emitter.rate, 0.0f)) * std::max(dt, 0.0f);
+    double whole = std::floor(pendingEmission);
+    pendingEmission -= whole;
+    std::uint64_t emitCount = pendingBurst + static_cast<std::uint64_t>(whole);
+    pendingBurst = 0;
+
+    SimulatePush push = {};
+    push.gravity[0] = forces.gravity.x;
+    push.gravity[1] = forces.gravity.y;
+    push.gravity[2] = forces.gravity.z;
+    push.gravity[3] = forces.drag;
+    push.origin[0] = emitter.origin.x;
+    push.origin[1] = emitter.origin.y;
+    push.origin[2] = emitter.origin.z;
+    push.origin[3] = emitter.radius;
+    push.direction[0] = emitter.direction.x;
+    push.direction[1] = emitter.direction.y;
+    push.direction[2] = emitter.direction.z;
+    push.direction[3] = emitter.speed;
+    push.spread[0] = std::min(std::max(emitter.spread, 0.0f), 0.99f);
+    push.spread[1] = emitter.speedJitter;
+    push.spread[2] = emitter.lifeMin;
+    push.spread[3] = std::max(emitter.lifeMax, emitter.lifeMin);
+    push.dt = dt;
+    push.floorHeight = forces.floorHeight;
+    push.bounce = forces.bounce;
+    push.emitCount = static_cast<std::uint32_t>(std::min<std::uint64_t>(emitCount, maxParticles));
+    push.seed = ++frame * 0x9E3779B9u;
+    push.capacity = maxParticles;
+    push.current = current;
+
+    vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &computeSets[current],
+                                0, nullptr);
+    vkd.vkCmdPushConstants(commandBuffer, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    // As many workgroups as the last finalize counted, without the CPU knowing how many that is.
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulatePipeline);
+    vkd.vkCmdDispatchIndirect(commandBuffer, state.buffer, DISPATCH_OFFSET);
+    passBarrier(commandBuffer);
+    if (push.emitCount > 0) {
+        vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, emitPipeline);
+        vkd.vkCmdDispatch(commandBuffer, (push.emitCount + PARTICLE_GROUP - 1) / PARTICLE_GROUP, 1, 1);
+        passBarrier(commandBuffer);
+    }
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, finalizePipeline);
+    vkd.vkCmdDispatch(commandBuffer, 1, 1, 1);
+    current = 1 - current;
+
+    VkMemoryBarrier hostBarrier = {};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                             &hostBarrier, 0, nullptr, 0, nullptr);
+    if (crossQueue()) {
+        transferBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT, 0, 0, computeFamily, graphicsFamily);
+    } else {
+        // One queue: make the results visible to the draw and to the next simulate at once.
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 drawWaitStages() | simulateWaitStages(), 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    phase = Simulated;
+}
+
+void ParticleSystem::acquire(VkCommandBuffer commandBuffer) {
+    if (phase != Simulated) {
+        throw std::runtime_error("particle acquire() without simulate()!");
+    }
+    // On one queue simulate()'s last barrier already covers the draw.
+    if (crossQueue()) {
+        transferBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, drawWaitStages(), 0, VK_ACCESS_SHADER_READ_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT, computeFamily, graphicsFamily);
+    }
+    phase = Drawing;
+}
+
+void ParticleSystem::draw(VkCommandBuffer commandBuffer, GraphicsPipelineCache& pipelines, const RenderTarget& target,
+                          const Mat4& viewProj, const Vec3& cameraRight, const Vec3& cameraUp, float size) {
+    if (phase != Drawing) {
+        throw std::runtime_error("particle draw() without acquire()!");
+    }
+    RasterState raster;
+    raster.blend = true;
+    raster.depthTest = target.depthFormat != VK_FORMAT_UNDEFINED;
+    pipelines.bind(commandBuffer, program, target, raster);
+
+    DrawPush push;
+    std::memcpy(push.viewProj, viewProj.m, sizeof(push.viewProj));
+    push.right[0] = cameraRight.x;
+    push.right[1] = cameraRight.y;
+    push.right[2] = cameraRight.z;
+    push.right[3] = size;
+    push.up[0] = cameraUp.x;
+    push.up[1] = cameraUp.y;
+    push.up[2] = cameraUp.z;
+    push.up[3] = 0;
+    vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, program.layout, 0, 1, &drawSets[current],
+                                0, nullptr);
+    vkd.vkCmdPushConstants(commandBuffer, program.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+    // The instance count is the live count finalize wrote.
+    vkd.vkCmdDrawIndirect(commandBuffer, state.buffer, DRAW_OFFSET, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void ParticleSystem::release(VkCommandBuffer commandBuffer) {
+    if (phase != Drawing) {
+        throw std::runtime_error("particle release() without acquire()!");
+    }
+    if (crossQueue()) {
+        transferBarrier(commandBuffer, drawWaitStages(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, graphicsFamily,
+                        computeFamily);
+    } else {
+        // The next simulate overwrites the state the draw read its arguments from.
+        vkd.vkCmdPipelineBarrier(commandBuffer, drawWaitStages(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                                 nullptr, 0, nullptr);
+    }
+    phase = Drawn;
+}
+
+ParticleStats ParticleSystem::stats() const {
+    const std::uint32_t* values = static_cast<const std::uint32_t*>(statsBuffer.mapped);
+    ParticleStats result;
+    result.live = values[0];
+    result.dropped = values[1];
+    return result;
+}
+
+void ParticleSystem::transferBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages,
+                                     VkPipelineStageFlags dstStages, VkAccessFlags srcAccess,
+                                     VkAccessFlags particleAccess, VkAccessFlags stateAccess, std::uint32_t srcFamily,
+                                     std::uint32_t dstFamily) {
+    VkBufferMemoryBarrier barriers[2] = {};
+    VkBuffer buffers[2] = {particles[current].buffer, state.buffer};
+    for (std::uint32_t i = 0; i < 2; i++) {
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = srcAccess;
+        barriers[i].dstAccessMask = i == 0 ? particleAccess : stateAccess;
+        barriers[i].srcQueueFamilyIndex = srcFamily;
+        barriers[i].dstQueueFamilyIndex = dstFamily;
+        barriers[i].buffer = buffers[i];
+        barriers[i].offset = 0;
+        barriers[i].size = VK_WHOLE_SIZE;
+    }
+    vkd.vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 2, barriers, 0, nullptr);
+}
@@ -0,0 +1,130 @@
+#ifndef ParticleSystem_hpp
+#define ParticleSystem_hpp
+
+#include "GraphicsPipelines.hpp"
+#include "VecMath.hpp"
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// Where particles are born and how they move at first.
+struct ParticleEmitter {
+    Vec3 origin = {0, 0, 0};
+    float radius = 0.1f;          // Of the sphere around origin they start in.
+    Vec3 direction = {0, 1, 0};   // Unit length.
+    float speed = 5.0f;
+    float spread = 0.3f;          // Random offset added to direction before normalizing; below 1.
+    float speedJitter = 0.2f;     // Fraction of speed, either way.
+    float lifeMin = 1.0f;         // Seconds.
+    float lifeMax = 3.0f;
+    float rate = 0.0f;            // Particles per second of simulated time.
+};
+
+struct ParticleForces {
+    Vec3 gravity = {0, -9.81f, 0};
+    float drag = 0.1f;        // Fraction of velocity lost per second.
+    float floorHeight = 0.0f; // Particles bounce off the plane y = floorHeight.
+    float bounce = 0.5f;      // Fraction of vertical speed kept in a bounce.
+};
+
+struct ParticleStats {
+    std::uint32_t live = 0;
+    std::uint32_t dropped = 0; // Emissions lost to a full buffer, in total.
+};
+
+// A GPU particle system. Emission, simulation and compaction of dead particles run in compute
+// shaders, and the live count goes straight from an atomic counter into the indirect arguments of
+// the draw and of the next frame's simulation, so no per-particle data ever reaches the CPU. See
+// shaders/particles.glsl for the passes.
+//
+// simulate() records on the compute queue family and acquire() / draw() / release() on the graphics
+// one. With a dedicated compute family the particle and state buffers move between the two with
+// queue family ownership transfers: simulate() ends by releasing them to graphics, acquire() takes
+// them, release() hands them back and the next simulate() takes them again. The submits must be
+// ordered with semaphores: graphics waits for the simulation at drawWaitStages(), and the next
+// simulation waits for the draw at simulateWaitStages(). On a single family the same calls record
+// plain barriers and submission order does the rest. Either way every simulate() has to be followed
+// by acquire() and release() before the next one.
+class ParticleSystem {
+public:
+    // capacity is the most live particles at once, at most 65535 * 256. shaderDir holds the
+    // particle_*.comp.spv, particle.vert.spv and particle.frag.spv shaders.
+    ParticleSystem(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t computeFamily,
+                   std::uint32_t graphicsFamily, const std::string& shaderDir, std::uint32_t capacity);
+    ~ParticleSystem();
+
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+    // Emits count more particles in the next simulate(), on top of the emitter's rate.
+    void burst(std::uint32_t count) { pendingBurst += count; }
+    // Compute command buffer: simulate and compact the live particles, then emit.
+    void simulate(VkCommandBuffer commandBuffer, float dt, const ParticleEmitter& emitter,
+                  const ParticleForces& forces = ParticleForces());
+    // Graphics command buffer, outside a render pass, before draw().
+    void acquire(VkCommandBuffer commandBuffer);
+    // Inside a render pass or dynamic rendering with target's formats; viewport and scissor are up to
+    // the caller. Camera-facing quads of size world units, blended, depth tested without writing when
+    // the target has depth.
+    void draw(VkCommandBuffer commandBuffer, GraphicsPipelineCache& pipelines, const RenderTarget& target,
+              const Mat4& viewProj, const Vec3& cameraRight, const Vec3& cameraUp, float size);
+    // Graphics command buffer, after the render pass.
+    void release(VkCommandBuffer commandBuffer);
+
+    // As of the last simulate() that finished on the GPU.
+    ParticleStats stats() const;
+    std::uint32_t capacity() const { return maxParticles; }
+    // True when simulation and drawing are on different queue families and need semaphores.
+    bool crossQueue() const { return computeFamily != graphicsFamily; }
+    static VkPipelineStageFlags drawWaitStages() {
+        return VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    }
+    static VkPipelineStageFlags simulateWaitStages() {
+        return VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+
+private:
+    enum Phase {
+        Fresh,     // Nothing recorded yet; the state buffer still needs clearing.
+        Simulated, // simulate() recorded, waiting for acquire().
+        Drawing,   // acquire() recorded.
+        Drawn,     // release() recorded.
+    };
+
+    VkDevice device;
+    std::uint32_t computeFamily;
+    std::uint32_t graphicsFamily;
+    std::uint32_t maxParticles;
+    Buffer particles[2];
+    Buffer state;     // Counts and indirect commands, see shaders/particles.glsl.
+    Buffer statsBuffer; // Host visible.
+    std::uint32_t current = 0; // Buffer the next simulate() reads; the last one drawn.
+    Phase phase = Fresh;
+    std::uint32_t pendingBurst = 0;
+    double pendingEmission = 0; // Fraction of a particle carried over between frames.
+    std::uint32_t frame = 0;
+
+    VkShaderModule emitModule = VK_NULL_HANDLE;
+    VkShaderModule simulateModule = VK_NULL_HANDLE;
+    VkShaderModule finalizeModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout computeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+    VkPipeline emitPipeline = VK_NULL_HANDLE;
+    VkPipeline simulatePipeline = VK_NULL_HANDLE;
+    VkPipeline finalizePipeline = VK_NULL_HANDLE;
+    GraphicsProgram program;
+    VkDescriptorSetLayout drawSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet computeSets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE}; // computeSets[i] reads particles[i].
+    VkDescriptorSet drawSets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};    // drawSets[i] reads particles[i].
+
+    // The buffers the graphics side uses: the one simulate() wrote, and state.
+    void transferBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+                         VkAccessFlags srcAccess, VkAccessFlags particleAccess, VkAccessFlags stateAccess,
+                         std::uint32_t srcFamily, std::uint32_t dstFamily);
+};
+
+#endif /* ParticleSystem_hpp */
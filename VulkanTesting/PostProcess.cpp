@@ -0,0 +1,391 @@
+#include "PostProcess.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    // One compute-stage binding per type, numbered in order.
+    VkDescriptorSetLayout createSetLayout(VkDevice device, const std::vector<VkDescriptorType>& types) {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+        for (std::uint32_t i = 0; i < types.size(); i++) {
+            bindings[i] = {};
+            bindings[i].binding = i;
+            bindings[i].descriptorType = types[i];
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+        VkDescriptorSetLayout setLayout;
+        if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create post-process descriptor set layout!");
+        }
+        return setLayout;
+    }
+
+    VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout, std::uint32_t pushSize) {
+        VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+        VkPipelineLayout pipelineLayout;
+        if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create post-process pipeline layout!");
+        }
+        return pipelineLayout;
+    }
+
+    // Mirrors the push constants of shaders/post_bloom_prefilter.comp.
+    struct PrefilterPush {
+        std::uint32_t extent[2];
+        float threshold;
+        float knee;
+    };
+
+    // Mirrors the push constants of shaders/post_bloom_blur.comp.
+    struct BlurPush {
+        std::uint32_t extent[2];
+        std::uint32_t horizontal;
+        std::uint32_t radius;
+    };
+
+    // Mirrors the push constants of shaders/post_composite.comp.
+    struct CompositePush {
+        float lift[4];
+        float gamma[4];
+        float gain[4];
+        std::uint32_t extent[2];
+        std::uint32_t stages;
+        float exposure;
+        float bloomIntensity;
+        float saturation;
+        float contrast;
+        float sharpness;
+    };
+
+    const std::uint32_t STAGE_TONEMAP = 1;
+    const std::uint32_t STAGE_GRADE = 2;
+    const std::uint32_t STAGE_SHARPEN = 4;
+    // Workgroup sizes of the shaders.
+    const std::uint32_t PREFILTER_GROUP = 8;
+    const std::uint32_t BLUR_RUN = 128;
+    const std::uint32_t COMPOSITE_TILE = 16;
+    const std::uint32_t MAX_BLOOM_RADIUS = 16;
+
+    // Bytes per texel of the images involved. The input is assumed RGBA16F, like RenderGraph and
+    // TemporalResolve produce.
+    const VkDeviceSize HDR_TEXEL = 8;
+    const VkDeviceSize LDR_TEXEL = 4;
+}
+
+PostProcess::PostProcess(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderDir, VkExtent2D extent,
+                         bool fused)
+    : device(device), extent(extent), fused(fused) {
+    bloomExtent = {(extent.width + 1) / 2, (extent.height + 1) / 2};
+    result = createImage(physicalDevice, device, extent, VK_FORMAT_R8G8B8A8_UNORM,
+                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                         "post-process output");
+    for (std::uint32_t i = 0; i < 2; i++) {
+        bloomImages[i] = createImage(physicalDevice, device, bloomExtent, VK_FORMAT_R16G16B16A16_SFLOAT,
+                                     VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                     i == 0 ? "bloom 0" : "bloom 1");
+        if (!fused) {
+            intermediates[i] = createImage(physicalDevice, device, extent, VK_FORMAT_R8G8B8A8_UNORM,
+                                           VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                           i == 0 ? "post-process intermediate 0" : "post-process intermediate 1");
+        }
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post-process sampler!");
+    }
+
+    prefilterModule = createShaderModule(device, shaderDir + "/post_bloom_prefilter.comp.spv");
+    blurModule = createShaderModule(device, shaderDir + "/post_bloom_blur.comp.spv");
+    compositeModule = createShaderModule(device, shaderDir + "/post_composite.comp.spv");
+    prefilterSetLayout = createSetLayout(device, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+    blurSetLayout = createSetLayout(device, {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+    compositeSetLayout = createSetLayout(device, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                  VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+    prefilterLayout = createPipelineLayout(device, prefilterSetLayout, sizeof(PrefilterPush));
+    blurLayout = createPipelineLayout(device, blurSetLayout, sizeof(BlurPush));
+    compositeLayout = createPipelineLayout(device, compositeSetLayout, sizeof(CompositePush));
+    prefilterPipeline = createComputePipeline(device, prefilterModule, prefilterLayout);
+    blurPipeline = createComputePipeline(device, blurModule, blurLayout);
+    compositePipeline = createComputePipeline(device, compositeModule, compositeLayout);
+
+    // Composite sets: fused reads the input and writes the output; unfused also goes between the
+    // intermediates, which are never both source and target of one dispatch.
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> routes = {{0, 0}};
+    if (!fused) {
+        routes = {{0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 2}, {2, 0}, {2, 1}};
+    }
+    auto compositeCount = static_cast<std::uint32_t>(routes.size());
+    VkDescriptorPoolSize poolSizes[2] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + 2 * compositeCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 + 2 * 2 + compositeCount},
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 3 + compositeCount;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post-process descriptor pool!");
+    }
+    std::vector<VkDescriptorSetLayout> setLayouts = {prefilterSetLayout, blurSetLayout, blurSetLayout};
+    setLayouts.insert(setLayouts.end(), compositeCount, compositeSetLayout);
+    std::vector<VkDescriptorSet> sets(setLayouts.size());
+    VkDescriptorSetAllocateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = static_cast<std::uint32_t>(sets.size());
+    setInfo.pSetLayouts = setLayouts.data();
+    if (vkd.vkAllocateDescriptorSets(device, &setInfo, sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate post-process descriptor sets!");
+    }
+    prefilterSet = sets[0];
+    blurSets[0] = sets[1];
+    blurSets[1] = sets[2];
+    for (std::uint32_t i = 0; i < compositeCount; i++) {
+        compositeSets[routes[i].first][routes[i].second] = sets[3 + i];
+    }
+
+    // Everything but the input: it only arrives in setInput().
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    std::vector<VkWriteDescriptorSet> writes;
+    // Writes point into imageInfos, which must not reallocate.
+    imageInfos.reserve(1 + 2 * 2 + 3 * routes.size());
+    auto write = [&](VkDescriptorSet set, std::uint32_t binding, VkDescriptorType type, VkSampler imageSampler, VkImageView view) {
+        imageInfos.push_back({imageSampler, view, VK_IMAGE_LAYOUT_GENERAL});
+        VkWriteDescriptorSet descriptorWrite = {};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = set;
+        descriptorWrite.dstBinding = binding;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = type;
+        descriptorWrite.pImageInfo = &imageInfos.back();
+        writes.push_back(descriptorWrite);
+    };
+    write(prefilterSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, bloomImages[0].view);
+    for (std::uint32_t i = 0; i < 2; i++) {
+        write(blurSets[i], 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, bloomImages[i].view);
+        write(blurSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, bloomImages[1 - i].view);
+    }
+    for (const auto& route : routes) {
+        VkDescriptorSet set = compositeSets[route.first][route.second];
+        if (route.first != 0) {
+            write(set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, intermediates[route.first - 1].view);
+        }
+        write(set, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, bloomImages[0].view);
+        write(set, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE,
+              route.second == 0 ? result.view : intermediates[route.second - 1].view);
+    }
+    vkd.vkUpdateDescriptorSets(device, static_cast<std::uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    setObjectName(device, sampler, "post-process sampler");
+    setObjectName(device, prefilterModule, "post_bloom_prefilter.comp");
+    setObjectName(device, blurModule, "post_bloom_blur.comp");
+    setObjectName(device, compositeModule, "post_composite.comp");
+    setObjectName(device, prefilterPipeline, "bloom prefilter");
+    setObjectName(device, blurPipeline, "bloom blur");
+    setObjectName(device, compositePipeline, fused ? "post-process composite (fused)" : "post-process composite");
+    setObjectName(device, descriptorPool, "post-process descriptor pool");
+}
+
+PostProcess::~PostProcess() {
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipeline(device, compositePipeline, nullptr);
+    vkDestroyPipeline(device, blurPipeline, nullptr);
+    vkDestroyPipeline(device, prefilterPipeline, nullptr);
+    vkDestroyPipelineLayout(device, compositeLayout, nullptr);
+    vkDestroyPipelineLayout(device, blurLayout, nullptr);
+    vkDestroyPipelineLayout(device, prefilterLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, compositeSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, blurSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, prefilterSetLayout, nullptr);
+    vkDestroyShaderModule(device, compositeModule, nullptr);
+    vkDestroyShaderModule(device, blurModule, nullptr);
+    vkDestroyShaderModule(device, prefilterModule, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    for (std::uint32_t i = 0; i < 2; i++) {
+        if (!fused) {
+            destroyImage(device, intermediates[i]);
+        }
+        destroyImage(device, bloomImages[i]);
+    }
+    destroyImage(device, result);
+}
+
+void PostProcess::setInput(VkImageView hdr, VkImageLayout layout) {
+    VkDescriptorImageInfo imageInfo = {sampler, hdr, layout};
+    VkWriteDescriptorSet writes[4] = {};
+    std::uint32_t count = 0;
+    for (VkDescriptorSet set : {prefilterSet, compositeSets[0][0], compositeSets[0][1], compositeSets[0][2]}) {
+        if (set == VK_NULL_HANDLE) {
+            continue;
+        }
+        VkWriteDescriptorSet& write = writes[count++];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+    }
+    vkd.vkUpdateDescriptorSets(device, count, writes, 0, nullptr);
+    hasInput = true;
+}
+
+void PostProcess::record(VkCommandBuffer commandBuffer, const PostProcessSettings& settings) {
+    if (!hasInput) {
+        throw std::runtime_error("PostProcess::record() needs setInput() first.");
+    }
+    CommandLabel label(commandBuffer, "post-process");
+    statistics = {};
+    VkDeviceSize pixels = static_cast<VkDeviceSize>(extent.width) * extent.height;
+    VkDeviceSize bloomTexels = static_cast<VkDeviceSize>(bloomExtent.width) * bloomExtent.height;
+
+    // Everything owned gets its one layout on first use. Later frames only wait for last frame's
+    // readers of the output: an execution dependency, nothing to flush.
+    if (!initialized) {
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (const Image* image : {&result, &bloomImages[0], &bloomImages[1], &intermediates[0], &intermediates[1]}) {
+            if (image->image == VK_NULL_HANDLE) {
+                continue;
+            }
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image->image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            barriers.push_back(barrier);
+        }
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 0, nullptr, 0, nullptr, static_cast<std::uint32_t>(barriers.size()), barriers.data());
+        initialized = true;
+    } else {
+        vkd.vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+    }
+    // Between dispatches: the next one reads what the last one wrote, same layout.
+    auto computeBarrier = [&]() {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 1, &barrier, 0, nullptr, 0, nullptr);
+    };
+
+    if (settings.bloom) {
+        CommandLabel bloomLabel(commandBuffer, "bloom");
+        PrefilterPush prefilter = {{bloomExtent.width, bloomExtent.height}, settings.bloomThreshold, settings.bloomKnee};
+        vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, prefilterPipeline);
+        vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, prefilterLayout, 0, 1, &prefilterSet, 0, nullptr);
+        vkd.vkCmdPushConstants(commandBuffer, prefilterLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(prefilter), &prefilter);
+        vkd.vkCmdDispatch(commandBuffer, (bloomExtent.width + PREFILTER_GROUP - 1) / PREFILTER_GROUP,
+                          (bloomExtent.height + PREFILTER_GROUP - 1) / PREFILTER_GROUP, 1);
+        statistics.bytesRead += pixels * HDR_TEXEL;
+        statistics.bytesWritten += bloomTexels * HDR_TEXEL;
+
+        // Horizontal from image 0 into 1, vertical back into 0, where the composite samples it.
+        vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, blurPipeline);
+        for (std::uint32_t horizontal : {1u, 0u}) {
+            computeBarrier();
+            BlurPush blur = {{bloomExtent.width, bloomExtent.height}, horizontal, std::min(settings.bloomRadius, MAX_BLOOM_RADIUS)};
+            std::uint32_t along = horizontal ? bloomExtent.width : bloomExtent.height;
+            std::uint32_t across = horizontal ? bloomExtent.height : bloomExtent.width;
+            vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, blurLayout, 0, 1,
+                                        &blurSets[horizontal ? 0 : 1], 0, nullptr);
+            vkd.vkCmdPushConstants(commandBuffer, blurLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(blur), &blur);
+            vkd.vkCmdDispatch(commandBuffer, (along + BLUR_RUN - 1) / BLUR_RUN, across, 1);
+            statistics.bytesRead += bloomTexels * HDR_TEXEL;
+            statistics.bytesWritten += bloomTexels * HDR_TEXEL;
+        }
+        statistics.dispatches += 3;
+        computeBarrier();
+    }
+
+    // Fused: one dispatch with every stage. Unfused: one per stage, ping-ponging between the
+    // intermediates and ending in the output.
+    std::vector<std::uint32_t> passes;
+    std::uint32_t all = STAGE_TONEMAP | (settings.grade ? STAGE_GRADE : 0) | (settings.sharpen ? STAGE_SHARPEN : 0);
+    if (fused) {
+        passes.push_back(all);
+    } else {
+        for (std::uint32_t stage : {STAGE_TONEMAP, STAGE_GRADE, STAGE_SHARPEN}) {
+            if (all & stage) passes.push_back(stage);
+        }
+    }
+    CompositePush push = {};
+    for (std::uint32_t c = 0; c < 3; c++) {
+        push.lift[c] = settings.lift[c];
+        push.gamma[c] = settings.gamma[c];
+        push.gain[c] = settings.gain[c];
+    }
+    push.extent[0] = extent.width;
+    push.extent[1] = extent.height;
+    push.exposure = settings.exposure;
+    push.bloomIntensity = settings.bloom ? settings.bloomIntensity : 0.0f;
+    push.saturation = settings.saturation;
+    push.contrast = settings.contrast;
+    push.sharpness = settings.sharpness;
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compositePipeline);
+    for (std::uint32_t i = 0; i < passes.size(); i++) {
+        bool last = i + 1 == passes.size();
+        std::uint32_t source = i == 0 ? 0 : 1 + (i - 1) % 2;
+        std::uint32_t target = last ? 0 : 1 + i % 2;
+        if (i > 0) {
+            computeBarrier();
+        }
+        push.stages = passes[i];
+        vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compositeLayout, 0, 1,
+                                    &compositeSets[source][target], 0, nullptr);
+        vkd.vkCmdPushConstants(commandBuffer, compositeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        vkd.vkCmdDispatch(commandBuffer, (extent.width + COMPOSITE_TILE - 1) / COMPOSITE_TILE,
+                          (extent.height + COMPOSITE_TILE - 1) / COMPOSITE_TILE, 1);
+        statistics.dispatches++;
+        statistics.bytesRead += pixels * (source == 0 ? HDR_TEXEL : LDR_TEXEL);
+        if (source == 0 && settings.bloom) {
+            statistics.bytesRead += bloomTexels * HDR_TEXEL;
+        }
+        statistics.bytesWritten += pixels * LDR_TEXEL;
+    }
+
+    VkImageMemoryBarrier done = {};
+    done.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    done.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    done.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    done.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    done.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    done.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    done.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    done.image = result.image;
+    done.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &done);
+}
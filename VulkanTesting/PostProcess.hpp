@@ -0,0 +1,105 @@
+#ifndef PostProcess_hpp
+#define PostProcess_hpp
+
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+struct PostProcessSettings {
+    float exposure = 1.0f;
+    // Bloom: what is brighter than threshold (with a soft knee below it), blurred at half resolution
+    // and added back before tonemapping.
+    bool bloom = true;
+    float bloomThreshold = 1.0f;
+    float bloomKnee = 0.5f;
+    float bloomIntensity = 0.08f;
+    std::uint32_t bloomRadius = 8; // Half-resolution texels, at most 16.
+    // Grading on the tonemapped color: lift, gamma and gain per channel, then contrast around 18%
+    // grey and saturation.
+    bool grade = true;
+    float lift[3] = {0.0f, 0.0f, 0.0f};
+    float gamma[3] = {1.0f, 1.0f, 1.0f};
+    float gain[3] = {1.0f, 1.0f, 1.0f};
+    float contrast = 1.0f;
+    float saturation = 1.0f;
+    // Contrast adaptive sharpening, 0..1.
+    bool sharpen = true;
+    float sharpness = 0.5f;
+};
+
+// What the last record() did, for logs and benchmarks. Bytes count full image reads and writes
+// of the chain, bloom included, as if nothing stayed in caches.
+struct PostProcessStats {
+    std::uint32_t dispatches = 0;
+    VkDeviceSize bytesRead = 0;
+    VkDeviceSize bytesWritten = 0;
+};
+
+// Bloom, tonemapping, color grading and sharpening as compute passes from a linear HDR frame to a
+// display-ready sRGB-encoded RGBA8 image. The per-pixel stages run fused in one dispatch, so the
+// frame is read and written once; the bloom blur loads its rows into shared memory once instead of
+// fetching every texel per tap. fused = false runs every stage as its own full-screen pass through
+// an intermediate image, for comparison.
+//
+// The input is sampled in whatever layout the caller leaves it in, e.g. straight from a
+// RenderGraph attachment in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. Every image the chain owns
+// stays in VK_IMAGE_LAYOUT_GENERAL for its whole life: dispatches are separated by memory barriers,
+// never layout transitions.
+class PostProcess {
+public:
+    // shaderDir holds post_bloom_prefilter.comp.spv, post_bloom_blur.comp.spv and
+    // post_composite.comp.spv.
+    PostProcess(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderDir, VkExtent2D extent,
+                bool fused = true);
+    ~PostProcess();
+
+    PostProcess(const PostProcess&) = delete;
+    PostProcess& operator=(const PostProcess&) = delete;
+
+    // Linear HDR color at the output extent. Must be set before the first record().
+    void setInput(VkImageView hdr, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // The input must be written and visible to compute shaders. Leaves the result in output(), in
+    // VK_IMAGE_LAYOUT_GENERAL, readable by compute and fragment shaders and transfers.
+    void record(VkCommandBuffer commandBuffer, const PostProcessSettings& settings);
+
+    const Image& output() const { return result; }
+    const PostProcessStats& stats() const { return statistics; }
+
+private:
+    VkDevice device;
+    VkExtent2D extent;
+    VkExtent2D bloomExtent;
+    bool fused;
+    Image result;
+    Image bloomImages[2];   // Half resolution RGBA16F: prefilter and vertical blur write 0, horizontal 1.
+    Image intermediates[2]; // Unfused only: output of every stage but the last, in turn.
+    bool hasInput = false;
+    bool initialized = false; // Owned images still in VK_IMAGE_LAYOUT_UNDEFINED until the first record().
+    PostProcessStats statistics;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkShaderModule prefilterModule = VK_NULL_HANDLE;
+    VkShaderModule blurModule = VK_NULL_HANDLE;
+    VkShaderModule compositeModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout prefilterSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout blurSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout compositeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout prefilterLayout = VK_NULL_HANDLE;
+    VkPipelineLayout blurLayout = VK_NULL_HANDLE;
+    VkPipelineLayout compositeLayout = VK_NULL_HANDLE;
+    VkPipeline prefilterPipeline = VK_NULL_HANDLE;
+    VkPipeline blurPipeline = VK_NULL_HANDLE;
+    VkPipeline compositePipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet prefilterSet = VK_NULL_HANDLE;
+    VkDescriptorSet blurSets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE}; // blurSets[i] reads bloomImages[i].
+    // compositeSets[source][target]: source 0 is the input, target 0 the output, 1 and 2 the
+    // intermediates. Fused only uses [0][0].
+    VkDescriptorSet compositeSets[3][3] = {};
+};
+
+#endif /* PostProcess_hpp */
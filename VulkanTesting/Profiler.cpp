@@ -0,0 +1,222 @@
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    struct ZoneEvent {
+        const ZoneSource* source;
+        std::uint64_t begin;
+        std::uint64_t end;
+    };
+
+    // Written only by its thread, drained only under the profiler lock: single producer, single
+    // consumer, so head and tail are the only shared state.
+    struct ThreadRing {
+        static const std::size_t CAPACITY = 1 << 14; // Power of two.
+        ZoneEvent events[CAPACITY];
+        std::atomic<std::uint64_t> head{0}; // Next slot to write. Producer only.
+        std::atomic<std::uint64_t> tail{0}; // Next slot to read. Consumer only.
+        std::atomic<std::uint64_t> dropped{0};
+        std::uint32_t track = 0;
+        std::string name;
+    };
+
+    struct CollectedZone {
+        const ZoneSource* source;
+        std::uint64_t begin;
+        std::uint64_t end;
+        std::uint32_t track;
+    };
+
+    // Rings are owned here rather than by the thread, so zones of threads that already exited can
+    // still be collected.
+    struct ProfilerState {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadRing>> rings;
+        std::map<std::string, std::uint32_t> gpuTracks; // Queue name -> track.
+        std::vector<CollectedZone> zones;
+        std::uint64_t zonesDropped = 0; // Collected past MAX_ZONES.
+        std::uint64_t origin = 0;
+        std::uint32_t nextTrack = 1;
+    };
+
+    // 64 MiB of collected zones. A profile that long is past reading anyway, and an app left running
+    // with the profiler on must not grow without bound.
+    const std::size_t MAX_ZONES = std::size_t(1) << 21;
+
+    ProfilerState& state() {
+        static ProfilerState* instance = new ProfilerState(); // Never destroyed: threads may outlive statics.
+        return *instance;
+    }
+
+    thread_local ThreadRing* threadRing = nullptr;
+    thread_local std::string threadName; // Kept here until the thread records its first zone.
+
+    // Only called while recording, so threads of a run without --profile never allocate a ring.
+    ThreadRing& ring() {
+        if (threadRing == nullptr) {
+            ProfilerState& s = state();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            std::unique_ptr<ThreadRing> created(new ThreadRing());
+            created->track = s.nextTrack++;
+            created->name = threadName.empty() ? "thread " + std::to_string(created->track) : threadName;
+            threadRing = created.get();
+            s.rings.push_back(std::move(created));
+        }
+        return *threadRing;
+    }
+
+    void writeEscaped(std::ostream& out, const char* s) {
+        out << '"';
+        for (; *s != '\0'; s++) {
+            if (*s == '"' || *s == '\\') {
+                out << '\\' << *s;
+            } else if (static_cast<unsigned char>(*s) >= 0x20) {
+                out << *s;
+            }
+        }
+        out << '"';
+    }
+}
+
+std::atomic<bool> Profiler::recording{false};
+
+void Profiler::start() {
+    ProfilerState& s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.origin == 0) {
+            s.origin = now();
+        }
+    }
+    recording.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::stop() {
+    recording.store(false, std::memory_order_relaxed);
+}
+
+std::uint64_t Profiler::now() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    threadName = name;
+    if (threadRing != nullptr) {
+        std::lock_guard<std::mutex> lock(state().mutex);
+        threadRing->name = name;
+    }
+}
+
+void Profiler::record(const ZoneSource* source, std::uint64_t beginNs, std::uint64_t endNs) {
+    ThreadRing& r = ring();
+    std::uint64_t head = r.head.load(std::memory_order_relaxed);
+    if (head - r.tail.load(std::memory_order_acquire) >= ThreadRing::CAPACITY) {
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    r.events[head & (ThreadRing::CAPACITY - 1)] = {source, beginNs, endNs};
+    r.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::gpuZone(const ZoneSource* source, const std::string& queue, std::uint64_t beginNs, std::uint64_t endNs) {
+    if (!enabled()) {
+        return;
+    }
+    ProfilerState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto track = s.gpuTracks.find(queue);
+    if (track == s.gpuTracks.end()) {
+        track = s.gpuTracks.emplace(queue, s.nextTrack++).first;
+    }
+    if (s.zones.size() < MAX_ZONES) {
+        s.zones.push_back({source, beginNs, endNs, track->second});
+    } else {
+        s.zonesDropped++;
+    }
+}
+
+void Profiler::collect() {
+    ProfilerState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (auto& r : s.rings) {
+        std::uint64_t tail = r->tail.load(std::memory_order_relaxed);
+        std::uint64_t head = r->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            const ZoneEvent& e = r->events[tail & (ThreadRing::CAPACITY - 1)];
+            if (s.zones.size() < MAX_ZONES) {
+                s.zones.push_back({e.source, e.begin, e.end, r->track});
+            } else {
+                s.zonesDropped++;
+            }
+        }
+        r->tail.store(tail, std::memory_order_release);
+    }
+}
+
+std::uint64_t Profiler::droppedZones() {
+    ProfilerState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::uint64_t dropped = s.zonesDropped;
+    for (auto& r : s.rings) {
+        dropped += r->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void Profiler::writeTrace(const std::string& path) {
+    collect();
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("failed to open profile output " + path);
+    }
+    ProfilerState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    // Chrome trace event format: timestamps in microseconds, one tid per track.
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) out << ",\n";
+        first = false;
+    };
+    for (auto& r : s.rings) {
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->track << ",\"args\":{\"name\":";
+        writeEscaped(out, r->name.c_str());
+        out << "}}";
+    }
+    for (auto& track : s.gpuTracks) {
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.second << ",\"args\":{\"name\":";
+        writeEscaped(out, ("GPU " + track.first).c_str());
+        out << "}}";
+    }
+    out.precision(3);
+    out << std::fixed;
+    for (const CollectedZone& zone : s.zones) {
+        // Zones from before start() (GPU timestamps converted late) are clamped to the origin.
+        std::uint64_t begin = zone.begin > s.origin ? zone.begin - s.origin : 0;
+        std::uint64_t end = zone.end > s.origin ? zone.end - s.origin : 0;
+        separator();
+        out << "{\"name\":";
+        writeEscaped(out, zone.source->name);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << zone.track
+            << ",\"ts\":" << begin / 1000.0 << ",\"dur\":" << (end > begin ? end - begin : 0) / 1000.0
+            << ",\"args\":{\"function\":";
+        writeEscaped(out, zone.source->function);
+        out << ",\"file\":";
+        writeEscaped(out, zone.source->file);
+        out << ",\"line\":" << zone.source->line << "}}";
+    }
+    out << "\n]}\n";
+    if (!out) {
+        throw std::runtime_error("failed to write profile output " + path);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Static description of a zone. One per VT_ZONE site, so events only carry a pointer to it.
+struct ZoneSource {
+    const char* name;
+    const char* function;
+    const char* file;
+    std::uint32_t line;
+};
+
+// Instrumentation profiler. Zones are RAII scopes; each thread writes finished zones into its own
+// single-producer ring, so recording is two clock reads and a store with no locks. collect() drains
+// the rings (call it once a frame so they don't overflow) and writeTrace() emits Chrome trace JSON,
+// which chrome://tracing and Perfetto open. GPU work measured with timestamp queries is added with
+// gpuZone() and shows up as its own track on the same timeline.
+//
+// Disabled until start(); a disabled zone costs one relaxed load. Define VT_DISABLE_PROFILER to
+// compile the macros out entirely.
+class Profiler {
+public:
+    static void start();
+    static void stop();
+    static bool enabled() { return recording.load(std::memory_order_relaxed); }
+
+    // Nanoseconds on the profiler clock (steady_clock). GPU zones must be converted to this clock.
+    static std::uint64_t now();
+
+    // Shown as the track name in the trace. Call from the thread itself. Cheap while disabled: the
+    // thread's ring is only allocated once it records a zone.
+    static void setThreadName(const std::string& name);
+
+    // A zone that ran on a GPU queue. source must have static storage duration.
+    static void gpuZone(const ZoneSource* source, const std::string& queue, std::uint64_t beginNs, std::uint64_t endNs);
+
+    // Moves finished zones from the per-thread rings into the profiler. Thread safe.
+    static void collect();
+    // Collects, then writes everything recorded so far. Throws std::runtime_error if the file can't be written.
+    static void writeTrace(const std::string& path);
+    // Zones lost because a ring was full between two collect() calls, or because the profiler
+    // already holds its maximum of collected zones.
+    static std::uint64_t droppedZones();
+
+    static void record(const ZoneSource* source, std::uint64_t beginNs, std::uint64_t endNs);
+
+private:
+    static std::atomic<bool> recording;
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const ZoneSource* source)
+        : source(Profiler::enabled() ? source : nullptr), begin(this->source ? Profiler::now() : 0) {}
+    ~ProfileZone() {
+        if (source != nullptr) {
+            Profiler::record(source, begin, Profiler::now());
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const ZoneSource* source;
+    std::uint64_t begin;
+};
+
+#define VT_CONCAT_INNER(a, b) a##b
+#define VT_CONCAT(a, b) VT_CONCAT_INNER(a, b)
+
+#ifdef VT_DISABLE_PROFILER
+#define VT_ZONE(name)
+#define VT_FUNCTION_ZONE()
+#else
+// Profiles the rest of the enclosing scope under a string literal name.
+#define VT_ZONE(name)                                                                                \
+    static const ZoneSource VT_CONCAT(vtZoneSource, __LINE__) = {name, __func__, __FILE__, __LINE__}; \
+    ProfileZone VT_CONCAT(vtZone, __LINE__)(&VT_CONCAT(vtZoneSource, __LINE__))
+#define VT_FUNCTION_ZONE() VT_ZONE(__func__)
+#endif
+
+#endif /* Profiler_hpp */
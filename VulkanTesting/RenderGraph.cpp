@@ -0,0 +1,436 @@
+#include "RenderGraph.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    bool writes(AttachmentUse use) {
+        return use == AttachmentUse::Color || use == AttachmentUse::Depth;
+    }
+
+    VkImageLayout layoutFor(AttachmentUse use) {
+        switch (use) {
+            case AttachmentUse::Color: return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            case AttachmentUse::Depth:
+            case AttachmentUse::DepthTest: return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            default: return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+    }
+
+    VkPipelineStageFlags stagesFor(AttachmentUse use) {
+        switch (use) {
+            case AttachmentUse::Color: return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            case AttachmentUse::Depth:
+            case AttachmentUse::DepthTest: return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            default: return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        }
+    }
+
+    // Everything the use may access, for the destination of a dependency.
+    VkAccessFlags accessFor(AttachmentUse use) {
+        switch (use) {
+            case AttachmentUse::Color: return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            case AttachmentUse::Depth: return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            case AttachmentUse::DepthTest: return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+            default: return VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        }
+    }
+
+    // Only writes need to be made available; reads before writes need an execution dependency only.
+    VkAccessFlags writeAccessFor(AttachmentUse use) {
+        switch (use) {
+            case AttachmentUse::Color: return VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            case AttachmentUse::Depth: return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            default: return 0;
+        }
+    }
+
+    VkImageUsageFlags usageFor(AttachmentUse use) {
+        switch (use) {
+            case AttachmentUse::Color: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            case AttachmentUse::Depth:
+            case AttachmentUse::DepthTest: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            case AttachmentUse::Input: return VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+            default: return VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+    }
+
+    VkDeviceSize bytesPerPixel(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8_UNORM:
+            case VK_FORMAT_R8_UINT: return 1;
+            case VK_FORMAT_R8G8_UNORM:
+            case VK_FORMAT_R16_SFLOAT:
+            case VK_FORMAT_D16_UNORM: return 2;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+            case VK_FORMAT_R32G32_SFLOAT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT: return 8;
+            case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+            default: return 4;
+        }
+    }
+
+    const char* loadOpName(VkAttachmentLoadOp op) {
+        return op == VK_ATTACHMENT_LOAD_OP_LOAD ? "load" : op == VK_ATTACHMENT_LOAD_OP_CLEAR ? "clear" : "dont_care";
+    }
+}
+
+RenderGraph::RenderGraph(VkPhysicalDevice physicalDevice, VkDevice device)
+    : physicalDevice(physicalDevice), device(device) {
+}
+
+RenderGraph::~RenderGraph() {
+    release();
+}
+
+std::uint32_t RenderGraph::addAttachment(const RenderGraphAttachment& attachment) {
+    attachmentInfos.push_back(attachment);
+    return static_cast<std::uint32_t>(attachmentInfos.size() - 1);
+}
+
+std::uint32_t RenderGraph::addPass(const RenderGraphPass& pass) {
+    bool hasDepth = false;
+    for (std::size_t i = 0; i < pass.uses.size(); i++) {
+        if (pass.uses[i].attachment >= attachmentInfos.size()) {
+            throw std::runtime_error("render graph pass '" + pass.name + "' uses an unknown attachment!");
+        }
+        for (std::size_t j = 0; j < i; j++) {
+            if (pass.uses[j].attachment == pass.uses[i].attachment) {
+                throw std::runtime_error("render graph pass '" + pass.name + "' uses '" +
+                                         attachmentInfos[pass.uses[i].attachment].name + "' twice!");
+            }
+        }
+        bool depth = pass.uses[i].use == AttachmentUse::Depth || pass.uses[i].use == AttachmentUse::DepthTest;
+        if (depth && hasDepth) {
+            throw std::runtime_error("render graph pass '" + pass.name + "' has two depth attachments!");
+        }
+        hasDepth |= depth;
+    }
+    passes.push_back(pass);
+    return static_cast<std::uint32_t>(passes.size() - 1);
+}
+
+void RenderGraph::release() {
+    for (Group& group : groups) {
+        vkDestroyFramebuffer(device, group.framebuffer, nullptr);
+        vkDestroyRenderPass(device, group.renderPass, nullptr);
+    }
+    for (Image& image : images) {
+        if (image.image != VK_NULL_HANDLE) {
+            destroyImage(device, image);
+        }
+    }
+    groups.clear();
+    images.clear();
+    statistics = RenderGraphStats();
+}
+
+void RenderGraph::compile(VkExtent2D newExtent, bool merge) {
+    release();
+    extent = newExtent;
+
+    // Grouping: a pass starts a new render pass only if it samples something the current one writes.
+    passGroup.assign(passes.size(), 0);
+    passSubpass.assign(passes.size(), 0);
+    for (std::uint32_t p = 0; p < passes.size(); p++) {
+        bool join = merge && !groups.empty();
+        for (std::size_t u = 0; join && u < passes[p].uses.size(); u++) {
+            if (passes[p].uses[u].use != AttachmentUse::Sampled) continue;
+            for (std::uint32_t earlier : groups.back().passes) {
+                for (const RenderGraphPass::Use& use : passes[earlier].uses) {
+                    if (use.attachment == passes[p].uses[u].attachment && writes(use.use)) {
+                        join = false;
+                    }
+                }
+            }
+        }
+        if (!join) {
+            groups.emplace_back();
+        }
+        passGroup[p] = static_cast<std::uint32_t>(groups.size() - 1);
+        passSubpass[p] = static_cast<std::uint32_t>(groups.back().passes.size());
+        groups.back().passes.push_back(p);
+    }
+
+    // Transient: used in one group only, written there before anything reads it, never sampled and
+    // not needed after the frame. Then it never has to be stored.
+    std::vector<bool> transient(attachmentInfos.size(), false);
+    for (std::uint32_t a = 0; a < attachmentInfos.size(); a++) {
+        bool candidate = !attachmentInfos[a].external;
+        bool seen = false;
+        std::uint32_t group = 0;
+        for (std::uint32_t p = 0; p < passes.size() && candidate; p++) {
+            for (const RenderGraphPass::Use& use : passes[p].uses) {
+                if (use.attachment != a) continue;
+                if (use.use == AttachmentUse::Sampled || (seen && passGroup[p] != group) || (!seen && !writes(use.use))) {
+                    candidate = false;
+                }
+                seen = true;
+                group = passGroup[p];
+            }
+        }
+        transient[a] = candidate && seen;
+    }
+
+    // Attachments, created for every use the graph makes of them.
+    images.resize(attachmentInfos.size());
+    for (std::uint32_t a = 0; a < attachmentInfos.size(); a++) {
+        VkImageUsageFlags usage = 0;
+        for (const RenderGraphPass& pass : passes) {
+            for (const RenderGraphPass::Use& use : pass.uses) {
+                if (use.attachment == a) usage |= usageFor(use.use);
+            }
+        }
+        if (usage == 0) continue;
+        if (transient[a]) {
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        } else {
+            // Stored attachments end in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+            usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+            if (attachmentInfos[a].external) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        images[a] = createImage(physicalDevice, device, extent, attachmentInfos[a].format, usage, attachmentInfos[a].name.c_str());
+        if (transient[a]) {
+            statistics.transientAttachments++;
+            if (images[a].lazilyAllocated) statistics.lazilyAllocated++;
+        }
+    }
+
+    for (Group& group : groups) {
+        createRenderPass(group, transient);
+        VkDeviceSize pixels = static_cast<VkDeviceSize>(extent.width) * extent.height;
+        for (std::size_t i = 0; i < group.attachments.size(); i++) {
+            VkDeviceSize bytes = pixels * bytesPerPixel(attachmentInfos[group.attachments[i]].format);
+            if (group.loadOps[i] == VK_ATTACHMENT_LOAD_OP_LOAD) statistics.bytesLoaded += bytes;
+            if (group.storeOps[i] == VK_ATTACHMENT_STORE_OP_STORE) statistics.bytesStored += bytes;
+        }
+    }
+    statistics.renderPasses = static_cast<std::uint32_t>(groups.size());
+    statistics.subpasses = static_cast<std::uint32_t>(passes.size());
+}
+
+void RenderGraph::createRenderPass(Group& group, const std::vector<bool>& transient) {
+    std::uint32_t groupIndex = passGroup[group.passes.front()];
+    std::uint32_t subpassCount = static_cast<std::uint32_t>(group.passes.size());
+
+    // Render pass attachments in order of first use; local[a] is the index of graph attachment a.
+    std::vector<std::uint32_t> local(attachmentInfos.size(), VK_ATTACHMENT_UNUSED);
+    for (std::uint32_t p : group.passes) {
+        for (const RenderGraphPass::Use& use : passes[p].uses) {
+            if (use.use != AttachmentUse::Sampled && local[use.attachment] == VK_ATTACHMENT_UNUSED) {
+                local[use.attachment] = static_cast<std::uint32_t>(group.attachments.size());
+                group.attachments.push_back(use.attachment);
+            }
+        }
+    }
+
+    std::vector<VkAttachmentDescription> descriptions;
+    for (std::uint32_t a : group.attachments) {
+        bool writtenBefore = false;
+        bool usedAfter = false;
+        AttachmentUse lastUse = AttachmentUse::Color;
+        for (std::uint32_t p = 0; p < passes.size(); p++) {
+            for (const RenderGraphPass::Use& use : passes[p].uses) {
+                if (use.attachment != a) continue;
+                if (passGroup[p] < groupIndex && writes(use.use)) writtenBefore = true;
+                if (passGroup[p] > groupIndex) usedAfter = true;
+                if (passGroup[p] == groupIndex) lastUse = use.use;
+            }
+        }
+        bool store = !transient[a] && (attachmentInfos[a].external || usedAfter);
+
+        VkAttachmentDescription description = {};
+        description.format = attachmentInfos[a].format;
+        description.samples = VK_SAMPLE_COUNT_1_BIT;
+        description.loadOp = writtenBefore ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        description.storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout = writtenBefore ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        description.finalLayout = store ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : layoutFor(lastUse);
+        descriptions.push_back(description);
+        group.loadOps.push_back(description.loadOp);
+        group.storeOps.push_back(description.storeOp);
+    }
+
+    // Subpasses. The references must stay put until vkCreateRenderPass, hence the reserve.
+    std::vector<std::vector<VkAttachmentReference>> colors(subpassCount), inputs(subpassCount);
+    std::vector<VkAttachmentReference> depths(subpassCount, {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+    std::vector<std::vector<std::uint32_t>> preserves(subpassCount);
+    std::vector<VkSubpassDescription> subpasses(subpassCount);
+    for (std::uint32_t s = 0; s < subpassCount; s++) {
+        for (const RenderGraphPass::Use& use : passes[group.passes[s]].uses) {
+            if (use.use == AttachmentUse::Sampled) continue;
+            VkAttachmentReference reference = {local[use.attachment], layoutFor(use.use)};
+            if (use.use == AttachmentUse::Color) colors[s].push_back(reference);
+            else if (use.use == AttachmentUse::Input) inputs[s].push_back(reference);
+            else depths[s] = reference;
+        }
+    }
+    // Attachments a subpass doesn't touch, between two that do, must be preserved for the later one.
+    for (std::uint32_t i = 0; i < group.attachments.size(); i++) {
+        std::vector<bool> uses(subpassCount, false);
+        std::uint32_t first = subpassCount, last = 0;
+        for (std::uint32_t s = 0; s < subpassCount; s++) {
+            for (const RenderGraphPass::Use& use : passes[group.passes[s]].uses) {
+                if (use.attachment == group.attachments[i] && use.use != AttachmentUse::Sampled) {
+                    uses[s] = true;
+                    first = std::min(first, s);
+                    last = s;
+                }
+            }
+        }
+        for (std::uint32_t s = first + 1; s < last; s++) {
+            if (!uses[s]) preserves[s].push_back(i);
+        }
+    }
+    for (std::uint32_t s = 0; s < subpassCount; s++) {
+        VkSubpassDescription& subpass = subpasses[s];
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.inputAttachmentCount = static_cast<std::uint32_t>(inputs[s].size());
+        subpass.pInputAttachments = inputs[s].data();
+        subpass.colorAttachmentCount = static_cast<std::uint32_t>(colors[s].size());
+        subpass.pColorAttachments = colors[s].data();
+        subpass.pDepthStencilAttachment = depths[s].attachment != VK_ATTACHMENT_UNUSED ? &depths[s] : nullptr;
+        subpass.preserveAttachmentCount = static_cast<std::uint32_t>(preserves[s].size());
+        subpass.pPreserveAttachments = preserves[s].data();
+    }
+
+    // Dependencies: each use waits for the previous subpass that touched the same attachment. By
+    // region, which is what lets a tiler run the whole group tile by tile.
+    std::vector<VkSubpassDependency> dependencies;
+    for (std::uint32_t t = 1; t < subpassCount; t++) {
+        for (const RenderGraphPass::Use& use : passes[group.passes[t]].uses) {
+            if (use.use == AttachmentUse::Sampled) continue;
+            for (std::uint32_t s = t; s-- > 0;) {
+                const RenderGraphPass::Use* previous = nullptr;
+                for (const RenderGraphPass::Use& candidate : passes[group.passes[s]].uses) {
+                    if (candidate.attachment == use.attachment && candidate.use != AttachmentUse::Sampled) {
+                        previous = &candidate;
+                    }
+                }
+                if (previous == nullptr) continue;
+                VkSubpassDependency* dependency = nullptr;
+                for (VkSubpassDependency& existing : dependencies) {
+                    if (existing.srcSubpass == s && existing.dstSubpass == t) dependency = &existing;
+                }
+                if (dependency == nullptr) {
+                    dependencies.push_back({s, t, 0, 0, 0, 0, VK_DEPENDENCY_BY_REGION_BIT});
+                    dependency = &dependencies.back();
+                }
+                dependency->srcStageMask |= stagesFor(previous->use);
+                dependency->srcAccessMask |= writeAccessFor(previous->use);
+                dependency->dstStageMask |= stagesFor(use.use);
+                dependency->dstAccessMask |= accessFor(use.use);
+                break;
+            }
+        }
+    }
+    // Around the group: earlier passes' attachment writes and sampled reads in, reads by later
+    // fragment and compute shaders or transfers out.
+    VkSubpassDependency enter = {};
+    enter.srcSubpass = VK_SUBPASS_EXTERNAL;
+    enter.dstSubpass = 0;
+    enter.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    enter.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    enter.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    enter.dstAccessMask = accessFor(AttachmentUse::Color) | accessFor(AttachmentUse::Depth) | accessFor(AttachmentUse::Input) |
+                          VK_ACCESS_SHADER_READ_BIT;
+    dependencies.push_back(enter);
+    VkSubpassDependency leave = {};
+    leave.srcSubpass = subpassCount - 1;
+    leave.dstSubpass = VK_SUBPASS_EXTERNAL;
+    leave.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    leave.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    leave.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    leave.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    dependencies.push_back(leave);
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<std::uint32_t>(descriptions.size());
+    renderPassInfo.pAttachments = descriptions.data();
+    renderPassInfo.subpassCount = subpassCount;
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<std::uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &group.renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+
+    std::vector<VkImageView> views;
+    for (std::uint32_t a : group.attachments) {
+        views.push_back(images[a].view);
+    }
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = group.renderPass;
+    framebufferInfo.attachmentCount = static_cast<std::uint32_t>(views.size());
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
+    framebufferInfo.layers = 1;
+    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &group.framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+
+    std::string name;
+    for (std::uint32_t p : group.passes) {
+        name += (name.empty() ? "" : "+") + passes[p].name;
+    }
+    setObjectName(device, group.renderPass, name);
+    setObjectName(device, group.framebuffer, name);
+}
+
+void RenderGraph::record(VkCommandBuffer commandBuffer) const {
+    for (const Group& group : groups) {
+        std::vector<VkClearValue> clearValues;
+        for (std::uint32_t a : group.attachments) {
+            clearValues.push_back(attachmentInfos[a].clearValue);
+        }
+        VkRenderPassBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        beginInfo.renderPass = group.renderPass;
+        beginInfo.framebuffer = group.framebuffer;
+        beginInfo.renderArea = {{0, 0}, extent};
+        beginInfo.clearValueCount = static_cast<std::uint32_t>(clearValues.size());
+        beginInfo.pClearValues = clearValues.data();
+        vkd.vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        for (std::size_t s = 0; s < group.passes.size(); s++) {
+            if (s > 0) {
+                vkd.vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+            }
+            const RenderGraphPass& pass = passes[group.passes[s]];
+            CommandLabel label(commandBuffer, pass.name.c_str());
+            if (pass.record) {
+                pass.record(commandBuffer);
+            }
+        }
+        vkd.vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+std::string RenderGraph::describe() const {
+    std::ostringstream out;
+    for (std::size_t g = 0; g < groups.size(); g++) {
+        const Group& group = groups[g];
+        out << "render pass " << g << ":";
+        for (std::size_t s = 0; s < group.passes.size(); s++) {
+            out << (s == 0 ? " " : " > ") << passes[group.passes[s]].name;
+        }
+        out << " |";
+        for (std::size_t i = 0; i < group.attachments.size(); i++) {
+            const Image& image = images[group.attachments[i]];
+            out << " " << attachmentInfos[group.attachments[i]].name << "=" << loadOpName(group.loadOps[i]) << "/"
+                << (group.storeOps[i] == VK_ATTACHMENT_STORE_OP_STORE ? "store" : "dont_care");
+            if (image.lazilyAllocated) out << "/lazy";
+        }
+        out << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,117 @@
+#ifndef RenderGraph_hpp
+#define RenderGraph_hpp
+
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// How a pass touches an attachment.
+enum class AttachmentUse {
+    Color,     // Written as a color attachment.
+    Depth,     // Depth tested and written.
+    DepthTest, // Depth tested only.
+    Input,     // Read at the pixel being shaded, as an input attachment (subpassInput in GLSL).
+    Sampled,   // Read anywhere through a sampler, so the writer must have finished the whole image.
+};
+
+struct RenderGraphAttachment {
+    std::string name;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    // Still needed after the graph (presented, copied out, read by next frame): always stored.
+    bool external = false;
+    // Used by the first pass that writes the attachment.
+    VkClearValue clearValue = {};
+};
+
+struct RenderGraphPass {
+    struct Use {
+        std::uint32_t attachment;
+        AttachmentUse use;
+    };
+    std::string name;
+    std::vector<Use> uses;
+    // Records the draws, inside this pass's subpass. Viewport and scissor are the caller's.
+    std::function<void(VkCommandBuffer)> record;
+};
+
+// What compile() decided, for logs and benchmarks.
+struct RenderGraphStats {
+    std::uint32_t renderPasses = 0;
+    std::uint32_t subpasses = 0;
+    std::uint32_t transientAttachments = 0; // Never leave the render pass that produces them.
+    std::uint32_t lazilyAllocated = 0;      // Transient ones the device doesn't even back with memory.
+    VkDeviceSize bytesLoaded = 0;           // Attachment traffic between tile memory and DRAM per frame,
+    VkDeviceSize bytesStored = 0;           // from the load and store ops.
+};
+
+// A frame's raster passes in submission order. compile() groups consecutive passes into subpasses
+// of one VkRenderPass whenever nothing between them needs the whole image: on tile-based GPUs
+// the G-buffer then never leaves tile memory, the lighting subpass reads it through input
+// attachments, and attachments nothing reads after the group are transient and need no memory.
+// Desktop GPUs treat the subpasses like separate passes, so nothing is lost there.
+//
+// A pass joins the group of the pass before it unless it samples an attachment written in that
+// group. Input attachments read the same pixel in either case, so shaders don't change when
+// merging is turned off: a separate pass just loads the attachment instead of keeping it on chip.
+class RenderGraph {
+public:
+    RenderGraph(VkPhysicalDevice physicalDevice, VkDevice device);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    std::uint32_t addAttachment(const RenderGraphAttachment& attachment);
+    std::uint32_t addPass(const RenderGraphPass& pass);
+
+    // Groups passes, creates render passes, attachments and framebuffers at extent. Call again
+    // after a resize, then recreate the pipelines: render passes may change. merge = false gives
+    // every pass its own render pass, for comparison.
+    void compile(VkExtent2D extent, bool merge = true);
+
+    // Records every group. Attachments end in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when stored.
+    void record(VkCommandBuffer commandBuffer) const;
+
+    // For pipeline creation after compile().
+    VkRenderPass renderPass(std::uint32_t pass) const { return groups[passGroup[pass]].renderPass; }
+    std::uint32_t subpass(std::uint32_t pass) const { return passSubpass[pass]; }
+    // For input attachment and sampler descriptors.
+    VkImageView view(std::uint32_t attachment) const { return images[attachment].view; }
+    const Image& image(std::uint32_t attachment) const { return images[attachment]; }
+
+    const RenderGraphStats& stats() const { return statistics; }
+    // One line per render pass with its subpasses and how every attachment is loaded and stored.
+    std::string describe() const;
+
+private:
+    struct Group {
+        std::vector<std::uint32_t> passes;
+        std::vector<std::uint32_t> attachments; // Graph attachment of each render pass attachment.
+        std::vector<VkAttachmentLoadOp> loadOps;
+        std::vector<VkAttachmentStoreOp> storeOps;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkExtent2D extent = {0, 0};
+    std::vector<RenderGraphAttachment> attachmentInfos;
+    std::vector<RenderGraphPass> passes;
+
+    std::vector<Group> groups;
+    std::vector<std::uint32_t> passGroup;
+    std::vector<std::uint32_t> passSubpass;
+    std::vector<Image> images;
+    RenderGraphStats statistics;
+
+    void release();
+    void createRenderPass(Group& group, const std::vector<bool>& transient);
+};
+
+#endif /* RenderGraph_hpp */
@@ -0,0 +1,265 @@
+#include "ShadingRate.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    std::uint32_t floorLog2(std::uint32_t value) {
+        std::uint32_t result = 0;
+        while (value > 1) {
+            value >>= 1;
+            result++;
+        }
+        return result;
+    }
+
+    // Mirrors the push constants of shaders/shading_rate.comp.
+    struct RatePush {
+        std::uint32_t framebufferExtent[2];
+        std::uint32_t tileSize[2];
+        float gaze[2];
+        float fovealRadius;
+        float peripheralRadius;
+        float contrastThreshold;
+        std::uint32_t contentAdaptive;
+        std::uint32_t maxRateLog2[2];
+        std::uint32_t maxAspectLog2;
+    };
+
+    // Tile size of the map when the device can't use it: only tools look at it then.
+    const VkExtent2D FALLBACK_TILE = {16, 16};
+}
+
+ShadingRateMap::ShadingRateMap(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderPath,
+                               VkExtent2D framebufferExtent, const FragmentShadingRateSupport& support)
+    : device(device), framebuffer(framebufferExtent) {
+    // shading_rate.comp writes an r8ui image, which takes an optional feature (VulkanContext enables
+    // it when present) and the format's storage support. Without them the map stays at full rate.
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8_UINT, &formatProperties);
+    storage = features.shaderStorageImageExtendedFormats &&
+              (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+    attachment = support.attachment && storage;
+    // The smallest tiles the device takes: the finest control over where detail goes, and the map
+    // is tiny either way.
+    tile = attachment ? support.texelSize : FALLBACK_TILE;
+    VkExtent2D maxFragment = attachment ? support.maxFragmentSize : VkExtent2D{4, 4};
+    maxRateLog2[0] = std::min<std::uint32_t>(2, floorLog2(maxFragment.width));
+    maxRateLog2[1] = std::min<std::uint32_t>(2, floorLog2(maxFragment.height));
+    maxAspectLog2 = attachment ? floorLog2(support.maxAspectRatio) : 1;
+
+    VkExtent2D mapExtent = {(framebufferExtent.width + tile.width - 1) / tile.width,
+                            (framebufferExtent.height + tile.height - 1) / tile.height};
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    usage |= storage ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (attachment) {
+        usage |= VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+    }
+    rates = createImage(physicalDevice, device, mapExtent, VK_FORMAT_R8_UINT, usage, "shading rate map");
+    if (!storage) {
+        // record() clears it instead; nothing else to create.
+        return;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shading rate sampler!");
+    }
+
+    shaderModule = createShaderModule(device, shaderPath);
+
+    // Previous color; rate map.
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    for (std::uint32_t i = 0; i < 2; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shading rate descriptor set layout!");
+    }
+
+    VkPushConstantRange pushRange = {};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.size = sizeof(RatePush);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shading rate pipeline layout!");
+    }
+
+    pipeline = createComputePipeline(device, shaderModule, pipelineLayout);
+
+    VkDescriptorPoolSize poolSizes[2] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shading rate descriptor pool!");
+    }
+    VkDescriptorSetAllocateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &descriptorSetLayout;
+    if (vkd.vkAllocateDescriptorSets(device, &setInfo, &set) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate shading rate descriptor set!");
+    }
+    VkDescriptorImageInfo rateInfo = {VK_NULL_HANDLE, rates.view, VK_IMAGE_LAYOUT_GENERAL};
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 1;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &rateInfo;
+    vkd.vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    setObjectName(device, sampler, "shading rate sampler");
+    setObjectName(device, shaderModule, "shading_rate.comp");
+    setObjectName(device, descriptorSetLayout, "shading rate set layout");
+    setObjectName(device, pipelineLayout, "shading rate layout");
+    setObjectName(device, pipeline, "shading rate map");
+    setObjectName(device, descriptorPool, "shading rate descriptor pool");
+    setObjectName(device, set, "shading rate set");
+}
+
+ShadingRateMap::~ShadingRateMap() {
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    destroyImage(device, rates);
+}
+
+void ShadingRateMap::setInput(VkImageView previousColor, VkImageLayout layout) {
+    hasInput = true;
+    if (!storage) {
+        return;
+    }
+    VkDescriptorImageInfo imageInfo = {sampler, previousColor, layout};
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkd.vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+void ShadingRateMap::record(VkCommandBuffer commandBuffer, const ShadingRateSettings& settings) {
+    if (!hasInput) {
+        throw std::runtime_error("ShadingRateMap::record() before setInput()!");
+    }
+    CommandLabel label(commandBuffer, "shading rate map");
+    VkImageLayout finalLayout = attachment ? VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR : VK_IMAGE_LAYOUT_GENERAL;
+    VkPipelineStageFlags readStages = attachment ? VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkAccessFlags readAccess = attachment ? VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR : VK_ACCESS_TRANSFER_READ_BIT;
+
+    if (!storage) {
+        // Rate 0 is 1x1 everywhere.
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = rates.image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkd.vkCmdPipelineBarrier(commandBuffer, readStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        VkClearColorValue fullRate = {};
+        vkCmdClearColorImage(commandBuffer, rates.image, VK_IMAGE_LAYOUT_GENERAL, &fullRate, 1, &barrier.subresourceRange);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = readAccess;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = finalLayout;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, readStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        return;
+    }
+
+    // Last frame's passes are done reading the map; every texel is rewritten.
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = rates.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkd.vkCmdPipelineBarrier(commandBuffer, readStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    RatePush push = {};
+    push.framebufferExtent[0] = framebuffer.width;
+    push.framebufferExtent[1] = framebuffer.height;
+    push.tileSize[0] = tile.width;
+    push.tileSize[1] = tile.height;
+    push.gaze[0] = settings.gaze[0];
+    push.gaze[1] = settings.gaze[1];
+    push.fovealRadius = settings.fovealRadius;
+    push.peripheralRadius = settings.peripheralRadius;
+    push.contrastThreshold = settings.contrastThreshold;
+    push.contentAdaptive = settings.contentAdaptive ? 1 : 0;
+    push.maxRateLog2[0] = maxRateLog2[0];
+    push.maxRateLog2[1] = maxRateLog2[1];
+    push.maxAspectLog2 = maxAspectLog2;
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+    vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkd.vkCmdDispatch(commandBuffer, rates.extent.width, rates.extent.height, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = readAccess;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = finalLayout;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, readStages,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+VkFragmentShadingRateAttachmentInfoKHR ShadingRateMap::attachmentInfo(const VkAttachmentReference2* reference) const {
+    VkFragmentShadingRateAttachmentInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR;
+    info.pFragmentShadingRateAttachment = reference;
+    info.shadingRateAttachmentTexelSize = tile;
+    return info;
+}
+
+VkPipelineFragmentShadingRateStateCreateInfoKHR ShadingRateMap::pipelineState() {
+    VkPipelineFragmentShadingRateStateCreateInfoKHR state = {};
+    state.sType = VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR;
+    state.fragmentSize = {1, 1};
+    // Pipeline rate combined with the (absent) primitive rate, then replaced by the attachment's.
+    state.combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+    state.combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
+    return state;
+}
@@ -0,0 +1,88 @@
+#ifndef ShadingRate_hpp
+#define ShadingRate_hpp
+
+#include "VulkanContext.hpp"
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// What decides the shading rate of a tile. Outside the fovea the coarser of the content and
+// foveation rates wins; inside it every tile shades at full rate.
+struct ShadingRateSettings {
+    // Content: tiles whose last frame had little contrast along an axis get coarser along it.
+    // Off for the first frame or after a cut, when there is no meaningful last frame.
+    bool contentAdaptive = true;
+    // Largest acceptable error from coarse shading, in perceptual lightness (0..1). Higher is more
+    // aggressive.
+    float contrastThreshold = 0.03f;
+    // Foveation around a gaze point in 0..1 uv (eye tracker, or the screen center for a fixed
+    // foveation on head-mounted or very wide displays). Negative = off.
+    float gaze[2] = {-1.0f, -1.0f};
+    // Radii in units of the shorter framebuffer side: full rate inside fovealRadius, at least 2x2
+    // beyond it and 4x4 beyond peripheralRadius.
+    float fovealRadius = 0.2f;
+    float peripheralRadius = 0.45f;
+};
+
+// Per-tile fragment shading rates for a framebuffer, rebuilt every frame by a compute pass from the
+// previous frame's color and the gaze point. Flat, dark or blurred regions and the periphery shade
+// one fragment per 2x1 .. 4x4 pixels; edges and text keep full rate.
+//
+// With attachment support (FragmentShadingRateSupport::attachment) the image is a shading rate
+// attachment: add attachmentInfo() to the subpass and pipelineState() to the graphics pipelines.
+// Without it the map is still built, so that tools and debug views can show it, but nothing reads it
+// and every pass shades at full rate; renderers only need to check active(). Devices that can't
+// write R8_UINT storage images get neither: the map is cleared to full rate and never active().
+class ShadingRateMap {
+public:
+    ShadingRateMap(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderPath,
+                   VkExtent2D framebufferExtent, const FragmentShadingRateSupport& support);
+    ~ShadingRateMap();
+
+    ShadingRateMap(const ShadingRateMap&) = delete;
+    ShadingRateMap& operator=(const ShadingRateMap&) = delete;
+
+    // Last frame's color, sampled in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL over its whole uv
+    // range, so its size need not match the framebuffer (e.g. TemporalResolve::output() at output
+    // size while the scene renders smaller). Must be set before the first record().
+    void setInput(VkImageView previousColor, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Rebuilds the rates. The input must be visible to compute shaders. Leaves the image in
+    // VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR when active(), otherwise in
+    // VK_IMAGE_LAYOUT_GENERAL readable by transfers.
+    void record(VkCommandBuffer commandBuffer, const ShadingRateSettings& settings);
+
+    bool active() const { return attachment; }
+    // R8_UINT, one texel per tile: (log2 width << 2) | log2 height, the Vulkan rate encoding.
+    const Image& image() const { return rates; }
+    VkExtent2D texelSize() const { return tile; }
+
+    // For VkSubpassDescription2::pNext. reference must outlive the render pass creation.
+    VkFragmentShadingRateAttachmentInfoKHR attachmentInfo(const VkAttachmentReference2* reference) const;
+    // For VkGraphicsPipelineCreateInfo::pNext: full rate per draw, replaced by the attachment's rate.
+    static VkPipelineFragmentShadingRateStateCreateInfoKHR pipelineState();
+
+private:
+    VkDevice device;
+    VkExtent2D framebuffer;
+    VkExtent2D tile;
+    bool attachment;
+    bool storage; // R8_UINT storage images work, so the compute pass can build the map.
+    std::uint32_t maxRateLog2[2];
+    std::uint32_t maxAspectLog2;
+    Image rates;
+    bool hasInput = false;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+#endif /* ShadingRate_hpp */
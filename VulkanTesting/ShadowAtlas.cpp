@@ -0,0 +1,431 @@
+#include "ShadowAtlas.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+    const float SHADOW_NEAR = 0.05f;
+    const float PI = 3.14159265358979f;
+    // How much larger than the camera slice a cascade is, giving it room to stay put.
+    const float CASCADE_MARGIN = 1.25f;
+
+    std::uint32_t packTile(std::uint32_t x, std::uint32_t y) { return x << 16 | y; }
+
+    bool sameDesc(const ShadowLightDesc& a, const ShadowLightDesc& b) {
+        return a.type == b.type && a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+               a.direction.x == b.direction.x && a.direction.y == b.direction.y && a.direction.z == b.direction.z &&
+               a.outerAngle == b.outerAngle && a.range == b.range && a.resolution == b.resolution &&
+               a.cascadeCount == b.cascadeCount && a.shadowDistance == b.shadowDistance && a.splitLambda == b.splitLambda;
+    }
+
+    std::uint32_t viewsFor(const ShadowLightDesc& desc) {
+        return desc.type == ShadowLightType::Spot ? 1 : desc.type == ShadowLightType::Point ? 6 : desc.cascadeCount;
+    }
+
+    bool emptyRect(const VkRect2D& rect) { return rect.extent.width == 0 || rect.extent.height == 0; }
+
+    bool overlap(const VkRect2D& a, const VkRect2D& b) {
+        return a.offset.x < b.offset.x + static_cast<std::int32_t>(b.extent.width) &&
+               b.offset.x < a.offset.x + static_cast<std::int32_t>(a.extent.width) &&
+               a.offset.y < b.offset.y + static_cast<std::int32_t>(b.extent.height) &&
+               b.offset.y < a.offset.y + static_cast<std::int32_t>(a.extent.height);
+    }
+
+    VkRect2D unite(const VkRect2D& a, const VkRect2D& b) {
+        std::int32_t x0 = std::min(a.offset.x, b.offset.x);
+        std::int32_t y0 = std::min(a.offset.y, b.offset.y);
+        std::int32_t x1 = std::max(a.offset.x + static_cast<std::int32_t>(a.extent.width), b.offset.x + static_cast<std::int32_t>(b.extent.width));
+        std::int32_t y1 = std::max(a.offset.y + static_cast<std::int32_t>(a.extent.height), b.offset.y + static_cast<std::int32_t>(b.extent.height));
+        return {{x0, y0}, {static_cast<std::uint32_t>(x1 - x0), static_cast<std::uint32_t>(y1 - y0)}};
+    }
+
+    // Overlapping rects would restore and re-render the same texels twice; merge them until the
+    // rest are disjoint. Casters far apart keep separate, small rects.
+    void mergeOverlapping(std::vector<VkRect2D>& rects) {
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (std::size_t i = 0; i < rects.size() && !merged; i++) {
+                for (std::size_t j = i + 1; j < rects.size(); j++) {
+                    if (overlap(rects[i], rects[j])) {
+                        rects[i] = unite(rects[i], rects[j]);
+                        rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(j));
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+ShadowAtlas::ShadowAtlas(const ShadowAtlasCreateInfo& info) : atlasSize(info.size), minTile(info.minTile) {
+    levelCount = 1;
+    while ((atlasSize >> levelCount) >= minTile) {
+        levelCount++;
+    }
+    freeTiles.resize(levelCount);
+    freeTiles[0].push_back(packTile(0, 0));
+}
+
+bool ShadowAtlas::allocate(std::uint32_t level, Tile& tile) {
+    // Smallest free block that is at least as big, split down to the wanted size.
+    std::int32_t from = static_cast<std::int32_t>(level);
+    while (from >= 0 && freeTiles[from].empty()) {
+        from--;
+    }
+    if (from < 0) {
+        return false;
+    }
+    std::uint32_t packed = freeTiles[from].back();
+    freeTiles[from].pop_back();
+    std::uint32_t x = packed >> 16;
+    std::uint32_t y = packed & 0xFFFF;
+    for (std::uint32_t l = static_cast<std::uint32_t>(from) + 1; l <= level; l++) {
+        std::uint32_t half = atlasSize >> l;
+        freeTiles[l].push_back(packTile(x + half, y));
+        freeTiles[l].push_back(packTile(x, y + half));
+        freeTiles[l].push_back(packTile(x + half, y + half));
+    }
+    tile.level = level;
+    tile.x = x;
+    tile.y = y;
+    tile.valid = true;
+    return true;
+}
+
+void ShadowAtlas::release(Tile& tile) {
+    if (!tile.valid) {
+        return;
+    }
+    std::uint32_t level = tile.level;
+    std::uint32_t x = tile.x;
+    std::uint32_t y = tile.y;
+    tile.valid = false;
+    // Merge with the three buddies while they are all free.
+    while (level > 0) {
+        std::uint32_t size = atlasSize >> level;
+        std::uint32_t parentX = x & ~(2 * size - 1);
+        std::uint32_t parentY = y & ~(2 * size - 1);
+        std::vector<std::uint32_t>& levelFree = freeTiles[level];
+        std::vector<std::size_t> buddies;
+        for (std::size_t i = 0; i < levelFree.size(); i++) {
+            std::uint32_t bx = levelFree[i] >> 16;
+            std::uint32_t by = levelFree[i] & 0xFFFF;
+            if ((bx & ~(2 * size - 1)) == parentX && (by & ~(2 * size - 1)) == parentY) {
+                buddies.push_back(i);
+            }
+        }
+        if (buddies.size() != 3) {
+            break;
+        }
+        for (auto i = buddies.rbegin(); i != buddies.rend(); ++i) {
+            levelFree.erase(levelFree.begin() + static_cast<std::ptrdiff_t>(*i));
+        }
+        x = parentX;
+        y = parentY;
+        level--;
+    }
+    freeTiles[level].push_back(packTile(x, y));
+}
+
+std::uint32_t ShadowAtlas::levelFor(std::uint32_t resolution) const {
+    std::uint32_t level = 0;
+    while (level + 1 < levelCount && (atlasSize >> level) > resolution) {
+        level++;
+    }
+    return level;
+}
+
+void ShadowAtlas::setLight(std::uint32_t light, const ShadowLightDesc& desc) {
+    auto found = lights.find(light);
+    if (found != lights.end() && sameDesc(found->second.desc, desc)) {
+        return;
+    }
+    Light& entry = lights[light];
+    entry.desc = desc;
+    entry.changed = true;
+}
+
+void ShadowAtlas::removeLight(std::uint32_t light) {
+    auto found = lights.find(light);
+    if (found == lights.end()) {
+        return;
+    }
+    for (View& view : found->second.views) {
+        release(view.tile);
+    }
+    lights.erase(found);
+}
+
+void ShadowAtlas::staticGeometryChanged(const Bounds& bounds) {
+    staticChanges.push_back(bounds);
+}
+
+void ShadowAtlas::dynamicCasterMoved(const Bounds& previous, const Bounds& current) {
+    // The old footprint has to be restored from the cache, the new one drawn.
+    Bounds swept = previous;
+    swept.add(current);
+    dynamicRegions.push_back(swept);
+}
+
+std::uint32_t ShadowAtlas::firstView(std::uint32_t light) const {
+    auto found = viewRanges.find(light);
+    return found == viewRanges.end() ? 0 : found->second.first;
+}
+
+std::uint32_t ShadowAtlas::viewCount(std::uint32_t light) const {
+    auto found = viewRanges.find(light);
+    return found == viewRanges.end() ? 0 : found->second.second;
+}
+
+void ShadowAtlas::updateViews(Light& light) {
+    const ShadowLightDesc& desc = light.desc;
+    if (light.changed) {
+        // New tiles; keeping the old ones only pays off when the size stays, and a changed light
+        // has to re-render its static depth anyway.
+        for (View& view : light.views) {
+            release(view.tile);
+        }
+        light.views.assign(viewsFor(desc), View());
+        std::uint32_t level = std::min(levelFor(desc.resolution) + levelBias, levelCount - 1);
+        // All views of a light get the same size; if the atlas is too full, try smaller ones.
+        for (; level < levelCount; level++) {
+            bool ok = true;
+            for (View& view : light.views) {
+                ok = ok && allocate(level, view.tile);
+            }
+            if (ok) {
+                break;
+            }
+            for (View& view : light.views) {
+                release(view.tile);
+            }
+        }
+        if (desc.type == ShadowLightType::Spot) {
+            Mat4 view = lookAt(desc.position, desc.position + desc.direction, Vec3(0, 1, 0));
+            light.views[0].viewProj = perspective(desc.outerAngle, 1.0f, SHADOW_NEAR, desc.range) * view;
+            light.views[0].perspective = true;
+        } else if (desc.type == ShadowLightType::Point) {
+            // +X, -X, +Y, -Y, +Z, -Z, matching pointShadowFace() in shadow_atlas.glsl.
+            static const Vec3 directions[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+            static const Vec3 ups[6] = {{0, 1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}, {0, 1, 0}, {0, 1, 0}};
+            Mat4 projection = perspective(PI * 0.5f, 1.0f, SHADOW_NEAR, desc.range);
+            for (int face = 0; face < 6; face++) {
+                light.views[face].viewProj = projection * lookAt(desc.position, desc.position + directions[face], ups[face]);
+                light.views[face].perspective = true;
+            }
+        }
+    }
+    light.changed = false;
+}
+
+void ShadowAtlas::fitCascades(Light& light, const ShadowCamera& camera) {
+    const ShadowLightDesc& desc = light.desc;
+    std::uint32_t count = static_cast<std::uint32_t>(light.views.size());
+    Vec3 forward = normalize(camera.forward);
+    Vec3 right = normalize(cross(forward, camera.up));
+    Vec3 up = cross(right, forward);
+    float tanY = std::tan(camera.fovY * 0.5f);
+    float tanX = tanY * camera.aspect;
+    Mat4 rotation = lookAt(Vec3(), desc.direction, Vec3(0, 1, 0));
+
+    auto split = [&](std::uint32_t i) {
+        float t = static_cast<float>(i) / count;
+        float uniform = camera.nearPlane + (desc.shadowDistance - camera.nearPlane) * t;
+        float logarithmic = camera.nearPlane * std::pow(desc.shadowDistance / camera.nearPlane, t);
+        return desc.splitLambda * logarithmic + (1.0f - desc.splitLambda) * uniform;
+    };
+    for (std::uint32_t i = 0; i < count; i++) {
+        View& view = light.views[i];
+        if (!view.tile.valid) {
+            continue;
+        }
+        Vec3 corners[8];
+        Vec3 center;
+        for (int c = 0; c < 8; c++) {
+            float d = c & 4 ? split(i + 1) : split(i);
+            float sx = c & 1 ? tanX : -tanX;
+            float sy = c & 2 ? tanY : -tanY;
+            corners[c] = camera.position + forward * d + right * (sx * d) + up * (sy * d);
+            center = center + corners[c] / 8.0f;
+        }
+        // A sphere instead of a box keeps the cascade the same size however the camera turns;
+        // rounding the radius keeps float noise from changing it frame to frame.
+        float radius = 0;
+        for (const Vec3& corner : corners) {
+            radius = std::max(radius, length(corner - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+        float extent = radius * CASCADE_MARGIN;
+
+        // The cascade covers more than the slice needs and stays put while the slice's sphere is
+        // inside it, so the cached static depth survives camera motion for many frames.
+        Vec3 lightCenter = rotation.transformPoint(center);
+        float slack = extent - radius;
+        if (view.extent == extent && std::fabs(lightCenter.x - view.center.x) <= slack &&
+            std::fabs(lightCenter.y - view.center.y) <= slack && std::fabs(lightCenter.z - view.center.z) <= slack) {
+            continue;
+        }
+        // Refit, with the origin snapped to whole texels in light space: shadow edges then move by
+        // whole texels when the cascade moves and never swim.
+        float texel = 2.0f * extent / static_cast<float>(atlasSize >> view.tile.level);
+        view.center = Vec3(std::floor(lightCenter.x / texel) * texel, std::floor(lightCenter.y / texel) * texel,
+                           std::floor(lightCenter.z / texel) * texel);
+        view.extent = extent;
+        // Casters between the light and the sphere still throw shadows into it.
+        float nearPlane = -view.center.z - extent - desc.shadowDistance;
+        float farPlane = -view.center.z + extent;
+        view.viewProj = orthographic(view.center.x - extent, view.center.x + extent, view.center.y - extent,
+                                     view.center.y + extent, nearPlane, farPlane) * rotation;
+        view.perspective = false;
+        view.staticValid = false;
+    }
+}
+
+VkRect2D ShadowAtlas::project(const View& view, const Bounds& bounds) const {
+    std::uint32_t size = atlasSize >> view.tile.level;
+    VkRect2D none = {{0, 0}, {0, 0}};
+    VkRect2D whole = {{0, 0}, {size, size}};
+    if (bounds.empty()) {
+        return none;
+    }
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    bool anyBeforeFar = false, anyBehindNear = false, anyInFront = false;
+    for (int c = 0; c < 8; c++) {
+        Vec4 clip = view.viewProj.transform(bounds.corner(c));
+        if (view.perspective && clip.w <= 1e-4f) {
+            anyBehindNear = true;
+            continue;
+        }
+        anyInFront = true;
+        float x = clip.x / clip.w;
+        float y = clip.y / clip.w;
+        anyBeforeFar = anyBeforeFar || clip.z / clip.w <= 1.0f;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    }
+    if (!anyInFront || !anyBeforeFar) {
+        return none;
+    }
+    if (anyBehindNear) {
+        // Straddles the light's plane: its projection is unbounded, so take the whole tile.
+        return whole;
+    }
+    if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) {
+        return none;
+    }
+    // One texel of margin for filtering and rasterization rules.
+    auto toTexel = [size](float ndc) { return (std::max(-1.0f, std::min(1.0f, ndc)) * 0.5f + 0.5f) * size; };
+    std::int32_t x0 = std::max(0, static_cast<std::int32_t>(std::floor(toTexel(minX))) - 1);
+    std::int32_t y0 = std::max(0, static_cast<std::int32_t>(std::floor(toTexel(minY))) - 1);
+    std::int32_t x1 = std::min(static_cast<std::int32_t>(size), static_cast<std::int32_t>(std::ceil(toTexel(maxX))) + 1);
+    std::int32_t y1 = std::min(static_cast<std::int32_t>(size), static_cast<std::int32_t>(std::ceil(toTexel(maxY))) + 1);
+    return {{x0, y0}, {static_cast<std::uint32_t>(x1 - x0), static_cast<std::uint32_t>(y1 - y0)}};
+}
+
+std::vector<ShadowPass> ShadowAtlas::build(const ShadowCamera& camera) {
+    // When the requested tiles do not fit, all lights step down a size together instead of the
+    // last lights getting nothing.
+    std::uint64_t atlasArea = static_cast<std::uint64_t>(atlasSize) * atlasSize;
+    std::uint32_t bias = 0;
+    for (; bias + 1 < levelCount; bias++) {
+        std::uint64_t requested = 0;
+        for (auto& entry : lights) {
+            std::uint64_t tile = atlasSize >> std::min(levelFor(entry.second.desc.resolution) + bias, levelCount - 1);
+            requested += viewsFor(entry.second.desc) * tile * tile;
+        }
+        if (requested <= atlasArea) {
+            break;
+        }
+    }
+    if (bias != levelBias) {
+        // Free everything first so the new sizes pack without fragmentation.
+        levelBias = bias;
+        for (auto& entry : lights) {
+            for (View& view : entry.second.views) {
+                release(view.tile);
+            }
+            entry.second.changed = true;
+        }
+    }
+    for (auto& entry : lights) {
+        if (entry.second.changed) {
+            updateViews(entry.second);
+        }
+    }
+    for (auto& entry : lights) {
+        if (entry.second.desc.type == ShadowLightType::Directional) {
+            fitCascades(entry.second, camera);
+        }
+    }
+
+    std::vector<ShadowPass> staticPasses, copyPasses, dynamicPasses;
+    gpuViews.clear();
+    viewRanges.clear();
+    for (auto& entry : lights) {
+        Light& light = entry.second;
+        bool hasTiles = !light.views.empty() && light.views[0].tile.valid;
+        if (!hasTiles) {
+            continue;
+        }
+        viewRanges[entry.first] = {static_cast<std::uint32_t>(gpuViews.size()), static_cast<std::uint32_t>(light.views.size())};
+        for (View& view : light.views) {
+            std::uint32_t index = static_cast<std::uint32_t>(gpuViews.size());
+            std::uint32_t size = atlasSize >> view.tile.level;
+            ShadowViewGpu gpu;
+            std::memcpy(gpu.viewProj, view.viewProj.m, sizeof(gpu.viewProj));
+            gpu.atlasRect[0] = static_cast<float>(view.tile.x) / atlasSize;
+            gpu.atlasRect[1] = static_cast<float>(view.tile.y) / atlasSize;
+            gpu.atlasRect[2] = static_cast<float>(size) / atlasSize;
+            gpu.atlasRect[3] = static_cast<float>(size) / atlasSize;
+            gpuViews.push_back(gpu);
+
+            VkViewport viewport = {static_cast<float>(view.tile.x), static_cast<float>(view.tile.y),
+                                   static_cast<float>(size), static_cast<float>(size), 0.0f, 1.0f};
+            auto toAtlas = [&](const VkRect2D& rect) {
+                return VkRect2D{{static_cast<std::int32_t>(view.tile.x) + rect.offset.x, static_cast<std::int32_t>(view.tile.y) + rect.offset.y},
+                                rect.extent};
+            };
+            // Static depth to redo: the whole tile for a new view, else where static geometry changed.
+            std::vector<VkRect2D> stale;
+            if (!view.staticValid) {
+                stale.push_back({{0, 0}, {size, size}});
+                view.staticValid = true;
+            } else {
+                for (const Bounds& bounds : staticChanges) {
+                    VkRect2D rect = project(view, bounds);
+                    if (!emptyRect(rect)) {
+                        stale.push_back(rect);
+                    }
+                }
+                mergeOverlapping(stale);
+            }
+            for (const VkRect2D& rect : stale) {
+                staticPasses.push_back({ShadowPassType::RenderStatic, index, toAtlas(rect), viewport});
+            }
+            // Everything restored from the cache needs the moving casters drawn over it again.
+            std::vector<VkRect2D> dirty = stale;
+            for (const Bounds& bounds : dynamicRegions) {
+                VkRect2D rect = project(view, bounds);
+                if (!emptyRect(rect)) {
+                    dirty.push_back(rect);
+                }
+            }
+            mergeOverlapping(dirty);
+            for (const VkRect2D& rect : dirty) {
+                copyPasses.push_back({ShadowPassType::CopyStatic, index, toAtlas(rect), viewport});
+                dynamicPasses.push_back({ShadowPassType::RenderDynamic, index, toAtlas(rect), viewport});
+            }
+        }
+    }
+    staticChanges.clear();
+    dynamicRegions.clear();
+
+    std::vector<ShadowPass> passes = std::move(staticPasses);
+    passes.insert(passes.end(), copyPasses.begin(), copyPasses.end());
+    passes.insert(passes.end(), dynamicPasses.begin(), dynamicPasses.end());
+    return passes;
+}
@@ -0,0 +1,144 @@
+#ifndef ShadowAtlas_hpp
+#define ShadowAtlas_hpp
+
+#include "VecMath.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+enum class ShadowLightType {
+    Spot,        // One perspective view.
+    Point,       // Six 90 degree cube faces, each with its own tile.
+    Directional, // Cascades fitted to the camera.
+};
+
+struct ShadowLightDesc {
+    ShadowLightType type = ShadowLightType::Spot;
+    Vec3 position;
+    Vec3 direction{0, -1, 0}; // Spot and directional.
+    float outerAngle = 0.8f;  // Spot, full cone angle in radians.
+    float range = 20.0f;      // Spot and point far plane.
+    std::uint32_t resolution = 1024; // Requested tile size; the atlas may hand out less when full.
+    // Directional only.
+    std::uint32_t cascadeCount = 4;
+    float shadowDistance = 200.0f;
+    float splitLambda = 0.75f; // 0 = uniform splits, 1 = logarithmic.
+};
+
+struct ShadowCamera {
+    Vec3 position;
+    Vec3 forward{0, 0, -1};
+    Vec3 up{0, 1, 0};
+    float fovY = 1.0f;
+    float aspect = 16.0f / 9.0f;
+    float nearPlane = 0.1f;
+};
+
+// Matches ShadowView in shaders/shadow_atlas.glsl.
+struct ShadowViewGpu {
+    float viewProj[16];
+    float atlasRect[4]; // uv offset xy, uv scale zw.
+};
+
+enum class ShadowPassType {
+    RenderStatic,  // Render static casters into the cache atlas; the region is cleared first.
+    CopyStatic,    // Copy the region from the cache atlas to the shadow atlas.
+    RenderDynamic, // Render moving casters into the shadow atlas, over the copied static depth.
+};
+
+struct ShadowPass {
+    ShadowPassType type;
+    std::uint32_t view;  // Index into views().
+    VkRect2D region;     // Scissor / copy rectangle in atlas texels.
+    VkViewport viewport; // The whole tile, so the projection matches the cached content.
+};
+
+struct ShadowAtlasCreateInfo {
+    std::uint32_t size = 8192;    // Square, power of two.
+    std::uint32_t minTile = 128;  // Smallest tile handed out.
+};
+
+// Packs the shadow maps of many lights into one depth atlas and keeps them up to date with as
+// little rendering as possible.
+//
+// Tiles come from a buddy allocator over power-of-two squares. Every view has a twin tile at the
+// same place in a cache atlas that holds static casters only. Static depth is re-rendered only when
+// the view itself changes (light moved, tile reallocated, cascade moved by a texel) or static
+// geometry inside it changed. Moving casters dirty the part of each view their old and new bounds
+// project to; only those rectangles are restored from the cache and re-rendered. A quiet scene
+// costs no shadow rendering at all.
+//
+// Directional lights use cascades fitted to bounding spheres of the camera frustum slices, so their
+// size does not change with camera rotation. A cascade is a little larger than its slice and is
+// only refit once the slice leaves it; refits snap the origin to whole texels, so shadow edges do
+// not swim and the static cache of each cascade survives most camera motion.
+//
+// The atlas is CPU bookkeeping only: build() returns the passes to execute, views() the data the
+// shaders sample with.
+class ShadowAtlas {
+public:
+    explicit ShadowAtlas(const ShadowAtlasCreateInfo& info = ShadowAtlasCreateInfo());
+
+    void setLight(std::uint32_t light, const ShadowLightDesc& desc);
+    void removeLight(std::uint32_t light);
+
+    // Call between build()s. Bounds are world space; moving casters pass where they were when the
+    // last build() ran and where they are now.
+    void staticGeometryChanged(const Bounds& bounds);
+    void dynamicCasterMoved(const Bounds& previous, const Bounds& current);
+
+    // Refits cascades, reallocates tiles and returns this frame's passes, static renders first.
+    std::vector<ShadowPass> build(const ShadowCamera& camera);
+
+    const std::vector<ShadowViewGpu>& views() const { return gpuViews; }
+    // First view of a light and how many it has (1, 6 or cascadeCount), or count 0 if it got no tile.
+    std::uint32_t firstView(std::uint32_t light) const;
+    std::uint32_t viewCount(std::uint32_t light) const;
+    std::uint32_t size() const { return atlasSize; }
+
+private:
+    struct Tile {
+        std::uint32_t level = 0; // Size is atlasSize >> level.
+        std::uint32_t x = 0;
+        std::uint32_t y = 0;
+        bool valid = false;
+    };
+    struct View {
+        Tile tile;
+        Mat4 viewProj;
+        bool perspective = false;
+        bool staticValid = false;
+        // Cascades: light-space origin and half extent of the current fit.
+        Vec3 center;
+        float extent = 0;
+    };
+    struct Light {
+        ShadowLightDesc desc;
+        std::vector<View> views;
+        bool changed = true;
+    };
+
+    std::uint32_t atlasSize;
+    std::uint32_t minTile;
+    std::uint32_t levelCount;
+    std::uint32_t levelBias = 0; // Added to every light's level while the requests do not fit.
+    std::vector<std::vector<std::uint32_t>> freeTiles; // Per level, packed x << 16 | y.
+    std::map<std::uint32_t, Light> lights;
+    std::vector<Bounds> staticChanges;
+    std::vector<Bounds> dynamicRegions; // Swept bounds of each moving caster.
+    std::vector<ShadowViewGpu> gpuViews;
+    std::map<std::uint32_t, std::pair<std::uint32_t, std::uint32_t>> viewRanges;
+
+    bool allocate(std::uint32_t level, Tile& tile);
+    void release(Tile& tile);
+    std::uint32_t levelFor(std::uint32_t resolution) const;
+    void updateViews(Light& light);
+    void fitCascades(Light& light, const ShadowCamera& camera);
+    // Tile-local rect that bounds project to, or an empty rect when they miss the view.
+    VkRect2D project(const View& view, const Bounds& bounds) const;
+};
+
+#endif /* ShadowAtlas_hpp */
@@ -0,0 +1,260 @@
+#include "Temporal.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+    float radicalInverse(std::uint32_t index, std::uint32_t base) {
+        float result = 0.0f;
+        float digit = 1.0f / base;
+        for (; index > 0; index /= base, digit /= base) {
+            result += static_cast<float>(index % base) * digit;
+        }
+        return result;
+    }
+
+    // Mirrors the push constants of shaders/taa_resolve.comp.
+    struct ResolvePush {
+        std::uint32_t renderExtent[2];
+        std::uint32_t outputExtent[2];
+        float jitter[2];
+        float blend;
+        std::uint32_t reset;
+    };
+
+    // Weight of the current frame when its nearest sample hits the pixel center. Lower is smoother
+    // and slower to react.
+    const float CURRENT_FRAME_WEIGHT = 0.1f;
+}
+
+void haltonJitter(std::uint32_t index, float& x, float& y) {
+    x = radicalInverse(index, 2) - 0.5f;
+    y = radicalInverse(index, 3) - 0.5f;
+}
+
+std::uint32_t jitterPhaseCount(VkExtent2D renderExtent, VkExtent2D outputExtent) {
+    double ratio = static_cast<double>(outputExtent.width) * outputExtent.height /
+                   (static_cast<double>(renderExtent.width) * renderExtent.height);
+    return static_cast<std::uint32_t>(std::ceil(8.0 * std::max(1.0, ratio)));
+}
+
+Mat4 jitterProjection(const Mat4& projection, float jitterX, float jitterY, VkExtent2D renderExtent) {
+    // A clip-space translation scaled by w, i.e. a constant offset after the perspective divide.
+    float dx = 2.0f * jitterX / static_cast<float>(renderExtent.width);
+    float dy = 2.0f * jitterY / static_cast<float>(renderExtent.height);
+    Mat4 result = projection;
+    for (int column = 0; column < 4; column++) {
+        result.at(0, column) += dx * projection.at(3, column);
+        result.at(1, column) += dy * projection.at(3, column);
+    }
+    return result;
+}
+
+TemporalView TemporalCamera::advance(const Mat4& view, const Mat4& projection, VkExtent2D renderExtent, VkExtent2D outputExtent) {
+    if (outputExtent.width != previousOutput.width || outputExtent.height != previousOutput.height) {
+        hasPrevious = false;
+    }
+    TemporalView result;
+    result.viewProj = projection * view;
+    // Halton starts at index 1; index 0 would be the unjittered pixel corner.
+    haltonJitter(frame % jitterPhaseCount(renderExtent, outputExtent) + 1, result.jitter[0], result.jitter[1]);
+    result.jitteredViewProj = jitterProjection(projection, result.jitter[0], result.jitter[1], renderExtent) * view;
+    result.previousViewProj = hasPrevious ? previousViewProj : result.viewProj;
+    result.reset = !hasPrevious;
+
+    frame++;
+    previousViewProj = result.viewProj;
+    previousOutput = outputExtent;
+    hasPrevious = true;
+    return result;
+}
+
+TemporalResolve::TemporalResolve(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderPath,
+                                 VkExtent2D outputExtent)
+    : device(device), extent(outputExtent) {
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    history[0] = createImage(physicalDevice, device, outputExtent, VK_FORMAT_R16G16B16A16_SFLOAT, usage, "temporal history 0");
+    history[1] = createImage(physicalDevice, device, outputExtent, VK_FORMAT_R16G16B16A16_SFLOAT, usage, "temporal history 1");
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &linearSampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create temporal sampler!");
+    }
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &pointSampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create temporal sampler!");
+    }
+
+    shaderModule = createShaderModule(device, shaderPath);
+
+    // Color, motion, depth, history read; history write.
+    VkDescriptorSetLayoutBinding bindings[5] = {};
+    for (std::uint32_t i = 0; i < 5; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i < 4 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 5;
+    layoutInfo.pBindings = bindings;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create temporal resolve descriptor set layout!");
+    }
+
+    VkPushConstantRange pushRange = {};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.size = sizeof(ResolvePush);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create temporal resolve pipeline layout!");
+    }
+
+    pipeline = createComputePipeline(device, shaderModule, pipelineLayout);
+
+    VkDescriptorPoolSize poolSizes[2] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2},
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 2;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create temporal resolve descriptor pool!");
+    }
+    VkDescriptorSetLayout setLayouts[2] = {descriptorSetLayout, descriptorSetLayout};
+    VkDescriptorSetAllocateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool;
+    setInfo.descriptorSetCount = 2;
+    setInfo.pSetLayouts = setLayouts;
+    if (vkd.vkAllocateDescriptorSets(device, &setInfo, sets) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate temporal resolve descriptor sets!");
+    }
+    // The history bindings never change: set i reads the other image and writes image i.
+    VkDescriptorImageInfo imageInfos[4];
+    VkWriteDescriptorSet writes[4] = {};
+    for (std::uint32_t i = 0; i < 2; i++) {
+        imageInfos[i * 2] = {linearSampler, history[1 - i].view, VK_IMAGE_LAYOUT_GENERAL};
+        imageInfos[i * 2 + 1] = {VK_NULL_HANDLE, history[i].view, VK_IMAGE_LAYOUT_GENERAL};
+        for (std::uint32_t j = 0; j < 2; j++) {
+            VkWriteDescriptorSet& write = writes[i * 2 + j];
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = sets[i];
+            write.dstBinding = 3 + j;
+            write.descriptorCount = 1;
+            write.descriptorType = j == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            write.pImageInfo = &imageInfos[i * 2 + j];
+        }
+    }
+    vkd.vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+
+    setObjectName(device, linearSampler, "temporal linear sampler");
+    setObjectName(device, pointSampler, "temporal point sampler");
+    setObjectName(device, shaderModule, "taa_resolve.comp");
+    setObjectName(device, descriptorSetLayout, "temporal resolve set layout");
+    setObjectName(device, pipelineLayout, "temporal resolve layout");
+    setObjectName(device, pipeline, "temporal resolve");
+    setObjectName(device, descriptorPool, "temporal resolve descriptor pool");
+    setObjectName(device, sets[0], "temporal resolve set 0");
+    setObjectName(device, sets[1], "temporal resolve set 1");
+}
+
+TemporalResolve::~TemporalResolve() {
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    vkDestroySampler(device, pointSampler, nullptr);
+    vkDestroySampler(device, linearSampler, nullptr);
+    destroyImage(device, history[1]);
+    destroyImage(device, history[0]);
+}
+
+void TemporalResolve::setInputs(VkImageView color, VkImageView motion, VkImageView depth) {
+    // Color is filtered; motion and depth are fetched per texel.
+    VkDescriptorImageInfo imageInfos[3] = {
+        {linearSampler, color, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {pointSampler, motion, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {pointSampler, depth, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+    };
+    VkWriteDescriptorSet writes[6] = {};
+    for (std::uint32_t i = 0; i < 6; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = sets[i / 3];
+        writes[i].dstBinding = i % 3;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[i].pImageInfo = &imageInfos[i % 3];
+    }
+    vkd.vkUpdateDescriptorSets(device, 6, writes, 0, nullptr);
+}
+
+void TemporalResolve::record(VkCommandBuffer commandBuffer, const TemporalView& view, VkExtent2D renderExtent) {
+    CommandLabel label(commandBuffer, "temporal resolve");
+    current ^= 1;
+    const Image& target = history[current];
+
+    // The target was last frame's history input (and whoever read the output before that): wait for
+    // those reads. Its content is about to be overwritten in full, so the old layout is irrelevant.
+    VkImageMemoryBarrier barriers[2] = {};
+    for (VkImageMemoryBarrier& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    }
+    barriers[0].image = target.image;
+    // On the very first frame the history input needs a layout too; the shader ignores its content.
+    barriers[1].image = history[current ^ 1].image;
+    vkd.vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, initialized ? 1 : 2, barriers);
+
+    ResolvePush push = {};
+    push.renderExtent[0] = renderExtent.width;
+    push.renderExtent[1] = renderExtent.height;
+    push.outputExtent[0] = extent.width;
+    push.outputExtent[1] = extent.height;
+    push.jitter[0] = view.jitter[0];
+    push.jitter[1] = view.jitter[1];
+    push.blend = CURRENT_FRAME_WEIGHT;
+    push.reset = view.reset || !initialized ? 1 : 0;
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &sets[current], 0, nullptr);
+    vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkd.vkCmdDispatch(commandBuffer, (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+    initialized = true;
+
+    VkImageMemoryBarrier resolved = barriers[0];
+    resolved.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    resolved.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    resolved.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &resolved);
+}
@@ -0,0 +1,97 @@
+#ifndef Temporal_hpp
+#define Temporal_hpp
+
+#include "VecMath.hpp"
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// Point index (1-based) of the Halton (2, 3) sequence, as a subpixel offset in -0.5..0.5.
+void haltonJitter(std::uint32_t index, float& x, float& y);
+
+// Jitter phases before the sequence repeats: 8 at native resolution, more when upscaling so that
+// every output pixel still gets samples near its center. Grows with the pixel ratio.
+std::uint32_t jitterPhaseCount(VkExtent2D renderExtent, VkExtent2D outputExtent);
+
+// projection moved by a subpixel offset. The offset is in render pixels with y pointing down, like
+// the viewport, and works for perspective and orthographic projections alike.
+Mat4 jitterProjection(const Mat4& projection, float jitterX, float jitterY, VkExtent2D renderExtent);
+
+// One frame's camera for temporal rendering. Rasterize with jitteredViewProj. Motion vectors come
+// from viewProj and previousViewProj (temporalMotion() in shaders/temporal.glsl), which carry no
+// jitter, so a still scene has zero motion and the jitter is not mistaken for movement.
+struct TemporalView {
+    Mat4 viewProj;
+    Mat4 previousViewProj;
+    Mat4 jitteredViewProj;
+    float jitter[2] = {0, 0}; // Render pixels.
+    bool reset = true;        // No usable history: first frame, camera cut or new output size.
+};
+
+// Hands out the jitter sequence and remembers last frame's matrices.
+class TemporalCamera {
+public:
+    // Call once per frame. The render extent may change every frame (dynamic resolution) without
+    // losing history; a new output extent starts over.
+    TemporalView advance(const Mat4& view, const Mat4& projection, VkExtent2D renderExtent, VkExtent2D outputExtent);
+    // Camera cut: history of the next frame would only smear the old view into the new one.
+    void cut() { hasPrevious = false; }
+
+private:
+    std::uint32_t frame = 0;
+    Mat4 previousViewProj;
+    VkExtent2D previousOutput = {0, 0};
+    bool hasPrevious = false;
+};
+
+// Temporal anti-aliasing and upscaling in one compute pass. Every output pixel is reconstructed from
+// the jittered render-resolution samples around it, weighted by how close they landed to the pixel
+// center, and blended with last frame's output reprojected along the motion vectors. The history is
+// clipped to the color range of the current neighborhood, so disoccluded and changed pixels do not
+// ghost. Over a jitter cycle the history gathers samples from all over each pixel: that is the
+// anti-aliasing at native resolution and the extra detail when rendering fewer pixels.
+//
+// History is two output-sized RGBA16F images used in turn; output() is the newer one. Record on a
+// graphics-capable queue: the barriers make the output visible to fragment shaders.
+class TemporalResolve {
+public:
+    TemporalResolve(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& shaderPath,
+                    VkExtent2D outputExtent);
+    ~TemporalResolve();
+
+    TemporalResolve(const TemporalResolve&) = delete;
+    TemporalResolve& operator=(const TemporalResolve&) = delete;
+
+    // Render-resolution inputs, sampled in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: linear HDR
+    // color, motion (RG16F, as written by temporalMotion()) and depth (0 = near). They may be larger
+    // than the render extent, e.g. allocated for the largest dynamic resolution scale.
+    void setInputs(VkImageView color, VkImageView motion, VkImageView depth);
+
+    // Resolves one frame. The inputs must be written and visible to compute shaders. Leaves the
+    // result in output(), in VK_IMAGE_LAYOUT_GENERAL.
+    void record(VkCommandBuffer commandBuffer, const TemporalView& view, VkExtent2D renderExtent);
+
+    const Image& output() const { return history[current]; }
+    VkExtent2D outputExtent() const { return extent; }
+
+private:
+    VkDevice device;
+    VkExtent2D extent;
+    Image history[2];
+    std::uint32_t current = 0;
+    bool initialized = false; // History images still in VK_IMAGE_LAYOUT_UNDEFINED until the first record().
+
+    VkSampler linearSampler = VK_NULL_HANDLE;
+    VkSampler pointSampler = VK_NULL_HANDLE;
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet sets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE}; // sets[i] writes history[i].
+};
+
+#endif /* Temporal_hpp */
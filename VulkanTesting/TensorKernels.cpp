@@ -0,0 +1,608 @@
+#include "TensorKernels.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    // Mirrors the push constants of shaders/conv2d_tiled.comp. The GEMM shaders take the first six.
+    struct KernelPush {
+        std::uint32_t m;
+        std::uint32_t n;
+        std::uint32_t k;
+        float alpha;
+        float beta;
+        std::uint32_t flags;
+        std::uint32_t height;
+        std::uint32_t width;
+        std::uint32_t channels;
+        std::uint32_t outputHeight;
+        std::uint32_t outputWidth;
+        std::uint32_t kernelSize;
+        std::uint32_t stride;
+        std::uint32_t padding;
+    };
+    const std::uint32_t GEMM_PUSH_SIZE = 6 * sizeof(std::uint32_t);
+    const std::uint32_t FLAG_BIAS = 1;
+    const std::uint32_t FLAG_RELU = 2;
+
+    // Constant ids 0-7 of shaders/gemm_tiled.glsl.
+    struct TiledSpecialization {
+        std::uint32_t groupX;
+        std::uint32_t groupY;
+        std::uint32_t tileM;
+        std::uint32_t tileN;
+        std::uint32_t tileK;
+        std::uint32_t threadM;
+        std::uint32_t threadN;
+        VkBool32 vec4;
+    };
+
+    // shaders/gemm_coopmat.comp: four subgroups on a 64x64 tile, K in steps of 32.
+    const std::uint32_t COOPERATIVE_TILE = 64;
+    const std::uint32_t COOPERATIVE_STEP = 32;
+    const std::uint32_t COOPERATIVE_SUBGROUPS = 4;
+
+    // What tune() tries, roughly from most to least work per workgroup. Big tiles reuse each loaded
+    // element more and win on large matrices; small ones keep more workgroups in flight when the
+    // matrices are small. Variants that don't fit the device are skipped.
+    const KernelConfig TILED_CONFIGS[] = {
+        {false, 128, 128, 8, 8, 8},
+        {false, 128, 64, 16, 8, 4},
+        {false, 64, 128, 16, 4, 8},
+        {false, 64, 64, 16, 4, 4},
+        {false, 64, 64, 8, 4, 4},
+        {false, 64, 32, 16, 4, 2},
+        {false, 32, 64, 16, 2, 4},
+        {false, 32, 32, 16, 2, 2},
+        {false, 32, 32, 8, 4, 4},
+        {false, 16, 16, 16, 1, 1},
+    };
+    // Untuned shapes. The second one fits the minimum limits of every device.
+    const KernelConfig DEFAULT_CONFIGS[] = {
+        {false, 64, 64, 16, 4, 4},
+        {false, 32, 32, 8, 4, 4},
+    };
+
+    // Workgroup tiles far bigger than the matrix only add idle invocations.
+    bool oversized(const KernelConfig& config, const GemmShape& shape) {
+        return (config.tileM > 32 && config.tileM >= 2 * shape.m) || (config.tileN > 32 && config.tileN >= 2 * shape.n);
+    }
+
+    // Size class of a dimension: ceil(log2(x)).
+    std::uint32_t sizeClass(std::uint32_t x) {
+        std::uint32_t bits = 0;
+        while (bits < 31 && (1u << bits) < x) bits++;
+        return bits;
+    }
+
+    const char* kernelName(KernelType type) {
+        return type == KernelType::Gemm ? "gemm" : "conv2d";
+    }
+}
+
+std::string KernelConfig::name() const {
+    if (cooperative) {
+        return "coopmat";
+    }
+    return std::to_string(tileM) + "x" + std::to_string(tileN) + "x" + std::to_string(tileK) + "/" +
+           std::to_string(threadM) + "x" + std::to_string(threadN);
+}
+
+bool KernelConfig::parse(const std::string& name, KernelConfig& config) {
+    if (name == "coopmat") {
+        config = KernelConfig();
+        config.cooperative = true;
+        return true;
+    }
+    KernelConfig parsed;
+    char extra;
+    if (std::sscanf(name.c_str(), "%ux%ux%u/%ux%u%c", &parsed.tileM, &parsed.tileN, &parsed.tileK,
+                    &parsed.threadM, &parsed.threadN, &extra) != 5) {
+        return false;
+    }
+    config = parsed;
+    return true;
+}
+
+TensorKernels::TensorKernels(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t queueFamily, VkQueue queue,
+                             const std::string& shaderDir, const CooperativeMatrixSupport& cooperativeMatrix,
+                             bool allowFloat16)
+    : physicalDevice(physicalDevice), device(device), queue(queue), cooperativeMatrix(cooperativeMatrix),
+      allowFloat16(allowFloat16) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    limits = properties.limits;
+    char key[32];
+    std::snprintf(key, sizeof(key), "%04x:%04x:%08x", properties.vendorID, properties.deviceID, properties.driverVersion);
+    deviceKey = key;
+
+    gemmModule = createShaderModule(device, shaderDir + "/gemm_tiled.comp.spv");
+    convModule = createShaderModule(device, shaderDir + "/conv2d_tiled.comp.spv");
+    if (cooperativeMatrix.float16 && allowFloat16 &&
+        COOPERATIVE_SUBGROUPS * cooperativeMatrix.subgroupSize <= limits.maxComputeWorkGroupInvocations &&
+        COOPERATIVE_SUBGROUPS * cooperativeMatrix.subgroupSize <= limits.maxComputeWorkGroupSize[0]) {
+        cooperativeModule = createShaderModule(device, shaderDir + "/gemm_coopmat.comp.spv");
+    }
+
+    // A, B, C and bias, the same for every kernel.
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for (std::uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings = bindings;
+    if (vkd.vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tensor descriptor set layout!");
+    }
+    VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(KernelPush)};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkd.vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tensor pipeline layout!");
+    }
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tensor command pool!");
+    }
+    VkCommandBufferAllocateInfo commandBufferInfo = {};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    if (vkd.vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate tensor command buffer!");
+    }
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tensor fence!");
+    }
+
+    // Timestamps are optional per queue family; tune() falls back to CPU time.
+    std::uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    std::uint32_t validBits = families[queueFamily].timestampValidBits;
+    if (validBits > 0) {
+        timestampPeriod = limits.timestampPeriod;
+        timestampMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        if (vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create tensor query pool!");
+        }
+    }
+
+    setObjectName(device, gemmModule, "gemm_tiled.comp");
+    setObjectName(device, convModule, "conv2d_tiled.comp");
+    setObjectName(device, cooperativeModule, "gemm_coopmat.comp");
+    setObjectName(device, setLayout, "tensor set layout");
+    setObjectName(device, pipelineLayout, "tensor pipeline layout");
+    setObjectName(device, commandPool, "tensor tuning command pool");
+    setObjectName(device, commandBuffer, "tensor tuning commands");
+    setObjectName(device, fence, "tensor tuning fence");
+    setObjectName(device, queryPool, "tensor tuning timestamps");
+}
+
+TensorKernels::~TensorKernels() {
+    if (queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, queryPool, nullptr);
+    vkDestroyFence(device, fence, nullptr);
+    vkd.vkDestroyCommandPool(device, commandPool, nullptr);
+    for (VkDescriptorPool pool : descriptorPools) {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    for (auto& entry : pipelines) {
+        vkDestroyPipeline(device, entry.second, nullptr);
+    }
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    if (cooperativeModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, cooperativeModule, nullptr);
+    vkDestroyShaderModule(device, convModule, nullptr);
+    vkDestroyShaderModule(device, gemmModule, nullptr);
+}
+
+void TensorKernels::gemm(VkCommandBuffer commandBuffer, const GemmShape& shape, VkBuffer a, VkBuffer b, VkBuffer c,
+                         const KernelEpilogue& epilogue) {
+    record(commandBuffer, KernelType::Gemm, choose(KernelType::Gemm, shape), shape, ConvShape(), a, b, c, epilogue);
+}
+
+void TensorKernels::conv2d(VkCommandBuffer commandBuffer, const ConvShape& shape, VkBuffer input, VkBuffer weights,
+                           VkBuffer output, const KernelEpilogue& epilogue) {
+    if (shape.pointwise()) {
+        gemm(commandBuffer, shape.gemm(), input, weights, output, epilogue);
+        return;
+    }
+    GemmShape gemmShape = shape.gemm();
+    record(commandBuffer, KernelType::Conv2d, choose(KernelType::Conv2d, gemmShape), gemmShape, shape, input, weights,
+           output, epilogue);
+}
+
+void TensorKernels::reset() {
+    for (VkDescriptorPool pool : descriptorPools) {
+        vkResetDescriptorPool(device, pool, 0);
+    }
+    currentPool = 0;
+}
+
+KernelConfig TensorKernels::config(const GemmShape& shape) const {
+    return choose(KernelType::Gemm, shape);
+}
+
+KernelConfig TensorKernels::config(const ConvShape& shape) const {
+    return shape.pointwise() ? choose(KernelType::Gemm, shape.gemm()) : choose(KernelType::Conv2d, shape.gemm());
+}
+
+bool TensorKernels::fits(const KernelConfig& config) const {
+    if (config.cooperative) {
+        return cooperativeModule != VK_NULL_HANDLE;
+    }
+    if (config.threadM == 0 || config.threadN == 0 || config.tileM % config.threadM != 0 ||
+        config.tileN % config.threadN != 0 || config.tileK == 0 || config.tileK % 4 != 0 || config.tileN % 4 != 0) {
+        return false;
+    }
+    std::uint32_t groupX = config.tileN / config.threadN;
+    std::uint32_t groupY = config.tileM / config.threadM;
+    std::uint32_t sharedBytes = config.tileK * (config.tileM + config.tileN) * sizeof(float);
+    return groupX * groupY <= limits.maxComputeWorkGroupInvocations && groupX <= limits.maxComputeWorkGroupSize[0] &&
+           groupY <= limits.maxComputeWorkGroupSize[1] && sharedBytes <= limits.maxComputeSharedMemorySize;
+}
+
+bool TensorKernels::cooperativeFits(const GemmShape& shape) const {
+    return cooperativeModule != VK_NULL_HANDLE && shape.m % COOPERATIVE_TILE == 0 && shape.n % COOPERATIVE_TILE == 0 &&
+           shape.k % COOPERATIVE_STEP == 0 && shape.k > 0;
+}
+
+std::vector<KernelConfig> TensorKernels::candidates(KernelType type, const GemmShape& shape) const {
+    std::vector<KernelConfig> result;
+    if (type == KernelType::Gemm && cooperativeFits(shape)) {
+        KernelConfig cooperative;
+        cooperative.cooperative = true;
+        result.push_back(cooperative);
+    }
+    for (const KernelConfig& config : TILED_CONFIGS) {
+        if (fits(config) && !oversized(config, shape)) {
+            result.push_back(config);
+        }
+    }
+    return result;
+}
+
+KernelConfig TensorKernels::defaultConfig(KernelType type, const GemmShape& shape) const {
+    if (type == KernelType::Gemm && cooperativeFits(shape)) {
+        KernelConfig cooperative;
+        cooperative.cooperative = true;
+        return cooperative;
+    }
+    for (const KernelConfig& config : DEFAULT_CONFIGS) {
+        if (fits(config) && !oversized(config, shape)) {
+            return config;
+        }
+    }
+    return DEFAULT_CONFIGS[1];
+}
+
+KernelConfig TensorKernels::choose(KernelType type, const GemmShape& shape) const {
+    auto found = tuned.find(tuningKey(type, shape));
+    // A size class also holds shapes the cooperative kernel can't take, and tuning files may come from
+    // an older driver with other limits.
+    if (found != tuned.end() && fits(found->second) && (!found->second.cooperative || cooperativeFits(shape))) {
+        return found->second;
+    }
+    return defaultConfig(type, shape);
+}
+
+std::string TensorKernels::tuningKey(KernelType type, const GemmShape& shape) const {
+    return std::string("kernel=") + kernelName(type) + " m=" + std::to_string(sizeClass(shape.m)) +
+           " n=" + std::to_string(sizeClass(shape.n)) + " k=" + std::to_string(sizeClass(shape.k));
+}
+
+std::vector<KernelTiming> TensorKernels::tune(const GemmShape& shape) {
+    return measure(KernelType::Gemm, shape, ConvShape());
+}
+
+std::vector<KernelTiming> TensorKernels::tune(const ConvShape& shape) {
+    if (shape.pointwise()) {
+        return tune(shape.gemm());
+    }
+    return measure(KernelType::Conv2d, shape.gemm(), shape);
+}
+
+std::vector<KernelTiming> TensorKernels::measure(KernelType type, const GemmShape& shape, const ConvShape& convShape) {
+    VT_FUNCTION_ZONE();
+    VkDeviceSize aSize = type == KernelType::Conv2d
+                             ? VkDeviceSize(convShape.batch) * convShape.height * convShape.width * convShape.channels
+                             : VkDeviceSize(shape.m) * shape.k;
+    VkDeviceSize sizes[3] = {aSize, VkDeviceSize(shape.k) * shape.n, VkDeviceSize(shape.m) * shape.n};
+    const char* names[3] = {"tuning A", "tuning B", "tuning C"};
+    Buffer buffers[3];
+    for (std::uint32_t i = 0; i < 3; i++) {
+        buffers[i] = createBuffer(physicalDevice, device, std::max<VkDeviceSize>(sizes[i], 1) * sizeof(float),
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, names[i]);
+    }
+    // Enough repeats for about a GFLOP per variant, so short dispatches aren't lost in timer noise.
+    auto repeats = static_cast<std::uint32_t>(std::min(16.0, std::max(2.0, 1e9 / std::max(shape.flops(), 1.0))));
+
+    std::vector<KernelTiming> timings;
+    bool filled = false;
+    for (const KernelConfig& config : candidates(type, shape)) {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        if (!filled) {
+            // 1.0f everywhere: no denormals, and sums stay exact enough to never overflow.
+            for (const Buffer& buffer : buffers) {
+                vkd.vkCmdFillBuffer(commandBuffer, buffer.buffer, 0, VK_WHOLE_SIZE, 0x3f800000);
+            }
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 1, &barrier, 0, nullptr, 0, nullptr);
+            filled = true;
+        }
+        // One untimed dispatch first: caches, clocks and the pipeline's first-use costs.
+        KernelEpilogue epilogue;
+        record(commandBuffer, type, config, shape, convShape, buffers[0].buffer, buffers[1].buffer, buffers[2].buffer, epilogue);
+        if (queryPool != VK_NULL_HANDLE) {
+            vkd.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+            vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, queryPool, 0);
+        }
+        for (std::uint32_t i = 0; i < repeats; i++) {
+            record(commandBuffer, type, config, shape, convShape, buffers[0].buffer, buffers[1].buffer, buffers[2].buffer,
+                   epilogue);
+        }
+        if (queryPool != VK_NULL_HANDLE) {
+            vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, queryPool, 1);
+        }
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        std::uint64_t submitted = Profiler::now();
+        if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit tensor tuning!");
+        }
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        std::uint64_t signaled = Profiler::now();
+        vkResetFences(device, 1, &fence);
+        reset();
+
+        KernelTiming timing;
+        timing.config = config;
+        if (queryPool != VK_NULL_HANDLE) {
+            std::uint64_t ticks[2];
+            vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(ticks), ticks, sizeof(std::uint64_t),
+                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+            timing.ms = ((ticks[1] - ticks[0]) & timestampMask) * timestampPeriod * 1e-6 / repeats;
+        } else {
+            timing.ms = (signaled - submitted) * 1e-6 / (repeats + 1);
+        }
+        timing.gflops = timing.ms > 0 ? shape.flops() / (timing.ms * 1e6) : 0;
+        timings.push_back(timing);
+    }
+    for (Buffer& buffer : buffers) {
+        destroyBuffer(device, buffer);
+    }
+
+    std::sort(timings.begin(), timings.end(),
+              [](const KernelTiming& a, const KernelTiming& b) { return a.ms < b.ms; });
+    if (!timings.empty()) {
+        tuned[tuningKey(type, shape)] = timings.front().config;
+    }
+    return timings;
+}
+
+void TensorKernels::loadTuning(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return;
+    }
+    std::string prefix = "device=" + deviceKey + " ";
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line.compare(0, prefix.size(), prefix) != 0) {
+            otherDevices.push_back(line);
+            continue;
+        }
+        auto configStart = line.rfind(" config=");
+        KernelConfig config;
+        if (configStart == std::string::npos || configStart < prefix.size() ||
+            !KernelConfig::parse(line.substr(configStart + 8), config)) {
+            continue;
+        }
+        tuned[line.substr(prefix.size(), configStart - prefix.size())] = config;
+    }
+}
+
+void TensorKernels::saveTuning(const std::string& path) const {
+    std::ofstream file(path);
+    file << "# TensorKernels tuning: m, n and k are ceil(log2) of the matrix sizes." << std::endl;
+    for (const std::string& line : otherDevices) {
+        file << line << std::endl;
+    }
+    for (const auto& entry : tuned) {
+        file << "device=" << deviceKey << " " << entry.first << " config=" << entry.second.name() << std::endl;
+    }
+    if (!file) {
+        throw std::runtime_error("failed to write tuning file " + path);
+    }
+}
+
+VkPipeline TensorKernels::pipeline(KernelType type, const KernelConfig& config, bool vec4) {
+    std::string key = std::string(kernelName(type)) + " " + config.name() + (vec4 && !config.cooperative ? " vec4" : "");
+    auto found = pipelines.find(key);
+    if (found != pipelines.end()) {
+        return found->second;
+    }
+
+    TiledSpecialization tiled = {config.tileN / std::max(config.threadN, 1u), config.tileM / std::max(config.threadM, 1u),
+                                 config.tileM, config.tileN, config.tileK, config.threadM, config.threadN,
+                                 vec4 ? VK_TRUE : VK_FALSE};
+    std::uint32_t groupSize = COOPERATIVE_SUBGROUPS * cooperativeMatrix.subgroupSize;
+    VkSpecializationMapEntry entries[8];
+    for (std::uint32_t i = 0; i < 8; i++) {
+        entries[i] = {i, i * static_cast<std::uint32_t>(sizeof(std::uint32_t)), sizeof(std::uint32_t)};
+    }
+    VkSpecializationInfo specialization = {};
+    specialization.pMapEntries = entries;
+    VkPipelineShaderStageRequiredSubgroupSizeCreateInfoEXT subgroupSize = {};
+    subgroupSize.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO_EXT;
+    subgroupSize.requiredSubgroupSize = cooperativeMatrix.subgroupSize;
+    VkShaderModule module;
+    VkPipelineShaderStageCreateFlags stageFlags = 0;
+    const void* stageNext = nullptr;
+    if (config.cooperative) {
+        module = cooperativeModule;
+        specialization.mapEntryCount = 1;
+        specialization.dataSize = sizeof(groupSize);
+        specialization.pData = &groupSize;
+        // The shader counts on exactly four full subgroups per workgroup.
+        if (cooperativeMatrix.requireSubgroupSize) {
+            stageNext = &subgroupSize;
+            stageFlags = VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT;
+        }
+    } else {
+        module = type == KernelType::Gemm ? gemmModule : convModule;
+        specialization.mapEntryCount = 8;
+        specialization.dataSize = sizeof(tiled);
+        specialization.pData = &tiled;
+    }
+
+    VkPipeline created = createComputePipeline(device, module, pipelineLayout, &specialization, stageFlags, stageNext);
+    setObjectName(device, created, key);
+    pipelines[key] = created;
+    return created;
+}
+
+VkDescriptorSet TensorKernels::allocateSet(VkBuffer a, VkBuffer b, VkBuffer c, VkBuffer bias) {
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    for (;;) {
+        bool fresh = currentPool == descriptorPools.size();
+        if (fresh) {
+            VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * 64};
+            VkDescriptorPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.maxSets = 64;
+            poolInfo.poolSizeCount = 1;
+            poolInfo.pPoolSizes = &poolSize;
+            VkDescriptorPool pool;
+            if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create tensor descriptor pool!");
+            }
+            setObjectName(device, pool, "tensor descriptor pool");
+            descriptorPools.push_back(pool);
+        }
+        VkDescriptorSetAllocateInfo setInfo = {};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = descriptorPools[currentPool];
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &setLayout;
+        if (vkd.vkAllocateDescriptorSets(device, &setInfo, &set) == VK_SUCCESS) {
+            break;
+        }
+        // A full pool moves on to the next one; a fresh pool can't be full.
+        if (fresh) {
+            throw std::runtime_error("failed to allocate tensor descriptor set!");
+        }
+        currentPool++;
+    }
+
+    VkDescriptorBufferInfo bufferInfos[4] = {
+        {a, 0, VK_WHOLE_SIZE},
+        {b, 0, VK_WHOLE_SIZE},
+        {c, 0, VK_WHOLE_SIZE},
+        {bias, 0, VK_WHOLE_SIZE},
+    };
+    VkWriteDescriptorSet writes[4] = {};
+    for (std::uint32_t i = 0; i < 4; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkd.vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+    return set;
+}
+
+void TensorKernels::record(VkCommandBuffer commandBuffer, KernelType type, const KernelConfig& config,
+                           const GemmShape& shape, const ConvShape& convShape, VkBuffer a, VkBuffer b, VkBuffer c,
+                           const KernelEpilogue& epilogue) {
+    CommandLabel label(commandBuffer, kernelName(type));
+    // 4-wide loads need rows that start on 16 bytes: K (input channels for convolutions) and N in fours.
+    bool vec4 = shape.n % 4 == 0 && (type == KernelType::Gemm ? shape.k % 4 == 0 : convShape.channels % 4 == 0);
+    std::uint32_t groupsX = config.cooperative ? shape.n / COOPERATIVE_TILE : (shape.n + config.tileN - 1) / config.tileN;
+    std::uint32_t groupsY = config.cooperative ? shape.m / COOPERATIVE_TILE : (shape.m + config.tileM - 1) / config.tileM;
+    if (groupsX > limits.maxComputeWorkGroupCount[0] || groupsY > limits.maxComputeWorkGroupCount[1]) {
+        throw std::runtime_error("tensor shape " + std::to_string(shape.m) + "x" + std::to_string(shape.n) +
+                                 " needs more workgroups than the device dispatches!");
+    }
+    if (groupsX == 0 || groupsY == 0) {
+        return;
+    }
+
+    KernelPush push = {};
+    push.m = shape.m;
+    push.n = shape.n;
+    push.k = shape.k;
+    push.alpha = epilogue.alpha;
+    push.beta = epilogue.beta;
+    push.flags = (epilogue.bias != VK_NULL_HANDLE ? FLAG_BIAS : 0) | (epilogue.relu ? FLAG_RELU : 0);
+    if (type == KernelType::Conv2d) {
+        push.height = convShape.height;
+        push.width = convShape.width;
+        push.channels = convShape.channels;
+        push.outputHeight = convShape.outputHeight();
+        push.outputWidth = convShape.outputWidth();
+        push.kernelSize = convShape.kernelSize;
+        push.stride = convShape.stride;
+        push.padding = convShape.padding;
+    }
+    // Without a bias, binding 3 still needs a valid buffer; the shader never reads it.
+    VkDescriptorSet set = allocateSet(a, b, c, epilogue.bias != VK_NULL_HANDLE ? epilogue.bias : c);
+
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline(type, config, vec4));
+    vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+    vkd.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           type == KernelType::Conv2d ? sizeof(KernelPush) : GEMM_PUSH_SIZE, &push);
+    vkd.vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+    // Make the result visible to whatever reads it next, including the next kernel of a network.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
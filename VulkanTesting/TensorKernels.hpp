@@ -0,0 +1,170 @@
+#ifndef TensorKernels_hpp
+#define TensorKernels_hpp
+
+#include "VulkanContext.hpp"
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// C (m x n) = A (m x k) * B (k x n), fp32, row major, densely packed.
+struct GemmShape {
+    std::uint32_t m = 0;
+    std::uint32_t n = 0;
+    std::uint32_t k = 0;
+
+    double flops() const { return 2.0 * m * n * k; }
+};
+
+// A square-kernel 2D convolution. Input NHWC (batch x height x width x channels), weights
+// [kernelSize][kernelSize][channels][outputChannels], output NHWC with outputChannels.
+struct ConvShape {
+    std::uint32_t batch = 1;
+    std::uint32_t height = 0;
+    std::uint32_t width = 0;
+    std::uint32_t channels = 0;
+    std::uint32_t outputChannels = 0;
+    std::uint32_t kernelSize = 3;
+    std::uint32_t stride = 1;
+    std::uint32_t padding = 1;
+
+    std::uint32_t outputHeight() const { return (height + 2 * padding - kernelSize) / stride + 1; }
+    std::uint32_t outputWidth() const { return (width + 2 * padding - kernelSize) / stride + 1; }
+    // The implicit GEMM: one row per output pixel, one column per output channel.
+    GemmShape gemm() const {
+        return {batch * outputHeight() * outputWidth(), outputChannels, kernelSize * kernelSize * channels};
+    }
+    // 1x1, stride 1, no padding: a plain GEMM on the NHWC data, which TensorKernels runs as one.
+    bool pointwise() const { return kernelSize == 1 && stride == 1 && padding == 0; }
+};
+
+// What happens to each output element after the multiply: alpha * sum + beta * previous value, plus
+// bias[column] (bias[output channel]) when there is a bias buffer, then max(0, x) with relu.
+struct KernelEpilogue {
+    float alpha = 1.0f;
+    float beta = 0.0f;
+    VkBuffer bias = VK_NULL_HANDLE;
+    bool relu = false;
+};
+
+// One variant of a kernel. Tiled: a tileM x tileN output block per workgroup, K staged tileK at a
+// time, threadM x threadN outputs per invocation. Cooperative: 64x64 blocks on cooperative matrices,
+// fp16 inputs, see shaders/gemm_coopmat.comp; the tile fields are unused.
+struct KernelConfig {
+    bool cooperative = false;
+    std::uint32_t tileM = 64;
+    std::uint32_t tileN = 64;
+    std::uint32_t tileK = 16;
+    std::uint32_t threadM = 4;
+    std::uint32_t threadN = 4;
+
+    // "64x64x16/4x4" or "coopmat"; what the tuning file stores.
+    std::string name() const;
+    // Inverse of name(). Returns false on anything else.
+    static bool parse(const std::string& name, KernelConfig& config);
+};
+
+struct KernelTiming {
+    KernelConfig config;
+    double ms = 0;     // Per dispatch.
+    double gflops = 0;
+};
+
+enum class KernelType {
+    Gemm,
+    Conv2d,
+};
+
+// GEMM and convolution kernels on the compute path, for inference-style workloads: shared-memory
+// tiled fp32 kernels with vectorized loads on every device, and cooperative matrix kernels (fp16
+// inputs, fp32 accumulation) where VK_KHR_cooperative_matrix has them. Convolutions run as implicit
+// GEMMs on the same tiling.
+//
+// The best tile sizes differ between GPUs (occupancy, register file, shared memory), so tune() times
+// the variants that fit the device on a shape and remembers the winner for shapes of that size,
+// rounded to powers of two. Results persist in a tuning file, keyed by vendor, device and driver,
+// so only the first run on a machine pays for it. Untuned shapes get a sensible default.
+//
+// The recording calls take buffers that are already visible to compute shaders and leave the output
+// visible to everything after on the same queue family. Each call allocates a descriptor set;
+// reset() frees them all once the recorded work has finished.
+class TensorKernels {
+public:
+    // queue must belong to queueFamily and support compute; tune() measures on it. shaderDir holds
+    // gemm_tiled.comp.spv, conv2d_tiled.comp.spv and gemm_coopmat.comp.spv. Cooperative matrices are
+    // used when cooperativeMatrix says the device has them, unless allowFloat16 is false.
+    TensorKernels(VkPhysicalDevice physicalDevice, VkDevice device, std::uint32_t queueFamily, VkQueue queue,
+                  const std::string& shaderDir, const CooperativeMatrixSupport& cooperativeMatrix,
+                  bool allowFloat16 = true);
+    ~TensorKernels();
+
+    TensorKernels(const TensorKernels&) = delete;
+    TensorKernels& operator=(const TensorKernels&) = delete;
+
+    void gemm(VkCommandBuffer commandBuffer, const GemmShape& shape, VkBuffer a, VkBuffer b, VkBuffer c,
+              const KernelEpilogue& epilogue = KernelEpilogue());
+    void conv2d(VkCommandBuffer commandBuffer, const ConvShape& shape, VkBuffer input, VkBuffer weights,
+                VkBuffer output, const KernelEpilogue& epilogue = KernelEpilogue());
+    // Frees the descriptor sets of everything recorded so far.
+    void reset();
+
+    // Times every variant that fits the device on scratch buffers of this shape, fastest first, and
+    // keeps the fastest for the shape's size class. Submits and waits; resets like reset().
+    std::vector<KernelTiming> tune(const GemmShape& shape);
+    std::vector<KernelTiming> tune(const ConvShape& shape);
+    // What gemm() / conv2d() would run for this shape.
+    KernelConfig config(const GemmShape& shape) const;
+    KernelConfig config(const ConvShape& shape) const;
+
+    // Tuning results in a text file, one per line. Entries of other devices are kept when saving.
+    // Loading a missing file does nothing.
+    void loadTuning(const std::string& path);
+    void saveTuning(const std::string& path) const;
+
+private:
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue queue;
+    CooperativeMatrixSupport cooperativeMatrix;
+    bool allowFloat16;
+    VkPhysicalDeviceLimits limits;
+    std::string deviceKey; // "vendor:device:driver", the tuning file key.
+
+    VkShaderModule gemmModule = VK_NULL_HANDLE;
+    VkShaderModule convModule = VK_NULL_HANDLE;
+    VkShaderModule cooperativeModule = VK_NULL_HANDLE; // Null without cooperative matrices.
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::map<std::string, VkPipeline> pipelines; // Built on first use, by kernel, config and load width.
+    std::vector<VkDescriptorPool> descriptorPools;
+    std::size_t currentPool = 0;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // tune()'s.
+    VkFence fence = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE; // Null when the queue family has no timestamps.
+    double timestampPeriod = 0;
+    std::uint64_t timestampMask = 0; // The queue family's timestampValidBits.
+
+    std::map<std::string, KernelConfig> tuned;  // By tuningKey().
+    std::vector<std::string> otherDevices;      // Lines of the tuning file for other devices.
+
+    std::vector<KernelConfig> candidates(KernelType type, const GemmShape& shape) const;
+    bool fits(const KernelConfig& config) const;
+    bool cooperativeFits(const GemmShape& shape) const;
+    KernelConfig defaultConfig(KernelType type, const GemmShape& shape) const;
+    KernelConfig choose(KernelType type, const GemmShape& shape) const;
+    std::string tuningKey(KernelType type, const GemmShape& shape) const;
+    std::vector<KernelTiming> measure(KernelType type, const GemmShape& gemmShape, const ConvShape& convShape);
+
+    VkPipeline pipeline(KernelType type, const KernelConfig& config, bool vec4);
+    VkDescriptorSet allocateSet(VkBuffer a, VkBuffer b, VkBuffer c, VkBuffer bias);
+    void record(VkCommandBuffer commandBuffer, KernelType type, const KernelConfig& config, const GemmShape& shape,
+                const ConvShape& convShape, VkBuffer a, VkBuffer b, VkBuffer c, const KernelEpilogue& epilogue);
+};
+
+#endif /* TensorKernels_hpp */
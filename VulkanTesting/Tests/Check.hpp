@@ -0,0 +1,64 @@
+#ifndef Check_hpp
+#define Check_hpp
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+// Just enough of a test harness for CTest: every test file is an executable whose main() calls its
+// cases and returns checkResult(). A failed CHECK prints where it was and the test carries on, so
+// one run reports every failure.
+
+// Exit code CTest reads as "skipped" (SKIP_RETURN_CODE), for tests that need a GPU when there is none.
+const int CHECK_SKIPPED = 77;
+
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void checkFailed(const char* file, int line, const char* what) {
+    std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+    checkFailures()++;
+}
+
+inline int checkResult() {
+    if (checkFailures() != 0) {
+        std::cerr << checkFailures() << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#define CHECK(condition)                                   \
+    do {                                                   \
+        if (!(condition)) {                                \
+            checkFailed(__FILE__, __LINE__, #condition);   \
+        }                                                  \
+    } while (0)
+
+// statement has to throw a std::exception (std::runtime_error everywhere in this tree).
+#define CHECK_THROWS(statement)                                          \
+    do {                                                                 \
+        bool thrown = false;                                             \
+        try {                                                            \
+            statement;                                                   \
+        } catch (const std::exception&) {                                \
+            thrown = true;                                               \
+        }                                                                \
+        if (!thrown) {                                                   \
+            checkFailed(__FILE__, __LINE__, "throws: " #statement);      \
+        }                                                                \
+    } while (0)
+
+#define CHECK_NOTHROW(statement)                                                            \
+    do {                                                                                    \
+        try {                                                                               \
+            statement;                                                                      \
+        } catch (const std::exception& e) {                                                 \
+            std::cerr << e.what() << std::endl;                                             \
+            checkFailed(__FILE__, __LINE__, "doesn't throw: " #statement);                  \
+        }                                                                                   \
+    } while (0)
+
+#endif /* Check_hpp */
@@ -0,0 +1,120 @@
+// app_config_test: command line and config file parsing, the command line overriding the file, nested
+// config files, and bad or out of range values refused with an error instead of half-applied.
+
+#include "../AppConfig.hpp"
+#include "Check.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    // parseCommandLine() with a program name in front.
+    bool parse(AppConfig& config, std::vector<std::string> args) {
+        args.insert(args.begin(), "app_config_test");
+        std::vector<char*> argv;
+        for (std::string& arg : args) {
+            argv.push_back(&arg[0]);
+        }
+        return config.parseCommandLine(static_cast<int>(argv.size()), argv.data());
+    }
+
+    bool refused(const std::vector<std::string>& args) {
+        AppConfig config;
+        try {
+            parse(config, args);
+        } catch (const std::exception&) {
+            return true;
+        }
+        return false;
+    }
+
+    void writeFile(const std::string& path, const std::string& text) {
+        std::ofstream file(path, std::ios::trunc);
+        file << text;
+    }
+
+    void commandLine() {
+        AppConfig config;
+        CHECK(parse(config, {"--resolution", "1280x720", "--headless", "--frames=300", "--device", "GeForce",
+                             "--present-mode", "mailbox", "--no-validation", "--target-fps", "120",
+                             "--min-render-scale=0.25", "--dynamic-resolution", "off", "--verbose"}));
+        CHECK(config.width == 1280 && config.height == 720);
+        CHECK(config.mode == RunMode::Headless);
+        CHECK(config.frameCount == 300);
+        CHECK(config.device == "GeForce");
+        CHECK(config.presentMode == PresentModePreference::Mailbox);
+        CHECK(!config.validation);
+        CHECK(config.targetFrameMs > 8.3 && config.targetFrameMs < 8.4);
+        CHECK(config.minRenderScale == 0.25);
+        CHECK(!config.dynamicResolution);
+        CHECK(config.verbose);
+    }
+
+    void badValues() {
+        CHECK(refused({"positional"}));
+        CHECK(refused({"--unknown", "1"}));
+        CHECK(refused({"--width"}));
+        CHECK(refused({"--width", "0"}));
+        CHECK(refused({"--width", "12px"}));
+        CHECK(refused({"--resolution", "1280"}));
+        CHECK(refused({"--frames-in-flight", "-1"}));
+        CHECK(refused({"--frames-in-flight", "17"}));
+        CHECK(!refused({"--frames-in-flight", "16"}));
+        CHECK(refused({"--present-mode", "vsync"}));
+        CHECK(refused({"--validation=maybe"}));
+        CHECK(refused({"--target-fps", "0"}));
+        CHECK(refused({"--target-fps", "inf"}));
+        CHECK(!refused({"--capture-first-frame", "0"}));
+        // Past what the field holds, instead of truncated by the cast.
+        CHECK(refused({"--width", "4294967297"}));
+        CHECK(refused({"--frames", "4294967296"}));
+        CHECK(refused({"--capture-first-frame", "99999999999999999999"}));
+        CHECK(!refused({"--frames", "4294967295"}));
+        // A render scale is a fraction of the window.
+        CHECK(refused({"--min-render-scale", "0"}));
+        CHECK(refused({"--min-render-scale", "1.5"}));
+        CHECK(refused({"--min-render-scale", "nan"}));
+        CHECK(!refused({"--min-render-scale", "1"}));
+    }
+
+    void configFile() {
+        writeFile("app_config_test.cfg",
+                  "# comment line\n"
+                  "resolution = 640x480   # trailing comment\n"
+                  "\n"
+                  "  frames = 50\n"
+                  "present-mode=immediate\n");
+        AppConfig config;
+        CHECK(parse(config, {"--config", "app_config_test.cfg", "--frames", "70"}));
+        CHECK(config.width == 640 && config.height == 480);
+        CHECK(config.presentMode == PresentModePreference::Immediate);
+        CHECK(config.frameCount == 70); // Later options win.
+
+        writeFile("app_config_test.cfg", "frames 50\n");
+        CHECK(refused({"--config", "app_config_test.cfg"}));
+        CHECK(refused({"--config", "app_config_test.missing"}));
+
+        // Includes nest, but a file including itself, directly or through another, is refused.
+        writeFile("app_config_test.cfg", "config = app_config_test_inner.cfg\nframes = 20\n");
+        writeFile("app_config_test_inner.cfg", "frames = 10\nwidth = 1024\n");
+        AppConfig nested;
+        CHECK(parse(nested, {"--config", "app_config_test.cfg"}));
+        CHECK(nested.frameCount == 20 && nested.width == 1024);
+        writeFile("app_config_test.cfg", "config = app_config_test.cfg\n");
+        CHECK(refused({"--config", "app_config_test.cfg"}));
+        writeFile("app_config_test.cfg", "config = app_config_test_inner.cfg\n");
+        writeFile("app_config_test_inner.cfg", "config = ./app_config_test.cfg\n");
+        CHECK(refused({"--config", "app_config_test.cfg"}));
+        std::remove("app_config_test.cfg");
+        std::remove("app_config_test_inner.cfg");
+    }
+}
+
+int main() {
+    CHECK_NOTHROW(commandLine());
+    badValues();
+    CHECK_NOTHROW(configFile());
+    return checkResult();
+}
@@ -0,0 +1,203 @@
+// asset_pack_test: AssetPackWriter output read back by AssetPack with every codec this build has,
+// serially and on the job system, and files that aren't packs, truncated packs and packs with
+// out-of-range tables refused when opened. The writer refuses a name it already has.
+
+#include "../AssetPack.hpp"
+#include "../JobSystem.hpp"
+#include "Check.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const char* PACK_PATH = "asset_pack_test.vtpack";
+
+    std::vector<std::uint8_t> sample(std::size_t size, std::uint32_t seed) {
+        // Half repetitive, half noise, so compressed chunks and chunks stored raw both show up.
+        std::mt19937 random(seed);
+        std::vector<std::uint8_t> data(size);
+        for (std::size_t i = 0; i < size; i++) {
+            data[i] = (i / 4096) % 2 == 0 ? static_cast<std::uint8_t>(i % 61) : static_cast<std::uint8_t>(random());
+        }
+        return data;
+    }
+
+    void writeFile(const std::string& path, const std::vector<std::uint8_t>& bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    void roundTrip() {
+        const PackCodec codecs[] = {PackCodec::Store, PackCodec::GLZ, PackCodec::LZ4, PackCodec::Zstd};
+        const std::size_t sizes[] = {0, 1, PACK_CHUNK_SIZE, 3 * PACK_CHUNK_SIZE + 5};
+        std::vector<std::string> names;
+        std::vector<std::vector<std::uint8_t>> contents;
+        AssetPackWriter writer;
+        for (PackCodec codec : codecs) {
+            if (!packCodecAvailable(codec)) {
+                continue;
+            }
+            for (std::size_t size : sizes) {
+                names.push_back("codec" + std::to_string(static_cast<int>(codec)) + "/size" + std::to_string(size));
+                contents.push_back(sample(size, static_cast<std::uint32_t>(names.size())));
+                writer.add(names.back(), contents.back(), codec);
+            }
+        }
+        writer.write(PACK_PATH);
+
+        AssetPack pack(PACK_PATH);
+        CHECK(pack.entries().size() == names.size());
+        CHECK(pack.find("missing") == nullptr);
+        JobSystem jobs(3);
+        for (std::size_t i = 0; i < names.size(); i++) {
+            const PackEntry* entry = pack.find(names[i]);
+            CHECK(entry != nullptr);
+            if (entry == nullptr) {
+                continue;
+            }
+            CHECK(pack.name(*entry) == names[i]);
+            CHECK(entry->uncompressedSize == contents[i].size());
+            if (entry->codec == PackCodec::Store && entry->chunkCount > 0) {
+                CHECK(pack.chunk(entry->firstChunk).offset % PACK_ALIGNMENT == 0);
+            }
+            for (JobSystem* with : {static_cast<JobSystem*>(nullptr), &jobs}) {
+                std::vector<std::uint8_t> out(contents[i].size() + 1, 0xCD);
+                pack.decompress(*entry, out.data(), with);
+                CHECK(std::memcmp(out.data(), contents[i].data(), contents[i].size()) == 0);
+                CHECK(out.back() == 0xCD);
+            }
+        }
+    }
+
+    void rejectsNonPacks() {
+        CHECK_THROWS(AssetPack pack("asset_pack_test.missing"));
+        writeFile(PACK_PATH, std::vector<std::uint8_t>(8, 0));
+        CHECK_THROWS(AssetPack pack(PACK_PATH));
+        writeFile(PACK_PATH, std::vector<std::uint8_t>(PACK_ALIGNMENT, 0));
+        CHECK_THROWS(AssetPack pack(PACK_PATH));
+
+        // A header whose table of contents points past the end of the file.
+        PackHeader header = {};
+        header.magic = PACK_MAGIC;
+        header.version = PACK_VERSION;
+        header.assetCount = 1;
+        header.tocOffset = PACK_ALIGNMENT;
+        header.stringsOffset = PACK_ALIGNMENT + sizeof(PackEntry);
+        std::vector<std::uint8_t> bytes(PACK_ALIGNMENT, 0);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        writeFile(PACK_PATH, bytes);
+        CHECK_THROWS(AssetPack pack(PACK_PATH));
+    }
+
+    void rejectsDuplicateNames() {
+        AssetPackWriter writer;
+        writer.add("mesh", sample(10, 1), PackCodec::Store);
+        CHECK_THROWS(writer.add("mesh", sample(10, 2), PackCodec::GLZ));
+        CHECK_NOTHROW(writer.add("mesh.lod1", sample(10, 3), PackCodec::Store));
+    }
+
+    std::vector<std::uint8_t> readFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Opens the pack and decodes everything in it; false if either throws.
+    bool opensAndDecodes(const std::vector<std::uint8_t>& bytes) {
+        writeFile(PACK_PATH, bytes);
+        try {
+            AssetPack pack(PACK_PATH);
+            for (const PackEntry* entry : pack.entries()) {
+                std::vector<std::uint8_t> out(static_cast<std::size_t>(entry->uncompressedSize));
+                pack.decompress(*entry, out.data());
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    void rejectsCorruptTables() {
+        AssetPackWriter writer;
+        writer.add("a", sample(2 * PACK_CHUNK_SIZE + 100, 1), PackCodec::Store);
+        writer.add("b", sample(PACK_CHUNK_SIZE, 2), PackCodec::GLZ);
+        writer.write(PACK_PATH);
+        const std::vector<std::uint8_t> good = readFile(PACK_PATH);
+        CHECK(opensAndDecodes(good));
+
+        PackHeader header;
+        std::memcpy(&header, good.data(), sizeof(header));
+        std::size_t entries = static_cast<std::size_t>(header.tocOffset);
+        std::size_t chunks = entries + header.assetCount * sizeof(PackEntry);
+        // Edits one field of the good pack and checks the result is refused when opened.
+        auto refuses = [&](std::size_t offset, const void* value, std::size_t size) {
+            std::vector<std::uint8_t> bad = good;
+            std::memcpy(bad.data() + offset, value, size);
+            writeFile(PACK_PATH, bad);
+            try {
+                AssetPack pack(PACK_PATH);
+            } catch (const std::exception&) {
+                return true;
+            }
+            return false;
+        };
+        std::uint64_t huge64 = ~0ull - 16;
+        std::uint32_t huge32 = ~0u - 16;
+        CHECK(refuses(offsetof(PackHeader, tocOffset), &huge64, 8));
+        CHECK(refuses(offsetof(PackHeader, stringsSize), &huge64, 8));
+        CHECK(refuses(offsetof(PackHeader, chunkCount), &huge32, 4));
+        CHECK(refuses(entries + offsetof(PackEntry, firstChunk), &huge32, 4));
+        CHECK(refuses(entries + offsetof(PackEntry, nameOffset), &huge32, 4));
+        std::uint32_t moreChunks = 4;
+        CHECK(refuses(entries + offsetof(PackEntry, chunkCount), &moreChunks, 4));
+        std::uint64_t biggerAsset = 5 * PACK_CHUNK_SIZE;
+        CHECK(refuses(entries + offsetof(PackEntry, uncompressedSize), &biggerAsset, 8));
+        CHECK(refuses(entries + offsetof(PackEntry, uncompressedSize), &huge64, 8));
+        std::uint8_t codec = 9;
+        CHECK(refuses(entries + offsetof(PackEntry, codec), &codec, 1));
+        CHECK(refuses(chunks + offsetof(PackChunk, offset), &huge64, 8));
+        std::uint64_t nearEnd = good.size() - 10;
+        CHECK(refuses(chunks + offsetof(PackChunk, offset), &nearEnd, 8));
+        std::uint32_t biggerChunk = PACK_CHUNK_SIZE + 1;
+        CHECK(refuses(chunks + offsetof(PackChunk, uncompressedSize), &biggerChunk, 4));
+        // Chunks 0-2 are "a", chunk 3 is "b". A chunk that doesn't follow the previous one.
+        PackChunk firstChunk;
+        std::memcpy(&firstChunk, good.data() + chunks, sizeof(firstChunk));
+        CHECK(refuses(chunks + sizeof(PackChunk) + offsetof(PackChunk, offset), &firstChunk.offset, 8));
+        // A GLZ chunk off its 4-byte alignment.
+        PackChunk glzChunk;
+        std::memcpy(&glzChunk, good.data() + chunks + 3 * sizeof(PackChunk), sizeof(glzChunk));
+        std::uint64_t misaligned = glzChunk.offset + 1;
+        CHECK(refuses(chunks + 3 * sizeof(PackChunk) + offsetof(PackChunk, offset), &misaligned, 8));
+
+        // Truncated anywhere: refused.
+        for (std::size_t size = sizeof(PackHeader); size < good.size(); size += good.size() / 37) {
+            CHECK(!opensAndDecodes(std::vector<std::uint8_t>(good.begin(), good.begin() + static_cast<std::ptrdiff_t>(size))));
+        }
+        // Random damage to the tables is refused, or decodes without touching memory it shouldn't.
+        std::mt19937 random(3);
+        for (int i = 0; i < 500; i++) {
+            std::vector<std::uint8_t> bad = good;
+            std::size_t at = entries + random() % (good.size() - entries);
+            bad[at] ^= static_cast<std::uint8_t>(1u << (random() % 8));
+            if (random() % 2 == 0) {
+                bad[random() % sizeof(PackHeader)] ^= static_cast<std::uint8_t>(1u << (random() % 8));
+            }
+            opensAndDecodes(bad);
+        }
+    }
+}
+
+int main() {
+    CHECK_NOTHROW(roundTrip());
+    rejectsNonPacks();
+    rejectsDuplicateNames();
+    CHECK_NOTHROW(rejectsCorruptTables());
+    std::remove(PACK_PATH);
+    return checkResult();
+}
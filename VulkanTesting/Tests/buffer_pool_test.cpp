@@ -0,0 +1,156 @@
+// buffer_pool_test: BufferPool bookkeeping on a real device (lavapipe will do): ranges that don't
+// overlap and respect the alignment, stale handles refused, stats that add up, and defragment()
+// emptying blocks without losing a byte of what it moved. Skipped without a Vulkan device.
+
+#include "../BufferPool.hpp"
+#include "../VulkanContext.hpp"
+#include "Check.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+    const VkDeviceSize BLOCK_SIZE = 4ull << 20;
+    const VkDeviceSize ALLOCATION_SIZE = 60 << 10;
+
+    struct Live {
+        BufferHandle handle;
+        std::uint8_t fill;
+    };
+
+    void fillAllocation(BufferPool& pool, const Live& live) {
+        BufferRange range = pool.resolve(live.handle);
+        std::memset(range.mapped, live.fill, static_cast<std::size_t>(ALLOCATION_SIZE));
+    }
+
+    bool holds(BufferPool& pool, const Live& live) {
+        BufferRange range = pool.resolve(live.handle);
+        auto bytes = static_cast<const std::uint8_t*>(range.mapped);
+        return std::all_of(bytes, bytes + ALLOCATION_SIZE, [&](std::uint8_t b) { return b == live.fill; });
+    }
+
+    bool disjoint(BufferPool& pool, const std::vector<Live>& allocations) {
+        std::vector<BufferRange> ranges;
+        for (const Live& live : allocations) {
+            ranges.push_back(pool.resolve(live.handle));
+        }
+        for (std::size_t i = 0; i < ranges.size(); i++) {
+            for (std::size_t j = i + 1; j < ranges.size(); j++) {
+                const BufferRange& a = ranges[i];
+                const BufferRange& b = ranges[j];
+                if (a.buffer == b.buffer && a.offset < b.offset + b.size && b.offset < a.offset + a.size) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void bookkeeping(VulkanContext& context, BufferPoolCreateInfo info) {
+        BufferPool pool(context.physicalDevice(), context.device(), info);
+        CHECK_THROWS(pool.allocate(0));
+        CHECK_THROWS(pool.resolve(BufferHandle()));
+
+        std::vector<Live> allocations;
+        for (std::uint32_t i = 0; i < 200; i++) {
+            allocations.push_back({pool.allocate(ALLOCATION_SIZE), static_cast<std::uint8_t>(i)});
+        }
+        BufferPoolStats stats = pool.stats();
+        CHECK(stats.allocations == 200);
+        CHECK(stats.usedBytes >= 200 * ALLOCATION_SIZE);
+        CHECK(stats.blockBytes >= stats.usedBytes);
+        CHECK(stats.blocks >= 3); // 200 * 60 KiB doesn't fit in fewer 4 MiB blocks.
+        CHECK(disjoint(pool, allocations));
+        for (const Live& live : allocations) {
+            BufferRange range = pool.resolve(live.handle);
+            CHECK(range.size >= ALLOCATION_SIZE);
+            CHECK(range.mapped != nullptr);
+            CHECK(range.offset % 16 == 0);
+            CHECK(range.offset + range.size <= BLOCK_SIZE);
+        }
+
+        // A freed slot is reused with a new generation; the old handle stops resolving.
+        BufferHandle stale = allocations[5].handle;
+        pool.free(stale);
+        BufferHandle reused = pool.allocate(ALLOCATION_SIZE);
+        CHECK(reused.index == stale.index && reused.generation != stale.generation);
+        CHECK_THROWS(pool.resolve(stale));
+        CHECK_THROWS(pool.free(stale));
+        allocations[5].handle = reused;
+        CHECK(pool.stats().allocations == 200);
+        CHECK(disjoint(pool, allocations));
+
+        for (const Live& live : allocations) {
+            pool.free(live.handle);
+        }
+        CHECK(pool.stats().allocations == 0);
+        CHECK(pool.stats().usedBytes == 0);
+    }
+
+    void defragmentation(VulkanContext& context, BufferPoolCreateInfo info) {
+        BufferPool pool(context.physicalDevice(), context.device(), info);
+        std::vector<Live> allocations;
+        for (std::uint32_t i = 0; i < 300; i++) {
+            allocations.push_back({pool.allocate(ALLOCATION_SIZE), static_cast<std::uint8_t>(i * 7 + 1)});
+            fillAllocation(pool, allocations.back());
+        }
+        std::uint32_t blocksBefore = pool.stats().blocks;
+        // Churn: keep every fourth allocation, spread over all blocks.
+        std::vector<Live> kept;
+        for (std::size_t i = 0; i < allocations.size(); i++) {
+            if (i % 4 == 0) {
+                kept.push_back(allocations[i]);
+            } else {
+                pool.free(allocations[i].handle);
+            }
+        }
+
+        std::uint64_t epoch = pool.moveEpoch();
+        for (int frame = 0; frame < 200; frame++) {
+            pool.defragment(1.0);
+            vkQueueWaitIdle(info.transferQueue);
+        }
+        BufferPoolStats stats = pool.stats();
+        CHECK(stats.moves > 0);
+        CHECK(stats.moving == 0);
+        CHECK(pool.moveEpoch() > epoch);
+        CHECK(stats.blocks < blocksBefore);
+        CHECK(stats.allocations == kept.size());
+        CHECK(disjoint(pool, kept));
+        for (const Live& live : kept) {
+            CHECK(holds(pool, live));
+        }
+        for (const Live& live : kept) {
+            pool.free(live.handle);
+        }
+    }
+}
+
+int main() {
+    std::unique_ptr<VulkanContext> context;
+    try {
+        VulkanContextCreateInfo contextInfo;
+        contextInfo.applicationName = "buffer_pool_test";
+        context.reset(new VulkanContext(contextInfo));
+    } catch (const std::exception& e) {
+        std::cerr << "skipped, no Vulkan device: " << e.what() << std::endl;
+        return CHECK_SKIPPED;
+    }
+    BufferPoolCreateInfo info;
+    info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    info.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    info.blockSize = BLOCK_SIZE;
+    info.queueFamilies = {context->queueFamilies().graphicsFamily};
+    info.transferQueue = context->transferQueue();
+    info.transferFamily = context->queueFamilies().transferFamily;
+    info.name = "buffer_pool_test";
+
+    CHECK_NOTHROW(bookkeeping(*context, info));
+    CHECK_NOTHROW(defragmentation(*context, info));
+    vkDeviceWaitIdle(context->device());
+    return checkResult();
+}
@@ -0,0 +1,230 @@
+// capture_replay_test: on a real device (lavapipe will do) GpuCapture recording a frame range of
+// buffer copies, fills and barriers that starts after the buffers were created, GpuReplay reading
+// the file back with the same frame and submit counts and running it more than once, and a submit
+// that touches an image aborting the capture and deleting the file. Everything is skipped without a
+// Vulkan device.
+
+#include "../GpuCapture.hpp"
+#include "../GpuReplay.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+#include "Check.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    const char* CAPTURE_PATH = "capture_replay_test.vtcap";
+    const char* ABORTED_PATH = "capture_replay_test.aborted.vtcap";
+    const VkDeviceSize SIZE = 64 * 1024;
+    const VkDeviceSize FILL_SIZE = 256;
+
+    bool exists(const char* path) {
+        return std::ifstream(path).good();
+    }
+
+    // A pool on the graphics family and one command buffer from it, allocated through vkd so an
+    // active capture tracks it.
+    struct Commands {
+        VkDevice device;
+        VkCommandPool pool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+
+        Commands(VulkanContext& context) : device(context.device()) {
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            poolInfo.queueFamilyIndex = context.queueFamilies().graphicsFamily;
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create command pool!");
+            }
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = pool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkd.vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS ||
+                vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+                vkd.vkDestroyCommandPool(device, pool, nullptr);
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+        }
+
+        ~Commands() {
+            vkDestroyFence(device, fence, nullptr);
+            vkd.vkDestroyCommandPool(device, pool, nullptr);
+        }
+
+        void begin() {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        }
+
+        // Throws what the capture's submit hook throws.
+        VkResult submit(VkQueue queue) {
+            vkEndCommandBuffer(commandBuffer);
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            VkResult result = vkd.vkQueueSubmit(queue, 1, &submitInfo, fence);
+            if (result == VK_SUCCESS) {
+                result = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                vkResetFences(device, 1, &fence);
+            }
+            return result;
+        }
+    };
+
+    VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess, std::uint32_t family) {
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        // The same family on both sides is no ownership transfer, but is written as queue numbers.
+        barrier.srcQueueFamilyIndex = family;
+        barrier.dstQueueFamilyIndex = family;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        return barrier;
+    }
+
+    void roundTrip(VulkanContext& context) {
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        const std::uint32_t family = context.queueFamilies().graphicsFamily;
+        std::remove(CAPTURE_PATH);
+        {
+            // Frame 0 runs uncaptured; the buffers already exist when frame 1 starts the file.
+            GpuCapture capture(context, CAPTURE_PATH, 1, 2);
+            CHECK(!capture.capturing());
+            Buffer upload = createBuffer(physicalDevice, device, SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "capture upload");
+            Buffer scratch = createBuffer(physicalDevice, device, SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "capture scratch");
+            Buffer readback = createBuffer(physicalDevice, device, SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "capture readback");
+            {
+                Commands commands(context);
+                for (std::uint32_t frame = 0; frame < 3; frame++) {
+                    CHECK(capture.capturing() == (frame >= 1));
+                    std::vector<std::uint32_t> words(SIZE / 4);
+                    for (std::size_t i = 0; i < words.size(); i++) {
+                        words[i] = static_cast<std::uint32_t>(i * 3 + frame);
+                    }
+                    std::memcpy(upload.mapped, words.data(), SIZE);
+
+                    commands.begin();
+                    VkBufferCopy region = {0, 0, SIZE};
+                    vkd.vkCmdCopyBuffer(commands.commandBuffer, upload.buffer, scratch.buffer, 1, &region);
+                    VkBufferMemoryBarrier barrier = bufferBarrier(scratch.buffer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, family);
+                    vkd.vkCmdPipelineBarrier(commands.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0, 0, nullptr, 1, &barrier, 0, nullptr);
+                    vkd.vkCmdFillBuffer(commands.commandBuffer, scratch.buffer, 0, FILL_SIZE, 0xC0DE0000u + frame);
+                    vkd.vkCmdPipelineBarrier(commands.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0, 0, nullptr, 1, &barrier, 0, nullptr);
+                    vkd.vkCmdCopyBuffer(commands.commandBuffer, scratch.buffer, readback.buffer, 1, &region);
+                    CHECK(commands.submit(context.graphicsQueue()) == VK_SUCCESS);
+
+                    const std::uint32_t* out = static_cast<const std::uint32_t*>(readback.mapped);
+                    CHECK(out[0] == 0xC0DE0000u + frame && out[FILL_SIZE / 4 - 1] == 0xC0DE0000u + frame);
+                    CHECK(out[FILL_SIZE / 4] == words[FILL_SIZE / 4] && out[SIZE / 4 - 1] == words[SIZE / 4 - 1]);
+                    capture.frameBoundary();
+                }
+            }
+            CHECK(capture.finished());
+            CHECK(!capture.capturing());
+            destroyBuffer(device, readback);
+            destroyBuffer(device, scratch);
+            destroyBuffer(device, upload);
+        }
+
+        std::ifstream file(CAPTURE_PATH, std::ios::binary);
+        std::uint32_t header[2] = {0, 0};
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        CHECK(header[0] == CAPTURE_MAGIC && header[1] == CAPTURE_VERSION);
+
+        GpuReplay replay(context, CAPTURE_PATH);
+        CHECK(replay.frameCount() == 2);
+        CHECK(replay.submitCount() == 2);
+        for (int run = 0; run < 2; run++) {
+            std::vector<double> frameTimes = replay.run();
+            CHECK(frameTimes.size() == 2);
+            for (double ms : frameTimes) {
+                CHECK(ms >= 0);
+            }
+        }
+    }
+
+    void imagesAbort(VulkanContext& context) {
+        VkDevice device = context.device();
+        std::remove(ABORTED_PATH);
+        GpuCapture capture(context, ABORTED_PATH, 0, 1);
+        CHECK(capture.capturing());
+        Image image = createImage(context.physicalDevice(), device, {4, 4}, VK_FORMAT_R8G8B8A8_UNORM,
+                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, "capture image");
+        {
+            Commands commands(context);
+            commands.begin();
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            vkd.vkCmdPipelineBarrier(commands.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+            CHECK_THROWS(commands.submit(context.graphicsQueue()));
+        }
+        CHECK(!capture.capturing());
+        CHECK(!exists(ABORTED_PATH));
+        vkDeviceWaitIdle(device);
+        destroyImage(device, image);
+    }
+
+    void rejectsOtherFiles(VulkanContext& context) {
+        CHECK_THROWS(GpuReplay(context, "capture_replay_test.missing"));
+        {
+            std::ofstream junk(ABORTED_PATH, std::ios::binary | std::ios::trunc);
+            junk << "not a capture file";
+        }
+        CHECK_THROWS(GpuReplay(context, ABORTED_PATH));
+        std::remove(ABORTED_PATH);
+    }
+}
+
+int main() {
+    std::unique_ptr<VulkanContext> context;
+    try {
+        VulkanContextCreateInfo contextInfo;
+        contextInfo.applicationName = "capture_replay_test";
+        context.reset(new VulkanContext(contextInfo));
+    } catch (const std::exception& e) {
+        std::cerr << "skipped, no Vulkan device: " << e.what() << std::endl;
+        return checkFailures() != 0 ? checkResult() : CHECK_SKIPPED;
+    }
+    CHECK_NOTHROW(roundTrip(*context));
+    CHECK_NOTHROW(imagesAbort(*context));
+    CHECK_NOTHROW(rejectsOtherFiles(*context));
+    vkDeviceWaitIdle(context->device());
+    std::remove(CAPTURE_PATH);
+    return checkResult();
+}
@@ -0,0 +1,113 @@
+// cluster_test: clusterLightCounts(), the CPU reference that light_bench validates the binning
+// shader against, checked against what the froxel grid has to give for simple light placements.
+
+#include "../ClusteredLighting.hpp"
+#include "Check.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+    // Column major, camera at the origin looking down -z.
+    const float IDENTITY[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+    PointLight light(float x, float y, float z, float radius) {
+        PointLight l = {};
+        l.position[0] = x;
+        l.position[1] = y;
+        l.position[2] = z;
+        l.radius = radius;
+        l.intensity = 1.0f;
+        return l;
+    }
+
+    std::uint64_t total(const std::vector<std::uint32_t>& counts) {
+        std::uint64_t sum = 0;
+        for (std::uint32_t c : counts) {
+            sum += c;
+        }
+        return sum;
+    }
+
+    void outsideFrustum() {
+        ClusterParams params;
+        PointLight behind = light(0, 0, 5, 1);
+        PointLight beyondFar = light(0, 0, -params.farPlane - 10, 5);
+        PointLight aside = light(1000, 0, -10, 1);
+        for (const PointLight& l : {behind, beyondFar, aside}) {
+            CHECK(total(clusterLightCounts(params, IDENTITY, &l, 1)) == 0);
+        }
+    }
+
+    void everywhere() {
+        // A light around the camera reaching past the far plane touches every cluster once.
+        ClusterParams params;
+        PointLight huge = light(0, 0, 0, params.farPlane * 4);
+        auto counts = clusterLightCounts(params, IDENTITY, &huge, 1);
+        CHECK(counts.size() == params.clusterCount());
+        bool allOne = true;
+        for (std::uint32_t c : counts) {
+            allOne = allOne && c == 1;
+        }
+        CHECK(allOne);
+    }
+
+    void localized() {
+        // A small light straight ahead lands in the middle tiles and the slices around its depth.
+        ClusterParams params;
+        params.tilesX = 16;
+        params.tilesY = 8;
+        PointLight small = light(0, 0, -10, 0.5f);
+        auto counts = clusterLightCounts(params, IDENTITY, &small, 1);
+        CHECK(total(counts) > 0);
+        float logRange = std::log(params.farPlane / params.nearPlane);
+        auto sliceOf = [&](float depth) {
+            return static_cast<std::uint32_t>(std::log(depth / params.nearPlane) / logRange * params.slices);
+        };
+        for (std::uint32_t slice = 0; slice < params.slices; slice++) {
+            for (std::uint32_t y = 0; y < params.tilesY; y++) {
+                for (std::uint32_t x = 0; x < params.tilesX; x++) {
+                    if (counts[(slice * params.tilesY + y) * params.tilesX + x] == 0) {
+                        continue;
+                    }
+                    CHECK(slice >= sliceOf(9.5f) && slice <= sliceOf(10.5f));
+                    CHECK(x >= params.tilesX / 2 - 1 && x <= params.tilesX / 2);
+                    CHECK(y >= params.tilesY / 2 - 1 && y <= params.tilesY / 2);
+                }
+            }
+        }
+    }
+
+    void additiveAndViewSpace() {
+        ClusterParams params;
+        std::vector<PointLight> lights = {light(-3, 1, -20, 2), light(4, -2, -50, 8), light(0, 0, -2, 1)};
+        auto together = clusterLightCounts(params, IDENTITY, lights.data(), static_cast<std::uint32_t>(lights.size()));
+        std::vector<std::uint32_t> sum(together.size(), 0);
+        for (const PointLight& l : lights) {
+            auto one = clusterLightCounts(params, IDENTITY, &l, 1);
+            for (std::size_t i = 0; i < sum.size(); i++) {
+                sum[i] += one[i];
+            }
+        }
+        CHECK(together == sum);
+
+        // Moving the camera by t is the same as moving the lights by -t.
+        float view[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -5, 2, -7, 1};
+        std::vector<PointLight> moved = lights;
+        for (PointLight& l : moved) {
+            l.position[0] -= 5;
+            l.position[1] += 2;
+            l.position[2] -= 7;
+        }
+        CHECK(clusterLightCounts(params, view, lights.data(), 3) ==
+              clusterLightCounts(params, IDENTITY, moved.data(), 3));
+    }
+}
+
+int main() {
+    outsideFrustum();
+    everywhere();
+    localized();
+    additiveAndViewSpace();
+    return checkResult();
+}
@@ -0,0 +1,122 @@
+// glz_test: GLZ round trips over chunk sizes and data shapes, and the reference decoder rejecting
+// malformed chunks without reading or writing out of bounds (run it in a sanitizer build to see
+// the latter).
+
+#include "../Glz.hpp"
+#include "Check.hpp"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+    std::vector<std::uint8_t> textLike(std::size_t size) {
+        static const char words[] = "the quick brown fox jumps over the lazy dog while vulkan renders ";
+        std::vector<std::uint8_t> data(size);
+        for (std::size_t i = 0; i < size; i++) {
+            data[i] = static_cast<std::uint8_t>(words[(i * 7 + i / 64) % (sizeof(words) - 1)]);
+        }
+        return data;
+    }
+
+    std::vector<std::uint8_t> noise(std::size_t size, std::uint32_t seed) {
+        std::mt19937 random(seed);
+        std::vector<std::uint8_t> data(size);
+        for (auto& b : data) {
+            b = static_cast<std::uint8_t>(random());
+        }
+        return data;
+    }
+
+    bool roundTrips(const std::vector<std::uint8_t>& data) {
+        auto packed = glzCompress(data.data(), data.size());
+        if (packed.size() % 4 != 0) {
+            return false;
+        }
+        std::vector<std::uint8_t> out(data.size() + 1, 0xCD);
+        if (!glzDecompress(packed.data(), packed.size(), out.data(), data.size())) {
+            return false;
+        }
+        // Exactly dstSize bytes written.
+        return std::memcmp(out.data(), data.data(), data.size()) == 0 && out[data.size()] == 0xCD;
+    }
+
+    void roundTrip() {
+        const std::size_t sizes[] = {1, 3, 4, 100, GLZ_STREAM_SIZE - 1, GLZ_STREAM_SIZE, GLZ_STREAM_SIZE + 1,
+                                     10000, GLZ_CHUNK_SIZE - 1, GLZ_CHUNK_SIZE};
+        for (std::size_t size : sizes) {
+            CHECK(roundTrips(std::vector<std::uint8_t>(size, 0)));
+            CHECK(roundTrips(textLike(size)));
+            CHECK(roundTrips(noise(size, static_cast<std::uint32_t>(size))));
+        }
+        // Long runs exercise the length extension bytes on both sides of a token.
+        auto mixed = noise(GLZ_CHUNK_SIZE, 7);
+        std::memset(mixed.data() + 100, 'a', 1500);
+        std::memset(mixed.data() + 5000, 'b', 300);
+        CHECK(roundTrips(mixed));
+    }
+
+    void compresses() {
+        auto zeros = std::vector<std::uint8_t>(GLZ_CHUNK_SIZE, 0);
+        CHECK(glzCompress(zeros.data(), zeros.size()).size() < GLZ_CHUNK_SIZE / 16);
+        auto text = textLike(GLZ_CHUNK_SIZE);
+        CHECK(glzCompress(text.data(), text.size()).size() < GLZ_CHUNK_SIZE / 2);
+    }
+
+    void rejectsMalformed() {
+        auto data = textLike(3 * GLZ_STREAM_SIZE + 17);
+        auto packed = glzCompress(data.data(), data.size());
+        std::vector<std::uint8_t> out(data.size());
+
+        CHECK(!glzDecompress(packed.data(), 0, out.data(), out.size()));
+        CHECK(!glzDecompress(packed.data(), 3, out.data(), out.size()));
+        // The stream count has to match the output size.
+        CHECK(!glzDecompress(packed.data(), packed.size(), out.data(), out.size() - GLZ_STREAM_SIZE));
+        CHECK(!glzDecompress(packed.data(), packed.size(), out.data(), out.size() + GLZ_STREAM_SIZE));
+        // Every truncation fails cleanly.
+        for (std::size_t size = 4; size < packed.size(); size += 13) {
+            CHECK(!glzDecompress(packed.data(), size, out.data(), out.size()));
+        }
+
+        auto bad = packed;
+        bad[0] = 0xFF; // Stream count far past the input.
+        CHECK(!glzDecompress(bad.data(), bad.size(), out.data(), out.size()));
+        bad = packed;
+        std::uint32_t huge = 0x7FFFFFFF; // Stream end past the input.
+        std::memcpy(bad.data() + 4, &huge, 4);
+        CHECK(!glzDecompress(bad.data(), bad.size(), out.data(), out.size()));
+        bad = packed;
+        std::uint32_t backwards = 0; // Second stream ending before the first one does.
+        std::memcpy(bad.data() + 8, &backwards, 4);
+        CHECK(!glzDecompress(bad.data(), bad.size(), out.data(), out.size()));
+        // The header check the GPU decoder relies on agrees with the CPU decoder.
+        CHECK(glzCheckHeader(packed.data(), packed.size(), out.size()));
+        CHECK(!glzCheckHeader(bad.data(), bad.size(), out.size()));
+        CHECK(!glzCheckHeader(packed.data(), packed.size(), out.size() + GLZ_STREAM_SIZE));
+        CHECK(!glzCheckHeader(packed.data(), 8, out.size()));
+
+        // A first match reaching before the start of the output.
+        std::vector<std::uint8_t> chunk = {1, 0, 0, 0, 5, 0, 0, 0, 0x10, 'x', 0x20, 0x00};
+        std::uint32_t end = 4;
+        std::memcpy(chunk.data() + 4, &end, 4);
+        std::uint8_t small[8];
+        CHECK(!glzDecompress(chunk.data(), chunk.size(), small, sizeof(small)));
+
+        // Random damage may decode to garbage but never reads or writes outside the buffers.
+        std::mt19937 random(1);
+        for (int i = 0; i < 2000; i++) {
+            bad = packed;
+            for (int flips = 0; flips < 4; flips++) {
+                bad[random() % bad.size()] ^= static_cast<std::uint8_t>(1u << (random() % 8));
+            }
+            glzDecompress(bad.data(), bad.size(), out.data(), out.size());
+        }
+    }
+}
+
+int main() {
+    roundTrip();
+    compresses();
+    rejectsMalformed();
+    return checkResult();
+}
@@ -0,0 +1,72 @@
+// image_codec_test: PNM encode/decode round trips, header parsing (comments, grey images) and the
+// images parsePnmHeader() has to refuse.
+
+#include "../ImageCodec.hpp"
+#include "Check.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+    std::vector<std::uint8_t> bytes(const std::string& s) {
+        return std::vector<std::uint8_t>(s.begin(), s.end());
+    }
+
+    bool refused(const std::string& image) {
+        auto data = bytes(image);
+        try {
+            parsePnmHeader(data.data(), data.size());
+        } catch (const std::exception&) {
+            return true;
+        }
+        return false;
+    }
+
+    void roundTrip() {
+        const std::uint32_t width = 5;
+        const std::uint32_t height = 3;
+        std::vector<std::uint8_t> rgba(width * height * 4);
+        for (std::size_t i = 0; i < rgba.size(); i++) {
+            rgba[i] = (i % 4) == 3 ? 255 : static_cast<std::uint8_t>(i * 11);
+        }
+        auto encoded = encodePnm(rgba.data(), width, height);
+        PnmHeader header = parsePnmHeader(encoded.data(), encoded.size());
+        CHECK(header.width == width);
+        CHECK(header.height == height);
+        CHECK(header.channels == 3);
+        CHECK(header.dataOffset + width * height * 3 == encoded.size());
+        std::vector<std::uint8_t> decoded(rgba.size());
+        decodePnm(encoded.data(), header, decoded.data());
+        CHECK(decoded == rgba);
+    }
+
+    void grey() {
+        auto data = bytes("P5\n# written by hand\n2 1\n# still the header\n255\n");
+        data.push_back(7);
+        data.push_back(200);
+        PnmHeader header = parsePnmHeader(data.data(), data.size());
+        CHECK(header.width == 2 && header.height == 1 && header.channels == 1);
+        std::vector<std::uint8_t> rgba(8);
+        decodePnm(data.data(), header, rgba.data());
+        CHECK((rgba == std::vector<std::uint8_t>{7, 7, 7, 255, 200, 200, 200, 255}));
+    }
+
+    void refusals() {
+        CHECK(refused(""));
+        CHECK(refused("P3\n1 1\n255\n000"));          // ASCII.
+        CHECK(refused("P6\n1 1\n65535\n123456"));     // 16-bit samples.
+        CHECK(refused("P6\n0 1\n255\n"));             // Empty.
+        CHECK(refused("P6\n1 x\n255\nabc"));          // Not a number.
+        CHECK(refused("P6\n99999999 1\n255\n"));      // Out of range.
+        CHECK(refused("P6\n2 2\n255\nabc"));          // Truncated samples.
+        CHECK(refused("P6\n1 1\n255"));               // No separator before the samples.
+        CHECK(!refused("P6\n1 1\n255\nabc"));
+    }
+}
+
+int main() {
+    CHECK_NOTHROW(roundTrip());
+    CHECK_NOTHROW(grey());
+    refusals();
+    return checkResult();
+}
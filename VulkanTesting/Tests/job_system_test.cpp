@@ -0,0 +1,63 @@
+// job_system_test: parallelFor() running every index exactly once, and a body that throws on a
+// worker or on the calling thread coming back as an exception from parallelFor() instead of
+// terminating the process. Run it in a thread sanitizer build as well.
+
+#include "../JobSystem.hpp"
+#include "Check.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    void everyIndexOnce() {
+        JobSystem jobs(4);
+        for (std::size_t count : {std::size_t(0), std::size_t(1), std::size_t(7), std::size_t(10000)}) {
+            std::vector<std::atomic<int>> hits(count);
+            for (auto& h : hits) {
+                h = 0;
+            }
+            jobs.parallelFor(count, [&](std::size_t i) { hits[i]++; });
+            bool once = true;
+            for (auto& h : hits) {
+                once = once && h == 1;
+            }
+            CHECK(once);
+        }
+    }
+
+    void exceptions() {
+        JobSystem jobs(4);
+        for (int round = 0; round < 200; round++) {
+            // Index 0 usually runs on the calling thread, the last one on a worker.
+            std::size_t failing = round % 2 == 0 ? 0 : 63;
+            std::atomic<int> ran{0};
+            bool caught = false;
+            try {
+                jobs.parallelFor(64, [&](std::size_t i) {
+                    ran++;
+                    if (i == failing) {
+                        throw std::runtime_error("chunk " + std::to_string(i) + " is corrupt");
+                    }
+                });
+            } catch (const std::runtime_error& e) {
+                caught = std::string(e.what()) == "chunk " + std::to_string(failing) + " is corrupt";
+            }
+            CHECK(caught);
+            CHECK(ran >= 1 && ran <= 64);
+        }
+        // Every body throwing: still exactly one exception out, and the pool keeps working.
+        CHECK_THROWS(jobs.parallelFor(1000, [](std::size_t) { throw std::runtime_error("all"); }));
+        std::atomic<int> after{0};
+        jobs.parallelFor(100, [&](std::size_t) { after++; });
+        CHECK(after == 100);
+        jobs.waitIdle();
+    }
+}
+
+int main() {
+    everyIndexOnce();
+    exceptions();
+    return checkResult();
+}
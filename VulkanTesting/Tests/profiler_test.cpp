@@ -0,0 +1,131 @@
+// profiler_test: zones recorded only while the profiler runs, per-thread rings drained by
+// collect() while their threads keep recording, a full ring counting its losses instead of
+// overwriting, GPU zones on their own track, and the Chrome trace JSON naming every track and
+// escaping names. Run it in a thread sanitizer build as well.
+
+#include "../Profiler.hpp"
+#include "Check.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const char* TRACE_PATH = "profiler_test.json";
+
+    std::string writeAndRead() {
+        Profiler::writeTrace(TRACE_PATH);
+        std::ifstream file(TRACE_PATH);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::size_t count(const std::string& text, const std::string& what) {
+        std::size_t n = 0;
+        for (std::size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + what.size())) {
+            n++;
+        }
+        return n;
+    }
+
+    void disabledRecordsNothing() {
+        CHECK(!Profiler::enabled());
+        for (int i = 0; i < 100; i++) {
+            VT_ZONE("before start");
+        }
+        std::string trace = writeAndRead();
+        CHECK(count(trace, "before start") == 0);
+        CHECK(count(trace, "\"ph\":\"X\"") == 0);
+    }
+
+    void threadsAndCollect() {
+        Profiler::start();
+        Profiler::setThreadName("test main");
+        {
+            VT_ZONE("outer");
+            VT_ZONE("inner");
+        }
+        // Workers record while this thread collects, the way a frame loop drains the rings.
+        const int threadCount = 4;
+        const int zonesPerThread = 5000;
+        std::atomic<int> running{threadCount};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([t, &running] {
+                Profiler::setThreadName("worker " + std::to_string(t));
+                for (int i = 0; i < zonesPerThread; i++) {
+                    VT_ZONE("worker zone");
+                }
+                running--;
+            });
+        }
+        while (running > 0) {
+            Profiler::collect();
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        std::string trace = writeAndRead();
+        CHECK(Profiler::droppedZones() == 0);
+        CHECK(count(trace, "\"worker zone\"") == threadCount * zonesPerThread);
+        CHECK(count(trace, "\"outer\"") == 1 && count(trace, "\"inner\"") == 1);
+        CHECK(count(trace, "\"test main\"") == 1);
+        for (int t = 0; t < threadCount; t++) {
+            CHECK(count(trace, "\"worker " + std::to_string(t) + "\"") == 1);
+        }
+        CHECK(count(trace, "\"function\":\"operator()\"") == threadCount * zonesPerThread);
+        CHECK(trace.find("profiler_test.cpp") != std::string::npos);
+    }
+
+    void fullRingDrops() {
+        // A fresh thread gets its own empty ring. Far more zones than it holds, with no collect().
+        const int zones = 100000;
+        std::thread thread([] {
+            for (int i = 0; i < zones; i++) {
+                VT_ZONE("flood");
+            }
+        });
+        thread.join();
+        std::uint64_t dropped = Profiler::droppedZones();
+        std::string trace = writeAndRead();
+        std::size_t kept = count(trace, "\"flood\"");
+        CHECK(dropped > 0);
+        CHECK(kept > 0);
+        CHECK(kept + dropped == zones);
+    }
+
+    void gpuZonesAndEscaping() {
+        static const ZoneSource gpuSource = {"GPU \"decode\"", "gpuZonesAndEscaping", "profiler_test.cpp", 1};
+        std::uint64_t now = Profiler::now();
+        Profiler::gpuZone(&gpuSource, "compute", now, now + 1000);
+        Profiler::gpuZone(&gpuSource, "compute", now + 2000, now + 3000);
+        Profiler::gpuZone(&gpuSource, "transfer", now, now + 500);
+        std::string trace = writeAndRead();
+        CHECK(count(trace, "\"GPU compute\"") == 1);
+        CHECK(count(trace, "\"GPU transfer\"") == 1);
+        CHECK(count(trace, "\"GPU \\\"decode\\\"\"") == 3);
+
+        // Stopped again: neither CPU nor GPU zones are kept.
+        Profiler::stop();
+        {
+            VT_ZONE("after stop");
+        }
+        Profiler::gpuZone(&gpuSource, "late queue", now, now + 1);
+        trace = writeAndRead();
+        CHECK(count(trace, "after stop") == 0);
+        CHECK(count(trace, "late queue") == 0);
+    }
+}
+
+int main() {
+    CHECK_NOTHROW(disabledRecordsNothing());
+    CHECK_NOTHROW(threadsAndCollect());
+    CHECK_NOTHROW(fullRingDrops());
+    CHECK_NOTHROW(gpuZonesAndEscaping());
+    CHECK_THROWS(Profiler::writeTrace("profiler_test.missing/trace.json"));
+    std::remove(TRACE_PATH);
+    return checkResult();
+}
@@ -0,0 +1,148 @@
+// render_graph_test: RenderGraph pass validation, and on a real device (lavapipe will do) the
+// G-buffer, lighting and post chain merged into two render passes with the G-buffer transient,
+// the same chain unmerged into three with every attachment stored, and both recorded and
+// submitted. Validation runs everywhere; the rest is skipped without a Vulkan device.
+
+#include "../RenderGraph.hpp"
+#include "../VulkanContext.hpp"
+#include "Check.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    struct Chain {
+        std::uint32_t albedo, normal, depth, hdr, ldr;
+        std::uint32_t gbuffer, lighting, post;
+    };
+
+    Chain addChain(RenderGraph& graph) {
+        Chain c;
+        c.albedo = graph.addAttachment({"albedo", VK_FORMAT_R8G8B8A8_UNORM, false, {}});
+        c.normal = graph.addAttachment({"normal", VK_FORMAT_R16G16B16A16_SFLOAT, false, {}});
+        c.depth = graph.addAttachment({"depth", VK_FORMAT_D32_SFLOAT, false, {}});
+        c.hdr = graph.addAttachment({"hdr", VK_FORMAT_R16G16B16A16_SFLOAT, false, {}});
+        c.ldr = graph.addAttachment({"ldr", VK_FORMAT_R8G8B8A8_UNORM, true, {}});
+        c.gbuffer = graph.addPass({"gbuffer",
+            {{c.albedo, AttachmentUse::Color}, {c.normal, AttachmentUse::Color}, {c.depth, AttachmentUse::Depth}}, nullptr});
+        c.lighting = graph.addPass({"lighting",
+            {{c.albedo, AttachmentUse::Input}, {c.normal, AttachmentUse::Input}, {c.depth, AttachmentUse::Input},
+             {c.hdr, AttachmentUse::Color}}, nullptr});
+        c.post = graph.addPass({"post", {{c.hdr, AttachmentUse::Sampled}, {c.ldr, AttachmentUse::Color}}, nullptr});
+        return c;
+    }
+
+    void validation() {
+        RenderGraph graph(VK_NULL_HANDLE, VK_NULL_HANDLE);
+        std::uint32_t color = graph.addAttachment({"color", VK_FORMAT_R8G8B8A8_UNORM, false, {}});
+        std::uint32_t depth = graph.addAttachment({"depth", VK_FORMAT_D32_SFLOAT, false, {}});
+        std::uint32_t depth2 = graph.addAttachment({"depth2", VK_FORMAT_D32_SFLOAT, false, {}});
+        CHECK_THROWS(graph.addPass({"unknown", {{7, AttachmentUse::Color}}, nullptr}));
+        CHECK_THROWS(graph.addPass({"twice", {{color, AttachmentUse::Color}, {color, AttachmentUse::Input}}, nullptr}));
+        CHECK_THROWS(graph.addPass({"two depths", {{depth, AttachmentUse::Depth}, {depth2, AttachmentUse::DepthTest}}, nullptr}));
+        CHECK(graph.addPass({"fine", {{color, AttachmentUse::Color}, {depth, AttachmentUse::Depth}}, nullptr}) == 0);
+    }
+
+    // Records the compiled graph with empty passes and runs it, which is enough for the validation
+    // layers to check the render passes and the subpass sequence.
+    void submit(VulkanContext& context, const RenderGraph& graph) {
+        VkDevice device = context.device();
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = context.queueFamilies().graphicsFamily;
+        VkCommandPool pool;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        VkResult result = vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        if (result == VK_SUCCESS) {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            graph.record(commandBuffer);
+            vkEndCommandBuffer(commandBuffer);
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            result = vkQueueSubmit(context.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+            if (result == VK_SUCCESS) {
+                result = vkQueueWaitIdle(context.graphicsQueue());
+            }
+        }
+        vkDestroyCommandPool(device, pool, nullptr);
+        CHECK(result == VK_SUCCESS);
+    }
+
+    void merging(VulkanContext& context) {
+        RenderGraph graph(context.physicalDevice(), context.device());
+        Chain c = addChain(graph);
+        const VkExtent2D extent = {64, 48};
+        const VkDeviceSize pixels = 64 * 48;
+
+        graph.compile(extent);
+        const RenderGraphStats merged = graph.stats();
+        // Lighting reads the G-buffer through input attachments, so it joins; post samples hdr,
+        // which lighting wrote, so it starts a render pass of its own.
+        CHECK(merged.renderPasses == 2);
+        CHECK(merged.subpasses == 3);
+        CHECK(graph.renderPass(c.gbuffer) == graph.renderPass(c.lighting));
+        CHECK(graph.renderPass(c.post) != graph.renderPass(c.lighting));
+        CHECK(graph.subpass(c.gbuffer) == 0 && graph.subpass(c.lighting) == 1 && graph.subpass(c.post) == 0);
+        // The G-buffer never leaves the first render pass; only hdr and the external ldr are stored.
+        CHECK(merged.transientAttachments == 3);
+        CHECK(merged.bytesLoaded == 0);
+        CHECK(merged.bytesStored == pixels * (8 + 4));
+        std::string description = graph.describe();
+        CHECK(description.find("gbuffer > lighting") != std::string::npos);
+        CHECK(description.find("albedo=clear/dont_care") != std::string::npos);
+        CHECK(description.find("hdr=clear/store") != std::string::npos);
+        submit(context, graph);
+
+        graph.compile(extent, false);
+        const RenderGraphStats separate = graph.stats();
+        CHECK(separate.renderPasses == 3);
+        CHECK(separate.subpasses == 3);
+        CHECK(separate.transientAttachments == 0);
+        CHECK(graph.renderPass(c.gbuffer) != graph.renderPass(c.lighting));
+        CHECK(graph.subpass(c.lighting) == 0);
+        // Lighting loads the whole G-buffer the first pass had to store.
+        CHECK(separate.bytesLoaded == pixels * (4 + 8 + 4));
+        CHECK(separate.bytesStored == merged.bytesStored + separate.bytesLoaded);
+        CHECK(graph.describe().find("albedo=load/dont_care") != std::string::npos);
+        submit(context, graph);
+
+        // Compiling again, as after a resize, rebuilds everything at the new size.
+        graph.compile({32, 32});
+        CHECK(graph.stats().renderPasses == 2);
+        CHECK(graph.image(c.ldr).image != VK_NULL_HANDLE);
+        submit(context, graph);
+    }
+}
+
+int main() {
+    CHECK_NOTHROW(validation());
+    std::unique_ptr<VulkanContext> context;
+    try {
+        VulkanContextCreateInfo contextInfo;
+        contextInfo.applicationName = "render_graph_test";
+        context.reset(new VulkanContext(contextInfo));
+    } catch (const std::exception& e) {
+        std::cerr << "skipped, no Vulkan device: " << e.what() << std::endl;
+        return checkFailures() != 0 ? checkResult() : CHECK_SKIPPED;
+    }
+    CHECK_NOTHROW(merging(*context));
+    vkDeviceWaitIdle(context->device());
+    return checkResult();
+}
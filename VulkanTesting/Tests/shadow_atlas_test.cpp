@@ -0,0 +1,152 @@
+// shadow_atlas_test: the buddy allocator behind ShadowAtlas (tile sizes, no overlaps, everything
+// stepping down a size when the atlas is full, buddies merging again on free) and the passes
+// build() asks for in a quiet and in a changing scene.
+
+#include "../ShadowAtlas.hpp"
+#include "Check.hpp"
+
+#include <vector>
+
+namespace {
+    const std::uint32_t ATLAS = 4096;
+
+    ShadowLightDesc spot(float x, std::uint32_t resolution) {
+        ShadowLightDesc desc;
+        desc.type = ShadowLightType::Spot;
+        desc.position = Vec3(x, 5, 0);
+        desc.direction = Vec3(0, -1, 0);
+        desc.resolution = resolution;
+        return desc;
+    }
+
+    // Tile size of a view in texels.
+    std::uint32_t tileSize(const ShadowViewGpu& view) {
+        return static_cast<std::uint32_t>(view.atlasRect[2] * ATLAS + 0.5f);
+    }
+
+    bool disjoint(const std::vector<ShadowViewGpu>& views) {
+        for (std::size_t i = 0; i < views.size(); i++) {
+            const float* a = views[i].atlasRect;
+            if (a[0] < 0 || a[1] < 0 || a[0] + a[2] > 1.0f || a[1] + a[3] > 1.0f) {
+                return false;
+            }
+            for (std::size_t j = i + 1; j < views.size(); j++) {
+                const float* b = views[j].atlasRect;
+                if (a[0] < b[0] + b[2] && b[0] < a[0] + a[2] && a[1] < b[1] + b[3] && b[1] < a[1] + a[3]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::size_t countPasses(const std::vector<ShadowPass>& passes, ShadowPassType type) {
+        std::size_t count = 0;
+        for (const ShadowPass& pass : passes) {
+            count += pass.type == type;
+        }
+        return count;
+    }
+
+    void allocation() {
+        ShadowAtlasCreateInfo info;
+        info.size = ATLAS;
+        info.minTile = 256;
+        ShadowAtlas atlas(info);
+        ShadowCamera camera;
+
+        // Sixteen 1024 tiles fill the atlas exactly.
+        for (std::uint32_t i = 0; i < 16; i++) {
+            atlas.setLight(i, spot(static_cast<float>(i), 1024));
+        }
+        atlas.build(camera);
+        CHECK(atlas.views().size() == 16);
+        for (std::uint32_t i = 0; i < 16; i++) {
+            CHECK(atlas.viewCount(i) == 1);
+            CHECK(tileSize(atlas.views()[atlas.firstView(i)]) == 1024);
+        }
+        CHECK(disjoint(atlas.views()));
+
+        // One more and every light steps down to 512 rather than the last one getting nothing.
+        atlas.setLight(16, spot(16, 1024));
+        atlas.build(camera);
+        CHECK(atlas.views().size() == 17);
+        for (const ShadowViewGpu& view : atlas.views()) {
+            CHECK(tileSize(view) == 512);
+        }
+        CHECK(disjoint(atlas.views()));
+
+        // A point light takes six tiles of one size.
+        atlas.setLight(20, [] {
+            ShadowLightDesc desc;
+            desc.type = ShadowLightType::Point;
+            desc.resolution = 512;
+            return desc;
+        }());
+        atlas.build(camera);
+        CHECK(atlas.viewCount(20) == 6);
+        CHECK(disjoint(atlas.views()));
+
+        // Freed tiles merge with their buddies until the whole atlas is one block again.
+        for (std::uint32_t i = 0; i < 21; i++) {
+            atlas.removeLight(i);
+        }
+        atlas.setLight(0, spot(0, ATLAS));
+        atlas.build(camera);
+        CHECK(atlas.views().size() == 1);
+        CHECK(tileSize(atlas.views()[0]) == ATLAS);
+    }
+
+    void passes() {
+        ShadowAtlasCreateInfo info;
+        info.size = ATLAS;
+        ShadowAtlas atlas(info);
+        ShadowCamera camera;
+        atlas.setLight(0, spot(0, 1024));
+
+        // A new view renders its whole tile once.
+        auto first = atlas.build(camera);
+        CHECK(countPasses(first, ShadowPassType::RenderStatic) == 1);
+        CHECK(first.size() == 3);
+        CHECK(first[0].region.extent.width == 1024 && first[0].region.extent.height == 1024);
+
+        // Nothing changed, nothing to draw.
+        CHECK(atlas.build(camera).empty());
+        atlas.setLight(0, spot(0, 1024));
+        CHECK(atlas.build(camera).empty());
+
+        // A caster moving under the light: restore and redraw only where it was and is, static
+        // depth untouched.
+        Bounds before, after;
+        before.add(Vec3(-0.5f, 0, -0.5f));
+        before.add(Vec3(0, 0.5f, 0));
+        after.add(Vec3(0, 0, -0.5f));
+        after.add(Vec3(0.5f, 0.5f, 0));
+        atlas.dynamicCasterMoved(before, after);
+        auto moved = atlas.build(camera);
+        CHECK(countPasses(moved, ShadowPassType::RenderStatic) == 0);
+        CHECK(countPasses(moved, ShadowPassType::CopyStatic) == 1);
+        CHECK(countPasses(moved, ShadowPassType::RenderDynamic) == 1);
+        for (const ShadowPass& pass : moved) {
+            CHECK(pass.region.extent.width < 1024 && pass.region.extent.height < 1024);
+        }
+
+        // Outside the light's range nothing is redrawn.
+        Bounds far;
+        far.add(Vec3(100, 0, 100));
+        far.add(Vec3(101, 1, 101));
+        atlas.dynamicCasterMoved(far, far);
+        atlas.staticGeometryChanged(far);
+        CHECK(atlas.build(camera).empty());
+
+        // Moving the light itself re-renders all of it.
+        atlas.setLight(0, spot(1, 1024));
+        CHECK(countPasses(atlas.build(camera), ShadowPassType::RenderStatic) == 1);
+    }
+}
+
+int main() {
+    allocation();
+    passes();
+    return checkResult();
+}
@@ -0,0 +1,142 @@
+// tensor_kernels_test: KernelConfig names parsing back to the same config and anything else
+// refused, and on a real device (lavapipe will do) a tuning file round trip: tune() picks the
+// fastest variant, saveTuning() keeps other devices' entries, a second TensorKernels loading the
+// file runs the same variant, and an entry that doesn't parse falls back to the default. The
+// parsing cases run everywhere; the rest is skipped without a Vulkan device.
+
+#include "../TensorKernels.hpp"
+#include "../VulkanContext.hpp"
+#include "Check.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    const char* TUNING_PATH = "tensor_kernels_test.tuning";
+    const char* OTHER_DEVICE = "device=ffff:ffff:00000000 kernel=gemm m=6 n=6 k=6 config=32x32x8/2x2";
+
+    bool roundTrips(const KernelConfig& config) {
+        KernelConfig parsed;
+        parsed.tileM = 1;
+        return KernelConfig::parse(config.name(), parsed) && parsed.name() == config.name() &&
+               parsed.cooperative == config.cooperative && parsed.tileM == config.tileM && parsed.tileN == config.tileN &&
+               parsed.tileK == config.tileK && parsed.threadM == config.threadM && parsed.threadN == config.threadN;
+    }
+
+    void names() {
+        KernelConfig config;
+        CHECK(config.name() == "64x64x16/4x4");
+        CHECK(roundTrips(config));
+        config.tileM = 128;
+        config.tileN = 32;
+        config.tileK = 8;
+        config.threadM = 8;
+        config.threadN = 2;
+        CHECK(config.name() == "128x32x8/8x2");
+        CHECK(roundTrips(config));
+        KernelConfig cooperative;
+        cooperative.cooperative = true;
+        CHECK(cooperative.name() == "coopmat");
+        CHECK(roundTrips(cooperative));
+
+        // Anything else leaves the config alone.
+        const char* bad[] = {"", "coopmat2", "64x64x16", "64x64/4x4", "64x64x16/4x4x", "64x64x16/4x4 ", "64x64x16/4", "fast"};
+        for (const char* name : bad) {
+            KernelConfig untouched;
+            untouched.tileM = 7;
+            CHECK(!KernelConfig::parse(name, untouched));
+            CHECK(untouched.tileM == 7 && !untouched.cooperative);
+        }
+    }
+
+    std::string readFile(const std::string& path) {
+        std::ifstream file(path);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string& path, const std::string& text) {
+        std::ofstream file(path, std::ios::trunc);
+        file << text;
+    }
+
+    void tuningRoundTrip(VulkanContext& context) {
+        auto create = [&]() {
+            return std::unique_ptr<TensorKernels>(new TensorKernels(
+                context.physicalDevice(), context.device(), context.queueFamilies().computeFamily, context.computeQueue(),
+                "shaders", context.cooperativeMatrix()));
+        };
+        const GemmShape shape = {64, 64, 64};
+        std::string defaultName = create()->config(shape).name();
+
+        // A missing file is no error.
+        std::remove(TUNING_PATH);
+        create()->loadTuning(TUNING_PATH);
+
+        writeFile(TUNING_PATH, std::string("# written by hand\n") + OTHER_DEVICE + "\n");
+        std::string winner;
+        {
+            auto kernels = create();
+            kernels->loadTuning(TUNING_PATH);
+            std::vector<KernelTiming> timings = kernels->tune(shape);
+            CHECK(!timings.empty());
+            if (timings.empty()) {
+                return;
+            }
+            for (std::size_t i = 1; i < timings.size(); i++) {
+                CHECK(timings[i - 1].ms <= timings[i].ms);
+            }
+            winner = timings.front().config.name();
+            CHECK(kernels->config(shape).name() == winner);
+            kernels->saveTuning(TUNING_PATH);
+        }
+        std::string saved = readFile(TUNING_PATH);
+        CHECK(saved.find(OTHER_DEVICE) != std::string::npos);
+        CHECK(saved.find("kernel=gemm m=6 n=6 k=6 config=" + winner + "\n") != std::string::npos);
+
+        // Loaded into a fresh instance: same choice, and saving again writes the same file.
+        {
+            auto kernels = create();
+            kernels->loadTuning(TUNING_PATH);
+            CHECK(kernels->config(shape).name() == winner);
+            kernels->saveTuning(TUNING_PATH);
+            CHECK(readFile(TUNING_PATH) == saved);
+        }
+
+        // This device's entry damaged: ignored, so the shape gets the default again.
+        std::string damaged = saved;
+        std::string ours = "kernel=gemm m=6 n=6 k=6 config=" + winner;
+        std::size_t at = damaged.rfind(ours);
+        CHECK(at != std::string::npos && at > saved.find(OTHER_DEVICE));
+        if (at != std::string::npos) {
+            damaged.replace(at, ours.size(), "kernel=gemm m=6 n=6 k=6 config=fast");
+            writeFile(TUNING_PATH, damaged);
+            auto kernels = create();
+            kernels->loadTuning(TUNING_PATH);
+            CHECK(kernels->config(shape).name() == defaultName);
+        }
+    }
+}
+
+int main() {
+    CHECK_NOTHROW(names());
+    std::unique_ptr<VulkanContext> context;
+    try {
+        VulkanContextCreateInfo contextInfo;
+        contextInfo.applicationName = "tensor_kernels_test";
+        context.reset(new VulkanContext(contextInfo));
+    } catch (const std::exception& e) {
+        std::cerr << "skipped, no Vulkan device: " << e.what() << std::endl;
+        return checkFailures() != 0 ? checkResult() : CHECK_SKIPPED;
+    }
+    CHECK_NOTHROW(tuningRoundTrip(*context));
+    vkDeviceWaitIdle(context->device());
+    std::remove(TUNING_PATH);
+    return checkResult();
+}
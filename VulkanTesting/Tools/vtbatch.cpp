@@ -0,0 +1,260 @@
+// vtbatch: filters a directory of images on the GPU, headless.
+//
+//   vtbatch [--device SEL] [--shaders DIR] [--slots N] [--threads N] [--profile trace.json]
+//           [-f FILTER]... INPUT_DIR OUTPUT_DIR
+//   vtbatch --generate N WxH DIR
+//
+// Filters run in the order given:
+//   resize=WxH, resize=Wx0, resize=0xH    area-averaged resize; 0 keeps the aspect ratio
+//   blur, blur5, sharpen, edge, emboss    convolution presets
+//   kernel=W,W,...                        9 or 25 weights, row major
+//   grayscale, sepia, invert              color conversion presets
+// Reads the binary netpbm images (.ppm, .pgm, .pnm) in INPUT_DIR and writes OUTPUT_DIR/NAME.ppm.
+// --generate writes N synthetic test images instead, for runs without a data set, e.g. on lavapipe
+// with --device llvmpipe.
+//
+// Reports images per second and the time each stage took. The stages overlap, so their sum exceeds
+// the wall time; overlap= is that ratio.
+
+#include "../ImageBatch.hpp"
+#include "../ImageCodec.hpp"
+#include "../JobSystem.hpp"
+#include "../Profiler.hpp"
+#include "../VulkanContext.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    void usage() {
+        std::cerr << "usage: vtbatch [--device SEL] [--shaders DIR] [--slots N] [--threads N] [--profile trace.json]" << std::endl;
+        std::cerr << "               [-f FILTER]... INPUT_DIR OUTPUT_DIR" << std::endl;
+        std::cerr << "       vtbatch --generate N WxH DIR" << std::endl;
+    }
+
+    bool parseSize(const std::string& value, std::uint32_t& width, std::uint32_t& height) {
+        auto x = value.find('x');
+        if (x == std::string::npos) return false;
+        width = static_cast<std::uint32_t>(std::atoi(value.substr(0, x).c_str()));
+        height = static_cast<std::uint32_t>(std::atoi(value.substr(x + 1).c_str()));
+        return true;
+    }
+
+    ImageFilter convolution(std::uint32_t size, const std::vector<float>& weights, float bias = 0.0f) {
+        ImageFilter filter;
+        filter.type = ImageFilterType::Convolve;
+        filter.kernelSize = size;
+        std::copy(weights.begin(), weights.end(), filter.kernel);
+        filter.bias = bias;
+        return filter;
+    }
+
+    ImageFilter color(const std::vector<float>& matrix, bool linear) {
+        ImageFilter filter;
+        filter.type = ImageFilterType::Color;
+        std::copy(matrix.begin(), matrix.end(), filter.matrix);
+        filter.linear = linear;
+        return filter;
+    }
+
+    ImageFilter parseFilter(const std::string& spec) {
+        std::string name = spec.substr(0, spec.find('='));
+        std::string value = spec.find('=') == std::string::npos ? "" : spec.substr(spec.find('=') + 1);
+        if (name == "resize") {
+            ImageFilter filter;
+            filter.type = ImageFilterType::Resize;
+            if (!parseSize(value, filter.width, filter.height)) {
+                throw std::runtime_error("Expected resize=WxH, got '" + spec + "'");
+            }
+            return filter;
+        }
+        if (name == "blur") return convolution(3, {1, 2, 1, 2, 4, 2, 1, 2, 1});
+        if (name == "blur5") return convolution(5, {1, 4, 6, 4, 1, 4, 16, 24, 16, 4, 6, 24, 36, 24, 6, 4, 16, 24, 16, 4, 1, 4, 6, 4, 1});
+        if (name == "sharpen") return convolution(3, {0, -1, 0, -1, 5, -1, 0, -1, 0});
+        if (name == "edge") return convolution(3, {-1, -1, -1, -1, 8, -1, -1, -1, -1});
+        if (name == "emboss") return convolution(3, {-2, -1, 0, -1, 0, 1, 0, 1, 2}, 0.5f);
+        if (name == "kernel") {
+            std::vector<float> weights;
+            std::stringstream stream(value);
+            std::string weight;
+            while (std::getline(stream, weight, ',')) {
+                weights.push_back(static_cast<float>(std::atof(weight.c_str())));
+            }
+            if (weights.size() != 9 && weights.size() != 25) {
+                throw std::runtime_error("A kernel needs 9 or 25 weights, got " + std::to_string(weights.size()));
+            }
+            return convolution(weights.size() == 9 ? 3 : 5, weights);
+        }
+        // Rec. 709 luma, in linear light.
+        if (name == "grayscale") {
+            return color({0.2126f, 0.7152f, 0.0722f, 0, 0.2126f, 0.7152f, 0.0722f, 0, 0.2126f, 0.7152f, 0.0722f, 0}, true);
+        }
+        if (name == "sepia") {
+            return color({0.393f, 0.769f, 0.189f, 0, 0.349f, 0.686f, 0.168f, 0, 0.272f, 0.534f, 0.131f, 0}, false);
+        }
+        if (name == "invert") return color({-1, 0, 0, 1, 0, -1, 0, 1, 0, 0, -1, 1}, false);
+        throw std::runtime_error("Unknown filter '" + spec + "'");
+    }
+
+    bool hasImageExtension(const std::string& name) {
+        for (const char* extension : {".ppm", ".pgm", ".pnm"}) {
+            std::size_t length = std::strlen(extension);
+            if (name.size() > length && name.compare(name.size() - length, length, extension) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::string> listImages(const std::string& path) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr) {
+            throw std::runtime_error("Cannot open directory " + path);
+        }
+        std::vector<std::string> names;
+        while (dirent* child = readdir(dir)) {
+            if (hasImageExtension(child->d_name)) {
+                names.push_back(child->d_name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    void makeDirectory(const std::string& path) {
+        if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Cannot create directory " + path);
+        }
+    }
+
+    // Gradients, rings and a hard-edged checkerboard, so every filter has something to do.
+    void generate(std::uint32_t count, std::uint32_t width, std::uint32_t height, const std::string& path) {
+        makeDirectory(path);
+        std::vector<std::uint8_t> rgba(static_cast<std::size_t>(width) * height * 4);
+        for (std::uint32_t i = 0; i < count; i++) {
+            float phase = 0.37f * i;
+            std::uint8_t* pixel = rgba.data();
+            for (std::uint32_t y = 0; y < height; y++) {
+                for (std::uint32_t x = 0; x < width; x++) {
+                    float u = static_cast<float>(x) / width;
+                    float v = static_cast<float>(y) / height;
+                    float ring = 0.5f + 0.5f * std::sin(40.0f * std::hypot(u - 0.5f, v - 0.5f) + phase);
+                    bool check = ((x / 32) + (y / 32) + i) % 2 == 0;
+                    pixel[0] = static_cast<std::uint8_t>(255.0f * u);
+                    pixel[1] = static_cast<std::uint8_t>(255.0f * ring);
+                    pixel[2] = check ? 200 : static_cast<std::uint8_t>(255.0f * v);
+                    pixel[3] = 255;
+                    pixel += 4;
+                }
+            }
+            auto encoded = encodePnm(rgba.data(), width, height);
+            char name[32];
+            std::snprintf(name, sizeof(name), "/gen_%06u.ppm", i);
+            std::ofstream file(path + name, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+            if (!file) {
+                throw std::runtime_error("Cannot write " + path + name);
+            }
+        }
+        std::cout << "generated=" << count << " resolution=" << width << "x" << height << " dir=" << path << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::string device;
+        std::string shaderDir = "shaders";
+        std::string profilePath;
+        unsigned slots = 0;
+        unsigned threads = 0;
+        std::vector<ImageFilter> filters;
+        std::vector<std::string> paths;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) device = argv[++i];
+            else if (arg == "--shaders" && hasValue) shaderDir = argv[++i];
+            else if (arg == "--slots" && hasValue) slots = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--threads" && hasValue) threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--profile" && hasValue) profilePath = argv[++i];
+            else if (arg == "-f" && hasValue) filters.push_back(parseFilter(argv[++i]));
+            else if (arg == "--generate" && i + 3 < argc) {
+                std::uint32_t width, height;
+                if (!parseSize(argv[i + 2], width, height) || width == 0 || height == 0) {
+                    throw std::runtime_error(std::string("Expected WxH for --generate, got '") + argv[i + 2] + "'");
+                }
+                generate(static_cast<std::uint32_t>(std::max(1, std::atoi(argv[i + 1]))), width, height, argv[i + 3]);
+                return EXIT_SUCCESS;
+            } else if (!arg.empty() && arg[0] == '-') {
+                usage();
+                return EXIT_FAILURE;
+            } else paths.push_back(arg);
+        }
+        if (paths.size() != 2) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        if (!profilePath.empty()) {
+            Profiler::setThreadName("main");
+            Profiler::start();
+        }
+
+        std::vector<std::string> inputs, outputs;
+        makeDirectory(paths[1]);
+        for (const std::string& name : listImages(paths[0])) {
+            inputs.push_back(paths[0] + "/" + name);
+            outputs.push_back(paths[1] + "/" + name.substr(0, name.size() - 4) + ".ppm");
+        }
+        if (inputs.empty()) {
+            throw std::runtime_error("No .ppm, .pgm or .pnm images in " + paths[0]);
+        }
+
+        // Headless: no surface extensions. Filters on the async compute queue when there is one.
+        VulkanContextCreateInfo info;
+        info.applicationName = "vtbatch";
+        info.device = device;
+        VulkanContext context(info);
+        JobSystem jobs(threads);
+        ImageBatch batch(context.physicalDevice(), context.device(), context.queueFamilies().computeFamily,
+                         context.computeQueue(), shaderDir, jobs, filters, slots);
+        batch.run(inputs, outputs);
+
+        const ImageBatchStats& stats = batch.stats();
+        for (std::size_t i = 0; i < batch.failures().size() && i < 20; i++) {
+            std::cerr << "skipped " << batch.failures()[i] << std::endl;
+        }
+        double seconds = stats.wallMs * 1e-3;
+        std::cout << "images=" << stats.images << " failed=" << stats.failed << " filters=" << filters.size()
+                  << " workers=" << jobs.threadCount()
+                  << " wall_ms=" << stats.wallMs
+                  << " images_per_s=" << stats.images / seconds
+                  << " mpixels_per_s=" << stats.pixelsIn * 1e-6 / seconds
+                  << " read_mb=" << stats.bytesRead / 1048576.0
+                  << " written_mb=" << stats.bytesWritten / 1048576.0
+                  << " decode_ms=" << stats.decodeMs
+                  << " gpu_ms=" << stats.gpuMs
+                  << " encode_ms=" << stats.encodeMs
+                  << " overlap=" << (stats.decodeMs + stats.gpuMs + stats.encodeMs) / stats.wallMs << std::endl;
+        if (!profilePath.empty()) {
+            Profiler::writeTrace(profilePath);
+        }
+        return stats.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
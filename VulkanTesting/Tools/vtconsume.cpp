@@ -0,0 +1,228 @@
+// vtconsume: takes frames from vtproduce through shared images, the consumer half of a local
+// zero-copy test.
+//
+//   vtconsume [--socket PATH] [--verify]
+//
+// Connects to the producer's Unix socket (default /tmp/vtshare.sock), imports its images and
+// semaphores and opens the same device by UUID. For every frame number the producer sends, it waits
+// on the image's "ready" semaphore, acquires the image from VK_QUEUE_FAMILY_EXTERNAL, copies one
+// pixel out (the whole frame with --verify) and checks it against the frame's color, then releases
+// the image back and signals "released". The frames themselves never pass through host memory;
+// only the check does.
+
+#include "../ExternalMemory.hpp"
+#include "../Profiler.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    const std::uint32_t endOfStream = ~0u;
+
+    // frameColor() of vtproduce, as R8G8B8A8_UNORM bytes.
+    std::uint32_t frameBytes(std::uint32_t frame) {
+        std::uint8_t bytes[4] = {static_cast<std::uint8_t>(frame * 37), static_cast<std::uint8_t>(frame * 91),
+                                 static_cast<std::uint8_t>(frame * 13), 255};
+        std::uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::string socketPath = "/tmp/vtshare.sock";
+        bool verify = false;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--socket" && hasValue) socketPath = argv[++i];
+            else if (arg == "--verify") verify = true;
+            else {
+                std::cerr << "usage: vtconsume [--socket PATH] [--verify]" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        FdChannel channel(socketPath, false);
+        SharedImageInfo shared;
+        std::vector<int> fds;
+        if (!channel.receive(&shared, sizeof(shared), &fds) || fds.size() != 3 * shared.imageCount) {
+            for (int fd : fds) close(fd);
+            throw std::runtime_error("producer sent no images!");
+        }
+        shared.deviceUUID[sizeof(shared.deviceUUID) - 1] = '\0';
+        shared.driverUUID[sizeof(shared.driverUUID) - 1] = '\0';
+
+        VulkanContextCreateInfo info;
+        info.applicationName = "vtconsume";
+        info.device = shared.deviceUUID;
+        VulkanContext context(info);
+        const ExternalInteropSupport& interop = context.externalInterop();
+        if (!interop.memoryFd || !interop.semaphoreFd || interop.driverUUID != shared.driverUUID) {
+            for (int fd : fds) close(fd);
+            throw std::runtime_error("can't import the producer's frames: different driver or no fd interop!");
+        }
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+
+        // Import takes over each fd once it succeeds; whatever is left is closed on failure.
+        std::uint32_t count = shared.imageCount;
+        std::vector<Image> images(count);
+        std::vector<VkSemaphore> ready(count);
+        std::vector<VkSemaphore> released(count);
+        std::size_t imported = 0;
+        try {
+            for (std::uint32_t k = 0; k < count; k++, imported++) {
+                std::string name = "imported frame " + std::to_string(k);
+                images[k] = importImage(physicalDevice, device, fds[k], shared.allocationSize, shared.extent, shared.format,
+                                        shared.usage, name.c_str());
+            }
+            for (std::uint32_t k = 0; k < count; k++, imported++) {
+                ready[k] = importSemaphore(device, fds[count + k], "imported ready");
+            }
+            for (std::uint32_t k = 0; k < count; k++, imported++) {
+                released[k] = importSemaphore(device, fds[2 * count + k], "imported released");
+            }
+        } catch (...) {
+            for (std::size_t i = imported; i < fds.size(); i++) close(fds[i]);
+            throw;
+        }
+
+        VkDeviceSize frameSize = VkDeviceSize(shared.extent.width) * shared.extent.height * 4;
+        Buffer readback = createBuffer(physicalDevice, device, verify ? frameSize : 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       "frame check");
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+        VkCommandBufferAllocateInfo commandBufferInfo = {};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        std::uint32_t frames = 0;
+        std::uint32_t mismatches = 0;
+        std::uint64_t waitNs = 0; // From submit to the copy being done, producer included.
+        std::uint64_t start = Profiler::now();
+        std::uint32_t frame;
+        while (channel.receive(&frame, sizeof(frame)) && frame != endOfStream) {
+            std::uint32_t k = frame % count;
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            // Matches the producer's release: GENERAL to here, then back the same way.
+            VkImageMemoryBarrier acquire = {};
+            acquire.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            acquire.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            acquire.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            acquire.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            acquire.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+            acquire.dstQueueFamilyIndex = family;
+            acquire.image = images[k].image;
+            acquire.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                     0, nullptr, 0, nullptr, 1, &acquire);
+            VkBufferImageCopy region = {};
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.imageExtent = verify ? VkExtent3D{shared.extent.width, shared.extent.height, 1} : VkExtent3D{1, 1, 1};
+            if (!verify) {
+                region.imageOffset = {static_cast<std::int32_t>(shared.extent.width / 2),
+                                      static_cast<std::int32_t>(shared.extent.height / 2), 0};
+            }
+            vkCmdCopyImageToBuffer(commandBuffer, images[k].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1,
+                                   &region);
+            VkImageMemoryBarrier release = acquire;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            release.dstAccessMask = 0;
+            release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            release.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            release.srcQueueFamilyIndex = family;
+            release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+            VkMemoryBarrier copied = {};
+            copied.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            copied.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            copied.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &copied, 0,
+                                     nullptr, 1, &release);
+            vkEndCommandBuffer(commandBuffer);
+
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &ready[k];
+            submitInfo.pWaitDstStageMask = &waitStage;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &released[k];
+            std::uint64_t submitted = Profiler::now();
+            if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit frame!");
+            }
+            // The producer may now wait on released[k].
+            channel.send(&frame, sizeof(frame));
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+            waitNs += Profiler::now() - submitted;
+
+            const auto* pixels = static_cast<const std::uint32_t*>(readback.mapped);
+            std::uint32_t expected = frameBytes(frame);
+            for (VkDeviceSize i = 0; i < readback.size / 4; i++) {
+                if (pixels[i] != expected) {
+                    mismatches++;
+                    break;
+                }
+            }
+            frames++;
+        }
+        double seconds = (Profiler::now() - start) * 1e-9;
+        std::cout << "frames=" << frames << " size=" << shared.extent.width << "x" << shared.extent.height
+                  << " fps=" << (seconds > 0 ? frames / seconds : 0)
+                  << " wait_ms=" << (frames > 0 ? waitNs * 1e-6 / frames : 0)
+                  << " check=" << (verify ? "full" : "pixel") << " mismatches=" << mismatches << std::endl;
+
+        vkDeviceWaitIdle(device);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        destroyBuffer(device, readback);
+        for (std::uint32_t k = 0; k < count; k++) {
+            vkDestroySemaphore(device, released[k], nullptr);
+            vkDestroySemaphore(device, ready[k], nullptr);
+            destroyImage(device, images[k]);
+        }
+        if (mismatches != 0) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+// vtpack: builds and lists VTPK asset packs.
+//
+//   vtpack [-c store|lz4|zstd|glz] [-l level] [-C rootdir] -o out.vtpk file-or-dir...
+//   vtpack -t pack.vtpk
+//
+// Directories are walked recursively. Asset names are paths relative to -C (default: as given).
+
+#include "../AssetPack.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+    void usage() {
+        std::cerr << "usage: vtpack [-c store|lz4|zstd|glz] [-l level] [-C rootdir] -o out.vtpk file-or-dir..." << std::endl;
+        std::cerr << "       vtpack -t pack.vtpk" << std::endl;
+    }
+
+    PackCodec parseCodec(const std::string& name) {
+        if (name == "store") return PackCodec::Store;
+        if (name == "lz4") return PackCodec::LZ4;
+        if (name == "zstd") return PackCodec::Zstd;
+        if (name == "glz") return PackCodec::GLZ;
+        throw std::runtime_error("Unknown codec: " + name);
+    }
+
+    const char* codecName(PackCodec codec) {
+        switch (codec) {
+            case PackCodec::Store: return "store";
+            case PackCodec::LZ4: return "lz4";
+            case PackCodec::Zstd: return "zstd";
+            case PackCodec::GLZ: return "glz";
+        }
+        return "?";
+    }
+
+    void collect(const std::string& path, std::vector<std::string>& files) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        if (!S_ISDIR(info.st_mode)) {
+            files.push_back(path);
+            return;
+        }
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr) {
+            throw std::runtime_error("Cannot open directory " + path);
+        }
+        while (dirent* child = readdir(dir)) {
+            if (std::strcmp(child->d_name, ".") == 0 || std::strcmp(child->d_name, "..") == 0) {
+                continue;
+            }
+            collect(path + "/" + child->d_name, files);
+        }
+        closedir(dir);
+    }
+
+    int list(const std::string& path) {
+        AssetPack pack(path);
+        std::uint64_t raw = 0, packed = 0;
+        for (const PackEntry* entry : pack.entries()) {
+            std::uint64_t size = 0;
+            for (std::uint32_t i = 0; i < entry->chunkCount; i++) {
+                size += pack.chunk(entry->firstChunk + i).compressedSize;
+            }
+            raw += entry->uncompressedSize;
+            packed += size;
+            std::cout << codecName(entry->codec) << "\t" << entry->uncompressedSize << "\t" << size << "\t" << pack.name(*entry) << std::endl;
+        }
+        std::cout << pack.entries().size() << " assets, " << raw << " -> " << packed << " bytes" << std::endl;
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        PackCodec codec = PackCodec::LZ4;
+        int level = 0;
+        std::string output, root;
+        std::vector<std::string> inputs;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "-t" && hasValue) {
+                return list(argv[++i]);
+            } else if (arg == "-c" && hasValue) {
+                codec = parseCodec(argv[++i]);
+            } else if (arg == "-l" && hasValue) {
+                level = std::atoi(argv[++i]);
+            } else if (arg == "-C" && hasValue) {
+                root = argv[++i];
+            } else if (arg == "-o" && hasValue) {
+                output = argv[++i];
+            } else if (!arg.empty() && arg[0] == '-') {
+                usage();
+                return EXIT_FAILURE;
+            } else {
+                inputs.push_back(arg);
+            }
+        }
+        if (output.empty() || inputs.empty()) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        if (!packCodecAvailable(codec)) {
+            std::cerr << codecName(codec) << " support not compiled in, storing uncompressed." << std::endl;
+            codec = PackCodec::Store;
+        }
+
+        std::vector<std::string> files;
+        for (const auto& input : inputs) {
+            collect(root.empty() ? input : root + "/" + input, files);
+        }
+        AssetPackWriter writer;
+        for (const auto& file : files) {
+            std::ifstream in(file, std::ios::binary);
+            std::vector<std::uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            std::string name = root.empty() ? file : file.substr(root.size() + 1);
+            writer.add(name, std::move(bytes), codec);
+        }
+        writer.write(output, level);
+        std::cout << "Packed " << files.size() << " files into " << output << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+// vtproduce: renders frames into images shared with another process, the producer half of a local
+// zero-copy test with vtconsume.
+//
+//   vtproduce [--device SEL] [--socket PATH] [--frames N] [--size WxH] [--images K]
+//
+// Exports a ring of K images and two semaphores per image as fds, waits for vtconsume on the Unix
+// socket at PATH (default /tmp/vtshare.sock) and hands them over. Every frame then clears the next
+// image to a color derived from the frame number, releases it to VK_QUEUE_FAMILY_EXTERNAL, signals
+// its "ready" semaphore and tells the consumer the frame number. An image is reused once the
+// consumer has reported its "released" semaphore signaled. The consumer picks the same device by UUID.
+//
+//   vtproduce --frames 600 & vtconsume --verify
+
+#include "../ExternalMemory.hpp"
+#include "../Profiler.hpp"
+#include "../VulkanContext.hpp"
+#include "../VulkanDispatch.hpp"
+#include "../VulkanMemory.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    const VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // Sent instead of a frame number when there are no more frames.
+    const std::uint32_t endOfStream = ~0u;
+
+    // vtconsume checks for the same bytes.
+    VkClearColorValue frameColor(std::uint32_t frame) {
+        VkClearColorValue color = {};
+        color.float32[0] = ((frame * 37) & 255) / 255.0f;
+        color.float32[1] = ((frame * 91) & 255) / 255.0f;
+        color.float32[2] = ((frame * 13) & 255) / 255.0f;
+        color.float32[3] = 1.0f;
+        return color;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::string selector;
+        std::string socketPath = "/tmp/vtshare.sock";
+        std::uint32_t frames = 300;
+        VkExtent2D extent = {1920, 1080};
+        std::uint32_t imageCount = 3;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) selector = argv[++i];
+            else if (arg == "--socket" && hasValue) socketPath = argv[++i];
+            else if (arg == "--frames" && hasValue) frames = static_cast<std::uint32_t>(std::max(1, std::atoi(argv[++i])));
+            else if (arg == "--size" && hasValue && std::sscanf(argv[++i], "%ux%u", &extent.width, &extent.height) == 2) continue;
+            else if (arg == "--images" && hasValue) imageCount = static_cast<std::uint32_t>(std::min(16, std::max(1, std::atoi(argv[++i]))));
+            else {
+                std::cerr << "usage: vtproduce [--device SEL] [--socket PATH] [--frames N] [--size WxH] [--images K]" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        VulkanContextCreateInfo info;
+        info.applicationName = "vtproduce";
+        info.device = selector;
+        VulkanContext context(info);
+        const ExternalInteropSupport& interop = context.externalInterop();
+        if (!interop.memoryFd || !interop.semaphoreFd) {
+            throw std::runtime_error("device can't share memory and semaphores as fds!");
+        }
+        VkPhysicalDevice physicalDevice = context.physicalDevice();
+        VkDevice device = context.device();
+        VkQueue queue = context.graphicsQueue();
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+
+        SharedImageInfo shared;
+        std::strncpy(shared.deviceUUID, interop.deviceUUID.c_str(), sizeof(shared.deviceUUID) - 1);
+        std::strncpy(shared.driverUUID, interop.driverUUID.c_str(), sizeof(shared.driverUUID) - 1);
+        shared.extent = extent;
+        shared.format = format;
+        shared.usage = usage;
+        shared.imageCount = imageCount;
+        std::vector<Image> images(imageCount);
+        std::vector<VkSemaphore> ready(imageCount);
+        std::vector<VkSemaphore> released(imageCount);
+        std::vector<int> fds;
+        for (std::uint32_t k = 0; k < imageCount; k++) {
+            std::string name = "shared frame " + std::to_string(k);
+            images[k] = createExportableImage(physicalDevice, device, extent, format, usage, shared.allocationSize, name.c_str());
+            ready[k] = createExportableSemaphore(device, (name + " ready").c_str());
+            released[k] = createExportableSemaphore(device, (name + " released").c_str());
+        }
+        // Memory fds first, then the ready semaphores, then the released ones.
+        for (const Image& image : images) fds.push_back(exportMemoryFd(device, image.memory));
+        for (VkSemaphore semaphore : ready) fds.push_back(exportSemaphoreFd(device, semaphore));
+        for (VkSemaphore semaphore : released) fds.push_back(exportSemaphoreFd(device, semaphore));
+
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        VkCommandPool commandPool;
+        if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+        std::vector<VkCommandBuffer> commandBuffers(imageCount);
+        VkCommandBufferAllocateInfo commandBufferInfo = {};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = imageCount;
+        vkAllocateCommandBuffers(device, &commandBufferInfo, commandBuffers.data());
+        std::vector<VkFence> fences(imageCount);
+        for (VkFence& fence : fences) {
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            vkCreateFence(device, &fenceInfo, nullptr, &fence);
+        }
+
+        std::cout << "Waiting for a consumer on " << socketPath << std::endl;
+        FdChannel channel(socketPath, true);
+        channel.send(&shared, sizeof(shared), fds);
+        for (int fd : fds) {
+            close(fd);
+        }
+
+        std::uint64_t start = Profiler::now();
+        std::uint32_t acknowledged = 0; // Frames whose released semaphore the consumer has signaled.
+        auto acknowledge = [&]() {
+            std::uint32_t frame;
+            if (!channel.receive(&frame, sizeof(frame)) || frame != acknowledged) {
+                throw std::runtime_error("consumer went away or skipped a frame!");
+            }
+            acknowledged++;
+        };
+        for (std::uint32_t frame = 0; frame < frames; frame++) {
+            std::uint32_t k = frame % imageCount;
+            bool reused = frame >= imageCount;
+            // The wait on released[k] below has to be submitted after the consumer's signal.
+            while (reused && acknowledged <= frame - imageCount) {
+                acknowledge();
+            }
+            vkWaitForFences(device, 1, &fences[k], VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fences[k]);
+
+            VkCommandBuffer commandBuffer = commandBuffers[k];
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            // Acquire from the consumer (it released in GENERAL), or the first transition.
+            VkImageMemoryBarrier acquire = {};
+            acquire.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            acquire.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            acquire.oldLayout = reused ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            acquire.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            acquire.srcQueueFamilyIndex = reused ? VK_QUEUE_FAMILY_EXTERNAL : VK_QUEUE_FAMILY_IGNORED;
+            acquire.dstQueueFamilyIndex = reused ? family : VK_QUEUE_FAMILY_IGNORED;
+            acquire.image = images[k].image;
+            acquire.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                     0, nullptr, 0, nullptr, 1, &acquire);
+            VkClearColorValue color = frameColor(frame);
+            vkCmdClearColorImage(commandBuffer, images[k].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1,
+                                 &acquire.subresourceRange);
+            VkImageMemoryBarrier release = acquire;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.dstAccessMask = 0;
+            release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            release.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            release.srcQueueFamilyIndex = family;
+            release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+            vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                     0, nullptr, 0, nullptr, 1, &release);
+            vkEndCommandBuffer(commandBuffer);
+
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.waitSemaphoreCount = reused ? 1 : 0;
+            submitInfo.pWaitSemaphores = &released[k];
+            submitInfo.pWaitDstStageMask = &waitStage;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &ready[k];
+            if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fences[k]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit frame!");
+            }
+            channel.send(&frame, sizeof(frame));
+        }
+        channel.send(&endOfStream, sizeof(endOfStream));
+        // The consumer still waits on the last ready semaphores; keep everything alive until it's done.
+        while (acknowledged < frames) {
+            acknowledge();
+        }
+        vkDeviceWaitIdle(device);
+        double seconds = (Profiler::now() - start) * 1e-9;
+        std::cout << "frames=" << frames << " size=" << extent.width << "x" << extent.height << " images=" << imageCount
+                  << " fps=" << frames / seconds << std::endl;
+
+        for (VkFence fence : fences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        for (std::uint32_t k = 0; k < imageCount; k++) {
+            vkDestroySemaphore(device, released[k], nullptr);
+            vkDestroySemaphore(device, ready[k], nullptr);
+            destroyImage(device, images[k]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+// vtreplay: re-executes a GPU capture headless and reports frame times.
+//
+//   vtreplay [--device SEL] [--repeat N] capture.vtcap
+//
+// Captures come from VulkanTesting --capture FILE or glz_bench --capture FILE. The first run warms
+// up pipelines and caches and is not counted.
+
+#include "../GpuReplay.hpp"
+#include "../VulkanContext.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    try {
+        std::string device;
+        std::string path;
+        int repeat = 10;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--device" && hasValue) device = argv[++i];
+            else if (arg == "--repeat" && hasValue) repeat = std::max(1, std::atoi(argv[++i]));
+            else path = arg;
+        }
+        if (path.empty()) {
+            std::cerr << "usage: vtreplay [--device SEL] [--repeat N] capture.vtcap" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        VulkanContextCreateInfo info;
+        info.applicationName = "vtreplay";
+        info.device = device;
+        VulkanContext context(info);
+        GpuReplay replay(context, path);
+        std::cout << path << ": " << replay.frameCount() << " frames, " << replay.submitCount() << " submits" << std::endl;
+
+        replay.run();
+        // Per captured frame: best and average over the repeats.
+        std::vector<double> best(replay.frameCount(), 1e30);
+        std::vector<double> total(replay.frameCount(), 0.0);
+        for (int i = 0; i < repeat; i++) {
+            auto times = replay.run();
+            for (std::size_t f = 0; f < times.size() && f < best.size(); f++) {
+                best[f] = std::min(best[f], times[f]);
+                total[f] += times[f];
+            }
+        }
+        for (std::size_t f = 0; f < best.size(); f++) {
+            std::cout << "replay frame=" << f << " best_ms=" << best[f] << " avg_ms=" << total[f] / repeat << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
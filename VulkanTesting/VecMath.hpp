@@ -0,0 +1,130 @@
+#ifndef VecMath_hpp
+#define VecMath_hpp
+
+#include <algorithm>
+#include <cmath>
+
+// The little vector math the renderer-side code needs. Matrices are column major and map column
+// vectors (m[column * 4 + row]), so they can be copied straight into GLSL mat4s. Projections follow
+// Vulkan conventions: depth 0..1, y pointing down in clip space, camera looking down -Z.
+
+struct Vec3 {
+    float x = 0, y = 0, z = 0;
+
+    Vec3() = default;
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    Vec3 operator+(const Vec3& o) const { return {x + o.x, y + o.y, z + o.z}; }
+    Vec3 operator-(const Vec3& o) const { return {x - o.x, y - o.y, z - o.z}; }
+    Vec3 operator*(float s) const { return {x * s, y * s, z * s}; }
+    Vec3 operator/(float s) const { return {x / s, y / s, z / s}; }
+    float operator[](int i) const { return i == 0 ? x : i == 1 ? y : z; }
+};
+
+inline float dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+inline float length(const Vec3& v) { return std::sqrt(dot(v, v)); }
+inline Vec3 normalize(const Vec3& v) { return v / length(v); }
+inline Vec3 min(const Vec3& a, const Vec3& b) { return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)}; }
+inline Vec3 max(const Vec3& a, const Vec3& b) { return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)}; }
+
+struct Vec4 {
+    float x = 0, y = 0, z = 0, w = 0;
+};
+
+struct Mat4 {
+    float m[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+    float& at(int row, int column) { return m[column * 4 + row]; }
+    float at(int row, int column) const { return m[column * 4 + row]; }
+
+    Mat4 operator*(const Mat4& o) const {
+        Mat4 r;
+        for (int c = 0; c < 4; c++) {
+            for (int row = 0; row < 4; row++) {
+                float sum = 0;
+                for (int k = 0; k < 4; k++) {
+                    sum += at(row, k) * o.at(k, c);
+                }
+                r.at(row, c) = sum;
+            }
+        }
+        return r;
+    }
+
+    Vec4 transform(const Vec3& p, float w = 1.0f) const {
+        return {at(0, 0) * p.x + at(0, 1) * p.y + at(0, 2) * p.z + at(0, 3) * w,
+                at(1, 0) * p.x + at(1, 1) * p.y + at(1, 2) * p.z + at(1, 3) * w,
+                at(2, 0) * p.x + at(2, 1) * p.y + at(2, 2) * p.z + at(2, 3) * w,
+                at(3, 0) * p.x + at(3, 1) * p.y + at(3, 2) * p.z + at(3, 3) * w};
+    }
+    Vec3 transformPoint(const Vec3& p) const {
+        Vec4 r = transform(p);
+        return {r.x, r.y, r.z};
+    }
+};
+
+// World to view: camera at eye looking at target.
+inline Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up) {
+    Vec3 f = normalize(target - eye);
+    // Fall back to another up vector when looking straight along it.
+    Vec3 s = cross(f, up);
+    if (dot(s, s) < 1e-8f) {
+        s = cross(f, std::fabs(f.x) < 0.9f ? Vec3(1, 0, 0) : Vec3(0, 0, 1));
+    }
+    s = normalize(s);
+    Vec3 u = cross(s, f);
+    Mat4 r;
+    r.at(0, 0) = s.x; r.at(0, 1) = s.y; r.at(0, 2) = s.z; r.at(0, 3) = -dot(s, eye);
+    r.at(1, 0) = u.x; r.at(1, 1) = u.y; r.at(1, 2) = u.z; r.at(1, 3) = -dot(u, eye);
+    r.at(2, 0) = -f.x; r.at(2, 1) = -f.y; r.at(2, 2) = -f.z; r.at(2, 3) = dot(f, eye);
+    return r;
+}
+
+// Right handed perspective, depth 0 at near and 1 at far, clip-space y flipped for Vulkan.
+inline Mat4 perspective(float fovY, float aspect, float nearPlane, float farPlane) {
+    float t = 1.0f / std::tan(fovY * 0.5f);
+    Mat4 r;
+    r.at(0, 0) = t / aspect;
+    r.at(1, 1) = -t;
+    r.at(2, 2) = farPlane / (nearPlane - farPlane);
+    r.at(2, 3) = nearPlane * farPlane / (nearPlane - farPlane);
+    r.at(3, 2) = -1;
+    r.at(3, 3) = 0;
+    return r;
+}
+
+// View-space box to clip space, depth 0 at -nearPlane and 1 at -farPlane, y flipped for Vulkan.
+inline Mat4 orthographic(float left, float right, float bottom, float top, float nearPlane, float farPlane) {
+    Mat4 r;
+    r.at(0, 0) = 2.0f / (right - left);
+    r.at(1, 1) = -2.0f / (top - bottom);
+    r.at(2, 2) = 1.0f / (nearPlane - farPlane);
+    r.at(0, 3) = -(right + left) / (right - left);
+    r.at(1, 3) = (top + bottom) / (top - bottom);
+    r.at(2, 3) = nearPlane / (nearPlane - farPlane);
+    return r;
+}
+
+// Axis-aligned box, empty when min > max.
+struct Bounds {
+    Vec3 min{1e30f, 1e30f, 1e30f};
+    Vec3 max{-1e30f, -1e30f, -1e30f};
+
+    bool empty() const { return min.x > max.x; }
+    void add(const Vec3& p) {
+        min = ::min(min, p);
+        max = ::max(max, p);
+    }
+    void add(const Bounds& b) {
+        if (!b.empty()) {
+            add(b.min);
+            add(b.max);
+        }
+    }
+    Vec3 corner(int i) const { return {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z}; }
+};
+
+#endif /* VecMath_hpp */
@@ -0,0 +1,536 @@
+#include "VirtualTexture.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    const std::uint32_t TEXEL_SIZE = 4;
+    const VkImageUsageFlags USAGE = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    // The header of VirtualResidency in shaders/virtual_texture.glsl: tile grid, tail level, level
+    // count and 16 level offsets, then one uint per mip 0 tile.
+    const std::uint32_t MAX_LEVELS = 16;
+    const VkDeviceSize RESIDENCY_HEADER = (4 + MAX_LEVELS) * sizeof(std::uint32_t);
+
+    bool powerOfTwo(std::uint32_t x) {
+        return x != 0 && (x & (x - 1)) == 0;
+    }
+}
+
+VirtualTexture::VirtualTexture(VkPhysicalDevice physicalDevice, VkDevice device, const SparseSupport& sparse,
+                               VkQueue sparseQueue, std::uint32_t queueFamily, VkQueue queue, VkExtent2D extent,
+                               std::uint32_t budgetTiles, VirtualTileLoader loader, std::uint32_t maxUploadsPerUpdate)
+    : device(device), sparseQueue(sparseQueue), queue(queue), loader(loader),
+      maxUploads(std::max(maxUploadsPerUpdate, 1u)), extent(extent) {
+    VT_FUNCTION_ZONE();
+    if (!sparse.residencyImage2D || sparseQueue == VK_NULL_HANDLE) {
+        throw std::runtime_error("virtual textures need sparse residency for 2D images!");
+    }
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (!powerOfTwo(extent.width) || !powerOfTwo(extent.height) ||
+        std::max(extent.width, extent.height) > properties.limits.maxImageDimension2D) {
+        throw std::runtime_error("virtual texture size must be a power of two the device supports!");
+    }
+    std::uint32_t formatCount = 0;
+    vkGetPhysicalDeviceSparseImageFormatProperties(physicalDevice, FORMAT, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT, USAGE,
+                                                   VK_IMAGE_TILING_OPTIMAL, &formatCount, nullptr);
+    if (formatCount == 0) {
+        throw std::runtime_error("sparse RGBA8 images are not supported!");
+    }
+    while ((std::max(extent.width, extent.height) >> levelCount) > 0) {
+        levelCount++;
+    }
+    levelCount = std::min(levelCount, MAX_LEVELS);
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = FORMAT;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = USAGE;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create virtual texture image!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, image, &requirements);
+    std::uint32_t requirementCount = 0;
+    vkGetImageSparseMemoryRequirements(device, image, &requirementCount, nullptr);
+    std::vector<VkSparseImageMemoryRequirements> sparseRequirements(requirementCount);
+    vkGetImageSparseMemoryRequirements(device, image, &requirementCount, sparseRequirements.data());
+    const VkSparseImageMemoryRequirements* color = nullptr;
+    for (const auto& sparseRequirement : sparseRequirements) {
+        if (sparseRequirement.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) {
+            color = &sparseRequirement;
+        }
+    }
+    if (color == nullptr) {
+        throw std::runtime_error("failed to get virtual texture sparse requirements!");
+    }
+    tileSize = {color->formatProperties.imageGranularity.width, color->formatProperties.imageGranularity.height};
+    if (!powerOfTwo(tileSize.width) || !powerOfTwo(tileSize.height) || tileSize.width > extent.width ||
+        tileSize.height > extent.height) {
+        throw std::runtime_error("unsupported virtual texture tile shape!");
+    }
+    tailLevel = std::min(color->imageMipTailFirstLod, levelCount);
+    // A tile is one or more whole pages; with the standard block shape exactly one 64 KiB page.
+    VkDeviceSize texelBytes = static_cast<VkDeviceSize>(tileSize.width) * tileSize.height * TEXEL_SIZE;
+    tileBytes = (texelBytes + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+
+    for (std::uint32_t level = 0; level < tailLevel; level++) {
+        VkExtent2D grid = {(extent.width >> level) / tileSize.width, (extent.height >> level) / tileSize.height};
+        levelTiles.push_back(grid);
+        levelOffset.push_back(static_cast<std::uint32_t>(tiles.size()));
+        for (std::uint32_t y = 0; y < grid.height; y++) {
+            for (std::uint32_t x = 0; x < grid.width; x++) {
+                Tile tile;
+                tile.level = level;
+                tile.x = x;
+                tile.y = y;
+                tiles.push_back(tile);
+            }
+        }
+    }
+
+    budgetTiles = std::max(1u, std::min(budgetTiles, static_cast<std::uint32_t>(tiles.size())));
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = budgetTiles * tileBytes;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkd.vkAllocateMemory(device, &allocInfo, nullptr, &pagePool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate virtual texture pages!");
+    }
+    for (std::uint32_t page = budgetTiles; page > 0; page--) {
+        freePages.push_back(page - 1);
+    }
+
+    VkDeviceSize tailUploadBytes = 0;
+    for (std::uint32_t level = tailLevel; level < levelCount; level++) {
+        tailUploadBytes += static_cast<VkDeviceSize>(std::max(extent.width >> level, 1u)) * std::max(extent.height >> level, 1u) *
+                     TEXEL_SIZE;
+    }
+    std::uint32_t baseTiles = levelTiles.empty() ? 1 : levelTiles[0].width * levelTiles[0].height;
+    residency = createBuffer(physicalDevice, device, RESIDENCY_HEADER + baseTiles * sizeof(std::uint32_t),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             "virtual texture residency");
+    feedback = createBuffer(physicalDevice, device, std::max<VkDeviceSize>(tiles.size(), 1) * sizeof(std::uint32_t),
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            "virtual texture feedback");
+    std::memset(feedback.mapped, 0, static_cast<std::size_t>(feedback.size));
+    staging = createBuffer(physicalDevice, device, std::max(maxUploads * texelBytes, tailUploadBytes),
+                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           "virtual texture staging");
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create virtual texture command pool!");
+    }
+    VkCommandBufferAllocateInfo commandBufferInfo = {};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    vkd.vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(device, &fenceInfo, nullptr, &fence);
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    vkCreateSemaphore(device, &semaphoreInfo, nullptr, &bound);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = FORMAT;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create virtual texture view!");
+    }
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = static_cast<float>(levelCount);
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create virtual texture sampler!");
+    }
+
+    setObjectName(device, image, "virtual texture");
+    setObjectName(device, imageView, "virtual texture view");
+    setObjectName(device, sampler, "virtual texture sampler");
+    setObjectName(device, pagePool, "virtual texture pages");
+    setObjectName(device, commandPool, "virtual texture command pool");
+    setObjectName(device, commandBuffer, "virtual texture uploads");
+    setObjectName(device, fence, "virtual texture fence");
+    setObjectName(device, bound, "virtual texture bound");
+
+    statistics.tileSize = tileSize;
+    statistics.budgetTiles = budgetTiles;
+    statistics.virtualBytes = requirements.size;
+    bindTail(physicalDevice, requirements, sparseRequirements);
+    statistics.committedBytes = tailBytes;
+    uploadTail();
+    writeResidency();
+}
+
+VirtualTexture::~VirtualTexture() {
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyImageView(device, imageView, nullptr);
+    vkDestroySemaphore(device, bound, nullptr);
+    vkDestroyFence(device, fence, nullptr);
+    vkd.vkDestroyCommandPool(device, commandPool, nullptr);
+    destroyBuffer(device, staging);
+    destroyBuffer(device, feedback);
+    destroyBuffer(device, residency);
+    // Destroying the image releases its bindings.
+    vkDestroyImage(device, image, nullptr);
+    for (VkDeviceMemory memory : tailMemory) {
+        vkd.vkFreeMemory(device, memory, nullptr);
+    }
+    vkd.vkFreeMemory(device, pagePool, nullptr);
+}
+
+void VirtualTexture::writeDescriptors(VkDescriptorSet set, std::uint32_t firstBinding) const {
+    VkDescriptorImageInfo imageInfo = {sampler, imageView, VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorBufferInfo bufferInfos[2] = {{residency.buffer, 0, VK_WHOLE_SIZE}, {feedback.buffer, 0, VK_WHOLE_SIZE}};
+    VkWriteDescriptorSet writes[3] = {};
+    for (std::uint32_t i = 0; i < 3; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = firstBinding + i;
+        writes[i].descriptorCount = 1;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &imageInfo;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[1].pBufferInfo = &bufferInfos[0];
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[2].pBufferInfo = &bufferInfos[1];
+    vkd.vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+}
+
+void VirtualTexture::recordFeedbackBarrier(VkCommandBuffer commandBuffer) const {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+std::uint32_t VirtualTexture::update() {
+    VT_FUNCTION_ZONE();
+    std::uint64_t start = Profiler::now();
+    updates++;
+
+    // What the frame sampled, plus every coarser tile above it: trilinear filtering reads the next
+    // level, and a tile only becomes resident after its parent.
+    auto* flags = static_cast<std::uint32_t*>(feedback.mapped);
+    std::uint32_t requested = 0;
+    for (std::size_t i = 0; i < tiles.size(); i++) {
+        if (flags[i] == 0) {
+            continue;
+        }
+        const Tile& wanted = tiles[i];
+        for (std::uint32_t level = wanted.level; level < tailLevel; level++) {
+            std::uint32_t shift = level - wanted.level;
+            Tile& tile = tiles[levelOffset[level] + (wanted.y >> shift) * levelTiles[level].width + (wanted.x >> shift)];
+            if (tile.lastWanted == updates) {
+                break;
+            }
+            tile.lastWanted = updates;
+            requested++;
+        }
+    }
+    std::memset(flags, 0, static_cast<std::size_t>(feedback.size));
+
+    // Coarse levels first, so parents always arrive before their children.
+    std::vector<std::uint32_t> missing;
+    std::vector<std::uint32_t> victims;
+    for (std::uint32_t i = 0; i < tiles.size(); i++) {
+        if (tiles[i].lastWanted == updates && tiles[i].page < 0) {
+            missing.push_back(i);
+        } else if (tiles[i].page >= 0 && tiles[i].lastWanted < updates) {
+            victims.push_back(i);
+        }
+    }
+    std::stable_sort(missing.begin(), missing.end(),
+                     [this](std::uint32_t a, std::uint32_t b) { return tiles[a].level > tiles[b].level; });
+    // Least recently wanted first; on ties the finer tile, so no tile outlives its parent.
+    std::sort(victims.begin(), victims.end(), [this](std::uint32_t a, std::uint32_t b) {
+        if (tiles[a].lastWanted != tiles[b].lastWanted) return tiles[a].lastWanted < tiles[b].lastWanted;
+        return tiles[a].level < tiles[b].level;
+    });
+
+    std::vector<VkSparseImageMemoryBind> binds;
+    std::vector<std::uint32_t> loads;
+    std::size_t nextVictim = 0;
+    for (std::uint32_t index : missing) {
+        if (loads.size() == maxUploads) {
+            break;
+        }
+        if (freePages.empty()) {
+            if (nextVictim == victims.size()) {
+                break; // The budget is full of tiles this frame needs.
+            }
+            Tile& victim = tiles[victims[nextVictim++]];
+            VkSparseImageMemoryBind unbind = {};
+            unbind.subresource = {VK_IMAGE_ASPECT_COLOR_BIT, victim.level, 0};
+            unbind.offset = {static_cast<std::int32_t>(victim.x * tileSize.width),
+                             static_cast<std::int32_t>(victim.y * tileSize.height), 0};
+            unbind.extent = {tileSize.width, tileSize.height, 1};
+            unbind.memory = VK_NULL_HANDLE;
+            binds.push_back(unbind);
+            freePages.push_back(static_cast<std::uint32_t>(victim.page));
+            victim.page = -1;
+            statistics.evictedTiles++;
+        }
+        Tile& tile = tiles[index];
+        tile.page = static_cast<std::int32_t>(freePages.back());
+        freePages.pop_back();
+        VkSparseImageMemoryBind bind = {};
+        bind.subresource = {VK_IMAGE_ASPECT_COLOR_BIT, tile.level, 0};
+        bind.offset = {static_cast<std::int32_t>(tile.x * tileSize.width), static_cast<std::int32_t>(tile.y * tileSize.height), 0};
+        bind.extent = {tileSize.width, tileSize.height, 1};
+        bind.memory = pagePool;
+        bind.memoryOffset = static_cast<VkDeviceSize>(tile.page) * tileBytes;
+        binds.push_back(bind);
+        loads.push_back(index);
+    }
+
+    if (!loads.empty()) {
+        VkSparseImageMemoryBindInfo imageBinds = {image, static_cast<std::uint32_t>(binds.size()), binds.data()};
+        VkBindSparseInfo bindInfo = {};
+        bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+        bindInfo.imageBindCount = 1;
+        bindInfo.pImageBinds = &imageBinds;
+        bindInfo.signalSemaphoreCount = 1;
+        bindInfo.pSignalSemaphores = &bound;
+        if (vkQueueBindSparse(sparseQueue, 1, &bindInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind virtual texture tiles!");
+        }
+
+        // Loading on the CPU overlaps the binds.
+        VkDeviceSize texelBytes = static_cast<VkDeviceSize>(tileSize.width) * tileSize.height * TEXEL_SIZE;
+        std::vector<VkBufferImageCopy> regions;
+        for (std::size_t i = 0; i < loads.size(); i++) {
+            const Tile& tile = tiles[loads[i]];
+            loader(tile.level, tile.x * tileSize.width, tile.y * tileSize.height, tileSize.width, tileSize.height,
+                   static_cast<std::uint8_t*>(staging.mapped) + i * texelBytes);
+            VkBufferImageCopy region = {};
+            region.bufferOffset = i * texelBytes;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, tile.level, 0, 1};
+            region.imageOffset = {static_cast<std::int32_t>(tile.x * tileSize.width),
+                                  static_cast<std::int32_t>(tile.y * tileSize.height), 0};
+            region.imageExtent = {tileSize.width, tileSize.height, 1};
+            regions.push_back(region);
+        }
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        // The image stays in GENERAL, so the copies need no layout transitions around sampling.
+        vkd.vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_GENERAL,
+                                   static_cast<std::uint32_t>(regions.size()), regions.data());
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                 &barrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(commandBuffer);
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &bound;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit virtual texture uploads!");
+        }
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &fence);
+        // Only now can shaders read the new tiles.
+        writeResidency();
+    }
+
+    std::uint32_t resident = 0;
+    std::uint32_t pending = 0;
+    for (const Tile& tile : tiles) {
+        resident += tile.page >= 0;
+        pending += tile.lastWanted == updates && tile.page < 0;
+    }
+    statistics.residentTiles = resident;
+    statistics.requestedTiles = requested;
+    statistics.pendingTiles = pending;
+    statistics.loadedTiles += loads.size();
+    statistics.committedBytes = resident * tileBytes + tailBytes;
+    statistics.updateMs = static_cast<double>(Profiler::now() - start) * 1e-6;
+    return static_cast<std::uint32_t>(loads.size());
+}
+
+void VirtualTexture::bindTail(VkPhysicalDevice physicalDevice, const VkMemoryRequirements& requirements,
+                              const std::vector<VkSparseImageMemoryRequirements>& sparseRequirements) {
+    // The mip tail, and metadata where the format has any, are bound once as opaque ranges.
+    std::vector<VkSparseMemoryBind> binds;
+    for (const auto& sparseRequirement : sparseRequirements) {
+        bool metadata = (sparseRequirement.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) != 0;
+        if ((!metadata && tailLevel >= levelCount) || sparseRequirement.imageMipTailSize == 0) {
+            continue;
+        }
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = sparseRequirement.imageMipTailSize;
+        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkDeviceMemory memory;
+        if (vkd.vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate virtual texture mip tail!");
+        }
+        setObjectName(device, memory, metadata ? "virtual texture metadata" : "virtual texture mip tail");
+        tailMemory.push_back(memory);
+        tailBytes += sparseRequirement.imageMipTailSize;
+        VkSparseMemoryBind bind = {};
+        bind.resourceOffset = sparseRequirement.imageMipTailOffset;
+        bind.size = sparseRequirement.imageMipTailSize;
+        bind.memory = memory;
+        bind.flags = metadata ? VK_SPARSE_MEMORY_BIND_METADATA_BIT : 0;
+        binds.push_back(bind);
+    }
+    VkSparseImageOpaqueMemoryBindInfo opaqueBinds = {image, static_cast<std::uint32_t>(binds.size()), binds.data()};
+    VkBindSparseInfo bindInfo = {};
+    bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bindInfo.imageOpaqueBindCount = binds.empty() ? 0 : 1;
+    bindInfo.pImageOpaqueBinds = &opaqueBinds;
+    // uploadTail() waits for it, bound or not.
+    bindInfo.signalSemaphoreCount = 1;
+    bindInfo.pSignalSemaphores = &bound;
+    if (vkQueueBindSparse(sparseQueue, 1, &bindInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind virtual texture mip tail!");
+    }
+}
+
+void VirtualTexture::uploadTail() {
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    VkImageMemoryBarrier toGeneral = {};
+    toGeneral.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toGeneral.srcAccessMask = 0;
+    toGeneral.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+    toGeneral.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toGeneral.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toGeneral.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toGeneral.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toGeneral.image = image;
+    toGeneral.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &toGeneral);
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize offset = 0;
+    for (std::uint32_t level = tailLevel; level < levelCount; level++) {
+        std::uint32_t width = std::max(extent.width >> level, 1u);
+        std::uint32_t height = std::max(extent.height >> level, 1u);
+        loader(level, 0, 0, width, height, static_cast<std::uint8_t*>(staging.mapped) + offset);
+        VkBufferImageCopy region = {};
+        region.bufferOffset = offset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        region.imageExtent = {width, height, 1};
+        regions.push_back(region);
+        offset += static_cast<VkDeviceSize>(width) * height * TEXEL_SIZE;
+    }
+    if (!regions.empty()) {
+        vkd.vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_GENERAL,
+                                   static_cast<std::uint32_t>(regions.size()), regions.data());
+    }
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                             0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(commandBuffer);
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &bound;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkd.vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit virtual texture mip tail!");
+    }
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device, 1, &fence);
+}
+
+void VirtualTexture::writeResidency() {
+    auto* words = static_cast<std::uint32_t*>(residency.mapped);
+    VkExtent2D grid = levelTiles.empty() ? VkExtent2D{1, 1} : levelTiles[0];
+    words[0] = grid.width;
+    words[1] = grid.height;
+    words[2] = tailLevel;
+    words[3] = levelCount;
+    for (std::uint32_t level = 0; level < MAX_LEVELS; level++) {
+        words[4 + level] = level < levelOffset.size() ? levelOffset[level] : 0;
+    }
+    if (levelTiles.empty()) {
+        words[4 + MAX_LEVELS] = tailLevel;
+        return;
+    }
+    // The finest resident level over each mip 0 tile. Coarser tiles above a resident one are
+    // resident too (update() loads parents first and evicts children first).
+    std::vector<std::uint32_t> finest(grid.width * grid.height, tailLevel);
+    for (std::uint32_t y = 0; y < grid.height; y++) {
+        for (std::uint32_t x = 0; x < grid.width; x++) {
+            for (std::uint32_t level = 0; level < tailLevel; level++) {
+                if (tiles[levelOffset[level] + (y >> level) * levelTiles[level].width + (x >> level)].page >= 0) {
+                    finest[y * grid.width + x] = level;
+                    break;
+                }
+            }
+        }
+    }
+    // Bilinear filtering near a tile's edge reads its neighbours, so each tile only goes as fine as
+    // everything around it. Tiles at the edge of the view stay a level coarser until their neighbours
+    // are wanted too.
+    std::uint32_t* map = words + 4 + MAX_LEVELS;
+    for (std::uint32_t y = 0; y < grid.height; y++) {
+        for (std::uint32_t x = 0; x < grid.width; x++) {
+            std::uint32_t level = 0;
+            for (std::uint32_t ny = y > 0 ? y - 1 : 0; ny <= std::min(y + 1, grid.height - 1); ny++) {
+                for (std::uint32_t nx = x > 0 ? x - 1 : 0; nx <= std::min(x + 1, grid.width - 1); nx++) {
+                    level = std::max(level, finest[ny * grid.width + nx]);
+                }
+            }
+            map[y * grid.width + x] = level;
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef VirtualTexture_hpp
+#define VirtualTexture_hpp
+
+#include "VulkanContext.hpp"
+#include "VulkanMemory.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Fills width x height RGBA8 texels, tightly packed, of mip level starting at texel (x, y). Called
+// with one tile at a time, or a whole level of the mip tail.
+using VirtualTileLoader = std::function<void(std::uint32_t level, std::uint32_t x, std::uint32_t y,
+                                             std::uint32_t width, std::uint32_t height, std::uint8_t* rgba)>;
+
+struct VirtualTextureStats {
+    VkExtent2D tileSize = {0, 0};
+    std::uint32_t budgetTiles = 0;
+    std::uint32_t residentTiles = 0;
+    std::uint32_t requestedTiles = 0;  // Last update(), including the coarser tiles above them.
+    std::uint32_t pendingTiles = 0;    // Requested but left for later updates.
+    std::uint64_t loadedTiles = 0;     // In total.
+    std::uint64_t evictedTiles = 0;
+    VkDeviceSize virtualBytes = 0;     // The whole image, every mip.
+    VkDeviceSize committedBytes = 0;   // Memory bound right now, mip tail included.
+    double updateMs = 0;               // Last update(), waits included.
+};
+
+// A virtual texture on sparse residency: a 2D RGBA8 image, up to the device's largest, with memory
+// behind only the tiles that recent frames sampled. Datasets far larger than device memory fit
+// because the working set is what a frame shows, not what exists.
+//
+// Shaders sample through shaders/virtual_texture.glsl, which marks the tiles they want in a feedback
+// buffer and never reads finer than what is resident. update() reads that feedback once the frame is
+// done, evicts the least recently wanted tiles when the page budget is full, binds pages on the sparse
+// queue and uploads the new tiles through loader. Coarser mips come first, and the mip tail is
+// always resident, so sampling degrades to blurrier rather than wrong while tiles stream in.
+class VirtualTexture {
+public:
+    // extent is a power of two each way. queue (of queueFamily) uploads and is where the texture is
+    // sampled; sparseQueue binds. budgetTiles caps the pages in use, mip tail aside, and
+    // maxUploadsPerUpdate the work in one update().
+    VirtualTexture(VkPhysicalDevice physicalDevice, VkDevice device, const SparseSupport& sparse, VkQueue sparseQueue,
+                   std::uint32_t queueFamily, VkQueue queue, VkExtent2D extent, std::uint32_t budgetTiles,
+                   VirtualTileLoader loader, std::uint32_t maxUploadsPerUpdate = 64);
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    // The combined image sampler, residency and feedback buffers of shaders/virtual_texture.glsl at
+    // firstBinding to firstBinding + 2.
+    void writeDescriptors(VkDescriptorSet set, std::uint32_t firstBinding = 0) const;
+    // After the last draw or dispatch that samples, so update() sees the feedback.
+    void recordFeedbackBarrier(VkCommandBuffer commandBuffer) const;
+    // Once the frame's commands have finished and before the next frame is submitted: commits and
+    // evicts tiles for what the frame asked for, and waits for the binds and uploads. Returns the
+    // number of tiles loaded.
+    std::uint32_t update();
+
+    VkImageView view() const { return imageView; }
+    std::uint32_t levels() const { return levelCount; }
+    const VirtualTextureStats& stats() const { return statistics; }
+
+private:
+    struct Tile {
+        std::uint32_t level;
+        std::uint32_t x;
+        std::uint32_t y;
+        std::int32_t page = -1;      // In pagePool, -1 when not resident.
+        std::uint64_t lastWanted = 0; // update() count.
+    };
+
+    VkDevice device;
+    VkQueue sparseQueue;
+    VkQueue queue;
+    VirtualTileLoader loader;
+    std::uint32_t maxUploads;
+    VkExtent2D extent;
+    std::uint32_t levelCount = 0;
+    std::uint32_t tailLevel = 0;          // First level of the mip tail.
+    VkExtent2D tileSize = {0, 0};
+    VkDeviceSize tileBytes = 0;           // Memory per tile, a multiple of the sparse page size.
+    std::vector<VkExtent2D> levelTiles;   // Tile grid per tiled level.
+    std::vector<std::uint32_t> levelOffset; // First tile of each tiled level in tiles.
+    std::vector<Tile> tiles;
+    std::vector<std::uint32_t> freePages;
+    std::uint64_t updates = 0;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDeviceMemory pagePool = VK_NULL_HANDLE;
+    std::vector<VkDeviceMemory> tailMemory; // Mip tail and metadata, bound for good.
+    VkDeviceSize tailBytes = 0;
+    Buffer residency; // Host visible; see shaders/virtual_texture.glsl.
+    Buffer feedback;  // Host visible, one flag per tile.
+    Buffer staging;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkSemaphore bound = VK_NULL_HANDLE;
+    VirtualTextureStats statistics;
+
+    void bindTail(VkPhysicalDevice physicalDevice, const VkMemoryRequirements& requirements,
+                  const std::vector<VkSparseImageMemoryRequirements>& sparseRequirements);
+    void uploadTail();
+    void writeResidency();
+};
+
+#endif /* VirtualTexture_hpp */
@@ -0,0 +1,830 @@
+#include "VulkanContext.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+const std::vector<const char*> validationLayers = {
+    "VK_LAYER_KHRONOS_validation"
+};
+
+VulkanContext::VulkanContext(const VulkanContextCreateInfo& info) : info(info) {
+    createInstance();
+    setupDebugMessenger();
+    pickPhysicalDevice();
+    createLogicalDevice();
+}
+
+VulkanContext::~VulkanContext() {
+    VT_ZONE("destroy device");
+    vkDestroyDevice(logicalDevice, nullptr);
+    if (debugMessenger != VK_NULL_HANDLE) {
+        callVKfx<void, PFN_vkDestroyDebugUtilsMessengerEXT>("vkDestroyDebugUtilsMessengerEXT", instanceHandle, debugMessenger, nullptr);
+    }
+    vkDestroyInstance(instanceHandle, nullptr);
+}
+
+void VulkanContext::createLogicalDevice() {
+    VT_FUNCTION_ZONE();
+    families = findQueueFamilies(physical);
+    // Decides whether the sparse family gets a queue.
+    sparseSupport = querySparse(physical);
+
+    // Queue setup. One queue per distinct family.
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    float queuePriority = 1.0f;
+    std::vector<std::uint32_t> queueFamilyList = {families.graphicsFamily, families.computeFamily, families.transferFamily};
+    if (sparseSupport.binding) {
+        queueFamilyList.push_back(families.sparseFamily);
+    }
+    for (std::uint32_t family : queueFamilyList) {
+        bool created = false;
+        for (const auto& queueCreateInfo : queueCreateInfos) {
+            created = created || queueCreateInfo.queueFamilyIndex == family;
+        }
+        if (created) {
+            continue;
+        }
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = family;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    // Leaving all values as VK_FALSE, except optional ones that cost nothing when unused.
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physical, &supportedFeatures);
+    VkPhysicalDeviceFeatures deviceFeatures = {};
+    // r8ui and friends as storage images (ShadingRateMap).
+    deviceFeatures.shaderStorageImageExtendedFormats = supportedFeatures.shaderStorageImageExtendedFormats;
+    // Wireframe and point polygon modes (RasterState::polygonMode).
+    deviceFeatures.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
+    // Feedback stores from fragment shaders (shaders/virtual_texture.glsl).
+    deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+    // Virtual textures and huge buffers (VirtualTexture).
+    deviceFeatures.sparseBinding = sparseSupport.binding ? VK_TRUE : VK_FALSE;
+    deviceFeatures.sparseResidencyBuffer = sparseSupport.residencyBuffer ? VK_TRUE : VK_FALSE;
+    deviceFeatures.sparseResidencyImage2D = sparseSupport.residencyImage2D ? VK_TRUE : VK_FALSE;
+
+    VkDeviceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pQueueCreateInfos = queueCreateInfos.data();
+    createInfo.queueCreateInfoCount = static_cast<std::uint32_t>(queueCreateInfos.size());
+    createInfo.pEnabledFeatures = &deviceFeatures;
+
+    // Optional extensions on top of what the caller requires.
+    std::vector<const char*> extensions = info.deviceExtensions;
+    auto enable = [&extensions](const char* name) {
+        for (const char* enabled : extensions) {
+            if (std::strcmp(enabled, name) == 0) return;
+        }
+        extensions.push_back(name);
+    };
+    // Feature structs of optional extensions go in front of the createInfo chain.
+    auto chain = [&createInfo](auto& features) {
+        features.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &features;
+    };
+    // Variable rate shading. Render passes with a shading rate attachment are create_renderpass2 ones.
+    shadingRate = queryFragmentShadingRate(physical);
+    VkPhysicalDeviceFragmentShadingRateFeaturesKHR shadingRateFeatures = {};
+    shadingRateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+    if (shadingRate.pipeline || shadingRate.attachment) {
+        enable(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        enable(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME);
+        shadingRateFeatures.pipelineFragmentShadingRate = shadingRate.pipeline ? VK_TRUE : VK_FALSE;
+        shadingRateFeatures.attachmentFragmentShadingRate = shadingRate.attachment ? VK_TRUE : VK_FALSE;
+        chain(shadingRateFeatures);
+    }
+    // Dynamic rendering and dynamic state, so render passes and state bits stop multiplying pipelines.
+    dynamicStates = queryDynamicState(physical);
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    if (dynamicStates.dynamicRendering) {
+        enable(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        enable(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+        enable(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        chain(dynamicRenderingFeatures);
+    }
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+    dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    if (dynamicStates.extendedDynamicState) {
+        enable(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+        chain(dynamicStateFeatures);
+    }
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamicState2Features = {};
+    dynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+    if (dynamicStates.extendedDynamicState2) {
+        enable(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+        dynamicState2Features.extendedDynamicState2 = VK_TRUE;
+        chain(dynamicState2Features);
+    }
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = {};
+    dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    if (dynamicStates.polygonMode || dynamicStates.colorBlendEnable || dynamicStates.colorWriteMask) {
+        enable(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+        dynamicState3Features.extendedDynamicState3PolygonMode = dynamicStates.polygonMode ? VK_TRUE : VK_FALSE;
+        dynamicState3Features.extendedDynamicState3ColorBlendEnable = dynamicStates.colorBlendEnable ? VK_TRUE : VK_FALSE;
+        dynamicState3Features.extendedDynamicState3ColorWriteMask = dynamicStates.colorWriteMask ? VK_TRUE : VK_FALSE;
+        chain(dynamicState3Features);
+    }
+    // Cooperative matrices for TensorKernels.
+    cooperativeMatrices = queryCooperativeMatrix(physical);
+    VkPhysicalDeviceCooperativeMatrixFeaturesKHR cooperativeMatrixFeatures = {};
+    cooperativeMatrixFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COOPERATIVE_MATRIX_FEATURES_KHR;
+    VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16Features = {};
+    float16Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR;
+    VkPhysicalDeviceVulkanMemoryModelFeaturesKHR memoryModelFeatures = {};
+    memoryModelFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_MEMORY_MODEL_FEATURES_KHR;
+    VkPhysicalDeviceSubgroupSizeControlFeaturesEXT subgroupSizeFeatures = {};
+    subgroupSizeFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES_EXT;
+    if (cooperativeMatrices.float16) {
+        enable(VK_KHR_COOPERATIVE_MATRIX_EXTENSION_NAME);
+        enable(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+        enable(VK_KHR_VULKAN_MEMORY_MODEL_EXTENSION_NAME);
+        cooperativeMatrixFeatures.cooperativeMatrix = VK_TRUE;
+        chain(cooperativeMatrixFeatures);
+        float16Features.shaderFloat16 = VK_TRUE;
+        chain(float16Features);
+        memoryModelFeatures.vulkanMemoryModel = VK_TRUE;
+        chain(memoryModelFeatures);
+        if (cooperativeMatrices.requireSubgroupSize) {
+            enable(VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME);
+            subgroupSizeFeatures.subgroupSizeControl = VK_TRUE;
+            subgroupSizeFeatures.computeFullSubgroups = VK_TRUE;
+            chain(subgroupSizeFeatures);
+        }
+    }
+
+    // Sharing frames with other processes (ExternalMemory.hpp). No features to turn on, and the
+    // external_memory / external_semaphore extensions they build on are core in 1.1.
+    interopSupport = queryExternalInterop(physical);
+    if (interopSupport.memoryFd) {
+        enable(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+    }
+    if (interopSupport.semaphoreFd) {
+        enable(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
+    }
+
+    createInfo.enabledExtensionCount = static_cast<std::uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+    if (info.validation) {
+        createInfo.enabledLayerCount = static_cast<std::uint32_t>(validationLayers.size());
+        createInfo.ppEnabledLayerNames = validationLayers.data();
+    } else {
+        createInfo.enabledLayerCount = 0;
+    }
+    if (vkCreateDevice(physical, &createInfo, nullptr, &logicalDevice) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create logical device!");
+    }
+    vkd.load(logicalDevice);
+    if (info.validation) {
+        vkd.loadDebugUtils(instanceHandle);
+    }
+    vkGetDeviceQueue(logicalDevice, families.graphicsFamily, 0, &graphics);
+    vkGetDeviceQueue(logicalDevice, families.computeFamily, 0, &compute);
+    setObjectName(logicalDevice, logicalDevice, info.applicationName);
+    setObjectName(logicalDevice, graphics, compute == graphics ? "graphics+compute queue" : "graphics queue");
+    if (compute != graphics) {
+        setObjectName(logicalDevice, compute, "compute queue");
+    }
+    vkGetDeviceQueue(logicalDevice, families.transferFamily, 0, &transfer);
+    if (transfer != compute) {
+        setObjectName(logicalDevice, transfer, "transfer queue");
+    }
+    if (sparseSupport.binding) {
+        vkGetDeviceQueue(logicalDevice, families.sparseFamily, 0, &sparse);
+        if (sparse != graphics && sparse != compute) {
+            setObjectName(logicalDevice, sparse, "sparse binding queue");
+        }
+    }
+    // What got enabled, for --verbose.
+    if (info.verbose) {
+        if (shadingRate.attachment) {
+            std::cout << "Variable rate shading: " << shadingRate.texelSize.width << "x" << shadingRate.texelSize.height
+                      << " tiles, fragments up to " << shadingRate.maxFragmentSize.width << "x"
+                      << shadingRate.maxFragmentSize.height << std::endl;
+        }
+        if (dynamicStates.dynamicRendering || dynamicStates.extendedDynamicState) {
+            std::cout << "Dynamic state:" << (dynamicStates.dynamicRendering ? " rendering" : "")
+                      << (dynamicStates.extendedDynamicState ? " state1" : "")
+                      << (dynamicStates.extendedDynamicState2 ? " state2" : "")
+                      << (dynamicStates.polygonMode || dynamicStates.colorBlendEnable || dynamicStates.colorWriteMask ? " state3" : "")
+                      << std::endl;
+        }
+        if (cooperativeMatrices.float16) {
+            std::cout << "Cooperative matrix: 16x16x16 fp16, subgroup " << cooperativeMatrices.subgroupSize
+                      << (cooperativeMatrices.requireSubgroupSize ? " (pinned)" : "") << std::endl;
+        }
+        if (sparseSupport.binding) {
+            std::cout << "Sparse: binding" << (sparseSupport.residencyBuffer ? ", resident buffers" : "")
+                      << (sparseSupport.residencyImage2D ? ", resident 2D images" : "")
+                      << (sparseSupport.nonResidentStrict ? " (strict)" : "") << ", queue family " << families.sparseFamily
+                      << std::endl;
+        }
+        if (interopSupport.memoryFd || interopSupport.semaphoreFd) {
+            std::cout << "External interop:" << (interopSupport.memoryFd ? " memory fd" : "")
+                      << (interopSupport.semaphoreFd ? " semaphore fd" : "") << ", device " << interopSupport.deviceUUID
+                      << ", driver " << interopSupport.driverUUID << std::endl;
+        }
+    }
+
+    // Timed on the graphics queue, which needs timestamps. Opt-in: a few milliseconds at every start.
+    std::uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> familyProperties(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical, &familyCount, familyProperties.data());
+    bool timestamps = familyProperties[families.graphicsFamily].timestampValidBits != 0;
+    if (timestamps && info.measureBandwidth) {
+        // findMemoryType() prefers the faster of otherwise equal memory types from here on.
+        VT_ZONE("measure memory bandwidth");
+        bandwidth = measureMemoryBandwidth(physical, logicalDevice, graphics, families.graphicsFamily);
+        setMemoryBandwidth(bandwidth);
+        if (info.verbose) {
+            std::cout << "Memory bandwidth:";
+            const char* separator = " ";
+            for (std::uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+                if (bandwidth.gbps[i] > 0) {
+                    std::cout << separator << "type " << i << " " << bandwidth.gbps[i] << " GB/s";
+                    separator = ", ";
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+    if (timestamps && info.measureUploads && upload.hostVisibleDeviceLocal) {
+        // createDynamicBuffer() takes the faster upload path from here on.
+        VT_ZONE("measure upload path");
+        measureUploadPath(physical, logicalDevice, graphics, families.graphicsFamily, upload);
+        if (info.verbose) {
+            std::cout << "Dynamic uploads: " << (upload.direct ? "direct" : "staged") << " (direct "
+                      << upload.directGBps << " GB/s, staged " << upload.stagedGBps << " GB/s)" << std::endl;
+        }
+    }
+    setUploadPath(upload);
+}
+
+void VulkanContext::pickPhysicalDevice() {
+    VT_FUNCTION_ZONE();
+    std::uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instanceHandle, &deviceCount, nullptr);
+    if (deviceCount == 0) {
+        throw std::runtime_error("Failed to find GPUs with Vulkan support! Get a better computer LOSER!!!");
+    }
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(instanceHandle, &deviceCount, devices.data());
+
+    if (!info.device.empty()) {
+        physical = selectDevice(devices, info.device);
+    } else {
+        double score = 0;
+        for (const auto& device : devices) {
+            double devScore = deviceScore(device);
+            if (devScore > score) {
+                physical = device;
+                score = devScore;
+            }
+        }
+    }
+
+    if (physical == VK_NULL_HANDLE) {
+        throw std::runtime_error("failed to find a suitable GPU!");
+    } else if (info.verbose) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physical, &deviceProperties);
+        std::cout << "Using GPU: " << deviceProperties.deviceName << std::endl;
+    }
+    upload = findUploadPath(physical);
+    if (info.verbose && upload.hostVisibleDeviceLocal) {
+        std::cout << "Host-visible device-local heap: " << (upload.heapSize >> 20) << " MiB (memory type "
+                  << upload.memoryTypeIndex << ")" << std::endl;
+    }
+}
+
+std::string VulkanContext::deviceUUID(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (apiVersion < VK_API_VERSION_1_1 || deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+        return "";
+    }
+    VkPhysicalDeviceIDProperties idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+    std::ostringstream uuid;
+    for (std::uint8_t byte : idProperties.deviceUUID) {
+        uuid << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+    }
+    return uuid.str();
+}
+
+VkPhysicalDevice VulkanContext::selectDevice(const std::vector<VkPhysicalDevice>& devices, const std::string& selector) {
+    VkPhysicalDevice chosen = VK_NULL_HANDLE;
+    bool isIndex = selector.find_first_not_of("0123456789") == std::string::npos;
+    std::string hex;
+    for (char c : selector) {
+        if (c != '-') hex += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    for (std::size_t i = 0; i < devices.size() && chosen == VK_NULL_HANDLE; i++) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
+        if ((isIndex && std::to_string(i) == selector) ||
+            (hex.size() == 2 * VK_UUID_SIZE && deviceUUID(devices[i]) == hex) ||
+            (!isIndex && std::strstr(deviceProperties.deviceName, selector.c_str()) != nullptr)) {
+            chosen = devices[i];
+        }
+    }
+    if (chosen == VK_NULL_HANDLE) {
+        throw std::runtime_error("No GPU matches --device " + selector);
+    }
+    if (!findQueueFamilies(chosen).indexFound) {
+        throw std::runtime_error("Selected GPU has no graphics queue.");
+    }
+    return chosen;
+}
+
+QueueFamilyIndices VulkanContext::findQueueFamilies(VkPhysicalDevice device) {
+    QueueFamilyIndices indices{false, 0, 0, false, 0, 0};
+    bool dedicatedCompute = false;
+    auto queueFamilies = getVkVector<VkQueueFamilyProperties>(vkGetPhysicalDeviceQueueFamilyProperties, device);
+
+    std::uint32_t i = 0;
+    for (const auto& queueFamily : queueFamilies) {
+        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && !indices.indexFound) {
+            indices.graphicsFamily = i;
+            indices.indexFound = true;
+        }
+        // Compute without graphics runs concurrently with rendering (async compute).
+        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT &&
+            !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !dedicatedCompute) {
+            indices.computeFamily = i;
+            dedicatedCompute = true;
+        }
+
+        if (indices.indexFound && dedicatedCompute) {
+            break;
+        }
+
+        i++;
+    }
+    // No async compute: share the graphics family (in practice graphics families support compute).
+    if (!dedicatedCompute) {
+        indices.computeFamily = indices.graphicsFamily;
+    }
+
+    // Copies on a DMA engine run alongside both rendering and async compute.
+    indices.transferFamily = indices.computeFamily;
+    for (std::uint32_t family = 0; family < queueFamilies.size(); family++) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (queueFamilies[family].queueCount > 0 && flags & VK_QUEUE_TRANSFER_BIT &&
+            !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = family;
+            break;
+        }
+    }
+
+    // Sparse binds on a queue that exists anyway when possible. They are ordered against rendering
+    // with semaphores either way.
+    indices.sparseFamily = indices.graphicsFamily;
+    std::vector<std::uint32_t> sparseCandidates = {indices.graphicsFamily, indices.computeFamily};
+    for (std::uint32_t family = 0; family < queueFamilies.size(); family++) {
+        sparseCandidates.push_back(family);
+    }
+    for (std::uint32_t family : sparseCandidates) {
+        if (indices.indexFound && queueFamilies[family].queueCount > 0 &&
+            queueFamilies[family].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) {
+            indices.sparseFamily = family;
+            indices.sparseFound = true;
+            break;
+        }
+    }
+
+    return indices;
+}
+
+double VulkanContext::deviceScore(VkPhysicalDevice device) {
+    double score = 0;
+    VkPhysicalDeviceProperties deviceProperties;
+    VkPhysicalDeviceFeatures deviceFeatures;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+
+    if (info.verbose) std::cout << deviceProperties.deviceName << ": ";
+
+    score += deviceProperties.limits.maxImageDimension2D;
+    score += deviceProperties.limits.maxImageDimension3D;
+
+    // Example of required feature support.
+    // if (!deviceFeatures.tessellationShader) {
+    //       score = -1;
+    // }
+
+    QueueFamilyIndices indices = findQueueFamilies(device);
+    if (!indices.indexFound) {
+        score = -1;
+    }
+
+    // Every device extension the caller asked for is required.
+    for (const char* required : info.deviceExtensions) {
+        if (!hasDeviceExtension(device, required)) {
+            score = -1;
+        }
+    }
+
+    if (info.verbose) std::cout << score << std::endl;
+    return score;
+}
+
+bool VulkanContext::hasDeviceExtension(VkPhysicalDevice device, const char* name) {
+    auto extensions = getVkVector<VkExtensionProperties>(vkEnumerateDeviceExtensionProperties, device, nullptr);
+    for (const auto& extension : extensions) {
+        if (std::strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+FragmentShadingRateSupport VulkanContext::queryFragmentShadingRate(VkPhysicalDevice device) {
+    FragmentShadingRateSupport support;
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (apiVersion < VK_API_VERSION_1_1 || deviceProperties.apiVersion < VK_API_VERSION_1_1 ||
+        !hasDeviceExtension(device, VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME) ||
+        !hasDeviceExtension(device, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME)) {
+        return support;
+    }
+
+    VkPhysicalDeviceFragmentShadingRateFeaturesKHR features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features;
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    VkPhysicalDeviceFragmentShadingRatePropertiesKHR properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_PROPERTIES_KHR;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &properties;
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+
+    support.pipeline = features.pipelineFragmentShadingRate == VK_TRUE;
+    support.attachment = features.attachmentFragmentShadingRate == VK_TRUE;
+    support.texelSize = properties.minFragmentShadingRateAttachmentTexelSize;
+    support.maxFragmentSize = properties.maxFragmentSize;
+    support.maxAspectRatio = std::max<std::uint32_t>(1, properties.maxFragmentSizeAspectRatio);
+    return support;
+}
+
+DynamicStateSupport VulkanContext::queryDynamicState(VkPhysicalDevice device) {
+    DynamicStateSupport support;
+    VkPhysicalDeviceFeatures coreFeatures;
+    vkGetPhysicalDeviceFeatures(device, &coreFeatures);
+    support.fillModeNonSolid = coreFeatures.fillModeNonSolid == VK_TRUE;
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (apiVersion < VK_API_VERSION_1_1 || deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+        return support;
+    }
+    bool rendering = hasDeviceExtension(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+                     hasDeviceExtension(device, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+                     hasDeviceExtension(device, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+    bool state1 = hasDeviceExtension(device, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    bool state2 = hasDeviceExtension(device, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+    bool state3 = hasDeviceExtension(device, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
+    // Only chain the structs of extensions the device has; the others would be ignored at best.
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    auto chain = [&features2](auto& features) {
+        features.pNext = features2.pNext;
+        features2.pNext = &features;
+    };
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR renderingFeatures = {};
+    renderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    if (rendering) chain(renderingFeatures);
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT state1Features = {};
+    state1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    if (state1) chain(state1Features);
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT state2Features = {};
+    state2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+    if (state2) chain(state2Features);
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT state3Features = {};
+    state3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    if (state3) chain(state3Features);
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    VkPhysicalDeviceExtendedDynamicState3PropertiesEXT state3Properties = {};
+    state3Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_PROPERTIES_EXT;
+    if (state3) {
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &state3Properties;
+        vkGetPhysicalDeviceProperties2(device, &properties2);
+    }
+
+    support.dynamicRendering = renderingFeatures.dynamicRendering == VK_TRUE;
+    support.extendedDynamicState = state1Features.extendedDynamicState == VK_TRUE;
+    // The later extensions only add to the first one; GraphicsPipelineCache assumes it.
+    if (support.extendedDynamicState) {
+        support.extendedDynamicState2 = state2Features.extendedDynamicState2 == VK_TRUE;
+        support.polygonMode = state3Features.extendedDynamicState3PolygonMode == VK_TRUE;
+        support.colorBlendEnable = state3Features.extendedDynamicState3ColorBlendEnable == VK_TRUE;
+        support.colorWriteMask = state3Features.extendedDynamicState3ColorWriteMask == VK_TRUE;
+        support.unrestrictedTopology = state3Properties.dynamicPrimitiveTopologyUnrestricted == VK_TRUE;
+    }
+    return support;
+}
+
+CooperativeMatrixSupport VulkanContext::queryCooperativeMatrix(VkPhysicalDevice device) {
+    CooperativeMatrixSupport support;
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (apiVersion < VK_API_VERSION_1_1 || deviceProperties.apiVersion < VK_API_VERSION_1_1 ||
+        !hasDeviceExtension(device, VK_KHR_COOPERATIVE_MATRIX_EXTENSION_NAME) ||
+        !hasDeviceExtension(device, VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME) ||
+        !hasDeviceExtension(device, VK_KHR_VULKAN_MEMORY_MODEL_EXTENSION_NAME)) {
+        return support;
+    }
+    bool sizeControl = hasDeviceExtension(device, VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME);
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    auto chain = [&features2](auto& features) {
+        features.pNext = features2.pNext;
+        features2.pNext = &features;
+    };
+    VkPhysicalDeviceCooperativeMatrixFeaturesKHR matrixFeatures = {};
+    matrixFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COOPERATIVE_MATRIX_FEATURES_KHR;
+    chain(matrixFeatures);
+    VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16Features = {};
+    float16Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR;
+    chain(float16Features);
+    // GL_KHR_memory_scope_semantics, which the coopmat types need, declares the VulkanMemoryModel capability.
+    VkPhysicalDeviceVulkanMemoryModelFeaturesKHR memoryModelFeatures = {};
+    memoryModelFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_MEMORY_MODEL_FEATURES_KHR;
+    chain(memoryModelFeatures);
+    VkPhysicalDeviceSubgroupSizeControlFeaturesEXT sizeFeatures = {};
+    sizeFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES_EXT;
+    if (sizeControl) chain(sizeFeatures);
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    if (matrixFeatures.cooperativeMatrix != VK_TRUE || float16Features.shaderFloat16 != VK_TRUE ||
+        memoryModelFeatures.vulkanMemoryModel != VK_TRUE) {
+        return support;
+    }
+
+    VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceSubgroupSizeControlPropertiesEXT sizeProperties = {};
+    sizeProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES_EXT;
+    if (sizeControl) subgroupProperties.pNext = &sizeProperties;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+    if ((subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) == 0 ||
+        (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_BASIC_BIT) == 0) {
+        return support;
+    }
+    // The kernel counts on a fixed number of subgroups per workgroup. Devices that vary their compute
+    // subgroup size report it through subgroup_size_control; without a way to pin it, stay on fp32.
+    bool varying = sizeControl && sizeProperties.minSubgroupSize != sizeProperties.maxSubgroupSize;
+    if (varying && (sizeFeatures.subgroupSizeControl != VK_TRUE || sizeFeatures.computeFullSubgroups != VK_TRUE ||
+                    (sizeProperties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT) == 0)) {
+        return support;
+    }
+
+    // Physical device function, so not through callVKfx (that one passes the instance).
+    auto getProperties = reinterpret_cast<PFN_vkGetPhysicalDeviceCooperativeMatrixPropertiesKHR>(
+        vkGetInstanceProcAddr(instanceHandle, "vkGetPhysicalDeviceCooperativeMatrixPropertiesKHR"));
+    if (getProperties == nullptr) {
+        return support;
+    }
+    std::uint32_t count = 0;
+    getProperties(device, &count, nullptr);
+    std::vector<VkCooperativeMatrixPropertiesKHR> shapes(count);
+    for (auto& shape : shapes) {
+        shape.sType = VK_STRUCTURE_TYPE_COOPERATIVE_MATRIX_PROPERTIES_KHR;
+    }
+    getProperties(device, &count, shapes.data());
+    for (const auto& shape : shapes) {
+        if (shape.MSize == 16 && shape.NSize == 16 && shape.KSize == 16 && shape.scope == VK_SCOPE_SUBGROUP_KHR &&
+            shape.AType == VK_COMPONENT_TYPE_FLOAT16_KHR && shape.BType == VK_COMPONENT_TYPE_FLOAT16_KHR &&
+            shape.CType == VK_COMPONENT_TYPE_FLOAT32_KHR && shape.ResultType == VK_COMPONENT_TYPE_FLOAT32_KHR &&
+            shape.saturatingAccumulation == VK_FALSE) {
+            support.float16 = true;
+        }
+    }
+    support.subgroupSize = subgroupProperties.subgroupSize;
+    support.requireSubgroupSize = support.float16 && varying;
+    return support;
+}
+
+ExternalInteropSupport VulkanContext::queryExternalInterop(VkPhysicalDevice device) {
+    ExternalInteropSupport support;
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (apiVersion < VK_API_VERSION_1_1 || deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+        return support;
+    }
+    // Whether an image can be exported depends on its format and usage; createExportableImage() asks.
+    support.memoryFd = hasDeviceExtension(device, VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+    if (hasDeviceExtension(device, VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME)) {
+        VkPhysicalDeviceExternalSemaphoreInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO;
+        semaphoreInfo.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+        VkExternalSemaphoreProperties semaphoreProperties = {};
+        semaphoreProperties.sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES;
+        vkGetPhysicalDeviceExternalSemaphoreProperties(device, &semaphoreInfo, &semaphoreProperties);
+        const VkExternalSemaphoreFeatureFlags both =
+            VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT | VK_EXTERNAL_SEMAPHORE_FEATURE_IMPORTABLE_BIT;
+        support.semaphoreFd = (semaphoreProperties.externalSemaphoreFeatures & both) == both;
+    }
+
+    VkPhysicalDeviceIDProperties idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+    std::ostringstream driver;
+    for (std::uint8_t byte : idProperties.driverUUID) {
+        driver << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+    }
+    support.deviceUUID = deviceUUID(device);
+    support.driverUUID = driver.str();
+    return support;
+}
+
+SparseSupport VulkanContext::querySparse(VkPhysicalDevice device) {
+    SparseSupport support;
+    if (!findQueueFamilies(device).sparseFound) {
+        return support;
+    }
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(device, &features);
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    support.binding = features.sparseBinding == VK_TRUE;
+    // Residency builds on binding.
+    support.residencyBuffer = support.binding && features.sparseResidencyBuffer == VK_TRUE;
+    support.residencyImage2D = support.binding && features.sparseResidencyImage2D == VK_TRUE;
+    support.nonResidentStrict = deviceProperties.sparseProperties.residencyNonResidentStrict == VK_TRUE;
+    support.standardBlockShape = deviceProperties.sparseProperties.residencyStandard2DBlockShape == VK_TRUE;
+    return support;
+}
+
+void VulkanContext::createInstance() {
+    VT_FUNCTION_ZONE();
+    // Enumerate available extensions.
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+    // Print the extensions.
+    if (info.verbose) {
+        std::cout << "Available extensions:" << std::endl;
+        for (const auto& extension : extensions) {
+            std::cout << extension.extensionName << std::endl;
+        }
+    }
+
+    // Ask for 1.1 when the loader has it, for vkGetPhysicalDeviceProperties2 (device UUIDs).
+    // vkEnumerateInstanceVersion doesn't exist on 1.0 loaders, so look it up instead of linking it.
+    auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    std::uint32_t loaderVersion = VK_API_VERSION_1_0;
+    if (enumerateInstanceVersion != nullptr) {
+        enumerateInstanceVersion(&loaderVersion);
+    }
+    apiVersion = loaderVersion >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
+
+    // App info for instance.
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = info.applicationName.c_str();
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "No Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = apiVersion;
+
+    // Instance creation info.
+    VkInstanceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    // Query for extensions we need.
+    auto reqExtensions = getRequiredExtensions();
+
+    // Check that the requested extensions are available.
+    if (info.verbose) std::cout << "Requested extensions:" << std::endl;
+    for (auto reqExtension : reqExtensions) {
+        if (info.verbose) std::cout << reqExtension << "... ";
+        bool isPresent = false;
+        for (const auto& extension : extensions) {
+            if (std::strcmp(extension.extensionName, reqExtension) == 0) {
+                isPresent = true;
+                break;
+            }
+        }
+        if (info.verbose) std::cout << (isPresent ? "present." : "not available.") << std::endl;
+    }
+
+    // Enable requested extensions when creating instance.
+    createInfo.enabledExtensionCount = static_cast<std::uint32_t>(reqExtensions.size());
+    createInfo.ppEnabledExtensionNames = reqExtensions.data();
+
+    // Check for validation layers if requested.
+    if (info.validation && !checkValidationLayerSupport()) {
+        throw std::runtime_error("Validation layers requested, but not available!");
+    }
+
+    if (info.validation) {
+        createInfo.enabledLayerCount = static_cast<std::uint32_t>(validationLayers.size());
+        createInfo.ppEnabledLayerNames = validationLayers.data();
+    } else {
+        createInfo.enabledLayerCount = 0;
+    }
+    // Finally create the instance using the standard allocator.
+    if (vkCreateInstance(&createInfo, nullptr, &instanceHandle) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create instance.");
+    }
+}
+
+bool VulkanContext::checkValidationLayerSupport() {
+    std::uint32_t layerCount;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+    std::vector<VkLayerProperties> availableLayers(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+    bool allLayersAvailable = true;
+
+    if (info.verbose) std::cout << "Requested validation layer:" << std::endl;
+    for (const auto& requestedLayer : validationLayers) {
+        if (info.verbose) std::cout << requestedLayer << "... ";
+        bool isPresent = false;
+        for (const auto& availableLayer : availableLayers) {
+            if (std::strcmp(availableLayer.layerName, requestedLayer) == 0) {
+                isPresent = true;
+                break;
+            }
+        }
+        if (info.verbose) std::cout << (isPresent ? "present." : "not available.") << std::endl;
+        allLayersAvailable &= isPresent;
+    }
+
+    return allLayersAvailable;
+}
+
+std::vector<const char*> VulkanContext::getRequiredExtensions() {
+    // Whatever the caller needs (GLFW surface extensions for windowed runs, nothing for headless ones).
+    std::vector<const char*> extensions = info.instanceExtensions;
+
+    // With validation, add extensions for debug layer callbacks.
+    if (info.validation) {
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+
+    return extensions;
+}
+
+void VulkanContext::setupDebugMessenger() {
+    VT_FUNCTION_ZONE();
+    if (!info.validation) return;
+    VkDebugUtilsMessengerCreateInfoEXT createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    createInfo.messageSeverity =
+       VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+       VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+       VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    createInfo.messageType =
+       VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+       VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+       VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    createInfo.pfnUserCallback = debugCallback;
+    createInfo.pUserData = nullptr;
+    if (callVKfx<VkResult, PFN_vkCreateDebugUtilsMessengerEXT>("vkCreateDebugUtilsMessengerEXT", instanceHandle, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+        throw std::runtime_error("failed to set up debug messenger!");
+    }
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL VulkanContext::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+                                                            VkDebugUtilsMessageTypeFlagsEXT messageType,
+                                                            const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+                                                            void* pUserData) {
+    std::cerr << "Validation layer: " << pCallbackData->pMessage << std::endl;
+    return VK_FALSE;
+}
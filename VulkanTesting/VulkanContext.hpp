@@ -0,0 +1,188 @@
+#ifndef VulkanContext_hpp
+#define VulkanContext_hpp
+
+#include "VulkanMemory.hpp"
+#include "VulkanUtils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern const std::vector<const char*> validationLayers;
+
+struct QueueFamilyIndices {
+    bool indexFound;
+    std::uint32_t graphicsFamily;
+    std::uint32_t computeFamily; // Dedicated (async) compute family if there is one, otherwise graphicsFamily.
+    bool sparseFound;            // Some family has VK_QUEUE_SPARSE_BINDING_BIT.
+    // The graphics or compute family when they can bind sparse memory, so no extra queue is needed,
+    // otherwise the first family that can. graphicsFamily when none can.
+    std::uint32_t sparseFamily;
+    // Transfer-only (DMA) family if there is one, for copies that overlap rendering; otherwise
+    // computeFamily.
+    std::uint32_t transferFamily;
+};
+
+// VK_KHR_fragment_shading_rate, as far as the renderer uses it. Optional: createLogicalDevice() enables
+// it whenever the device has it, and everything stays false (full-rate shading) when it doesn't.
+struct FragmentShadingRateSupport {
+    bool pipeline = false;   // Per-draw rate through vkCmdSetFragmentShadingRateKHR.
+    bool attachment = false; // Per-tile rates from an image; see ShadingRateMap.
+    VkExtent2D texelSize = {0, 0};       // Smallest attachment texel (tile) size the device takes.
+    VkExtent2D maxFragmentSize = {1, 1}; // Coarsest rate, in pixels per fragment.
+    std::uint32_t maxAspectRatio = 1;    // Largest width/height (or height/width) ratio of a rate.
+};
+
+// VK_KHR_dynamic_rendering and VK_EXT_extended_dynamic_state 1 to 3, as far as GraphicsPipelineCache
+// uses them. Optional too: whatever is false stays baked into pipelines.
+struct DynamicStateSupport {
+    bool fillModeNonSolid = false;      // Core feature, enabled when present: line and point polygon modes.
+    bool dynamicRendering = false;      // vkCmdBeginRenderingKHR: pipelines take formats, not a VkRenderPass.
+    bool extendedDynamicState = false;  // Cull mode, front face, topology, depth test, write and compare.
+    bool extendedDynamicState2 = false; // Primitive restart.
+    bool polygonMode = false;           // extended_dynamic_state3 is per state: these three.
+    bool colorBlendEnable = false;
+    bool colorWriteMask = false;
+    bool unrestrictedTopology = false;  // Dynamic topology may switch class (triangles to lines).
+};
+
+// VK_KHR_cooperative_matrix with fp16 inputs and fp32 accumulators, as far as TensorKernels uses it:
+// 16x16x16 subgroup-scope multiplies. The kernel also needs vulkanMemoryModel. Optional as well;
+// without it GEMMs stay on the fp32 tiled kernel.
+struct CooperativeMatrixSupport {
+    bool float16 = false;
+    std::uint32_t subgroupSize = 0; // Compute subgroups are this wide, see requireSubgroupSize.
+    // The device may pick other compute subgroup sizes; pipelines must pin subgroupSize through
+    // VK_EXT_subgroup_size_control (VkPipelineShaderStageRequiredSubgroupSizeCreateInfoEXT).
+    bool requireSubgroupSize = false;
+};
+
+// Sparse binding and residency, Vulkan 1.0 features, as far as VirtualTexture uses them. Optional:
+// createLogicalDevice() enables what the device has, as long as some queue family binds sparse memory.
+struct SparseSupport {
+    bool binding = false;            // sparseBinding: resources bound page by page, on sparseQueue().
+    bool residencyBuffer = false;    // Buffers with unbound ranges.
+    bool residencyImage2D = false;   // 2D images with unbound tiles, for virtual textures.
+    bool nonResidentStrict = false;  // Unbound pages read as zero rather than undefined values.
+    bool standardBlockShape = false; // 2D tiles have the standard 64 KiB shapes (128x128 texels at 32 bits).
+};
+
+// VK_KHR_external_memory_fd and VK_KHR_external_semaphore_fd with opaque fds, as far as
+// ExternalMemory.hpp uses them. Optional, and Vulkan 1.1 only: the instance-level capability queries
+// are core there. A process that imports has to pick the device with the same deviceUUID, and
+// its driverUUID has to match too.
+struct ExternalInteropSupport {
+    bool memoryFd = false;    // Exportable and importable image memory (checked per format on creation).
+    bool semaphoreFd = false; // Binary semaphores, exportable and importable.
+    std::string deviceUUID;   // 32 lowercase hex digits, as VulkanContextCreateInfo::device takes them.
+    std::string driverUUID;
+};
+
+struct VulkanContextCreateInfo {
+    std::string applicationName = "Hello Triangle";
+    bool validation = false;
+    bool verbose = false; // Print device scores and choice, extension and layer lists, optional features enabled
+                          // and startup measurements. Otherwise only validation messages are printed.
+    // Empty = best score. Otherwise an index ("1"), a UUID ("a1b2...") or a substring of the device name.
+    std::string device;
+    // Extra instance extensions, e.g. what glfwGetRequiredInstanceExtensions() asks for. Empty for headless use.
+    std::vector<const char*> instanceExtensions;
+    std::vector<const char*> deviceExtensions;
+    // Time GPU copies in every memory type when the device is created, so that findMemoryType() ranks
+    // otherwise equal types by speed. A few milliseconds; off, such types keep their driver order.
+    bool measureBandwidth = false;
+    // Time dynamic-buffer uploads written in place against staged ones when the device is created,
+    // if the device has a host-visible device-local heap. Set it when the caller uses DynamicBuffer;
+    // off, uploadPath() stays direct whenever that heap exists.
+    bool measureUploads = false;
+};
+
+// Instance, debug messenger, physical device choice, logical device and queues: everything the app,
+// tools and benchmarks share. Knows nothing about windows, so it links without GLFW; surface
+// extensions come in through VulkanContextCreateInfo::instanceExtensions.
+class VulkanContext {
+public:
+    explicit VulkanContext(const VulkanContextCreateInfo& info);
+    ~VulkanContext();
+
+    VulkanContext(const VulkanContext&) = delete;
+    VulkanContext& operator=(const VulkanContext&) = delete;
+
+    VkInstance instance() const { return instanceHandle; }
+    std::uint32_t instanceApiVersion() const { return apiVersion; } // What we asked for in createInstance().
+    VkPhysicalDevice physicalDevice() const { return physical; }
+    VkDevice device() const { return logicalDevice; }
+    VkQueue graphicsQueue() const { return graphics; }
+    VkQueue computeQueue() const { return compute; } // Same as graphicsQueue() without a dedicated compute family.
+    // vkQueueBindSparse goes here; may be graphicsQueue() or computeQueue(). Null without sparse binding.
+    VkQueue sparseQueue() const { return sparse; }
+    // Background copies (BufferPool defragmentation). Same as computeQueue() without a transfer-only family.
+    VkQueue transferQueue() const { return transfer; }
+    const QueueFamilyIndices& queueFamilies() const { return families; }
+    const FragmentShadingRateSupport& fragmentShadingRate() const { return shadingRate; }
+    const DynamicStateSupport& dynamicState() const { return dynamicStates; }
+    const CooperativeMatrixSupport& cooperativeMatrix() const { return cooperativeMatrices; }
+    const SparseSupport& sparseResidency() const { return sparseSupport; }
+    const ExternalInteropSupport& externalInterop() const { return interopSupport; }
+    // Copy bandwidth per memory type, measured at startup with VulkanContextCreateInfo::measureBandwidth;
+    // all 0 without it or when the graphics queue has no timestamps.
+    const MemoryBandwidth& memoryBandwidth() const { return bandwidth; }
+    // Whether dynamic buffers are written in place in device-local memory (resizable BAR) or staged.
+    // Measured only with VulkanContextCreateInfo::measureUploads.
+    const UploadPath& uploadPath() const { return upload; }
+
+private:
+    VulkanContextCreateInfo info;
+    VkInstance instanceHandle = VK_NULL_HANDLE;
+    std::uint32_t apiVersion = VK_API_VERSION_1_0;
+    VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
+    VkPhysicalDevice physical = VK_NULL_HANDLE;
+    VkDevice logicalDevice = VK_NULL_HANDLE; // "Logical" device
+    VkQueue graphics = VK_NULL_HANDLE;
+    VkQueue compute = VK_NULL_HANDLE;
+    VkQueue sparse = VK_NULL_HANDLE;
+    VkQueue transfer = VK_NULL_HANDLE;
+    QueueFamilyIndices families{false, 0, 0, false, 0, 0};
+    FragmentShadingRateSupport shadingRate;
+    DynamicStateSupport dynamicStates;
+    CooperativeMatrixSupport cooperativeMatrices;
+    SparseSupport sparseSupport;
+    ExternalInteropSupport interopSupport;
+    MemoryBandwidth bandwidth;
+    UploadPath upload;
+
+    void createInstance();
+    bool checkValidationLayerSupport();
+    std::vector<const char*> getRequiredExtensions();
+    void setupDebugMessenger();
+    void pickPhysicalDevice();
+    void createLogicalDevice();
+
+    // Device UUID as 32 lowercase hex digits, or empty when the instance/device can't report it (Vulkan 1.0).
+    std::string deviceUUID(VkPhysicalDevice device);
+    // Explicit choice from the config: an index, a UUID (dashes optional) or a name substring, in that order.
+    // Still refuses devices without a graphics queue.
+    VkPhysicalDevice selectDevice(const std::vector<VkPhysicalDevice>& devices, const std::string& selector);
+    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+    double deviceScore(VkPhysicalDevice device);
+    bool hasDeviceExtension(VkPhysicalDevice device, const char* name);
+    // Needs Vulkan 1.1 for the features2/properties2 queries; reports nothing on 1.0.
+    FragmentShadingRateSupport queryFragmentShadingRate(VkPhysicalDevice device);
+    // Same 1.1 requirement.
+    DynamicStateSupport queryDynamicState(VkPhysicalDevice device);
+    // Same 1.1 requirement.
+    CooperativeMatrixSupport queryCooperativeMatrix(VkPhysicalDevice device);
+    // Plain 1.0 features, but only with a queue family that binds sparse memory.
+    SparseSupport querySparse(VkPhysicalDevice device);
+    // 1.1 again, for the external semaphore query and the UUIDs.
+    ExternalInteropSupport queryExternalInterop(VkPhysicalDevice device);
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+                                                        VkDebugUtilsMessageTypeFlagsEXT messageType,
+                                                        const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+                                                        void* pUserData);
+};
+
+#endif /* VulkanContext_hpp */
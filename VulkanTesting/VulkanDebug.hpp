@@ -0,0 +1,98 @@
+#ifndef VulkanDebug_hpp
+#define VulkanDebug_hpp
+
+#include "VulkanDispatch.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// Object names and command buffer labels through VK_EXT_debug_utils, so validation messages and
+// captures in RenderDoc, Nsight or RGP show "GLZ staging" instead of a raw handle.
+//
+// The entry points are only loaded when the instance has debug utils (validation on); otherwise the
+// vkd pointers are null and every helper here is a single predictable branch that touches nothing.
+// Call sites pass string literals, and composed names are built behind debugUtilsEnabled(), so a
+// release run never formats a name. Define VT_DISABLE_DEBUG_UTILS to compile the helpers out.
+
+template<typename T> struct VulkanObjectType;
+#define VT_OBJECT_TYPE(Handle, Type) \
+    template<> struct VulkanObjectType<Handle> { static const VkObjectType value = Type; };
+VT_OBJECT_TYPE(VkInstance, VK_OBJECT_TYPE_INSTANCE)
+VT_OBJECT_TYPE(VkDevice, VK_OBJECT_TYPE_DEVICE)
+VT_OBJECT_TYPE(VkQueue, VK_OBJECT_TYPE_QUEUE)
+VT_OBJECT_TYPE(VkCommandPool, VK_OBJECT_TYPE_COMMAND_POOL)
+VT_OBJECT_TYPE(VkCommandBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER)
+VT_OBJECT_TYPE(VkFence, VK_OBJECT_TYPE_FENCE)
+VT_OBJECT_TYPE(VkSemaphore, VK_OBJECT_TYPE_SEMAPHORE)
+VT_OBJECT_TYPE(VkBuffer, VK_OBJECT_TYPE_BUFFER)
+VT_OBJECT_TYPE(VkImage, VK_OBJECT_TYPE_IMAGE)
+VT_OBJECT_TYPE(VkImageView, VK_OBJECT_TYPE_IMAGE_VIEW)
+VT_OBJECT_TYPE(VkSampler, VK_OBJECT_TYPE_SAMPLER)
+VT_OBJECT_TYPE(VkDeviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY)
+VT_OBJECT_TYPE(VkShaderModule, VK_OBJECT_TYPE_SHADER_MODULE)
+VT_OBJECT_TYPE(VkDescriptorSetLayout, VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT)
+VT_OBJECT_TYPE(VkDescriptorPool, VK_OBJECT_TYPE_DESCRIPTOR_POOL)
+VT_OBJECT_TYPE(VkDescriptorSet, VK_OBJECT_TYPE_DESCRIPTOR_SET)
+VT_OBJECT_TYPE(VkPipelineLayout, VK_OBJECT_TYPE_PIPELINE_LAYOUT)
+VT_OBJECT_TYPE(VkPipeline, VK_OBJECT_TYPE_PIPELINE)
+VT_OBJECT_TYPE(VkRenderPass, VK_OBJECT_TYPE_RENDER_PASS)
+VT_OBJECT_TYPE(VkFramebuffer, VK_OBJECT_TYPE_FRAMEBUFFER)
+VT_OBJECT_TYPE(VkQueryPool, VK_OBJECT_TYPE_QUERY_POOL)
+#undef VT_OBJECT_TYPE
+
+inline bool debugUtilsEnabled() {
+#ifdef VT_DISABLE_DEBUG_UTILS
+    return false;
+#else
+    return vkd.vkSetDebugUtilsObjectNameEXT != nullptr;
+#endif
+}
+
+// Handles are pointers on the 64-bit targets this builds for, so the cast to the uint64 handle value
+// is lossless. Names are copied by the implementation.
+template<typename T>
+inline void setObjectName(VkDevice device, T handle, const char* name) {
+    if (!debugUtilsEnabled() || handle == VK_NULL_HANDLE || name == nullptr) {
+        return;
+    }
+    VkDebugUtilsObjectNameInfoEXT nameInfo = {};
+    nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    nameInfo.objectType = VulkanObjectType<T>::value;
+    nameInfo.objectHandle = reinterpret_cast<std::uint64_t>(handle);
+    nameInfo.pObjectName = name;
+    vkd.vkSetDebugUtilsObjectNameEXT(device, &nameInfo);
+}
+
+template<typename T>
+inline void setObjectName(VkDevice device, T handle, const std::string& name) {
+    setObjectName(device, handle, name.c_str());
+}
+
+// Labels the commands recorded during its lifetime, e.g. one pass. Labels nest.
+class CommandLabel {
+public:
+    CommandLabel(VkCommandBuffer commandBuffer, const char* name)
+        : commandBuffer(debugUtilsEnabled() ? commandBuffer : VK_NULL_HANDLE) {
+        if (this->commandBuffer != VK_NULL_HANDLE) {
+            VkDebugUtilsLabelEXT label = {};
+            label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+            label.pLabelName = name;
+            vkd.vkCmdBeginDebugUtilsLabelEXT(this->commandBuffer, &label);
+        }
+    }
+    ~CommandLabel() {
+        if (commandBuffer != VK_NULL_HANDLE) {
+            vkd.vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+        }
+    }
+
+    CommandLabel(const CommandLabel&) = delete;
+    CommandLabel& operator=(const CommandLabel&) = delete;
+
+private:
+    VkCommandBuffer commandBuffer;
+};
+
+#endif /* VulkanDebug_hpp */
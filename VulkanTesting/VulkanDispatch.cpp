@@ -0,0 +1,27 @@
+#include "VulkanDispatch.hpp"
+
+VulkanDispatch vkd;
+
+void VulkanDispatch::load(VkDevice device) {
+#define VT_DISPATCH_LOAD(name) \
+    if (auto function = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name))) name = function;
+    VT_DEVICE_FUNCTIONS(VT_DISPATCH_LOAD)
+#undef VT_DISPATCH_LOAD
+#define VT_DISPATCH_LOAD(name) name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+    VT_DEVICE_EXTENSION_FUNCTIONS(VT_DISPATCH_LOAD)
+#undef VT_DISPATCH_LOAD
+}
+
+void VulkanDispatch::loadDebugUtils(VkInstance instance) {
+#define VT_DISPATCH_LOAD(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+    VT_DISPATCH_LOAD(vkSetDebugUtilsObjectNameEXT)
+    VT_DISPATCH_LOAD(vkCmdBeginDebugUtilsLabelEXT)
+    VT_DISPATCH_LOAD(vkCmdEndDebugUtilsLabelEXT)
+#undef VT_DISPATCH_LOAD
+    // All or nothing, so VulkanDebug only has to test one pointer.
+    if (vkSetDebugUtilsObjectNameEXT == nullptr || vkCmdBeginDebugUtilsLabelEXT == nullptr || vkCmdEndDebugUtilsLabelEXT == nullptr) {
+        vkSetDebugUtilsObjectNameEXT = nullptr;
+        vkCmdBeginDebugUtilsLabelEXT = nullptr;
+        vkCmdEndDebugUtilsLabelEXT = nullptr;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef VulkanDispatch_hpp
+#define VulkanDispatch_hpp
+
+#include <vulkan/vulkan.h>
+
+// Device-level entry points that go through a table instead of the loader exports. Loading them with
+// vkGetDeviceProcAddr skips the loader trampoline on every call, and the table is the seam where
+// GpuCapture hooks the resource creation, recording and submit path.
+#define VT_DEVICE_FUNCTIONS(X) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkBindBufferMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkCreateShaderModule) \
+    X(vkCreateDescriptorSetLayout) \
+    X(vkCreatePipelineLayout) \
+    X(vkCreateComputePipelines) \
+    X(vkAllocateDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkAllocateCommandBuffers) \
+    X(vkFreeCommandBuffers) \
+    X(vkDestroyCommandPool) \
+    X(vkBeginCommandBuffer) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdPushConstants) \
+    X(vkCmdDispatch) \
+    X(vkCmdDispatchIndirect) \
+    X(vkCmdDrawIndirect) \
+    X(vkCmdCopyBuffer) \
+    X(vkCmdCopyBufferToImage) \
+    X(vkCmdCopyImageToBuffer) \
+    X(vkCmdFillBuffer) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCmdBeginRenderPass) \
+    X(vkCmdNextSubpass) \
+    X(vkCmdEndRenderPass) \
+    X(vkCmdResetQueryPool) \
+    X(vkCmdWriteTimestamp) \
+    X(vkQueueSubmit)
+
+// Device extension commands. Null when the extension isn't enabled; check VulkanContext::dynamicState()
+// and externalInterop(). The Vulkan 1.1 commands at the end are null on 1.0 devices.
+#define VT_DEVICE_EXTENSION_FUNCTIONS(X) \
+    X(vkCmdBeginRenderingKHR) \
+    X(vkCmdEndRenderingKHR) \
+    X(vkCmdSetCullModeEXT) \
+    X(vkCmdSetFrontFaceEXT) \
+    X(vkCmdSetPrimitiveTopologyEXT) \
+    X(vkCmdSetDepthTestEnableEXT) \
+    X(vkCmdSetDepthWriteEnableEXT) \
+    X(vkCmdSetDepthCompareOpEXT) \
+    X(vkCmdSetPrimitiveRestartEnableEXT) \
+    X(vkCmdSetPolygonModeEXT) \
+    X(vkCmdSetColorBlendEnableEXT) \
+    X(vkCmdSetColorWriteMaskEXT) \
+    X(vkGetMemoryFdKHR) \
+    X(vkGetSemaphoreFdKHR) \
+    X(vkImportSemaphoreFdKHR) \
+    X(vkGetBufferMemoryRequirements2) \
+    X(vkGetImageMemoryRequirements2)
+
+struct VulkanDispatch {
+#define VT_DISPATCH_MEMBER(name) PFN_##name name = ::name;
+    VT_DEVICE_FUNCTIONS(VT_DISPATCH_MEMBER)
+#undef VT_DISPATCH_MEMBER
+#define VT_DISPATCH_EXTENSION_MEMBER(name) PFN_##name name = nullptr;
+    VT_DEVICE_EXTENSION_FUNCTIONS(VT_DISPATCH_EXTENSION_MEMBER)
+#undef VT_DISPATCH_EXTENSION_MEMBER
+
+    // VK_EXT_debug_utils. Null unless the instance enabled the extension; see VulkanDebug.hpp.
+    PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT = nullptr;
+    PFN_vkCmdBeginDebugUtilsLabelEXT vkCmdBeginDebugUtilsLabelEXT = nullptr;
+    PFN_vkCmdEndDebugUtilsLabelEXT vkCmdEndDebugUtilsLabelEXT = nullptr;
+
+    // Replaces every entry with the device's own function and looks up the extension commands.
+    // Called by VulkanContext once the device exists.
+    void load(VkDevice device);
+    // Instance extension commands come from vkGetInstanceProcAddr. Only call when debug utils is enabled.
+    void loadDebugUtils(VkInstance instance);
+};
+
+// One device per process, so one table.
+extern VulkanDispatch vkd;
+
+#endif /* VulkanDispatch_hpp */
@@ -0,0 +1,601 @@
+#include "VulkanMemory.hpp"
+#include "Profiler.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    MemoryBandwidth measuredBandwidth;
+    UploadPath currentUploadPath;
+
+    // What the CPU can reach of device-local memory without resizable BAR.
+    const VkDeviceSize classicBarSize = 256ull << 20;
+
+    int popCount(std::uint32_t bits) {
+        int count = 0;
+        for (; bits != 0; bits &= bits - 1) {
+            count++;
+        }
+        return count;
+    }
+
+    // vkGetBufferMemoryRequirements2 / vkGetImageMemoryRequirements2 are null on Vulkan 1.0 devices,
+    // which then never get dedicated allocations.
+    VkMemoryRequirements bufferRequirements(VkDevice device, VkBuffer buffer, bool& dedicated) {
+        dedicated = false;
+        if (vkd.vkGetBufferMemoryRequirements2 == nullptr) {
+            VkMemoryRequirements requirements;
+            vkGetBufferMemoryRequirements(device, buffer, &requirements);
+            return requirements;
+        }
+        VkBufferMemoryRequirementsInfo2 info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+        info.buffer = buffer;
+        VkMemoryDedicatedRequirements dedicatedRequirements = {};
+        dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 requirements = {};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicatedRequirements;
+        vkd.vkGetBufferMemoryRequirements2(device, &info, &requirements);
+        dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+        return requirements.memoryRequirements;
+    }
+
+    VkMemoryRequirements imageRequirements(VkDevice device, VkImage image, bool& dedicated) {
+        dedicated = false;
+        if (vkd.vkGetImageMemoryRequirements2 == nullptr) {
+            VkMemoryRequirements requirements;
+            vkGetImageMemoryRequirements(device, image, &requirements);
+            return requirements;
+        }
+        VkImageMemoryRequirementsInfo2 info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        info.image = image;
+        VkMemoryDedicatedRequirements dedicatedRequirements = {};
+        dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 requirements = {};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicatedRequirements;
+        vkd.vkGetImageMemoryRequirements2(device, &info, &requirements);
+        dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+        return requirements.memoryRequirements;
+    }
+
+    // A command buffer, fence and timestamp pair for timing copies on one queue.
+    struct CopyTimer {
+        VkDevice device = VK_NULL_HANDLE;
+        VkQueue queue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        double period = 1; // Nanoseconds per tick.
+        std::uint64_t mask = 0; // The queue family's timestampValidBits; 0 when it has no timestamps.
+    };
+
+    CopyTimer createCopyTimer(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, std::uint32_t family) {
+        CopyTimer timer;
+        timer.device = device;
+        timer.queue = queue;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        timer.period = properties.limits.timestampPeriod;
+        std::uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        std::uint32_t validBits = families[family].timestampValidBits;
+        timer.mask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+        VkCommandPoolCreateInfo commandPoolInfo = {};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        commandPoolInfo.queueFamilyIndex = family;
+        if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &timer.commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create copy timing command pool!");
+        }
+        VkCommandBufferAllocateInfo commandBufferInfo = {};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = timer.commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        vkd.vkAllocateCommandBuffers(device, &commandBufferInfo, &timer.commandBuffer);
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        vkCreateQueryPool(device, &queryInfo, nullptr, &timer.queryPool);
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vkCreateFence(device, &fenceInfo, nullptr, &timer.fence);
+        return timer;
+    }
+
+    void destroyCopyTimer(CopyTimer& timer) {
+        vkDestroyFence(timer.device, timer.fence, nullptr);
+        vkDestroyQueryPool(timer.device, timer.queryPool, nullptr);
+        vkd.vkDestroyCommandPool(timer.device, timer.commandPool, nullptr);
+        timer = CopyTimer();
+    }
+
+    // Nanoseconds per copy of size bytes from src to dst, after one untimed copy that wakes the clocks
+    // up; 0 when the queue has no timestamps or they make no sense.
+    double timeCopies(const CopyTimer& timer, VkBuffer src, VkBuffer dst, VkDeviceSize size) {
+        const std::uint32_t repeats = 4;
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkd.vkBeginCommandBuffer(timer.commandBuffer, &beginInfo);
+        vkd.vkCmdResetQueryPool(timer.commandBuffer, timer.queryPool, 0, 2);
+        VkBufferCopy region = {0, 0, size};
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        for (std::uint32_t i = 0; i <= repeats; i++) {
+            vkd.vkCmdCopyBuffer(timer.commandBuffer, src, dst, 1, &region);
+            vkd.vkCmdPipelineBarrier(timer.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0, 1, &barrier, 0, nullptr, 0, nullptr);
+            if (i == 0) {
+                vkd.vkCmdWriteTimestamp(timer.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, timer.queryPool, 0);
+            }
+        }
+        vkd.vkCmdWriteTimestamp(timer.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, timer.queryPool, 1);
+        vkEndCommandBuffer(timer.commandBuffer);
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &timer.commandBuffer;
+        vkd.vkQueueSubmit(timer.queue, 1, &submitInfo, timer.fence);
+        vkWaitForFences(timer.device, 1, &timer.fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(timer.device, 1, &timer.fence);
+        std::uint64_t stamps[2];
+        vkGetQueryPoolResults(timer.device, timer.queryPool, 0, 2, sizeof(stamps), stamps, sizeof(std::uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        std::uint64_t ticks = (stamps[1] - stamps[0]) & timer.mask;
+        if (ticks == 0) {
+            return 0;
+        }
+        return ticks * timer.period / repeats;
+    }
+
+    // Copies within one memory type; 0 when the type can't hold two buffers of size, or buffers of
+    // that size can't be created at all.
+    double copyBandwidth(const CopyTimer& timer, std::uint32_t memoryType, VkDeviceSize size) {
+        Buffer buffers[2];
+        bool allocated = true;
+        for (Buffer& buffer : buffers) {
+            VkBufferCreateInfo bufferInfo = {};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            if (vkd.vkCreateBuffer(timer.device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS) {
+                buffer.buffer = VK_NULL_HANDLE;
+                allocated = false;
+                break;
+            }
+            VkMemoryAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = size;
+            allocInfo.memoryTypeIndex = memoryType;
+            if (vkd.vkAllocateMemory(timer.device, &allocInfo, nullptr, &buffer.memory) != VK_SUCCESS) {
+                buffer.memory = VK_NULL_HANDLE;
+                allocated = false;
+                break;
+            }
+            if (vkd.vkBindBufferMemory(timer.device, buffer.buffer, buffer.memory, 0) != VK_SUCCESS) {
+                allocated = false;
+                break;
+            }
+        }
+        double gbps = 0;
+        if (allocated) {
+            double ns = timeCopies(timer, buffers[0].buffer, buffers[1].buffer, size);
+            // Every copy reads and writes size bytes.
+            gbps = ns > 0 ? 2.0 * size / ns : 0;
+        }
+        for (Buffer& buffer : buffers) {
+            vkd.vkDestroyBuffer(timer.device, buffer.buffer, nullptr);
+            vkd.vkFreeMemory(timer.device, buffer.memory, nullptr);
+        }
+        return gbps;
+    }
+
+    // Best of a few memcpys into mapped, in GB/s. Write-combined memory is only fast for streaming writes.
+    double hostWriteBandwidth(void* mapped, const std::vector<std::uint8_t>& data) {
+        double bestNs = 0;
+        for (int i = 0; i < 4; i++) {
+            std::uint64_t start = Profiler::now();
+            std::memcpy(mapped, data.data(), data.size());
+            double ns = static_cast<double>(Profiler::now() - start);
+            if (bestNs == 0 || (ns > 0 && ns < bestNs)) {
+                bestNs = ns;
+            }
+        }
+        return bestNs > 0 ? data.size() / bestNs : 0;
+    }
+
+    // A mapped buffer in exactly memoryType, which must be host visible, rather than whichever type
+    // findMemoryType() prefers for the same properties. Null when the buffer can't live in that type.
+    Buffer createMappedBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, std::uint32_t memoryType,
+                              const char* name) {
+        Buffer result;
+        result.size = size;
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkd.vkCreateBuffer(device, &bufferInfo, nullptr, &result.buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+        VkMemoryRequirements requirements = bufferRequirements(device, result.buffer, result.dedicated);
+        if (!(requirements.memoryTypeBits & (1u << memoryType))) {
+            vkd.vkDestroyBuffer(device, result.buffer, nullptr);
+            return Buffer();
+        }
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = memoryType;
+        VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.buffer = result.buffer;
+        if (result.dedicated) {
+            allocInfo.pNext = &dedicatedInfo;
+        }
+        if (vkd.vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) != VK_SUCCESS) {
+            vkd.vkDestroyBuffer(device, result.buffer, nullptr);
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+        vkd.vkBindBufferMemory(device, result.buffer, result.memory, 0);
+        setObjectName(device, result.buffer, name);
+        setObjectName(device, result.memory, name);
+        vkd.vkMapMemory(device, result.memory, 0, VK_WHOLE_SIZE, 0, &result.mapped);
+        return result;
+    }
+}
+
+std::uint32_t findMemoryType(VkPhysicalDevice physicalDevice, std::uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    std::uint32_t best = VK_MAX_MEMORY_TYPES;
+    int bestMisplaced = 0;
+    int bestExtra = 0;
+    for (std::uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+        if (!(typeBits & (1u << i)) || (flags & properties) != properties) {
+            continue;
+        }
+        VkMemoryPropertyFlags extra = flags & ~properties;
+        int misplaced = (extra & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? 1 : 0;
+        if ((properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (extra & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+            misplaced = 1;
+        }
+        bool better = best == VK_MAX_MEMORY_TYPES || misplaced < bestMisplaced;
+        if (!better && misplaced == bestMisplaced) {
+            double gbps = measuredBandwidth.gbps[i];
+            double bestGbps = measuredBandwidth.gbps[best];
+            better = gbps > bestGbps || (gbps == bestGbps && popCount(extra) < bestExtra);
+        }
+        if (better) {
+            best = i;
+            bestMisplaced = misplaced;
+            bestExtra = popCount(extra);
+        }
+    }
+    if (best == VK_MAX_MEMORY_TYPES) {
+        throw std::runtime_error("failed to find a suitable memory type!");
+    }
+    return best;
+}
+
+MemoryBandwidth measureMemoryBandwidth(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, std::uint32_t family) {
+    const VkDeviceSize size = 32ull << 20;
+    MemoryBandwidth result;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer probe;
+    if (vkd.vkCreateBuffer(device, &bufferInfo, nullptr, &probe) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create memory bandwidth probe buffer!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, probe, &requirements);
+    vkd.vkDestroyBuffer(device, probe, nullptr);
+
+    CopyTimer timer = createCopyTimer(physicalDevice, device, queue, family);
+    std::map<std::pair<std::uint32_t, VkMemoryPropertyFlags>, double> measured;
+    for (std::uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        const VkMemoryType& type = memoryProperties.memoryTypes[i];
+        // Lazily allocated memory is for transient attachments, protected memory for protected resources.
+        if (!(requirements.memoryTypeBits & (1u << i)) ||
+            (type.propertyFlags & (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT)) ||
+            memoryProperties.memoryHeaps[type.heapIndex].size < 8 * size) {
+            continue;
+        }
+        auto key = std::make_pair(type.heapIndex, type.propertyFlags);
+        auto known = measured.find(key);
+        if (known == measured.end()) {
+            known = measured.emplace(key, copyBandwidth(timer, i, size)).first;
+        }
+        result.gbps[i] = known->second;
+    }
+
+    destroyCopyTimer(timer);
+    return result;
+}
+
+void setMemoryBandwidth(const MemoryBandwidth& bandwidth) {
+    measuredBandwidth = bandwidth;
+}
+
+VkDeviceMemory allocateBufferMemory(VkPhysicalDevice physicalDevice, VkDevice device, VkBuffer buffer,
+                                    VkMemoryPropertyFlags properties, bool* dedicated) {
+    bool wantsDedicated;
+    VkMemoryRequirements requirements = bufferRequirements(device, buffer, wantsDedicated);
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits, properties);
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = buffer;
+    if (wantsDedicated) {
+        allocInfo.pNext = &dedicatedInfo;
+    }
+    VkDeviceMemory memory;
+    if (vkd.vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate buffer memory!");
+    }
+    vkd.vkBindBufferMemory(device, buffer, memory, 0);
+    if (dedicated != nullptr) {
+        *dedicated = wantsDedicated;
+    }
+    return memory;
+}
+
+Buffer createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size,
+                    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char* name) {
+    Buffer result;
+    result.size = size;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkd.vkCreateBuffer(device, &bufferInfo, nullptr, &result.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    try {
+        result.memory = allocateBufferMemory(physicalDevice, device, result.buffer, properties, &result.dedicated);
+    } catch (...) {
+        vkd.vkDestroyBuffer(device, result.buffer, nullptr);
+        throw;
+    }
+    setObjectName(device, result.buffer, name);
+    setObjectName(device, result.memory, name);
+
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkd.vkMapMemory(device, result.memory, 0, VK_WHOLE_SIZE, 0, &result.mapped);
+    }
+    return result;
+}
+
+void destroyBuffer(VkDevice device, Buffer& buffer) {
+    if (buffer.mapped != nullptr) {
+        vkd.vkUnmapMemory(device, buffer.memory);
+    }
+    vkd.vkDestroyBuffer(device, buffer.buffer, nullptr);
+    vkd.vkFreeMemory(device, buffer.memory, nullptr);
+    buffer = Buffer();
+}
+
+Image createImage(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format,
+                  VkImageUsageFlags usage, const char* name) {
+    Image result;
+    result.format = format;
+    result.extent = extent;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &imageInfo, nullptr, &result.image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements requirements = imageRequirements(device, result.image, result.dedicated);
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+        // Tile-based GPUs keep transient attachments on chip and never commit this memory.
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        for (std::uint32_t i = 0; i < memoryProperties.memoryTypeCount && !result.lazilyAllocated; i++) {
+            if ((requirements.memoryTypeBits & (1u << i)) &&
+                (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+                allocInfo.memoryTypeIndex = i;
+                result.lazilyAllocated = true;
+            }
+        }
+    }
+    if (!result.lazilyAllocated) {
+        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.image = result.image;
+    if (result.dedicated) {
+        allocInfo.pNext = &dedicatedInfo;
+    }
+    if (vkd.vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) != VK_SUCCESS) {
+        vkDestroyImage(device, result.image, nullptr);
+        throw std::runtime_error("failed to allocate image memory!");
+    }
+    vkBindImageMemory(device, result.image, result.memory, 0);
+
+    bool depth = format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+                 format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_X8_D24_UNORM_PACK32;
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = result.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {static_cast<VkImageAspectFlags>(depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT), 0, 1, 0, 1};
+    if (vkCreateImageView(device, &viewInfo, nullptr, &result.view) != VK_SUCCESS) {
+        vkd.vkFreeMemory(device, result.memory, nullptr);
+        vkDestroyImage(device, result.image, nullptr);
+        throw std::runtime_error("failed to create image view!");
+    }
+    setObjectName(device, result.image, name);
+    setObjectName(device, result.memory, name);
+    setObjectName(device, result.view, name);
+    return result;
+}
+
+void destroyImage(VkDevice device, Image& image) {
+    vkDestroyImageView(device, image.view, nullptr);
+    vkDestroyImage(device, image.image, nullptr);
+    vkd.vkFreeMemory(device, image.memory, nullptr);
+    image = Image();
+}
+
+UploadPath findUploadPath(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    const VkMemoryPropertyFlags wanted =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    UploadPath path;
+    for (std::uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        const VkMemoryType& type = memoryProperties.memoryTypes[i];
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[type.heapIndex].size;
+        if ((type.propertyFlags & wanted) == wanted && heapSize > classicBarSize && heapSize > path.heapSize) {
+            path.hostVisibleDeviceLocal = true;
+            path.heapSize = heapSize;
+            path.memoryTypeIndex = i;
+        }
+    }
+    path.direct = path.hostVisibleDeviceLocal;
+    return path;
+}
+
+void measureUploadPath(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, std::uint32_t family,
+                       UploadPath& path, VkDeviceSize size) {
+    if (!path.hostVisibleDeviceLocal) {
+        return;
+    }
+    std::vector<std::uint8_t> data(static_cast<std::size_t>(size));
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<std::uint8_t>(i * 31);
+    }
+    // The type findUploadPath() found, not just any device-local host-visible one: that may be the
+    // small BAR window, and timing it would say nothing about the large heap.
+    Buffer direct = createMappedBuffer(device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, path.memoryTypeIndex,
+                                       "upload path direct");
+    if (direct.buffer == VK_NULL_HANDLE) {
+        // Storage buffers can't go there, so dynamic buffers can't either.
+        path.direct = false;
+        return;
+    }
+    Buffer staging = createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  "upload path staging");
+    Buffer target = createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "upload path target");
+    CopyTimer timer = createCopyTimer(physicalDevice, device, queue, family);
+
+    path.directGBps = hostWriteBandwidth(direct.mapped, data);
+    double hostGBps = hostWriteBandwidth(staging.mapped, data);
+    double copyNs = timeCopies(timer, staging.buffer, target.buffer, size);
+    if (hostGBps > 0 && copyNs > 0) {
+        // One after the other: the frame waits for both.
+        path.stagedGBps = size / (size / hostGBps + copyNs);
+    }
+    if (path.directGBps > 0 && path.stagedGBps > 0) {
+        path.direct = path.directGBps >= path.stagedGBps;
+    }
+
+    destroyCopyTimer(timer);
+    destroyBuffer(device, target);
+    destroyBuffer(device, staging);
+    destroyBuffer(device, direct);
+}
+
+void setUploadPath(const UploadPath& path) {
+    currentUploadPath = path;
+}
+
+DynamicBuffer createDynamicBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size,
+                                  VkBufferUsageFlags usage, const char* name) {
+    DynamicBuffer result;
+    if (currentUploadPath.direct) {
+        // In the type measureUploadPath() timed; staged after all when this usage can't go there.
+        result.buffer = createMappedBuffer(device, size, usage, currentUploadPath.memoryTypeIndex, name);
+        if (result.buffer.buffer != VK_NULL_HANDLE) {
+            result.mapped = result.buffer.mapped;
+            return result;
+        }
+    }
+    result.buffer = createBuffer(physicalDevice, device, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, name);
+    std::string stagingName = std::string(name != nullptr ? name : "dynamic buffer") + " staging";
+    try {
+        result.staging = createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      stagingName.c_str());
+    } catch (...) {
+        destroyBuffer(device, result.buffer);
+        throw;
+    }
+    result.mapped = result.staging.mapped;
+    return result;
+}
+
+void recordDynamicUpload(VkCommandBuffer commandBuffer, const DynamicBuffer& buffer, VkDeviceSize size,
+                         VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    if (buffer.staging.buffer == VK_NULL_HANDLE || size == 0) {
+        return;
+    }
+    VkBufferCopy region = {0, 0, size};
+    vkd.vkCmdCopyBuffer(commandBuffer, buffer.staging.buffer, buffer.buffer.buffer, 1, &region);
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer.buffer.buffer;
+    barrier.offset = 0;
+    barrier.size = size;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0,
+                             nullptr);
+}
+
+void destroyDynamicBuffer(VkDevice device, DynamicBuffer& buffer) {
+    destroyBuffer(device, buffer.staging);
+    destroyBuffer(device, buffer.buffer);
+    buffer = DynamicBuffer();
+}
@@ -0,0 +1,108 @@
+#ifndef VulkanMemory_hpp
+#define VulkanMemory_hpp
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// A buffer with its own VkDeviceMemory. Host-visible buffers stay persistently mapped. Many small
+// buffers that come and go belong in a BufferPool instead.
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    bool dedicated = false; // Allocated with VkMemoryDedicatedAllocateInfo, as the driver asked.
+};
+
+// A device-local 2D image with its own VkDeviceMemory and a view of the whole image.
+struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {0, 0};
+    bool lazilyAllocated = false; // Transient attachment memory that may never be backed (tilers).
+    bool dedicated = false;
+};
+
+// GPU copy bandwidth of each memory type in GB/s, from measureMemoryBandwidth(); 0 where not measured.
+struct MemoryBandwidth {
+    double gbps[VK_MAX_MEMORY_TYPES] = {};
+};
+
+// The best memory type allowed by typeBits that has all of the requested properties. Types that would
+// put data where it wasn't asked for come last: host-visible ones for device-only data (they are often
+// the small BAR window) and device-local ones for host data. Then the fastest as measured by
+// measureMemoryBandwidth(), then the fewest properties beyond the requested ones, then the first.
+// Throws when there is none.
+std::uint32_t findMemoryType(VkPhysicalDevice physicalDevice, std::uint32_t typeBits, VkMemoryPropertyFlags properties);
+
+// Times GPU copies within every memory type that buffers can use, on queue (of family, which needs
+// timestamps). Types with the same heap and properties are measured once. A few milliseconds;
+// VulkanContext does it when it creates the device if VulkanContextCreateInfo::measureBandwidth is set.
+MemoryBandwidth measureMemoryBandwidth(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, std::uint32_t family);
+// What findMemoryType() ranks by from now on. One device per process, like vkd.
+void setMemoryBandwidth(const MemoryBandwidth& bandwidth);
+
+// Memory for buffer, bound at offset 0. With Vulkan 1.1 the driver's VkMemoryDedicatedRequirements
+// decide whether the buffer gets a dedicated allocation; it asks for one where that lets it compress
+// or place the buffer better. dedicated (optional) reports the choice.
+VkDeviceMemory allocateBufferMemory(VkPhysicalDevice physicalDevice, VkDevice device, VkBuffer buffer,
+                                    VkMemoryPropertyFlags properties, bool* dedicated = nullptr);
+
+// name labels the buffer and its memory for debug tools (see VulkanDebug.hpp).
+Buffer createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size,
+                    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char* name = nullptr);
+void destroyBuffer(VkDevice device, Buffer& buffer);
+
+// One mip level and layer, optimal tiling, starting in VK_IMAGE_LAYOUT_UNDEFINED. Depth formats get
+// a depth-aspect view. Transient attachments (VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) go to lazily
+// allocated memory when the device has it. Render targets usually come out dedicated (see
+// allocateBufferMemory()).
+Image createImage(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format,
+                  VkImageUsageFlags usage, const char* name = nullptr);
+void destroyImage(VkDevice device, Image& image);
+
+// How data the CPU writes every frame reaches the GPU. With resizable BAR (or unified memory on
+// integrated GPUs) a DEVICE_LOCAL | HOST_VISIBLE heap well beyond the classic 256 MiB window is
+// open to the CPU, and writing straight into it saves a staging copy per frame.
+struct UploadPath {
+    bool hostVisibleDeviceLocal = false; // Such a heap exists; from findUploadPath().
+    VkDeviceSize heapSize = 0;
+    std::uint32_t memoryTypeIndex = 0;   // That heap's memory type; direct dynamic buffers go there.
+    double directGBps = 0; // Write-combined CPU writes into that heap; from measureUploadPath().
+    double stagedGBps = 0; // CPU writes into host memory plus the GPU copy into device-local memory.
+    bool direct = false;   // Dynamic buffers are written in place rather than staged.
+};
+
+// Looks at the memory heaps only, so it works before there is a device. direct starts out as
+// hostVisibleDeviceLocal.
+UploadPath findUploadPath(VkPhysicalDevice physicalDevice);
+// Times both routes with size-byte uploads on queue (of family, which needs timestamps) and keeps
+// direct only when writing in place is at least as fast. Does nothing without the heap.
+void measureUploadPath(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, std::uint32_t family,
+                       UploadPath& path, VkDeviceSize size = 4ull << 20);
+// What createDynamicBuffer() routes by from now on; staged until set. VulkanContext sets it, measured
+// when asked to (VulkanContextCreateInfo::measureUploads).
+void setUploadPath(const UploadPath& path);
+
+// A buffer the CPU rewrites every frame and shaders read. Written in place when the upload path is
+// direct and its memory type takes the usage; otherwise through a host-visible staging buffer that
+// recordDynamicUpload() copies from.
+struct DynamicBuffer {
+    Buffer buffer;  // What shaders bind.
+    Buffer staging; // Null when written in place.
+    void* mapped = nullptr;
+};
+
+// usage is what shaders need; the transfer bits are added when staged.
+DynamicBuffer createDynamicBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size,
+                                  VkBufferUsageFlags usage, const char* name = nullptr);
+// Makes the first size bytes written through mapped available to dstStage/dstAccess. Staged, that is
+// a copy and a barrier; in place it records nothing, since submission makes host writes visible.
+void recordDynamicUpload(VkCommandBuffer commandBuffer, const DynamicBuffer& buffer, VkDeviceSize size,
+                         VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+void destroyDynamicBuffer(VkDevice device, DynamicBuffer& buffer);
+
+#endif /* VulkanMemory_hpp */
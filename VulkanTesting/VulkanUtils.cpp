@@ -0,0 +1,46 @@
+#include "VulkanUtils.hpp"
+#include "VulkanDispatch.hpp"
+
+#include <fstream>
+#include <iterator>
+
+std::vector<char> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+VkShaderModule createShaderModule(VkDevice device, const std::string& path) {
+    auto code = readFile(path);
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const std::uint32_t*>(code.data());
+    VkShaderModule module;
+    if (vkd.vkCreateShaderModule(device, &moduleInfo, nullptr, &module) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module from " + path + "!");
+    }
+    return module;
+}
+
+VkPipeline createComputePipeline(VkDevice device, VkShaderModule module, VkPipelineLayout layout,
+                                 const VkSpecializationInfo* specialization, VkPipelineShaderStageCreateFlags stageFlags,
+                                 const void* stageNext) {
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.pNext = stageNext;
+    pipelineInfo.stage.flags = stageFlags;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = specialization;
+    pipelineInfo.layout = layout;
+    VkPipeline pipeline;
+    if (vkd.vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+    return pipeline;
+}
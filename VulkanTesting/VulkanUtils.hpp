@@ -0,0 +1,51 @@
+#ifndef VulkanUtils_hpp
+#define VulkanUtils_hpp
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Helper function to call Vulkan extension functions.
+// !!! Argument list is NOT checked for correctness. !!!
+// R = return type of function
+// S = function pointer type for fx being called
+// name = name of function to be called
+template<typename R, typename S, typename... Args>
+R callVKfx(const char* name, VkInstance instance, Args... args) {
+    //auto func = (R(*)(VkInstance, Args...)) vkGetInstanceProcAddr(instance, name);
+    auto func = (S) vkGetInstanceProcAddr(instance, name);
+    if (func != nullptr) {
+        return func(instance, args...);
+    } else {
+        throw std::runtime_error("VK_ERROR_EXTENSION_NOT_PRESENT");
+    }
+}
+
+// Does the thing where you call a Vulkan function first to figure out how big the output is, then call it again to fill a vector.
+// F is deduced rather than spelled out as void(*)(Args..., uint32_t*, S*): a pack that isn't last can't be
+// deduced, which clang tolerates and GCC rejects.
+template<typename S, typename F, typename... Args>
+std::vector<S> getVkVector(F fx, Args... args) {
+    std::uint32_t count = 0;
+    fx(args..., &count, nullptr);
+    std::vector<S> result(count);
+    fx(args..., &count, result.data());
+    return result;
+}
+
+// Reads a whole file, e.g. SPIR-V. Throws when it can't be opened.
+std::vector<char> readFile(const std::string& path);
+
+// A shader module from a SPIR-V file, created through vkd so GpuCapture sees it.
+VkShaderModule createShaderModule(VkDevice device, const std::string& path);
+
+// A compute pipeline running module's main(), created through vkd. The optional stage flags and pNext
+// chain are for things like a required subgroup size.
+VkPipeline createComputePipeline(VkDevice device, VkShaderModule module, VkPipelineLayout layout,
+                                 const VkSpecializationInfo* specialization = nullptr,
+                                 VkPipelineShaderStageCreateFlags stageFlags = 0, const void* stageNext = nullptr);
+
+#endif /* VulkanUtils_hpp */
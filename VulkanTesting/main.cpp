@@ -1,351 +1,401 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "AppConfig.hpp"
+#include "GpuCapture.hpp"
+#include "Profiler.hpp"
+#include "VulkanContext.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDispatch.hpp"
+
 #include <iostream>
 #include <stdexcept>
 #include <functional>
 #include <cstdlib>
 #include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <memory>
 
-const int WIDTH = 800;
-const int HEIGHT = 600;
+// Render extents are multiples of this, for tile and compute-group alignment, and never smaller.
+const std::uint32_t RENDER_ALIGNMENT = 8;
 
-const std::vector<const char*> validationLayers = {
-    "VK_LAYER_KHRONOS_validation"
+// Picks the internal render resolution each frame so that frame time stays near a target.
+// The render target is allocated once at maxScale of the window size; changing the scale only
+// changes the viewport/scissor used for rendering and the source rect of the final upscale blit,
+// so no Vulkan objects have to be recreated when the scale moves.
+struct DynamicResolutionScaler {
+    double targetFrameMs = 1000.0 / 60.0;
+    double minScale = 0.5;
+    double maxScale = 1.0;
+    double scale = 1.0;
+    double smoothedFrameMs = 0.0;
+    
+    // Feed the GPU time of the last finished frame: that is what the render scale changes. Returns
+    // true when the render extent changed.
+    bool update(double frameMs) {
+        // Exponential moving average so a single spike doesn't cause a resolution jump.
+        smoothedFrameMs = smoothedFrameMs == 0.0 ? frameMs : smoothedFrameMs * 0.9 + frameMs * 0.1;
+        
+        // Dead zone of +-5% around the target to avoid oscillating every frame.
+        double ratio = targetFrameMs / smoothedFrameMs;
+        if (ratio > 0.95 && ratio < 1.05) {
+            return false;
+        }
+        // Pixel cost scales with area, so the linear scale moves with the square root of the ratio.
+        // Step size is limited to keep changes invisible.
+        double wanted = scale * std::sqrt(ratio);
+        wanted = std::max(scale - 0.05, std::min(scale + 0.05, wanted));
+        wanted = std::max(minScale, std::min(maxScale, wanted));
+        if (std::fabs(wanted - scale) < 0.01) {
+            return false;
+        }
+        scale = wanted;
+        return true;
+    }
+    
+    // Internal render size for a given window size, rounded down to RENDER_ALIGNMENT.
+    VkExtent2D renderExtent(VkExtent2D windowExtent) const {
+        auto scaled = [this](std::uint32_t v) {
+            std::uint32_t s = static_cast<std::uint32_t>(v * scale) & ~(RENDER_ALIGNMENT - 1);
+            return std::max(s, RENDER_ALIGNMENT);
+        };
+        return { scaled(windowExtent.width), scaled(windowExtent.height) };
+    }
 };
 
-#ifdef NDEBUG
-const bool enableValidationLayers = false;
-#else
-const bool enableValidationLayers = true;
-#endif
+// Brackets each frame's work on the graphics queue with a pair of timestamps. There is one slot per
+// frame in flight, read back when it comes round again, so the CPU never waits for a query and the
+// time reported is that many frames old.
+class GpuFrameTimer {
+public:
+    GpuFrameTimer(const VulkanContext& context, std::uint32_t framesInFlight)
+        : device(context.device()), queue(context.graphicsQueue()), slots(framesInFlight) {
+        std::uint32_t family = context.queueFamilies().graphicsFamily;
+        auto families = getVkVector<VkQueueFamilyProperties>(vkGetPhysicalDeviceQueueFamilyProperties, context.physicalDevice());
+        std::uint32_t validBits = families[family].timestampValidBits;
+        if (validBits == 0) {
+            return;
+        }
+        timestampMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(context.physicalDevice(), &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = family;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame command pool!");
+        }
+        setObjectName(device, commandPool, "frame command pool");
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2 * framesInFlight;
+        if (vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame timestamps!");
+        }
+        setObjectName(device, queryPool, "frame timestamps");
+        for (Slot& slot : slots) {
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkd.vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate frame command buffer!");
+            }
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(device, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create frame fence!");
+            }
+        }
+    }
 
-// Helper function to call Vulkan extension functions.
-// !!! Argument list is NOT checked for correctness. !!!
-// R = return type of function
-// S = function pointer type for fx being called
-// name = name of function to be called
-template<typename R, typename S, typename... Args>
-R callVKfx(const char* name, VkInstance instance, Args... args) {
-    //auto func = (R(*)(VkInstance, Args...)) vkGetInstanceProcAddr(instance, name);
-    auto func = (S) vkGetInstanceProcAddr(instance, name);
-    if (func != nullptr) {
-        return func(instance, args...);
-    } else {
-        throw std::runtime_error("VK_ERROR_EXTENSION_NOT_PRESENT");
+    ~GpuFrameTimer() {
+        // Only fences of submitted frames will ever signal.
+        for (Slot& slot : slots) {
+            if (slot.pending) {
+                vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            }
+            if (slot.fence != VK_NULL_HANDLE) {
+                vkDestroyFence(device, slot.fence, nullptr);
+            }
+        }
+        if (queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, queryPool, nullptr);
+        if (commandPool != VK_NULL_HANDLE) vkd.vkDestroyCommandPool(device, commandPool, nullptr);
     }
-}
 
-// Does the thing where you call a Vulkan function first to figure out how big the output is, then call it again to fill a vector.
-template<typename S, typename... Args>
-std::vector<S> getVkVector(void (*fx)(Args..., std::uint32_t*, S*), Args... args) {
-    std::uint32_t count = 0;
-    fx(args..., &count, nullptr);
-    std::vector<S> result(count);
-    fx(args..., &count, result.data());
-    return result;
-}
+    GpuFrameTimer(const GpuFrameTimer&) = delete;
+    GpuFrameTimer& operator=(const GpuFrameTimer&) = delete;
+
+    // False when the graphics queue has no timestamps; then begin() and end() must not be called.
+    bool available() const { return queryPool != VK_NULL_HANDLE; }
+
+    // Waits for the frame that last used the slot, reads its time and returns the slot's command
+    // buffer, begun, with the start timestamp written. The frame's GPU work goes after it.
+    VkCommandBuffer begin() {
+        Slot& slot = slots[current];
+        if (slot.pending) {
+            vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            slot.pending = false;
+            std::uint64_t ticks[2];
+            if (vkGetQueryPoolResults(device, queryPool, 2 * current, 2, sizeof(ticks), ticks, sizeof(std::uint64_t),
+                                      VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                lastMs = ((ticks[1] - ticks[0]) & timestampMask) * timestampPeriod / 1e6;
+            }
+        }
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkd.vkBeginCommandBuffer(slot.commandBuffer, &beginInfo);
+        vkd.vkCmdResetQueryPool(slot.commandBuffer, queryPool, 2 * current, 2);
+        vkd.vkCmdWriteTimestamp(slot.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * current);
+        return slot.commandBuffer;
+    }
 
-struct QueueFamilyIndices {
-    bool indexFound;
-    std::uint32_t graphicsFamily;
+    // Writes the end timestamp and submits the slot's command buffer to the graphics queue.
+    void end() {
+        Slot& slot = slots[current];
+        vkd.vkCmdWriteTimestamp(slot.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * current + 1);
+        vkEndCommandBuffer(slot.commandBuffer);
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &slot.commandBuffer;
+        // Reset only now, so a fence is unsignaled only while its frame is in flight.
+        vkResetFences(device, 1, &slot.fence);
+        if (vkd.vkQueueSubmit(queue, 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit frame!");
+        }
+        slot.pending = true;
+        current = (current + 1) % static_cast<std::uint32_t>(slots.size());
+    }
+
+    // GPU time of the newest frame read back, in milliseconds. Negative until the first one is.
+    double lastFrameMs() const { return lastMs; }
+
+private:
+    struct Slot {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        bool pending = false; // Submitted and not yet waited for.
+    };
+
+    VkDevice device;
+    VkQueue queue;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE; // Null when the graphics queue has no timestamps.
+    double timestampPeriod = 0; // Nanoseconds per tick.
+    std::uint64_t timestampMask = 0; // The queue family's timestampValidBits.
+    std::vector<Slot> slots;
+    std::uint32_t current = 0;
+    double lastMs = -1;
 };
 
 class HelloTriangleApplication {
 public:
+    explicit HelloTriangleApplication(const AppConfig& config = AppConfig())
+        : config(config), windowExtent{static_cast<std::uint32_t>(config.width), static_cast<std::uint32_t>(config.height)} {
+        resolutionScaler.targetFrameMs = config.targetFrameMs;
+        resolutionScaler.minScale = config.minRenderScale;
+    }
+    
     void run() {
+        if (!config.profilePath.empty()) {
+            Profiler::setThreadName("main");
+            Profiler::start();
+        }
         initWindow();
         initVulkan();
         mainLoop();
         cleanup();
+        if (!config.profilePath.empty()) {
+            Profiler::stop();
+            Profiler::writeTrace(config.profilePath);
+            if (Profiler::droppedZones() > 0) {
+                std::cerr << "profiler dropped " << Profiler::droppedZones() << " zones" << std::endl;
+            }
+        }
     }
     
 private:
-    GLFWwindow* window;  // GLFW window.
-    VkInstance instance; // Vulkan instance.
-    VkDebugUtilsMessengerEXT debugMessenger; // Debug messenger object.
-    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-    VkDevice device; // "Logical" device
-    VkQueue graphicsQueue; // Graphics queue
+    AppConfig config;
+    GLFWwindow* window = nullptr;  // GLFW window. Stays null in headless mode.
+    std::unique_ptr<VulkanContext> context; // Instance, device and queues.
+    std::unique_ptr<GpuCapture> capture; // Only with --capture.
+    std::unique_ptr<GpuFrameTimer> frameTimer; // Feeds the scaler; only with dynamic resolution.
+    
+    VkExtent2D windowExtent; // Current framebuffer size of the window.
+    VkExtent2D renderExtent; // Internal render size chosen by the scaler.
+    bool framebufferResized = false; // Set by the GLFW callback, consumed by the main loop.
+    DynamicResolutionScaler resolutionScaler;
 
     void initWindow() {
+        VT_FUNCTION_ZONE();
+        renderExtent = resolutionScaler.renderExtent(windowExtent);
+        if (config.mode == RunMode::Headless) {
+            return;
+        }
         glfwInit(); // Initialize GLFW
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-        window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+        window = glfwCreateWindow(static_cast<int>(windowExtent.width), static_cast<int>(windowExtent.height), "Vulkan", nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
     }
     
-    void initVulkan() {
-        createInstance();
-        setupDebugMessenger();
-        pickPhysicalDevice();
-        createLogicalDevice();
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->framebufferResized = true;
     }
     
-    void createLogicalDevice() {
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-        
-        // Queue setup.
-        VkDeviceQueueCreateInfo queueCreateInfo = {};
-        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfo.queueFamilyIndex = indices.graphicsFamily;
-        queueCreateInfo.queueCount = 1;
-        float queuePriority = 1.0f;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
-        
-        // Leaving all values as VK_FALSE
-        VkPhysicalDeviceFeatures deviceFeatures = {};
-        
-        VkDeviceCreateInfo createInfo = {};
-        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        createInfo.pQueueCreateInfos = &queueCreateInfo;
-        createInfo.queueCreateInfoCount = 1;
-        createInfo.pEnabledFeatures = &deviceFeatures;
-        
-        createInfo.enabledExtensionCount = 0;
-        if (enableValidationLayers) {
-            createInfo.enabledLayerCount = static_cast<std::uint32_t>(validationLayers.size());
-            createInfo.ppEnabledLayerNames = validationLayers.data();
-        } else {
-            createInfo.enabledLayerCount = 0;
+    // Called from the main loop rather than the callback so that resizes are handled once per frame,
+    // no matter how many resize events GLFW delivered.
+    void handleResize() {
+        VT_FUNCTION_ZONE();
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        // Minimized: nothing to render into, wait until we're visible again or closed.
+        while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+            glfwWaitEvents();
+            glfwGetFramebufferSize(window, &width, &height);
         }
-        if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create logical device!");
+        framebufferResized = false;
+        if (width == 0 || height == 0) {
+            return; // Closed while minimized; keepRunning() ends the loop.
         }
-        vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
+        windowExtent = { static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height) };
+        renderExtent = resolutionScaler.renderExtent(windowExtent);
     }
-
-    void pickPhysicalDevice() {
-        std::uint32_t deviceCount = 0;
-        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
-        if (deviceCount == 0) {
-            throw std::runtime_error("Failed to find GPUs with Vulkan support! Get a better computer LOSER!!!");
+    
+    void initVulkan() {
+        VT_FUNCTION_ZONE();
+        VulkanContextCreateInfo info;
+        info.validation = config.validation;
+        info.verbose = config.verbose;
+        info.device = config.device;
+        // Ask GLFW for needed extensions. Headless runs have no surface, so need none.
+        if (window != nullptr) {
+            std::uint32_t extensionCount = 0;
+            const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&extensionCount);
+            info.instanceExtensions.assign(glfwExtensions, glfwExtensions + extensionCount);
         }
-        std::vector<VkPhysicalDevice> devices(deviceCount);
-        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
-        
-        double score = 0;
-        for (const auto& device : devices) {
-            double devScore = deviceScore(device);
-            if (devScore > score) {
-                physicalDevice = device;
-                score = devScore;
-            }
+        context.reset(new VulkanContext(info));
+        // Right after the device, so every resource the app creates is known to the capture.
+        if (!config.capturePath.empty()) {
+            VT_ZONE("start capture");
+            capture.reset(new GpuCapture(*context, config.capturePath, config.captureFirstFrame, config.captureFrameCount));
         }
-        
-        if (physicalDevice == VK_NULL_HANDLE) {
-            throw std::runtime_error("failed to find a suitable GPU!");
-        } else {
-            VkPhysicalDeviceProperties deviceProperties;
-            vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
-            std::cout << "Using GPU: " << deviceProperties.deviceName << std::endl;
+        if (config.dynamicResolution) {
+            frameTimer.reset(new GpuFrameTimer(*context, config.framesInFlight));
+            if (!frameTimer->available()) {
+                std::cerr << "No timestamps on the graphics queue: dynamic resolution stays at scale "
+                          << resolutionScaler.scale << "." << std::endl;
+                frameTimer.reset();
+            }
         }
     }
     
-    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
-        QueueFamilyIndices indices{false, 0};
-//        std::uint32_t queueFamilyCount = 0;
-//        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-        auto queueFamilies = getVkVector<VkQueueFamilyProperties>(vkGetPhysicalDeviceQueueFamilyProperties, device);
-        
-        int i = 0;
-        for (const auto& queueFamily : queueFamilies) {
-            if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                indices.graphicsFamily = i;
-                indices.indexFound = true;
-            }
-            
-            if (indices.indexFound) {
-                break;
-            }
-            
-            i++;
+    // Windowed runs until the window closes; headless and benchmark runs stop after config.frameCount frames.
+    bool keepRunning(std::uint32_t frame) {
+        if (config.mode != RunMode::Windowed && frame >= config.frameCount) {
+            return false;
         }
-        
-        return indices;
+        return window == nullptr || !glfwWindowShouldClose(window);
     }
     
-    double deviceScore(VkPhysicalDevice device) {
-        double score = 0;
-        VkPhysicalDeviceProperties deviceProperties;
-        VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceProperties(device, &deviceProperties);
-        vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-        
-        std::cout << deviceProperties.deviceName << ": ";
-        
-        score += deviceProperties.limits.maxImageDimension2D;
-        score += deviceProperties.limits.maxImageDimension3D;
-
-        // Example of required feature support.
-        // if (!deviceFeatures.tessellationShader) {
-        //       score = -1;
-        // }
-        
-        QueueFamilyIndices indices = findQueueFamilies(device);
-        if (!indices.indexFound) {
-            score = -1;
+    void mainLoop() {
+        VT_FUNCTION_ZONE();
+        std::vector<double> frameTimes;
+        if (config.mode == RunMode::Benchmark) {
+            frameTimes.reserve(config.frameCount);
         }
-        
-        std::cout << score << std::endl;
-        return score;
-    }
-
-    void createInstance() {
-        // Enumerate available extensions.
-        uint32_t extensionCount = 0;
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
-        std::vector<VkExtensionProperties> extensions(extensionCount);
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+        auto lastFrame = std::chrono::steady_clock::now();
+        for (std::uint32_t frame = 0; keepRunning(frame); frame++) {
+            VT_ZONE("frame");
+            if (window != nullptr) {
+                VT_ZONE("poll events");
+                glfwPollEvents();
+                if (framebufferResized) {
+                    handleResize();
+                }
+            }
+            
+            if (frameTimer) {
+                VT_ZONE("submit frame");
+                frameTimer->begin();
+                // The frame's rendering is recorded here, at renderExtent.
+                frameTimer->end();
+            }
 
-        // Print the extensions.
-        std::cout << "Available extensions:" << std::endl;
-        for (const auto& extension : extensions) {
-            std::cout << extension.extensionName << std::endl;
-        }
-        
-        // App info for instance.
-        VkApplicationInfo appInfo = {};
-        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-        appInfo.pApplicationName = "Hello Triangle";
-        appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.pEngineName = "No Engine";
-        appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
-        
-        // Instance creation info.
-        VkInstanceCreateInfo createInfo = {};
-        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-        createInfo.pApplicationInfo = &appInfo;
-        
-        // Query for extensions we need.
-        auto reqExtensions = getRequiredExtensions();
-        
-        // Check that GLFW requested extensions are available.
-        std::cout << "Requested extensions:" << std::endl;
-        for (auto reqExtension : reqExtensions) {
-            std::cout << reqExtension << "... ";
-            bool isPresent = false;
-            for (const auto& extension : extensions) {
-                if (std::strcmp(extension.extensionName, reqExtension)) {
-                    isPresent = true;
-                    break;
-                };
+            auto now = std::chrono::steady_clock::now();
+            double frameMs = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+            lastFrame = now;
+            if (config.mode == RunMode::Benchmark && frame > 0) {
+                frameTimes.push_back(frameMs);
+            }
+            // The scaler only changes GPU work, so it runs on GPU time, once a frame has been timed.
+            if (frameTimer && frameTimer->lastFrameMs() >= 0 && resolutionScaler.update(frameTimer->lastFrameMs())) {
+                renderExtent = resolutionScaler.renderExtent(windowExtent);
+            }
+            if (capture) {
+                capture->frameBoundary();
+            }
+            // Drain the per-thread rings once a frame so they never fill up.
+            if (Profiler::enabled()) {
+                Profiler::collect();
             }
-            std::cout << (isPresent ? "present." : "not available.") << std::endl;
-        }
-        
-        // Enable requested extensions when creating instance.
-        createInfo.enabledExtensionCount = static_cast<std::uint32_t>(reqExtensions.size());
-        createInfo.ppEnabledExtensionNames = reqExtensions.data();
-        
-        // Check for validation layers if in debug mode.
-        if (enableValidationLayers && !checkValidationLayerSupport()) {
-            throw std::runtime_error("Validation layers requested, but not available!");
-        }
-        
-        // Not enabling any validation layers.
-        if (enableValidationLayers) {
-            createInfo.enabledLayerCount = static_cast<std::uint32_t>(validationLayers.size());
-            createInfo.ppEnabledLayerNames = validationLayers.data();
-        } else {
-            createInfo.enabledLayerCount = 0;
         }
-        // Finally create the instance using the standard allocator.
-        if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create instance.");
+        if (config.mode == RunMode::Benchmark) {
+            printFrameStatistics(frameTimes);
         }
     }
     
-    bool checkValidationLayerSupport() {
-        std::uint32_t layerCount;
-        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-        std::vector<VkLayerProperties> availableLayers(layerCount);
-        vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-        bool allLayersAvailable = true;
-
-        std::cout << "Requested validation layer:" << std::endl;
-        for (const auto& requestedLayer : validationLayers) {
-            std::cout << requestedLayer << "... ";
-            bool isPresent = false;
-            for (const auto& availableLayer : availableLayers) {
-                if (std::strcmp(availableLayer.layerName, requestedLayer)) {
-                    isPresent = true;
-                    break;
-                };
-            }
-            std::cout << (isPresent ? "present." : "not available.") << std::endl;
-            allLayersAvailable &= isPresent;
+    // One key=value line so that sweep scripts can grep it.
+    void printFrameStatistics(std::vector<double> frameTimes) {
+        if (frameTimes.empty()) {
+            return;
         }
-        
-        return allLayersAvailable;
-    }
-    
-    std::vector<const char*> getRequiredExtensions() {
-        std::uint32_t extensionCount = 0;
-        
-        // Ask GLFW for needed extensions.
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&extensionCount);
-        
-        // Convert GLFW extension list to a vector.
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + extensionCount);
-        
-        // If in debug, add extensions for debug layer callbacks.
-        if (enableValidationLayers) {
-            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        std::sort(frameTimes.begin(), frameTimes.end());
+        double total = 0;
+        for (double t : frameTimes) {
+            total += t;
         }
-        
-        return extensions;
-    }
-    
-    void setupDebugMessenger() {
-        if (!enableValidationLayers) return;
-        VkDebugUtilsMessengerCreateInfoEXT createInfo = {};
-        createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-        createInfo.messageSeverity =
-           VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-           VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-           VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-        createInfo.messageType =
-           VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
-           VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-           VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-        createInfo.pfnUserCallback = debugCallback;
-        createInfo.pUserData = nullptr;
-        if (callVKfx<VkResult, PFN_vkCreateDebugUtilsMessengerEXT>("vkCreateDebugUtilsMessengerEXT", instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
-            throw std::runtime_error("failed to set up debug messenger!");
+        auto percentile = [&](double p) {
+            return frameTimes[static_cast<std::size_t>(p * (frameTimes.size() - 1))];
         };
-    }
-    
-    static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-                      VkDebugUtilsMessageTypeFlagsEXT messageType,
-                      const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-                      void* pUserData) {
-        std::cerr << "Validation later: " << pCallbackData->pMessage << std::endl;
-        return VK_FALSE;
-    }
-    
-    void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
-        }
+        std::cout << "benchmark frames=" << frameTimes.size()
+                  << " avg_ms=" << total / frameTimes.size()
+                  << " p50_ms=" << percentile(0.5)
+                  << " p99_ms=" << percentile(0.99)
+                  << " max_ms=" << frameTimes.back()
+                  << " render_scale=" << resolutionScaler.scale << std::endl;
     }
     
     void cleanup() {
-        // DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
-        vkDestroyDevice(device, nullptr);
-        callVKfx<void, PFN_vkDestroyDebugUtilsMessengerEXT>("vkDestroyDebugUtilsMessengerEXT", instance, debugMessenger, nullptr);
-        vkDestroyInstance(instance, nullptr);
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        VT_FUNCTION_ZONE();
+        frameTimer.reset();
+        capture.reset();
+        context.reset();
+        if (window != nullptr) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 };
 
-int main() {
-    HelloTriangleApplication app;
-    
+int main(int argc, char** argv) {
     try {
+        AppConfig config;
+        if (!config.parseCommandLine(argc, argv)) {
+            return EXIT_SUCCESS;
+        }
+        HelloTriangleApplication app(config);
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
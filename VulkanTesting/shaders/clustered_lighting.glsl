@@ -0,0 +1,84 @@
+// Clustered forward lighting, shared by light_cluster.comp (builds the grid) and every shader that
+// shades with it. See ClusteredLighting.hpp for the C++ side.
+//
+// The view frustum is cut into tilesX * tilesY screen tiles and `slices` depth slices spaced
+// exponentially between near and far, so clusters stay roughly cube shaped. Each cluster owns
+// maxLightsPerCluster slots in lightIndices; clusterCounts may exceed that when a cluster overflows,
+// so readers clamp.
+//
+// Include with CLUSTER_SET defined to move the bindings to another descriptor set, and with
+// CLUSTER_BUILD defined to make the grid writable.
+
+#ifndef CLUSTER_SET
+#define CLUSTER_SET 0
+#endif
+
+#ifdef CLUSTER_BUILD
+#define CLUSTER_ACCESS
+#else
+#define CLUSTER_ACCESS readonly
+#endif
+
+// Mirrors PointLight in ClusteredLighting.hpp.
+struct PointLight {
+    vec3 position; // World space.
+    float radius;  // Influence reaches zero here.
+    vec3 color;
+    float intensity;
+};
+
+// Mirrors ClusterParams in ClusteredLighting.hpp.
+struct ClusterParams {
+    vec4 frustum; // tan(fovX / 2), tan(fovY / 2), near, far
+    uvec4 grid;   // tiles x, tiles y, depth slices, max lights per cluster
+};
+
+layout(std430, set = CLUSTER_SET, binding = 0) readonly buffer Lights { PointLight lights[]; };
+layout(std430, set = CLUSTER_SET, binding = 1) CLUSTER_ACCESS buffer ViewLights { vec4 viewLights[]; }; // View-space center, radius.
+layout(std430, set = CLUSTER_SET, binding = 2) CLUSTER_ACCESS buffer ClusterCounts { uint clusterCounts[]; };
+layout(std430, set = CLUSTER_SET, binding = 3) CLUSTER_ACCESS buffer LightIndices { uint lightIndices[]; };
+
+// View depth (positive distance in front of the camera) where a slice starts.
+float clusterSliceDepth(ClusterParams p, float slice) {
+    return p.frustum.z * pow(p.frustum.w / p.frustum.z, slice / float(p.grid.z));
+}
+
+int clusterSlice(ClusterParams p, float depth) {
+    return int(floor(log(depth / p.frustum.z) / log(p.frustum.w / p.frustum.z) * float(p.grid.z)));
+}
+
+// uv spans the screen from 0 to 1 with y pointing down.
+uint clusterIndex(ClusterParams p, vec2 uv, float depth) {
+    ivec3 cell = ivec3(ivec2(uv * vec2(p.grid.xy)), clusterSlice(p, depth));
+    uvec3 c = uvec3(clamp(cell, ivec3(0), ivec3(p.grid.xyz) - 1));
+    return (c.z * p.grid.y + c.y) * p.grid.x + c.x;
+}
+
+// Smooth window so a light's contribution reaches exactly zero at its radius, which is what makes
+// binning by radius exact.
+float lightAttenuation(float dist, float radius) {
+    float x = dist / radius;
+    float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return window * window / (dist * dist + 1.0);
+}
+
+// Diffuse term of one light. viewPos and normal are in view space.
+vec3 pointLightContribution(uint light, vec3 viewPos, vec3 normal) {
+    vec4 sphere = viewLights[light];
+    vec3 toLight = sphere.xyz - viewPos;
+    float dist = length(toLight);
+    float nDotL = max(dot(normal, toLight / max(dist, 1e-4)), 0.0);
+    return lights[light].color * (lights[light].intensity * nDotL * lightAttenuation(dist, sphere.w));
+}
+
+// Lighting from the lights binned into the cluster that contains viewPos.
+vec3 clusteredLighting(ClusterParams p, vec2 uv, vec3 viewPos, vec3 normal) {
+    uint cluster = clusterIndex(p, uv, -viewPos.z);
+    uint lightCount = min(clusterCounts[cluster], p.grid.w);
+    uint base = cluster * p.grid.w;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < lightCount; i++) {
+        result += pointLightContribution(lightIndices[base + i], viewPos, normal);
+    }
+    return result;
+}
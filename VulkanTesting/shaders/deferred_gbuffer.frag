@@ -0,0 +1,14 @@
+#version 450
+
+layout(location = 0) in vec3 albedo;
+layout(location = 1) in vec2 local;
+
+layout(location = 0) out vec4 albedoOutput;
+layout(location = 1) out vec4 normalOutput;
+
+void main() {
+    // A rounded bump, so that the lighting has some shape to work with.
+    vec3 normal = normalize(vec3(local * 0.8, 1.0));
+    albedoOutput = vec4(albedo, 1.0);
+    normalOutput = vec4(normal, 0.0);
+}
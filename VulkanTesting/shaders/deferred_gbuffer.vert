@@ -0,0 +1,32 @@
+#version 450
+
+// G-buffer pass of render_pass_bench: instanced screen-space quads at pseudo-random depths, placed
+// from gl_InstanceIndex alone so that the benchmark needs no vertex buffers. The overlap gives the
+// depth test and the G-buffer writes something to do.
+
+layout(push_constant) uniform Push {
+    float aspect; // Width over height.
+    float time;
+} push;
+
+layout(location = 0) out vec3 albedo;
+layout(location = 1) out vec2 local;
+
+vec3 hash3(uint n) {
+    n = (n << 13u) ^ n;
+    n = n * (n * n * 15731u + 789221u) + 1376312589u;
+    uvec3 k = n * uvec3(n, n * 16807u, n * 48271u);
+    return vec3(k & uvec3(0x7fffffffu)) / float(0x7fffffff);
+}
+
+void main() {
+    const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+                                   vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+    vec2 corner = corners[gl_VertexIndex];
+    vec3 h = hash3(uint(gl_InstanceIndex));
+    vec2 center = h.xy * 2.0 - 1.0 + 0.05 * vec2(sin(push.time + h.z * 6.28), cos(push.time + h.x * 6.28));
+    float size = 0.03 + 0.12 * h.z;
+    gl_Position = vec4(center + corner * vec2(size / push.aspect, size), fract(h.x * 7.31 + h.y * 3.17), 1.0);
+    albedo = 0.2 + 0.8 * hash3(uint(gl_InstanceIndex) * 7u + 3u);
+    local = corner;
+}
@@ -0,0 +1,41 @@
+#version 450
+
+// Lighting pass of render_pass_bench. Reads the G-buffer through input attachments, so it only
+// ever sees its own pixel: that is what lets RenderGraph keep the G-buffer in tile memory when the
+// passes are merged into subpasses.
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput albedoInput;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput normalInput;
+layout(input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput depthInput;
+
+layout(push_constant) uniform Push {
+    float aspect;
+    float time;
+} push;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 color;
+
+const uint LIGHT_COUNT = 16u;
+
+void main() {
+    float depth = subpassLoad(depthInput).r;
+    if (depth >= 1.0) {
+        color = vec4(0.02, 0.02, 0.03, 1.0);
+        return;
+    }
+    vec3 albedo = subpassLoad(albedoInput).rgb;
+    vec3 normal = subpassLoad(normalInput).xyz;
+    vec3 position = vec3((uv * 2.0 - 1.0) * vec2(push.aspect, 1.0), depth);
+    vec3 lit = 0.05 * albedo;
+    for (uint i = 0u; i < LIGHT_COUNT; i++) {
+        float angle = push.time * 0.3 + float(i) * 0.3927;
+        float radius = 0.3 + 0.6 * fract(float(i) * 0.618);
+        vec3 lightPosition = vec3(cos(angle) * radius * push.aspect, sin(angle * 1.3) * radius, -0.4);
+        vec3 toLight = lightPosition - position;
+        float attenuation = 1.0 / (1.0 + 8.0 * dot(toLight, toLight));
+        vec3 lightColor = 0.5 + 0.5 * cos(vec3(0.0, 2.1, 4.2) + float(i));
+        lit += albedo * lightColor * max(dot(normal, normalize(toLight)), 0.0) * attenuation;
+    }
+    color = vec4(lit, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 450
+
+// Post pass of render_pass_bench: a small glow and a tonemap. It samples the lit image around each
+// pixel, so it needs the whole image and starts a new render pass.
+
+layout(set = 0, binding = 0) uniform sampler2D hdrInput;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 color;
+
+void main() {
+    vec2 texel = 1.0 / vec2(textureSize(hdrInput, 0));
+    vec3 center = texture(hdrInput, uv).rgb;
+    vec3 glow = vec3(0.0);
+    for (int i = 0; i < 8; i++) {
+        float angle = float(i) * 0.7854;
+        glow += texture(hdrInput, uv + 6.0 * texel * vec2(cos(angle), sin(angle))).rgb;
+    }
+    vec3 hdr = center + 0.05 * glow;
+    color = vec4(hdr / (1.0 + hdr), 1.0);
+}
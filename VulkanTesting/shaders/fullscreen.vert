@@ -0,0 +1,10 @@
+#version 450
+
+// One triangle covering the viewport; uv is 0..1 over the visible part.
+
+layout(location = 0) out vec2 uv;
+
+void main() {
+    uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
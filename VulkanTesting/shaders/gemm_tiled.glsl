@@ -0,0 +1,96 @@
+// Shared-memory tiled matrix multiply of TensorKernels, the core of gemm_tiled.comp and
+// conv2d_tiled.comp. A workgroup computes a TILE_M x TILE_N block of the M x N product of an M x K
+// and a K x N matrix. For every TILE_K slice of K it stages both operand blocks in shared memory (A
+// transposed, so both are read along M and N), then each invocation accumulates a THREAD_M x
+// THREAD_N block in registers. The block is strided by the workgroup size rather than contiguous, so
+// neighbouring invocations read neighbouring shared memory words and no two hit the same bank.
+//
+// The including shader defines, before the #include:
+//   float loadA(uint m, uint k), float loadB(uint k, uint n): an element, 0 outside the matrix.
+//   vec4 loadA4(uint m, uint k), vec4 loadB4(uint k, uint n): elements k..k+3 or n..n+3, only
+//     called with VEC4 set, which TensorKernels does when K and N are multiples of 4.
+//   void storeC(uint m, uint n, float sum): the epilogue, only called inside the M x N result.
+
+// Workgroup: (TILE_N / THREAD_N, TILE_M / THREAD_M). TensorKernels sets all of these per tuning.
+layout(local_size_x_id = 0, local_size_y_id = 1) in;
+layout(constant_id = 2) const uint TILE_M = 64;
+layout(constant_id = 3) const uint TILE_N = 64;
+layout(constant_id = 4) const uint TILE_K = 16; // A multiple of 4.
+layout(constant_id = 5) const uint THREAD_M = 4;
+layout(constant_id = 6) const uint THREAD_N = 4;
+layout(constant_id = 7) const bool VEC4 = false;
+
+shared float tileA[TILE_K * TILE_M]; // [k][m]
+shared float tileB[TILE_K * TILE_N]; // [k][n]
+
+void gemmTiled(uint M, uint N, uint K) {
+    uint threads = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+    uint row0 = gl_WorkGroupID.y * TILE_M;
+    uint column0 = gl_WorkGroupID.x * TILE_N;
+    float sum[THREAD_M * THREAD_N];
+    for (uint i = 0; i < THREAD_M * THREAD_N; i++) {
+        sum[i] = 0.0;
+    }
+
+    for (uint k0 = 0; k0 < K; k0 += TILE_K) {
+        if (VEC4) {
+            for (uint e = gl_LocalInvocationIndex; e < TILE_M * TILE_K / 4; e += threads) {
+                uint m = e / (TILE_K / 4);
+                uint k = e % (TILE_K / 4) * 4;
+                vec4 a = loadA4(row0 + m, k0 + k);
+                tileA[k * TILE_M + m] = a.x;
+                tileA[(k + 1) * TILE_M + m] = a.y;
+                tileA[(k + 2) * TILE_M + m] = a.z;
+                tileA[(k + 3) * TILE_M + m] = a.w;
+            }
+            for (uint e = gl_LocalInvocationIndex; e < TILE_K * TILE_N / 4; e += threads) {
+                uint k = e / (TILE_N / 4);
+                uint n = e % (TILE_N / 4) * 4;
+                vec4 b = loadB4(k0 + k, column0 + n);
+                tileB[k * TILE_N + n] = b.x;
+                tileB[k * TILE_N + n + 1] = b.y;
+                tileB[k * TILE_N + n + 2] = b.z;
+                tileB[k * TILE_N + n + 3] = b.w;
+            }
+        } else {
+            for (uint e = gl_LocalInvocationIndex; e < TILE_M * TILE_K; e += threads) {
+                uint m = e / TILE_K;
+                uint k = e % TILE_K;
+                tileA[k * TILE_M + m] = loadA(row0 + m, k0 + k);
+            }
+            for (uint e = gl_LocalInvocationIndex; e < TILE_K * TILE_N; e += threads) {
+                uint k = e / TILE_N;
+                uint n = e % TILE_N;
+                tileB[k * TILE_N + n] = loadB(k0 + k, column0 + n);
+            }
+        }
+        barrier();
+
+        for (uint k = 0; k < TILE_K; k++) {
+            float a[THREAD_M];
+            float b[THREAD_N];
+            for (uint i = 0; i < THREAD_M; i++) {
+                a[i] = tileA[k * TILE_M + gl_LocalInvocationID.y + i * gl_WorkGroupSize.y];
+            }
+            for (uint j = 0; j < THREAD_N; j++) {
+                b[j] = tileB[k * TILE_N + gl_LocalInvocationID.x + j * gl_WorkGroupSize.x];
+            }
+            for (uint i = 0; i < THREAD_M; i++) {
+                for (uint j = 0; j < THREAD_N; j++) {
+                    sum[i * THREAD_N + j] = fma(a[i], b[j], sum[i * THREAD_N + j]);
+                }
+            }
+        }
+        barrier();
+    }
+
+    for (uint i = 0; i < THREAD_M; i++) {
+        uint m = row0 + gl_LocalInvocationID.y + i * gl_WorkGroupSize.y;
+        for (uint j = 0; j < THREAD_N; j++) {
+            uint n = column0 + gl_LocalInvocationID.x + j * gl_WorkGroupSize.x;
+            if (m < M && n < N) {
+                storeC(m, n, sum[i * THREAD_N + j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,16 @@
+#version 450
+
+// Soft round sprite for particle.vert.
+
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 color;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float falloff = 1.0 - smoothstep(0.5, 1.0, length(corner));
+    if (falloff <= 0.0) {
+        discard;
+    }
+    outColor = vec4(color.rgb, color.a * falloff);
+}
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Camera-facing quads for ParticleSystem, instanced: instance i draws particle i of the buffer the
+// last simulate wrote. Hot and opaque at birth, cooling and fading out towards the end of life.
+
+#include "particles.glsl"
+
+layout(std430, set = 0, binding = 0) readonly buffer Particles { Particle particles[]; };
+
+layout(push_constant) uniform Push {
+    mat4 viewProj;
+    vec4 right; // xyz: camera right in world space, w: particle size.
+    vec4 up;    // xyz: camera up in world space.
+} push;
+
+layout(location = 0) out vec2 corner;
+layout(location = 1) out vec4 color;
+
+const vec2 corners[6] = vec2[](vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, -1), vec2(1, 1), vec2(-1, 1));
+
+void main() {
+    Particle p = particles[gl_InstanceIndex];
+    float age = clamp(1.0 - p.position.w / max(p.velocity.w, 1e-6), 0.0, 1.0);
+    corner = corners[gl_VertexIndex];
+    vec3 world = p.position.xyz + (corner.x * push.right.xyz + corner.y * push.up.xyz) * push.right.w;
+    gl_Position = push.viewProj * vec4(world, 1.0);
+    color = vec4(mix(vec3(1.0, 0.9, 0.5), vec3(0.6, 0.1, 0.05), age), 1.0 - age);
+}
@@ -0,0 +1,83 @@
+// GPU particles, shared by particle_emit.comp, particle_simulate.comp, particle_finalize.comp and
+// particle.vert. See ParticleSystem.hpp for the C++ side.
+//
+// Live particles are packed at the front of one of two buffers. Every frame simulate reads the
+// current buffer and appends the survivors to the other, emit appends new particles behind them,
+// and finalize turns the new count into the indirect arguments of the next simulate dispatch and of
+// the draw. Counts never leave the GPU except through the small stats block.
+//
+// Include with PARTICLE_COMPUTE defined for the compute bindings and push constants.
+
+struct Particle {
+    vec4 position; // xyz, w: seconds left to live.
+    vec4 velocity; // xyz per second, w: lifetime at birth.
+};
+
+#ifdef PARTICLE_COMPUTE
+
+#define PARTICLE_GROUP 256
+
+layout(std430, set = 0, binding = 0) readonly buffer Source { Particle source[]; };
+layout(std430, set = 0, binding = 1) buffer Destination { Particle destination[]; };
+// Mirrors the state layout in ParticleSystem.cpp; the indirect commands are read from there.
+layout(std430, set = 0, binding = 2) buffer State {
+    uint count[2];   // Live particles in buffer 0 and 1; the destination's grows during a frame.
+    uint dropped;    // Particles not emitted because the buffers were full, in total.
+    uint frame;
+    uvec4 dispatch;  // VkDispatchIndirectCommand of the next simulate, w unused.
+    uvec4 draw;      // VkDrawIndirectCommand of the draw.
+} state;
+// Host visible, written by finalize: live particles and dropped, for ParticleSystem::stats().
+layout(std430, set = 0, binding = 3) writeonly buffer Stats { uvec2 stats; };
+
+layout(push_constant) uniform Push {
+    vec4 gravity;   // xyz, w: drag, fraction of velocity lost per second.
+    vec4 origin;    // xyz, w: radius of the emission sphere.
+    vec4 direction; // xyz unit length, w: speed.
+    vec4 spread;    // x: cone jitter, y: speed jitter, z, w: lifetime range in seconds.
+    float dt;
+    float floorHeight;
+    float bounce;   // Velocity kept when bouncing off the floor.
+    uint emitCount;
+    uint seed;
+    uint capacity;  // Of each buffer.
+    uint current;   // Buffer simulate reads; the other one is written.
+} push;
+
+// Appends the invocations with append set to the destination, one global atomic per workgroup
+// rather than one per particle. Returns each appending invocation's index; the total may exceed
+// the capacity, finalize clamps it. Every invocation of the workgroup must call it.
+shared uint groupCount;
+shared uint groupBase;
+
+uint appendIndex(bool append) {
+    if (gl_LocalInvocationIndex == 0) {
+        groupCount = 0;
+    }
+    barrier();
+    uint slot = 0;
+    if (append) {
+        slot = atomicAdd(groupCount, 1u);
+    }
+    barrier();
+    if (gl_LocalInvocationIndex == 0 && groupCount > 0) {
+        groupBase = atomicAdd(state.count[1 - push.current], groupCount);
+    }
+    barrier();
+    return groupBase + slot;
+}
+
+#endif
+
+// PCG hash, for per-particle random numbers without state.
+uint particleHash(uint v) {
+    uint s = v * 747796405u + 2891336453u;
+    uint word = ((s >> ((s >> 28u) + 4u)) ^ s) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// 0..1.
+float particleRandom(inout uint seed) {
+    seed = particleHash(seed);
+    return float(seed) * (1.0 / 4294967296.0);
+}
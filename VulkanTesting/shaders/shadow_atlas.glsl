@@ -0,0 +1,54 @@
+// Sampling side of ShadowAtlas. Every shadowed light owns a contiguous range of views (1 for spot
+// lights, 6 cube faces for point lights, one per cascade for directional lights); see
+// ShadowAtlas::firstView() and viewCount().
+//
+// Include with SHADOW_SET defined to move the bindings to another descriptor set.
+
+#ifndef SHADOW_SET
+#define SHADOW_SET 1
+#endif
+
+// Mirrors ShadowViewGpu in ShadowAtlas.hpp.
+struct ShadowView {
+    mat4 viewProj;
+    vec4 atlasRect; // uv offset xy, uv scale zw.
+};
+
+layout(std430, set = SHADOW_SET, binding = 0) readonly buffer ShadowViews { ShadowView shadowViews[]; };
+layout(set = SHADOW_SET, binding = 1) uniform sampler2DShadow shadowAtlas;
+
+// Cube face for a vector from a point light to the shaded point, in ShadowAtlas face order.
+uint pointShadowFace(vec3 v) {
+    vec3 a = abs(v);
+    if (a.x >= a.y && a.x >= a.z) return v.x > 0.0 ? 0u : 1u;
+    if (a.y >= a.z) return v.y > 0.0 ? 2u : 3u;
+    return v.z > 0.0 ? 4u : 5u;
+}
+
+// Whether worldPos falls inside a view; used to pick the first cascade that covers it.
+bool shadowViewCovers(uint view, vec3 worldPos) {
+    vec4 clip = shadowViews[view].viewProj * vec4(worldPos, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    return all(lessThanEqual(abs(ndc.xy), vec2(0.98))) && ndc.z >= 0.0 && ndc.z <= 1.0;
+}
+
+// 1 = lit, 0 = in shadow. 3x3 PCF, clamped to the tile so neighbours in the atlas never bleed in.
+float shadowFactor(uint view, vec3 worldPos, float bias) {
+    ShadowView v = shadowViews[view];
+    vec4 clip = v.viewProj * vec4(worldPos, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    if (clip.w <= 0.0 || any(greaterThan(abs(ndc.xy), vec2(1.0))) || ndc.z > 1.0) {
+        return 1.0;
+    }
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    vec2 lo = v.atlasRect.xy + texel * 0.5;
+    vec2 hi = v.atlasRect.xy + v.atlasRect.zw - texel * 0.5;
+    vec2 uv = v.atlasRect.xy + (ndc.xy * 0.5 + 0.5) * v.atlasRect.zw;
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            lit += texture(shadowAtlas, vec3(clamp(uv + vec2(x, y) * texel, lo, hi), ndc.z - bias));
+        }
+    }
+    return lit / 9.0;
+}
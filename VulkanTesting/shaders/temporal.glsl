@@ -0,0 +1,11 @@
+// Producer side of TemporalResolve (Temporal.hpp): what every pass that feeds it writes besides
+// color. Rasterize with TemporalView::jitteredViewProj; compute motion from the unjittered
+// viewProj / previousViewProj (and the object's previous transform, for moving objects).
+
+// Screen motion of a surface point as previous uv minus current uv, the format of the resolve's
+// motion input. uv is 0..1 with y pointing down, like the viewport.
+vec2 temporalMotion(vec4 currentClip, vec4 previousClip) {
+    vec2 current = currentClip.xy / currentClip.w * 0.5 + 0.5;
+    vec2 previous = previousClip.xy / previousClip.w * 0.5 + 0.5;
+    return previous - current;
+}
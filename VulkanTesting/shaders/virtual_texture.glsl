@@ -0,0 +1,39 @@
+// Sampling side of VirtualTexture: a sparse image with memory only behind the tiles recent frames
+// sampled. Every sample marks the tile it wanted in a feedback buffer, which
+// VirtualTexture::update() turns into binds and uploads, and reads no finer than what is resident
+// around it, so unbound tiles are never touched.
+//
+// Include with VT_SET defined to move the bindings to another descriptor set;
+// VirtualTexture::writeDescriptors() fills bindings 0 to 2. Writing feedback from fragment shaders
+// needs fragmentStoresAndAtomics.
+
+#ifndef VT_SET
+#define VT_SET 1
+#endif
+
+layout(set = VT_SET, binding = 0) uniform sampler2D virtualTexture;
+// Mirrors the residency layout in VirtualTexture.cpp.
+layout(std430, set = VT_SET, binding = 1) readonly buffer VirtualResidency {
+    uvec2 vtTiles;          // Tile grid of mip 0; mip m has max(vtTiles >> m, 1).
+    uint vtTailLevel;       // Mips from here on are always resident.
+    uint vtLevels;
+    uint vtLevelOffset[16]; // Where each tiled mip starts in vtFeedback.
+    uint vtResidency[];     // Per mip 0 tile: the finest mip resident there and around it.
+};
+layout(std430, set = VT_SET, binding = 2) writeonly buffer VirtualFeedback { uint vtFeedback[]; };
+
+// lod as textureQueryLod(virtualTexture, uv).y in fragment shaders, or from the pixel footprint
+// elsewhere. level is what was sampled: coarser than lod while the wanted tiles stream in.
+vec4 virtualTextureLod(vec2 uv, float lod, out float level) {
+    uv = clamp(uv, 0.0, 1.0);
+    float wanted = clamp(lod, 0.0, float(vtLevels - 1u));
+    uint mip = uint(wanted);
+    if (mip < vtTailLevel) {
+        uvec2 grid = max(vtTiles >> mip, uvec2(1));
+        uvec2 tile = min(uvec2(uv * vec2(grid)), grid - 1u);
+        vtFeedback[vtLevelOffset[mip] + tile.y * grid.x + tile.x] = 1u;
+    }
+    uvec2 tile = min(uvec2(uv * vec2(vtTiles)), vtTiles - 1u);
+    level = max(wanted, float(vtResidency[tile.y * vtTiles.x + tile.x]));
+    return textureLod(virtualTexture, uv, level);
+}